@@ -4,85 +4,143 @@
 #include "eventloop.hh"
 
 #include <algorithm>
+#include <functional>
 #include <iostream>
+#include <list>
 #include <unistd.h>
 
 using namespace std;
 
-void bidirectional_stream_copy(Socket &socket) {
-    constexpr size_t max_copy_length = 65536;
-    constexpr size_t buffer_size = 1048576;
+static constexpr size_t max_copy_length = 65536;
+static constexpr size_t buffer_size = 1048576;
 
+//! One socket's copy of stdin, and its input on the way to stdout
+struct SocketCopy {
+    Socket &socket;
+    ByteStream outbound;
+    ByteStream inbound;
+    bool outbound_shutdown;
+};
+
+static void stream_copy(const vector<reference_wrapper<Socket>> &sockets) {
     EventLoop _eventloop{};
     FileDescriptor _input{STDIN_FILENO};
     FileDescriptor _output{STDOUT_FILENO};
-    ByteStream _outbound{buffer_size};
-    ByteStream _inbound{buffer_size};
-    bool _outbound_shutdown{false};
+    list<SocketCopy> _copies{};
     bool _inbound_shutdown{false};
 
-    socket.set_blocking(false);
+    for (Socket &socket : sockets) {
+        _copies.push_back({socket, ByteStream{buffer_size}, ByteStream{buffer_size}, false});
+        socket.set_blocking(false);
+    }
     _input.set_blocking(false);
     _output.set_blocking(false);
 
-    // rule 1: read from stdin into outbound byte stream
+    const auto outbound_capacity = [&] {
+        size_t capacity = buffer_size;
+        for (const SocketCopy &copy : _copies) {
+            capacity = min(capacity, copy.outbound.remaining_capacity());
+        }
+        return capacity;
+    };
+    const auto any_error = [&] {
+        return any_of(_copies.begin(), _copies.end(), [](const SocketCopy &copy) {
+            return copy.outbound.error() or copy.inbound.error();
+        });
+    };
+    const auto end_outbound = [&] {
+        for (SocketCopy &copy : _copies) {
+            copy.outbound.end_input();
+        }
+    };
+
+    // rule 1: read from stdin into every outbound byte stream
     _eventloop.add_rule(
         _input,
         Direction::In,
         [&] {
-            _outbound.write(_input.read(_outbound.remaining_capacity()));
+            const string data = _input.read(outbound_capacity());
+            for (SocketCopy &copy : _copies) {
+                copy.outbound.write(data);
+            }
             if (_input.eof()) {
-                _outbound.end_input();
+                end_outbound();
             }
         },
-        [&] { return (not _outbound.error()) and (_outbound.remaining_capacity() > 0) and (not _inbound.error()); },
-        [&] { _outbound.end_input(); });
+        [&] { return (not any_error()) and (outbound_capacity() > 0); },
+        end_outbound);
 
-    // rule 2: read from outbound byte stream into socket
-    _eventloop.add_rule(
-        socket,
-        Direction::Out,
-        [&] {
-            const size_t bytes_to_write = min(max_copy_length, _outbound.buffer_size());
-            const size_t bytes_written = socket.write(_outbound.peek_output(bytes_to_write), false);
-            _outbound.pop_output(bytes_written);
-            if (_outbound.eof()) {
-                socket.shutdown(SHUT_WR);
-                _outbound_shutdown = true;
-            }
-        },
-        [&] { return (not _outbound.buffer_empty()) or (_outbound.eof() and not _outbound_shutdown); },
-        [&] { _outbound.end_input(); });
+    for (SocketCopy &each : _copies) {
+        // rule 2: read from outbound byte stream into socket
+        _eventloop.add_rule(
+            each.socket,
+            Direction::Out,
+            [&copy = each] {
+                const size_t bytes_to_write = min(max_copy_length, copy.outbound.buffer_size());
+                const size_t bytes_written = copy.socket.write(copy.outbound.peek_views(bytes_to_write), false);
+                copy.outbound.pop_output(bytes_written);
+                if (copy.outbound.eof()) {
+                    copy.socket.shutdown(SHUT_WR);
+                    copy.outbound_shutdown = true;
+                }
+            },
+            [&copy = each] {
+                return (not copy.outbound.buffer_empty()) or (copy.outbound.eof() and not copy.outbound_shutdown);
+            },
+            [&copy = each] { copy.outbound.end_input(); });
 
-    // rule 3: read from socket into inbound byte stream
-    _eventloop.add_rule(
-        socket,
-        Direction::In,
-        [&] {
-            _inbound.write(socket.read(_inbound.remaining_capacity()));
-            if (socket.eof()) {
-                _inbound.end_input();
+        // rule 3: read from socket into inbound byte stream
+        _eventloop.add_rule(
+            each.socket,
+            Direction::In,
+            [&copy = each] {
+                copy.inbound.write(copy.socket.read(copy.inbound.remaining_capacity()));
+                if (copy.socket.eof()) {
+                    copy.inbound.end_input();
+                }
+            },
+            [&copy = each] {
+                return (not copy.inbound.error()) and (copy.inbound.remaining_capacity() > 0) and
+                       (not copy.outbound.error());
+            },
+            [&copy = each] { copy.inbound.end_input(); });
+    }
+
+    const auto all_inbound_eof = [&] {
+        return all_of(_copies.begin(), _copies.end(), [](const SocketCopy &copy) { return copy.inbound.eof(); });
+    };
+    const auto next_inbound = [&]() -> ByteStream * {
+        for (SocketCopy &copy : _copies) {
+            if (not copy.inbound.buffer_empty()) {
+                return &copy.inbound;
             }
-        },
-        [&] { return (not _inbound.error()) and (_inbound.remaining_capacity() > 0) and (not _outbound.error()); },
-        [&] { _inbound.end_input(); });
+        }
+        return nullptr;
+    };
 
-    // rule 4: read from inbound byte stream into stdout
+    // rule 4: read from the inbound byte streams into stdout
     _eventloop.add_rule(
         _output,
         Direction::Out,
         [&] {
-            const size_t bytes_to_write = min(max_copy_length, _inbound.buffer_size());
-            const size_t bytes_written = _output.write(_inbound.peek_output(bytes_to_write), false);
-            _inbound.pop_output(bytes_written);
+            ByteStream *_inbound = next_inbound();
+            if (_inbound) {
+                const size_t bytes_to_write = min(max_copy_length, _inbound->buffer_size());
+                const size_t bytes_written = _output.write(_inbound->peek_views(bytes_to_write), false);
+                _inbound->pop_output(bytes_written);
+            }
 
-            if (_inbound.eof()) {
+            if (all_inbound_eof()) {
                 _output.close();
                 _inbound_shutdown = true;
             }
         },
-        [&] { return (not _inbound.buffer_empty()) or (_inbound.eof() and not _inbound_shutdown); },
-        [&] { _inbound.end_input(); });
+        [&] { return next_inbound() or (all_inbound_eof() and not _inbound_shutdown); },
+        [&] {
+            for (SocketCopy &copy : _copies) {
+                copy.inbound.end_input();
+            }
+        });
 
     // loop until completion
     while (true) {
@@ -91,3 +149,11 @@ void bidirectional_stream_copy(Socket &socket) {
         }
     }
 }
+
+void bidirectional_stream_copy(Socket &socket) { stream_copy({socket}); }
+
+//! \details Each socket gets all of stdin. What the sockets send is written to stdout as it arrives, so the
+//! input of different sockets may be interleaved; stdout is closed once every socket has reached EOF.
+void bidirectional_stream_copy(vector<LocalStreamSocket> &sockets) {
+    stream_copy({sockets.begin(), sockets.end()});
+}
@@ -3,7 +3,12 @@
 
 #include "socket.hh"
 
+#include <vector>
+
 //! Copy socket input/output to stdin/stdout until finished
 void bidirectional_stream_copy(Socket &socket);
 
+//! Copy stdin to every socket, and the input of every socket to stdout, until finished
+void bidirectional_stream_copy(std::vector<LocalStreamSocket> &sockets);
+
 #endif  // SPONGE_APPS_BIDIRECTIONAL_STREAM_COPY_HH
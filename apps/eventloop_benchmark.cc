@@ -0,0 +1,147 @@
+#include "address.hh"
+#include "eventloop.hh"
+#include "socket.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static const char *name(const EventLoop::Backend backend) {
+    switch (backend) {
+        case EventLoop::Backend::Poll:
+            return "poll    : ";
+        case EventLoop::Backend::Epoll:
+            return "epoll   : ";
+        default:
+            return "io_uring: ";
+    }
+}
+
+//! Time per wakeup of an EventLoop with `idle` rules whose sockets never become readable, and one whose does
+void wakeup_loop(const EventLoop::Backend backend, const size_t idle) {
+    constexpr unsigned rounds = 2000;
+
+    EventLoop loop{backend};
+    vector<UDPSocket> sockets(idle);
+    for (UDPSocket &socket : sockets) {
+        loop.add_rule(socket, Direction::In, [&socket] { socket.recv(); });
+    }
+    UDPSocket receiver, sender;
+    receiver.bind(Address{"127.0.0.1", 0});
+    const Address destination = receiver.local_address();
+    UDPSocket::received_datagram datagram{Address{"0"}, {}};
+    loop.add_rule(receiver, Direction::In, [&] { receiver.recv(datagram); });
+
+    const auto first_time = high_resolution_clock::now();
+    for (unsigned i = 0; i < rounds; i++) {
+        sender.sendto(destination, string{"x"});
+        if (loop.wait_next_event(-1) != EventLoop::Result::Success) {
+            throw runtime_error("wakeup_loop: no event");
+        }
+    }
+    const auto final_time = high_resolution_clock::now();
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+    cout << fixed << setprecision(2) << name(backend) << setw(5) << idle + 1
+         << " rules, one ready: " << double(duration) / 1000.0 / rounds << " us per wakeup\n";
+}
+
+//! Time and system calls per datagram sent and received over loopback in bursts of `burst`: one sendto and one
+//! wakeup and recv per datagram with a readiness backend, against sends queued and receives kept posted with
+//! io_uring. The system calls are the loop's own and the benchmark's sendto and recv calls.
+void datagram_loop(const EventLoop::Backend backend, const size_t burst) {
+    constexpr unsigned rounds = 2000;
+
+    EventLoop loop{backend};
+    UDPSocket sender, receiver;
+    receiver.bind(Address{"127.0.0.1", 0});
+    const Address destination = receiver.local_address();
+    const string payload(1000, 'x');
+    size_t received = 0;
+    UDPSocket::received_datagram datagram{Address{"0"}, {}};
+    if (backend == EventLoop::Backend::IoUring) {
+        loop.add_datagram_rule(receiver, [&](vector<EventLoop::Datagram> &datagrams) { received += datagrams.size(); });
+    } else {
+        loop.add_rule(receiver, Direction::In, [&] {
+            receiver.recv(datagram);
+            received++;
+        });
+    }
+
+    const auto system_calls = [&] { return loop.system_calls() + sender.write_count() + receiver.read_count(); };
+    const uint64_t first_calls = system_calls();
+    const auto first_time = high_resolution_clock::now();
+    for (unsigned i = 0; i < rounds; i++) {
+        for (size_t k = 0; k < burst; k++) {
+            if (backend == EventLoop::Backend::IoUring) {
+                loop.send(sender, string{payload}, destination);
+            } else {
+                sender.sendto(destination, payload);
+            }
+        }
+        const size_t target = (i + 1) * burst;
+        while (received < target) {
+            if (loop.wait_next_event(1000) != EventLoop::Result::Success) {
+                throw runtime_error("datagram_loop: datagram lost");
+            }
+        }
+    }
+    const auto final_time = high_resolution_clock::now();
+    const uint64_t calls = system_calls() - first_calls;
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+    cout << fixed << setprecision(2) << name(backend) << "bursts of " << setw(3) << burst << " datagrams: "
+         << double(duration) / 1000.0 / rounds / burst << " us and " << setprecision(3)
+         << double(calls) / rounds / burst << " system calls per datagram\n";
+}
+
+int main() {
+    try {
+        // one socket per rule: allow as many as the hard limit does
+        rlimit limit{};
+        getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+
+        // io_uring may not be available, or not allowed (e.g. by a seccomp filter)
+        vector<EventLoop::Backend> backends{EventLoop::Backend::Poll, EventLoop::Backend::Epoll};
+        try {
+            const EventLoop probe{EventLoop::Backend::IoUring};
+            backends.push_back(EventLoop::Backend::IoUring);
+        } catch (const unix_error &e) {
+            cout << "skipping io_uring: " << e.what() << "\n";
+        }
+
+        for (const size_t burst : {1, 8, 64}) {
+            for (const auto backend : backends) {
+                if (backend != EventLoop::Backend::Poll) {
+                    datagram_loop(backend, burst);
+                }
+            }
+        }
+
+        for (const size_t idle : {10, 100, 1000, 10000, 60000}) {
+            if (idle + 16 > limit.rlim_cur) {
+                cout << "skipping " << idle + 1 << " rules: only " << limit.rlim_cur << " file descriptors allowed\n";
+                break;
+            }
+            for (const auto backend : backends) {
+                wakeup_loop(backend, idle);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -3,11 +3,13 @@
 #include "bidirectional_stream_copy.hh"
 #include "router.hh"
 #include "tcp_over_ip.hh"
+#include "tcp_sponge_listener.cc"
 #include "tcp_sponge_socket.cc"
 #include "util.hh"
 
 #include <cstdlib>
 #include <iostream>
+#include <optional>
 #include <thread>
 
 using namespace std;
@@ -83,13 +85,25 @@ class NetworkInterfaceAdapter : public TCPOverIPv4Adapter {
         }
     }
 
-  public:
-    NetworkInterfaceAdapter(const Address &ip_address, const Address &next_hop)
-        : _interface(random_host_ethernet_address(), ip_address), _next_hop(next_hop) {}
+    void send_pending(EventLoop &loop) {
+        while (not _interface.frames_out().empty()) {
+            loop.send(_data_socket_pair.first, _interface.frames_out().front().serialize());
+            _interface.frames_out().pop();
+        }
+    }
 
-    optional<TCPSegment> read() {
+    // like the other adapters, this does not wait for a frame
+    string read_frame() {
+        string frame(65536, '\0');
+        const ssize_t len = SystemCall(
+            "recv", ::recv(_data_socket_pair.first.fd_num(), frame.data(), frame.size(), MSG_DONTWAIT), EAGAIN);
+        frame.resize(len < 0 ? 0 : len);
+        return frame;
+    }
+
+    optional<InternetDatagram> receive_frame(EventLoop::Datagram &&datagram) {
         EthernetFrame frame;
-        if (frame.parse(_data_socket_pair.first.read()) != ParseResult::NoError) {
+        if (frame.parse(move(datagram.payload)) != ParseResult::NoError) {
             return {};
         }
 
@@ -99,7 +113,18 @@ class NetworkInterfaceAdapter : public TCPOverIPv4Adapter {
         // The incoming frame may have caused the NetworkInterface to send a frame
         send_pending();
 
+        return ip_dgram;
+    }
+
+  public:
+    NetworkInterfaceAdapter(const Address &ip_address, const Address &next_hop)
+        : _interface(random_host_ethernet_address(), ip_address), _next_hop(next_hop) {}
+
+    optional<TCPSegment> read() { return received({read_frame(), {}}); }
+
+    optional<TCPSegment> received(EventLoop::Datagram &&datagram) {
         // Try to interpret IPv4 datagram as TCP
+        optional<InternetDatagram> ip_dgram = receive_frame(move(datagram));
         if (ip_dgram) {
             return unwrap_tcp_in_ip(ip_dgram.value());
         }
@@ -110,6 +135,30 @@ class NetworkInterfaceAdapter : public TCPOverIPv4Adapter {
         _interface.send_datagram(wrap_tcp_in_ip(seg), _next_hop);
         send_pending();
     }
+    void write(TCPSegment &seg, EventLoop &loop) {
+        _interface.send_datagram(wrap_tcp_in_ip(seg), _next_hop);
+        send_pending(loop);
+    }
+
+    // unfiltered mode, for a TCPSpongeListener
+    optional<pair<FourTuple, TCPSegment>> read_from_any() { return received_from_any({read_frame(), {}}); }
+
+    optional<pair<FourTuple, TCPSegment>> received_from_any(EventLoop::Datagram &&datagram) {
+        optional<InternetDatagram> ip_dgram = receive_frame(move(datagram));
+        if (ip_dgram) {
+            return unwrap_any_tcp_in_ip(ip_dgram.value());
+        }
+
+        return {};
+    }
+    void write_to(const FourTuple &tuple, TCPSegment &seg) {
+        _interface.send_datagram(TCPDemux::wrap(tuple, seg), _next_hop);
+        send_pending();
+    }
+    void write_to(const FourTuple &tuple, TCPSegment &seg, EventLoop &loop) {
+        _interface.send_datagram(TCPDemux::wrap(tuple, seg), _next_hop);
+        send_pending(loop);
+    }
     void tick(const size_t ms_since_last_tick) {
         _interface.tick(ms_since_last_tick);
         send_pending();
@@ -140,19 +189,24 @@ class TCPSocketLab7 : public TCPSpongeSocket<NetworkInterfaceAdapter> {
         TCPSpongeSocket<NetworkInterfaceAdapter>::connect({}, multiplexer_config);
     }
 
-    void bind(const Address &address) {
-        if (address.ip() != _local_address.ip()) {
+    NetworkInterfaceAdapter &adapter() { return _datagram_adapter; }
+};
+
+class TCPListenerLab7 : public TCPSpongeListener<NetworkInterfaceAdapter> {
+    static FdAdapterConfig bind(const Address &ip_address, const Address &address) {
+        if (address.ip() != ip_address.ip()) {
             throw runtime_error("Cannot bind to " + address.to_string());
         }
-        _local_address = Address{_local_address.ip(), address.port()};
-    }
-
-    void listen_and_accept() {
         FdAdapterConfig multiplexer_config;
-        multiplexer_config.source = _local_address;
-        TCPSpongeSocket<NetworkInterfaceAdapter>::listen_and_accept({}, multiplexer_config);
+        multiplexer_config.source = address;
+        return multiplexer_config;
     }
 
+  public:
+    TCPListenerLab7(const Address &ip_address, const Address &next_hop, const Address &address)
+        : TCPSpongeListener<NetworkInterfaceAdapter>(
+              NetworkInterfaceAdapter(ip_address, next_hop), {}, bind(ip_address, address)) {}
+
     NetworkInterfaceAdapter &adapter() { return _datagram_adapter; }
 };
 
@@ -184,9 +238,15 @@ void program_body(bool is_client, const string &bounce_host, const string &bounc
         router.add_route(Address{"192.168.0.0"}.ipv4_numeric(), 16, Address{"10.0.0.192"}, internet_side);
     }
 
-    /* set up the client */
-    TCPSocketLab7 sock =
-        is_client ? TCPSocketLab7{{"192.168.0.50"}, {"192.168.0.1"}} : TCPSocketLab7{{"172.16.0.100"}, {"172.16.0.1"}};
+    /* set up the client, or the server */
+    optional<TCPSocketLab7> client;
+    optional<TCPListenerLab7> server;
+    if (is_client) {
+        client.emplace(Address{"192.168.0.50"}, Address{"192.168.0.1"});
+    } else {
+        server.emplace(Address{"172.16.0.100"}, Address{"172.16.0.1"}, Address{"172.16.0.100", 1234});
+    }
+    NetworkInterfaceAdapter &adapter = is_client ? client->adapter() : server->adapter();
 
     atomic<bool> exit_flag{};
 
@@ -195,9 +255,9 @@ void program_body(bool is_client, const string &bounce_host, const string &bounc
         try {
             EventLoop event_loop;
             // Frames from host to router
-            event_loop.add_rule(sock.adapter().frame_fd(), Direction::In, [&] {
+            event_loop.add_rule(adapter.frame_fd(), Direction::In, [&] {
                 EthernetFrame frame;
-                if (frame.parse(sock.adapter().frame_fd().read()) != ParseResult::NoError) {
+                if (frame.parse(adapter.frame_fd().read()) != ParseResult::NoError) {
                     return;
                 }
                 if (debug) {
@@ -209,14 +269,14 @@ void program_body(bool is_client, const string &bounce_host, const string &bounc
 
             // Frames from router to host
             event_loop.add_rule(
-                sock.adapter().frame_fd(),
+                adapter.frame_fd(),
                 Direction::Out,
                 [&] {
                     auto &f = router.interface(host_side).frames_out();
                     if (debug) {
                         cerr << "     Router->host:     " << summary(f.front()) << "\n";
                     }
-                    sock.adapter().frame_fd().write(f.front().serialize());
+                    adapter.frame_fd().write(f.front().serialize());
                     f.pop();
                 },
                 [&] { return not router.interface(host_side).frames_out().empty(); });
@@ -266,14 +326,15 @@ void program_body(bool is_client, const string &bounce_host, const string &bounc
 
     try {
         if (is_client) {
-            sock.connect({"172.16.0.100", 1234});
+            client->connect({"172.16.0.100", 1234});
+            bidirectional_stream_copy(client.value());
+            client->wait_until_closed();
         } else {
-            sock.bind({"172.16.0.100", 1234});
-            sock.listen_and_accept();
+            LocalStreamSocket connection = server->accept();
+            bidirectional_stream_copy(connection);
+            connection.close();
+            server->wait_until_closed();
         }
-
-        bidirectional_stream_copy(sock);
-        sock.wait_until_closed();
     } catch (const exception &e) {
         cerr << "Exception: " << e.what() << "\n";
     }
@@ -1,5 +1,6 @@
 #include "bidirectional_stream_copy.hh"
 #include "tcp_config.hh"
+#include "tcp_sponge_listener.hh"
 #include "tcp_sponge_socket.hh"
 #include "tun.hh"
 
@@ -34,9 +35,13 @@ static void show_usage(const char *argv0, const char *msg) {
 
          << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
 
+         << "   -C <algo>       Congestion control: newreno, cubic, bbr or none (none)\n\n"
+
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
+         << "   -U              Receive and send datagrams through io_uring     (epoll)\n\n"
+
          << "   -h              Show this message.\n\n";
 
     if (msg != nullptr) {
@@ -93,6 +98,16 @@ static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char
             tundev = argv[curr + 1];
             curr += 2;
 
+        } else if (strncmp("-C", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -C requires one argument.");
+            const auto algorithm = congestion_control_from_name(argv[curr + 1]);
+            if (not algorithm) {
+                show_usage(argv[0], "ERROR: unknown congestion control algorithm.");
+                exit(1);
+            }
+            c_fsm.congestion_control = *algorithm;
+            curr += 2;
+
         } else if (strncmp("-Lu", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -Lu requires one argument.");
             float lossrate = strtof(argv[curr + 1], nullptr);
@@ -109,6 +124,10 @@ static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char
                 static_cast<LossRateDnT>(static_cast<float>(numeric_limits<LossRateDnT>::max()) * lossrate);
             curr += 2;
 
+        } else if (strncmp("-U", argv[curr], 3) == 0) {
+            c_filt.io_uring = true;
+            curr += 1;
+
         } else if (strncmp("-h", argv[curr], 3) == 0) {
             show_usage(argv[0], nullptr);
             exit(0);
@@ -142,15 +161,23 @@ int main(int argc, char **argv) {
         }
 
         auto [c_fsm, c_filt, listen, tun_dev_name] = get_config(argc, argv);
-        LossyTCPOverIPv4SpongeSocket tcp_socket(LossyTCPOverIPv4OverTunFdAdapter(
-            TCPOverIPv4OverTunFdAdapter(TunFD(tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name))));
+        TunFD tun(tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name);
 
         if (listen) {
-            tcp_socket.listen_and_accept(c_fsm, c_filt);
-        } else {
-            tcp_socket.connect(c_fsm, c_filt);
+            // the demultiplexer answers SYNs, so that a flood of them gets cookies rather than connections
+            LossyTCPOverIPv4SpongeListener listener(
+                LossyTCPOverIPv4OverTunFdAdapter(TCPOverIPv4OverTunFdAdapter(move(tun))), c_fsm, c_filt);
+            LocalStreamSocket connection = listener.accept();
+            bidirectional_stream_copy(connection);
+            connection.close();
+            listener.wait_until_closed();
+            return EXIT_SUCCESS;
         }
 
+        LossyTCPOverIPv4SpongeSocket tcp_socket(
+            LossyTCPOverIPv4OverTunFdAdapter(TCPOverIPv4OverTunFdAdapter(move(tun))));
+        tcp_socket.connect(c_fsm, c_filt);
+
         bidirectional_stream_copy(tcp_socket);
         tcp_socket.wait_until_closed();
     } catch (const exception &e) {
@@ -1,5 +1,6 @@
 #include "bidirectional_stream_copy.hh"
 #include "tcp_config.hh"
+#include "tcp_sponge_listener.hh"
 #include "tcp_sponge_socket.hh"
 
 #include <cstdlib>
@@ -9,6 +10,7 @@
 #include <random>
 #include <string>
 #include <tuple>
+#include <vector>
 
 using namespace std;
 
@@ -23,14 +25,21 @@ static void show_usage(const char *argv0, const char *msg) {
          << "   -l              Server (listen) mode.                           (client mode)\n"
          << "                   In server mode, <host>:<port> is the address to bind.\n\n"
 
+         << "   -n <conns>      Server mode: accept <conns> connections; each   1\n"
+         << "                   gets stdin, and what each sends goes to stdout.\n\n"
+
          << "   -w <winsz>      Use a window of <winsz> bytes                   " << TCPConfig::MAX_PAYLOAD_SIZE
          << "\n\n"
 
          << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
+         << "   -C <algo>       Congestion control: newreno, cubic, bbr or none (none)\n\n"
+
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
+         << "   -U              Receive and send datagrams through io_uring     (epoll)\n\n"
+
          << "   -h              Show this message and quit.\n\n";
 
     if (msg != nullptr) {
@@ -46,18 +55,24 @@ static void check_argc(int argc, char **argv, int curr, const char *err) {
     }
 }
 
-static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv) {
+static tuple<TCPConfig, FdAdapterConfig, bool, size_t> get_config(int argc, char **argv) {
     TCPConfig c_fsm{};
     FdAdapterConfig c_filt{};
 
     int curr = 1;
     bool listen = false;
+    size_t connections = 1;
 
     while (argc - curr > 2) {
         if (strncmp("-l", argv[curr], 3) == 0) {
             listen = true;
             curr += 1;
 
+        } else if (strncmp("-n", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -n requires one argument.");
+            connections = strtoul(argv[curr + 1], nullptr, 0);
+            curr += 2;
+
         } else if (strncmp("-w", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -w requires one argument.");
             c_fsm.recv_capacity = strtol(argv[curr + 1], nullptr, 0);
@@ -68,6 +83,16 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
             c_fsm.rt_timeout = strtol(argv[curr + 1], nullptr, 0);
             curr += 2;
 
+        } else if (strncmp("-C", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -C requires one argument.");
+            const auto algorithm = congestion_control_from_name(argv[curr + 1]);
+            if (not algorithm) {
+                show_usage(argv[0], "ERROR: unknown congestion control algorithm.");
+                exit(1);
+            }
+            c_fsm.congestion_control = *algorithm;
+            curr += 2;
+
         } else if (strncmp("-Lu", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -Lu requires one argument.");
             float lossrate = strtof(argv[curr + 1], nullptr);
@@ -84,6 +109,10 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
                 static_cast<LossRateDnT>(static_cast<float>(numeric_limits<LossRateDnT>::max()) * lossrate);
             curr += 2;
 
+        } else if (strncmp("-U", argv[curr], 3) == 0) {
+            c_filt.io_uring = true;
+            curr += 1;
+
         } else if (strncmp("-h", argv[curr], 3) == 0) {
             show_usage(argv[0], nullptr);
             exit(0);
@@ -100,7 +129,7 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
         c_filt.destination = {argv[argc - 2], argv[argc - 1]};
     }
 
-    return make_tuple(c_fsm, c_filt, listen);
+    return make_tuple(c_fsm, c_filt, listen, connections);
 }
 
 int main(int argc, char **argv) {
@@ -111,19 +140,28 @@ int main(int argc, char **argv) {
         }
 
         // handle configuration and UDP setup from cmdline arguments
-        auto [c_fsm, c_filt, listen] = get_config(argc, argv);
+        auto [c_fsm, c_filt, listen, connections] = get_config(argc, argv);
 
         // build a TCP FSM on top of the UDP socket
         UDPSocket udp_sock;
         if (listen) {
+            // a server takes any number of connections on its port, through a demultiplexer
             udp_sock.bind(c_filt.source);
+            LossyTCPOverUDPSpongeListener listener(
+                LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(move(udp_sock))), c_fsm, c_filt);
+            vector<LocalStreamSocket> sockets;
+            while (sockets.size() < connections) {
+                sockets.push_back(listener.accept());
+            }
+
+            bidirectional_stream_copy(sockets);
+            sockets.clear();
+            listener.wait_until_closed();
+            return EXIT_SUCCESS;
         }
+
         LossyTCPOverUDPSpongeSocket tcp_socket(LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(move(udp_sock))));
-        if (listen) {
-            tcp_socket.listen_and_accept(c_fsm, c_filt);
-        } else {
-            tcp_socket.connect(c_fsm, c_filt);
-        }
+        tcp_socket.connect(c_fsm, c_filt);
 
         bidirectional_stream_copy(tcp_socket);
         tcp_socket.wait_until_closed();
@@ -1,6 +1,8 @@
 #include <stdexcept>
 #include "byte_stream.hh"
 
+#include <algorithm>
+
 // Dummy implementation of a flow-controlled in-memory byte stream.
 
 // For Lab 0, please replace with a real implementation that passes the
@@ -14,31 +16,162 @@ void DUMMY_CODE(Targs &&.../* unused */) {}
 
 using namespace std;
 
-ByteStream::ByteStream(const size_t capacity)
-    : _queue(), _capacity_size(capacity), _written_size(0), _read_size(0), _end_input(false), _error(false) {}
+// 向上取整到 2 的幂，这样环形缓冲区的下标可以用位与来回绕
+static size_t round_up_to_power_of_two(const size_t n) {
+    size_t size = 1;
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+ByteStream::ByteStream(const size_t capacity, const Mode mode)
+    : _mode(mode)
+    , _buffer(mode == Mode::Ring ? round_up_to_power_of_two(capacity) : 1)
+    , _mask(_buffer.size() - 1)
+    , _capacity_size(capacity)
+    , _written_size(0)
+    , _read_size(0)
+    , _end_input(false)
+    , _error(false) {}
+
+void ByteStream::copy_out(char *dst, const size_t offset, const size_t len) const {
+    const size_t start = (_head + offset) & _mask;
+    const size_t first = min(len, _buffer.size() - start);  // 第一段：从 start 到缓冲区末尾
+    memcpy(dst, _buffer.data() + start, first);
+    memcpy(dst + first, _buffer.data(), len - first);  // 第二段：回绕到缓冲区开头
+}
+
+void ByteStream::copy_in(const size_t offset, const char *src, const size_t len) {
+    const size_t start = (_head + offset) & _mask;
+    const size_t first = min(len, _buffer.size() - start);
+    memcpy(_buffer.data() + start, src, first);
+    memcpy(_buffer.data(), src + first, len - first);
+}
+
+void ByteStream::set_capacity(const size_t capacity) {
+    if (capacity < _size) {
+        throw out_of_range("ByteStream::set_capacity");
+    }
+    _capacity_size = capacity;
+    const size_t slots = round_up_to_power_of_two(capacity);
+    if (_mode == Mode::Chunked || slots == _buffer.size()) {
+        return;
+    }
+    // 换一个环形缓冲区，从队头开始的字节（包括 write_ahead 放好的）搬到新缓冲区开头
+    vector<char> buffer(slots);
+    copy_out(buffer.data(), 0, min(slots, _buffer.size()));
+    _buffer = move(buffer);
+    _mask = slots - 1;
+    _head = 0;
+}
 
-size_t ByteStream::write(const string &data) {
+size_t ByteStream::write(const string_view data) {
     if (_end_input)
         return 0;
-    size_t write_size = min(data.size(), _capacity_size - _queue.size());
+    size_t write_size = min(data.size(), remaining_capacity());
+    if (write_size == 0)
+        return 0;
+    if (_mode == Mode::Chunked) {
+        _chunks.emplace_back(string(data.substr(0, write_size)));
+    } else {
+        copy_in(_size, data.data(), write_size);
+    }
+    _size += write_size;
     _written_size += write_size;
-    for (size_t i = 0; i < write_size; i++)
-        _queue.push_back(data[i]);
     return write_size;
 }
 
+size_t ByteStream::write(Buffer &&data) {
+    if (_end_input)
+        return 0;
+    size_t write_size = min(data.size(), remaining_capacity());
+    if (write_size == 0)
+        return 0;
+    if (_mode == Mode::Chunked) {
+        data.remove_suffix(data.size() - write_size); // 放不下的部分丢掉，不用拷贝
+        _chunks.push_back(move(data));
+    } else {
+        copy_in(_size, data.str().data(), write_size);
+    }
+    _size += write_size;
+    _written_size += write_size;
+    return write_size;
+}
+
+//! \param[in] offset is counted from the end of the readable bytes
+//! \param[in] data is copied into the ring but stays invisible to the reader until commit()
+void ByteStream::write_ahead(const size_t offset, const string_view data) {
+    if (_mode != Mode::Ring) {
+        throw runtime_error("ByteStream::write_ahead: only supported in Mode::Ring");
+    }
+    if (_end_input) {
+        throw runtime_error("ByteStream::write_ahead: input has ended");
+    }
+    if (offset + data.size() > remaining_capacity()) {
+        throw out_of_range("ByteStream::write_ahead");
+    }
+    copy_in(_size + offset, data.data(), data.size());
+}
+
+//! \param[in] len bytes placed by write_ahead() become readable
+void ByteStream::commit(const size_t len) {
+    if (_mode != Mode::Ring) {
+        throw runtime_error("ByteStream::commit: only supported in Mode::Ring");
+    }
+    if (_end_input) {
+        throw runtime_error("ByteStream::commit: input has ended");
+    }
+    if (len > remaining_capacity()) {
+        throw out_of_range("ByteStream::commit");
+    }
+    _size += len;
+    _written_size += len;
+}
+
 //! \param[in] len bytes will be copied from the output side of the buffer
 string ByteStream::peek_output(const size_t len) const {
-    size_t pop_size = min(len, _queue.size()); // 不一定有 len 个
-    return string(_queue.begin(), _queue.begin() + pop_size);
+    size_t peek_size = min(len, _size); // 不一定有 len 个
+    if (_mode == Mode::Chunked) {
+        return peek_buffers(peek_size).concatenate();
+    }
+    string data(peek_size, 0);
+    copy_out(data.data(), 0, peek_size);
+    return data;
+}
+
+//! \param[in] len bytes will be viewed from the output side of the buffer
+array<string_view, 2> ByteStream::peek_views(const size_t len) const {
+    size_t peek_size = min(len, _size);
+    if (_mode == Mode::Chunked) {
+        array<string_view, 2> views{};
+        for (size_t i = 0; i < views.size() && i < _chunks.size() && peek_size > 0; i++) {
+            views[i] = _chunks[i].str().substr(0, peek_size);
+            peek_size -= views[i].size();
+        }
+        return views;
+    }
+    const size_t first = min(peek_size, _buffer.size() - _head); // 第一段到缓冲区末尾，剩下的回绕到开头
+    return {string_view(_buffer.data() + _head, first), string_view(_buffer.data(), peek_size - first)};
 }
 
 //! \param[in] len bytes will be removed from the output side of the buffer
 void ByteStream::pop_output(const size_t len) {
-    size_t pop_size = min(len, _queue.size());
-    _read_size += len; // // 要读的长度大于字节流长度，读出的大小定义为要读的长度
-    for (size_t i = 0; i < pop_size; i++)
-        _queue.pop_front();
+    size_t pop_size = min(len, _size);
+    _read_size += pop_size; // 要读的长度大于字节流长度时，只能读出字节流中已有的
+    _size -= pop_size;
+    if (_mode == Mode::Ring) {
+        _head = (_head + pop_size) & _mask;
+        return;
+    }
+    while (pop_size > 0) { // 整个 Buffer 读完了就出队，否则只去掉前缀
+        if (pop_size < _chunks.front().size()) {
+            _chunks.front().remove_prefix(pop_size);
+            break;
+        }
+        pop_size -= _chunks.front().size();
+        _chunks.pop_front();
+    }
 }
 
 //! Read (i.e., copy and then pop) the next "len" bytes of the stream
@@ -50,18 +183,44 @@ std::string ByteStream::read(const size_t len) {
     return data;
 }
 
+//! \param[in] len bytes will be viewed from the output side of the buffer
+//! \note In Mode::Chunked the returned Buffers share storage with the stream; in Mode::Ring the bytes are copied once
+BufferList ByteStream::peek_buffers(const size_t len) const {
+    size_t peek_size = min(len, _size);
+    if (_mode == Mode::Ring) {
+        return BufferList(peek_output(peek_size));
+    }
+    BufferList ret;
+    for (auto it = _chunks.begin(); peek_size > 0; ++it) {
+        Buffer piece = *it;
+        if (peek_size < piece.size()) {
+            piece.remove_suffix(piece.size() - peek_size);
+        }
+        peek_size -= piece.size();
+        ret.append(piece);
+    }
+    return ret;
+}
+
+//! \param[in] len bytes will be popped and returned
+BufferList ByteStream::read_buffers(const size_t len) {
+    BufferList data = peek_buffers(len);
+    pop_output(len);
+    return data;
+}
+
 void ByteStream::end_input() { _end_input = true; }
 
 bool ByteStream::input_ended() const { return _end_input; }
 
-size_t ByteStream::buffer_size() const { return _queue.size(); }
+size_t ByteStream::buffer_size() const { return _size; }
 
-bool ByteStream::buffer_empty() const { return _queue.empty(); }
+bool ByteStream::buffer_empty() const { return _size == 0; }
 
-bool ByteStream::eof() const { return _end_input && _queue.empty(); }
+bool ByteStream::eof() const { return _end_input && _size == 0; }
 
 size_t ByteStream::bytes_written() const { return _written_size; }
 
 size_t ByteStream::bytes_read() const { return _read_size; }
 
-size_t ByteStream::remaining_capacity() const { return _capacity_size - _queue.size(); }
\ No newline at end of file
+size_t ByteStream::remaining_capacity() const { return _capacity_size - _size; }
\ No newline at end of file
@@ -1,38 +1,78 @@
 #ifndef SPONGE_LIBSPONGE_BYTE_STREAM_HH
 #define SPONGE_LIBSPONGE_BYTE_STREAM_HH
 
+#include "buffer.hh"
+
+#include <array>
 #include <cstring>
+#include <deque>
 #include <string>
-#include <queue>
+#include <string_view>
+#include <vector>
 //! \brief An in-order byte stream.
 
 //! Bytes are written on the "input" side and read from the "output"
 //! side.  The byte stream is finite: the writer can end the input,
 //! and then no more bytes can be written.
 class ByteStream {
+  public:
+    //! How the stream stores the bytes that have been written but not yet read
+    enum class Mode {
+        Ring,    //!< Copy into a fixed ring buffer (good for many small writes)
+        Chunked  //!< Keep a queue of the written Buffers, so writes and reads share storage instead of copying
+    };
+
   private:
 
-    std::deque<char> _queue;  // char类型双端队列，即字节流（缓冲区）
-    size_t _capacity_size;    // 缓冲区容量
-    size_t _written_size;     // 已经写的数据的大小
-    size_t _read_size;        // 已经读的数据的大小
-    bool _end_input;          // 终止写入
-    bool _error{};            // 字节流发生错误
+    Mode _mode;                 // 存储方式
+    std::vector<char> _buffer;  // 环形缓冲区，大小为不小于容量的 2 的幂
+    size_t _mask;               // _buffer.size() - 1，用位与代替取模
+    size_t _head{0};            // 队头（下一个要读的字节）在 _buffer 中的位置
+    size_t _size{0};            // 缓冲区中当前的字节数
+    std::deque<Buffer> _chunks{};  // Chunked 模式下写入的 Buffer 队列，队头是下一个要读的
+    size_t _capacity_size;      // 缓冲区容量
+    size_t _written_size;       // 已经写的数据的大小
+    size_t _read_size;          // 已经读的数据的大小
+    bool _end_input;            // 终止写入
+    bool _error{};              // 字节流发生错误
 
+    // 从队头之后第 offset 个字节开始，拷贝 len 个字节到 dst，最多两次 memcpy
+    void copy_out(char *dst, const size_t offset, const size_t len) const;
+
+    // 把 src 的 len 个字节拷贝到队头之后第 offset 个字节开始的位置，最多两次 memcpy
+    void copy_in(const size_t offset, const char *src, const size_t len);
 
   public:
     //! Construct a stream with room for `capacity` bytes.
-    ByteStream(const size_t capacity);
+    ByteStream(const size_t capacity, const Mode mode = Mode::Ring);
 
     //! \name "Input" interface for the writer
     //!@{
 
     // 往字节流中写数据，返回写入的大小（不一定等于数据大小）
-    size_t write(const std::string &data);
+    size_t write(const std::string &data) { return write(std::string_view(data)); }
+    size_t write(const char *data) { return write(std::string_view(data)); }
+    size_t write(const std::string_view data);
+
+    // 写入一个 Buffer，Chunked 模式下直接保存（不拷贝），返回写入的大小
+    size_t write(Buffer &&data);
+
+    // （仅 Ring 模式）把 data 放到已缓存数据之后第 offset 个字节开始的位置，但还不能被读出
+    // 用于乱序重组时直接把字节放到最终位置，offset + data.size() 不能超过剩余空间，end_input() 之后不能再调用
+    void write_ahead(const size_t offset, const std::string_view data);
+
+    // （仅 Ring 模式）让 write_ahead 放好的接下来 len 个字节可以被读出，不用拷贝。end_input() 之后调用会抛异常
+    void commit(const size_t len);
 
     // 字节流的剩余空间，目前还可以写多少个字节
     size_t remaining_capacity() const;
 
+    // 改变容量，不能小于缓冲区中的字节数。Ring 模式下环形缓冲区跟着变大或变小，write_ahead 放好的字节保留
+    void set_capacity(const size_t capacity);
+
+    // 容量
+    size_t capacity() const { return _capacity_size; }
+
     // 字节流关闭，不能写入
     void end_input();
 
@@ -45,6 +85,11 @@ class ByteStream {
     // 查看接下来的 len 个字节，即队头前 len 个
     std::string peek_output(const size_t len) const;
 
+    // 不分配内存地查看接下来最多 len 个字节，返回最多两段连续的视图（可直接交给 writev）
+    // Ring 模式下两段之和为 min(len, buffer_size())；Chunked 模式下只覆盖前两个 Buffer，可能更少
+    // 视图在下一次 write/pop 之前有效
+    std::array<std::string_view, 2> peek_views(const size_t len) const;
+
     // 从字节流pop len 个字节
     void pop_output(const size_t len);
 
@@ -52,6 +97,12 @@ class ByteStream {
     //! \returns a string
     std::string read(const size_t len);
 
+    // 查看接下来的 len 个字节，Chunked 模式下与写入的 Buffer 共享存储
+    BufferList peek_buffers(const size_t len) const;
+
+    // 读出（peek 然后 pop）接下来的 len 个字节，Chunked 模式下不拷贝
+    BufferList read_buffers(const size_t len);
+
     // 字节流是否关闭
     bool input_ended() const;
 
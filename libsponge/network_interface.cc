@@ -38,21 +38,9 @@ void NetworkInterface::send_datagram(const InternetDatagram &dgram, const Addres
     if (arp_iter == _arp_table.end()) {
         // 则发送 ARP 包
         if (_waiting_arp_response_ip_addr.find(next_hop_ip) == _waiting_arp_response_ip_addr.end()) {
-            ARPMessage arp_request;
-            arp_request.opcode = ARPMessage::OPCODE_REQUEST;
-            arp_request.sender_ethernet_address = _ethernet_address;
-            arp_request.sender_ip_address = _ip_address.ipv4_numeric();
-            arp_request.target_ethernet_address = {/* 这里应该置为空*/};
-            arp_request.target_ip_address = next_hop_ip;
-
-            EthernetFrame eth_frame;
-            eth_frame.header() = {/* dst  */ ETHERNET_BROADCAST,
-                                  /* src  */ _ethernet_address,
-                                  /* type */ EthernetHeader::TYPE_ARP};
-            eth_frame.payload() = arp_request.serialize();
-            _frames_out.push(eth_frame);
-
-            _waiting_arp_response_ip_addr[next_hop_ip] = _arp_response_default_ttl;
+            send_arp_request(next_hop_ip);
+            _waiting_arp_response_ip_addr[next_hop_ip] =
+                _timers.arm(_arp_response_default_ttl, ARP_Timer{next_hop_ip, true});
         }
 
         // 将该 IP 包加入等待队列中
@@ -113,7 +101,13 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
         // 否则是一个 ARP 响应包
         //! NOTE: 我们可以同时从 ARP 请求和响应包中获取到新的 ARP 表项
         if (is_valid_arp_request || is_valid_arp_response) {
-            _arp_table[src_ip_addr] = {src_eth_addr, _arp_entry_default_ttl};
+            // 已有的条目换成新地址，从现在起重新计时
+            const auto old_entry = _arp_table.find(src_ip_addr);
+            if (old_entry != _arp_table.end()) {
+                _timers.cancel(old_entry->second.expiry);
+            }
+            _arp_table[src_ip_addr] = {src_eth_addr,
+                                       _timers.arm(_arp_entry_default_ttl, ARP_Timer{src_ip_addr, false})};
             // 将对应数据从原先等待队列里删除
             for (auto iter = _waiting_arp_internet_datagrams.begin(); iter != _waiting_arp_internet_datagrams.end();
                  /* nop */) {
@@ -123,7 +117,11 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
                 } else
                     ++iter;
             }
-            _waiting_arp_response_ip_addr.erase(src_ip_addr);
+            const auto waiting = _waiting_arp_response_ip_addr.find(src_ip_addr);
+            if (waiting != _waiting_arp_response_ip_addr.end()) {
+                _timers.cancel(waiting->second);
+                _waiting_arp_response_ip_addr.erase(waiting);
+            }
         }
     }
     return nullopt;
@@ -131,38 +129,31 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
 
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void NetworkInterface::tick(const size_t ms_since_last_tick) {
-    // 将 ARP 表中过期的条目删除
-    for (auto iter = _arp_table.begin(); iter != _arp_table.end(); /* nop */) {
-        if (iter->second.ttl <= ms_since_last_tick)
-            iter = _arp_table.erase(iter);
-        else {
-            iter->second.ttl -= ms_since_last_tick;
-            ++iter;
+    // 只处理到期的定时器：过期的 ARP 条目删除，没等到响应的 ARP 请求重新发送
+    _timers.advance(ms_since_last_tick, [this](const ARP_Timer &timer) {
+        if (!timer.request) {
+            _arp_table.erase(timer.ip);
+            return;
         }
-    }
-    // 将 ARP 等待队列中过期的条目删除
-    for (auto iter = _waiting_arp_response_ip_addr.begin(); iter != _waiting_arp_response_ip_addr.end(); /* nop */) {
-        // 如果 ARP 等待队列中的 ARP 请求过期
-        if (iter->second <= ms_since_last_tick) {
-            // 重新发送 ARP 请求
-            ARPMessage arp_request;
-            arp_request.opcode = ARPMessage::OPCODE_REQUEST;
-            arp_request.sender_ethernet_address = _ethernet_address;
-            arp_request.sender_ip_address = _ip_address.ipv4_numeric();
-            arp_request.target_ethernet_address = {/* 这里应该置为空*/};
-            arp_request.target_ip_address = iter->first;
-
-            EthernetFrame eth_frame;
-            eth_frame.header() = {/* dst  */ ETHERNET_BROADCAST,
-                                  /* src  */ _ethernet_address,
-                                  /* type */ EthernetHeader::TYPE_ARP};
-            eth_frame.payload() = arp_request.serialize();
-            _frames_out.push(eth_frame);
+        send_arp_request(timer.ip);
+        _waiting_arp_response_ip_addr[timer.ip] = _timers.arm(_arp_response_default_ttl, timer);
+    });
+}
 
-            iter->second = _arp_response_default_ttl;
-        } else {
-            iter->second -= ms_since_last_tick;
-            ++iter;
-        }
-    }
+optional<size_t> NetworkInterface::next_deadline() const { return _timers.next_expiry(); }
+
+void NetworkInterface::send_arp_request(const uint32_t ip) {
+    ARPMessage arp_request;
+    arp_request.opcode = ARPMessage::OPCODE_REQUEST;
+    arp_request.sender_ethernet_address = _ethernet_address;
+    arp_request.sender_ip_address = _ip_address.ipv4_numeric();
+    arp_request.target_ethernet_address = {/* 这里应该置为空*/};
+    arp_request.target_ip_address = ip;
+
+    EthernetFrame eth_frame;
+    eth_frame.header() = {/* dst  */ ETHERNET_BROADCAST,
+                          /* src  */ _ethernet_address,
+                          /* type */ EthernetHeader::TYPE_ARP};
+    eth_frame.payload() = arp_request.serialize();
+    _frames_out.push(eth_frame);
 }
@@ -3,6 +3,7 @@
 
 #include "ethernet_frame.hh"
 #include "tcp_over_ip.hh"
+#include "timer_wheel.hh"
 #include "tun.hh"
 
 #include <list>
@@ -33,18 +34,25 @@
 //! and learns or replies as necessary.
 class NetworkInterface {
   private:
+    //! ARP 条目过期和 ARP 请求重发的定时器，记着是哪个 IP 地址的哪一种
+    struct ARP_Timer {
+        uint32_t ip{0};
+        bool request{false};
+    };
+    TimerWheel<ARP_Timer> _timers{};
+
     //! ARP 条目
     struct ARP_Entry {
-        EthernetAddress eth_addr;
-        size_t ttl;
+        EthernetAddress eth_addr{};
+        TimerWheel<ARP_Timer>::Handle expiry{};
     };
     //! ARP 表
     std::map<uint32_t, ARP_Entry> _arp_table{};
     // 默认 ARP 条目过期时间 30s
     const size_t _arp_entry_default_ttl = 30 * 1000;
 
-    //! 正在查询的 ARP 报文。如果发送了 ARP 请求后，在过期时间内没有返回响应，则丢弃等待的 IP 报文
-    std::map<uint32_t, size_t> _waiting_arp_response_ip_addr{};
+    //! 正在查询的 ARP 报文和它重发的定时器。如果发送了 ARP 请求后，在过期时间内没有返回响应，则重新发送
+    std::map<uint32_t, TimerWheel<ARP_Timer>::Handle> _waiting_arp_response_ip_addr{};
     // 默认 ARP 请求过期时间 5s
     const size_t _arp_response_default_ttl = 5 * 1000;
 
@@ -60,6 +68,9 @@ class NetworkInterface {
     //! outbound queue of Ethernet frames that the NetworkInterface wants sent
     std::queue<EthernetFrame> _frames_out{};
 
+    //! 广播一个查询 `ip` 的 ARP 请求
+    void send_arp_request(const uint32_t ip);
+
   public:
     //! \brief Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer) addresses
     NetworkInterface(const EthernetAddress &ethernet_address, const Address &ip_address);
@@ -82,6 +93,9 @@ class NetworkInterface {
 
     //! \brief Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
+
+    //! \brief Milliseconds until tick() next expires an ARP entry or a request, or empty if there are none
+    std::optional<size_t> next_deadline() const;
 };
 
 #endif  // SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
@@ -1,5 +1,7 @@
 #include "stream_reassembler.hh"
 
+#include <algorithm>
+#include <iterator>
 #include <string>
 
 // Dummy implementation of a stream reassembler.
@@ -14,65 +16,249 @@ void DUMMY_CODE(Targs &&.../* unused */) {}
 
 using namespace std;
 
-StreamReassembler::StreamReassembler(const size_t capacity) : _output(capacity), _capacity(capacity) {
+StreamReassembler::StreamReassembler(const size_t capacity, const Mode mode)
+    : _mode(mode), _output(capacity), _capacity(capacity) {
     // printf("capacity: %zu\n", _capacity);
+    if (_mode == Mode::DirectPlacement) {
+        const size_t slots = filled_slots(capacity);
+        _filled.resize(slots / 64);
+        _filled_mask = slots - 1;
+    }
+}
+
+size_t StreamReassembler::filled_slots(const size_t capacity) {
+    size_t slots = 64;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+size_t StreamReassembler::set_capacity(size_t capacity) {
+    // 已经收下的字节不能丢，窗口右沿至少要包住最后一个暂存的字节
+    const auto held = held_ranges();
+    const size_t held_end = held.empty() ? _first_unassembled : held.back().second;
+    capacity = max(capacity, held_end - first_unread());
+
+    if (_mode == Mode::DirectPlacement && filled_slots(capacity) != _filled_mask + 1) {
+        // 槽位是绝对位置对位图大小取模，大小变了就按暂存的区间重新置位
+        const size_t slots = filled_slots(capacity);
+        _filled.assign(slots / 64, 0);
+        _filled_mask = slots - 1;
+        for (const auto &[start, end] : held) {
+            mark_filled(start, end);
+        }
+    }
+    _output.set_capacity(capacity);
+    _capacity = capacity;
+    return capacity;
 }
 
 //! \details This function accepts a substring (aka a segment) of bytes,
 //! possibly out-of-order, from the logical stream, and assembles any newly
 //! contiguous substrings and writes them into the output stream in order.
-void StreamReassembler::push_substring(const string &data, const size_t index, const bool eof) {
+void StreamReassembler::push_substring(const string_view data, const size_t index, const bool eof) {
+    push(data, nullptr, index, eof);
+}
+
+//! \details Bytes that have to wait for a hole to be filled share storage with `data`.
+void StreamReassembler::push_substring(const Buffer &data, const size_t index, const bool eof) {
+    push(data.str(), &data, index, eof);
+}
+
+size_t StreamReassembler::push_in_order(const string_view data) {
+    if (_output.input_ended()) {
+        return 0;
+    }
+    // 结尾可能已经先到了（FIN 在空洞之后），写到结尾就要结束字节流
+    const size_t end = min(first_unacceptable(), _eof ? eof_idx : SIZE_MAX);
+    const size_t n = min(data.size(), end - _first_unassembled);
+    _output.write(data.substr(0, n));
+    _first_unassembled += n;
+    if (_eof && _first_unassembled >= eof_idx) {
+        _output.end_input();
+    }
+    return n;
+}
+
+void StreamReassembler::push(const string_view data, const Buffer *owner, const uint64_t index, const bool eof) {
+    // 字节流已经结束，后面的字节不能再写入，也不能让 _first_unassembled 和字节流的计数对不上
+    if (_output.input_ended()) {
+        return;
+    }
     if (eof) {
         _eof = true;
         eof_idx = index + data.length();
     }
-    string s = data;
-    try_write(index, s); // 尝试写入字节流，不一定成功
+    // 只处理 [first_unassembled, first_unacceptable) 之内的部分，之前的已经写到字节流，之后的超出容量丢弃
+    // 已经知道流的结尾时，结尾之后的字节也丢弃
+    const size_t start = max(index, _first_unassembled);
+    const size_t end = min({index + data.length(), first_unacceptable(), _eof ? eof_idx : SIZE_MAX});
+
+    if (_mode == Mode::DirectPlacement) {
+        if (start < end) {
+            place(data, index, start, end);
+        }
+    } else if (start < end && start == _first_unassembled) { // 可以直接写入字节流
+        _output.write(data.substr(start - index, end - start));
+        _first_unassembled = end;
+
+        // 去除已经写到字节流的暂存区间，最后一个可能只去掉前缀
+        while (!_buf.empty() && _buf.begin()->first < _first_unassembled) {
+            auto node = _buf.extract(_buf.begin());
+            const size_t overlap = min(_first_unassembled - node.key(), node.mapped().size());
+            _unassembled_bytes -= overlap;
+            if (overlap < node.mapped().size()) {
+                node.mapped().remove_prefix(overlap);
+                node.key() = _first_unassembled;
+                _buf.insert(move(node));
+            }
+        }
+        // 暂存区间和字节流连上了，一起写入
+        while (!_buf.empty() && _buf.begin()->first == _first_unassembled) {
+            const Buffer &piece = _buf.begin()->second;
+            _output.write(piece.str());
+            _first_unassembled += piece.size();
+            _unassembled_bytes -= piece.size();
+            _buf.erase(_buf.begin());
+        }
+    } else if (start < end) { // 前面还有空洞，先暂存
+        store(data, owner, index, start, end);
+    }
+
     if (_eof && first_unassembled() >= eof_idx) {
         _output.end_input();
     }
 }
 
-size_t StreamReassembler::unassembled_bytes() const { return _buf.size(); }
+//! \details Only the parts of [start, end) that no stored range covers yet are added, so the ranges never overlap.
+void StreamReassembler::store(
+    const string_view data, const Buffer *owner, const uint64_t index, size_t start, const size_t end) {
+    auto it = _buf.upper_bound(start);
+    if (it != _buf.begin()) { // 前一个区间可能盖住了 start
+        const auto prev = std::prev(it);
+        start = max(start, prev->first + prev->second.size());
+    }
+    while (start < end) {
+        const size_t gap_end = it == _buf.end() ? end : min(end, it->first);
+        if (start < gap_end) { // [start, gap_end) 是空洞，暂存
+            Buffer piece;
+            if (owner) {
+                piece = *owner;
+                piece.remove_prefix(start - index);
+                piece.remove_suffix(piece.size() - (gap_end - start));
+            } else {
+                piece = Buffer(string(data.substr(start - index, gap_end - start)));
+            }
+            _buf.emplace_hint(it, start, move(piece));
+            _unassembled_bytes += gap_end - start;
+        }
+        if (it == _buf.end()) {
+            break;
+        }
+        start = max(start, it->first + it->second.size());
+        ++it;
+    }
+}
+
+//! \details Every byte is copied exactly once, into the ring slot it will be read from. When the byte at
+//! first_unassembled() arrives, the run of filled slots after it is committed to the stream without copying.
+void StreamReassembler::place(const string_view data, const uint64_t index, const size_t start, const size_t end) {
+    _output.write_ahead(start - _first_unassembled, data.substr(start - index, end - start));
+    _unassembled_bytes += mark_filled(start, end);
 
-bool StreamReassembler::empty() const { return _buf.empty(); }
+    if (start == _first_unassembled) { // 空洞填上了，连续的部分一起交给字节流
+        const size_t n = take_filled(_first_unassembled, first_unacceptable());
+        _output.commit(n);
+        _first_unassembled += n;
+        _unassembled_bytes -= n;
+    }
+}
 
-int StreamReassembler::try_write(size_t index, string &data) {
-    size_t old_first_unassembled = _first_unassembled;
+size_t StreamReassembler::mark_filled(const size_t start, const size_t end) {
+    size_t newly_filled = 0;
+    for (size_t pos = start; pos < end;) {
+        const size_t slot = pos & _filled_mask;
+        const size_t bit = slot % 64;
+        const size_t n = min({64 - bit, end - pos, _filled_mask + 1 - slot}); // 不跨 word，也不跨位图末尾
+        const uint64_t bits = (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+        uint64_t &word = _filled[slot / 64];
+        newly_filled += __builtin_popcountll(bits & ~word);
+        word |= bits;
+        pos += n;
+    }
+    return newly_filled;
+}
 
-    // 先对data处理，能写入写入，能缓存缓存，重复的跳过，当前不能接受的丢弃
-    for (size_t i = 0; i < data.length(); ++i) {
-        if (index + i >= first_unacceptable()) { // 超出可缓存的范围,丢弃
+size_t StreamReassembler::take_filled(const size_t start, const size_t end) {
+    size_t pos = start;
+    while (pos < end) {
+        const size_t slot = pos & _filled_mask;
+        const size_t bit = slot % 64;
+        const size_t n = min({64 - bit, end - pos, _filled_mask + 1 - slot});
+        uint64_t &word = _filled[slot / 64];
+        const uint64_t ones = ~(word >> bit); // 从 bit 开始第一个 0 的位置就是连续 1 的长度
+        const size_t run = min(n, ones == 0 ? size_t(64) : size_t(__builtin_ctzll(ones)));
+        word &= ~((run == 64 ? ~uint64_t(0) : ((uint64_t(1) << run) - 1)) << bit);
+        pos += run;
+        if (run < n) {
             break;
         }
-        if (index + i < _first_unassembled) {   // 之前已经写到字节流的
-            continue;
-        } else if (index + i == _first_unassembled) {   // 可以写入字节流，先暂存, 等会一次性写
-            assembled_s += data[i];
-            _first_unassembled++;
-        } else {    // 等会可以写入字节流, 先存到缓冲区
-            _buf.insert(pair<size_t, char>(index + i, data[i]));
-        }
     }
+    return pos - start;
+}
 
-    for (size_t i = _first_unassembled; i < first_unacceptable(); ++i) {
-        if (_buf.find(i) != _buf.end()) {
-            assembled_s += _buf.at(i);
-            _first_unassembled++;
-        } else {    // 升序的，找不到则break
-            break;
+size_t StreamReassembler::run_length(const size_t start, const size_t end, const bool value) const {
+    // 每个 ACK 都要为 SACK 扫一遍位图，所以一次跳过一整个 word。位图至少 64 位且是 64 的倍数，word 不会跨过位图末尾
+    const uint64_t flip = value ? ~uint64_t{0} : 0; // 取反之后找第一个 1，也就是第一个不等于 value 的位
+    size_t pos = start;
+    while (pos < end) {
+        const size_t bit = pos % 64;
+        const uint64_t others = (_filled[(pos & _filled_mask) / 64] ^ flip) >> bit;
+        if (others != 0) {
+            return min(pos + __builtin_ctzll(others), end) - start;
         }
+        pos += 64 - bit;
     }
-    size_t n = _output.write(assembled_s);
-    assembled_s = assembled_s.substr(n, assembled_s.length()); // 可能没写完
+    return end - start;
+}
 
-    for (size_t i = old_first_unassembled; i < _first_unassembled; ++i) { // 去除已经写到字节流的
-        if (_buf.find(i) != _buf.end()) {
-            _buf.erase(i);
+vector<pair<uint64_t, uint64_t>> StreamReassembler::held_ranges(const size_t max_ranges) const {
+    vector<pair<uint64_t, uint64_t>> ranges;
+    if (_unassembled_bytes == 0) {
+        return ranges;
+    }
+    if (_mode == Mode::DirectPlacement) { // 在位图里找连续为 1 的段，找齐了所有暂存的字节就停下
+        const size_t end = first_unacceptable();
+        size_t pos = _first_unassembled;
+        size_t found = 0;
+        while (pos < end && found < _unassembled_bytes && ranges.size() < max_ranges) {
+            pos += run_length(pos, end, false);
+            const size_t run = run_length(pos, end, true);
+            if (run > 0) {
+                ranges.emplace_back(pos, pos + run);
+            }
+            pos += run;
+            found += run;
         }
+        return ranges;
     }
-    return 0;
+    for (const auto &[start, piece] : _buf) { // 暂存区间互不重叠，但可能首尾相接，要合并
+        if (!ranges.empty() && ranges.back().second == start) {
+            ranges.back().second += piece.size();
+        } else if (ranges.size() < max_ranges) {
+            ranges.emplace_back(start, start + piece.size());
+        } else {
+            break;
+        }
+    }
+    return ranges;
 }
+
+size_t StreamReassembler::unassembled_bytes() const { return _unassembled_bytes; }
+
+bool StreamReassembler::empty() const { return _unassembled_bytes == 0; }
+
 size_t StreamReassembler::first_unacceptable() const { return first_unread() + _capacity; }
 size_t StreamReassembler::first_unread() const { return _output.bytes_read(); }
 size_t StreamReassembler::capacity() const{ return _capacity; }
@@ -83,4 +269,4 @@ bool StreamReassembler::eof() const{
     }
     return result;
 }
-size_t StreamReassembler::first_unassembled() const { return _first_unassembled; }
\ No newline at end of file
+size_t StreamReassembler::first_unassembled() const { return _first_unassembled; }
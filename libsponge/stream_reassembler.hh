@@ -1,31 +1,71 @@
 #ifndef SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 #define SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 
+#include "buffer.hh"
 #include "byte_stream.hh"
 
 #include <cstdint>
 #include <map>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 //! \brief A class that assembles a series of excerpts from a byte stream (possibly out of order,
 //! possibly overlapping) into an in-order byte stream.
 class StreamReassembler {
+  public:
+    //! Where bytes that arrive before a hole is filled are kept
+    enum class Mode {
+        Intervals,       //!< In a map of non-overlapping Buffer ranges, copied into the output when the hole closes
+        DirectPlacement  //!< Directly in their final slot of the output's ring buffer, tracked by a bitmap
+    };
+
   private:
     // Your code here -- add private members as necessary.
 
+    Mode _mode;
+
     ByteStream _output;                                       //!< The reassembled in-order byte stream
     size_t _capacity;                                         //!< The maximum number of bytes
-    std::map<size_t, char> _buf = std::map<size_t, char>();  // congestion window, 容量允许，但是现在还不能写入字节流，得等前面的先写入，暂存在这里
-    std::string assembled_s = std::string();
+    // 容量允许，但是现在还不能写入字节流的数据，得等前面的先写入，暂存在这里
+    // key 是区间起点，value 是 [key, key + size) 的数据，区间之间互不重叠
+    std::map<size_t, Buffer> _buf = std::map<size_t, Buffer>();
+    size_t _unassembled_bytes = 0;                            // 已经收到但还不能写入字节流的字节数
+    // DirectPlacement 模式下每个槽位是否已经放了数据，下标是绝对位置对位图大小取模
+    // 位图大小和字节流的环形缓冲区一样是 2 的幂，不小于容量，所以窗口内的位置不会冲突
+    std::vector<uint64_t> _filled{};
+    size_t _filled_mask = 0;
     size_t _first_unassembled = 0;
     bool _eof = false;
     size_t eof_idx = -1;
 
+    // 把 data 中 [start, end)（绝对下标）对应的部分暂存到 _buf，owner 不为空时与它共享存储
+    void store(const std::string_view data, const Buffer *owner, const uint64_t index, size_t start, size_t end);
+
+    // 把 data（起点为 index）写入字节流或暂存，然后把已经连续的暂存区间写入字节流
+    void push(const std::string_view data, const Buffer *owner, const uint64_t index, const bool eof);
+
+    // DirectPlacement 模式下把 data 中 [start, end) 放到字节流的最终位置，填上空洞后只需要 commit
+    void place(const std::string_view data, const uint64_t index, const size_t start, const size_t end);
+
+    // 把位图中 [start, end) 置 1，返回新置 1 的个数
+    size_t mark_filled(const size_t start, const size_t end);
+
+    // 从 start 开始（不超过 end）连续为 1 的个数，并把它们清零
+    size_t take_filled(const size_t start, const size_t end);
+
+    // 从 start 开始（不超过 end）连续为 value 的个数，不修改位图
+    size_t run_length(const size_t start, const size_t end, const bool value) const;
+
+    // DirectPlacement 模式下位图的大小：不小于 capacity 的 2 的幂，至少 64
+    static size_t filled_slots(const size_t capacity);
+
   public:
     //! \brief Construct a `StreamReassembler` that will store up to `capacity` bytes.
     //! \note This capacity limits both the bytes that have been reassembled,
     //! and those that have not yet been reassembled.
-    StreamReassembler(const size_t capacity);
+    StreamReassembler(const size_t capacity, const Mode mode = Mode::Intervals);
 
     //! \brief Receive a substring and write any newly contiguous bytes into the stream.
     //!
@@ -35,7 +75,20 @@ class StreamReassembler {
     //! \param data the substring
     //! \param index indicates the index (place in sequence) of the first byte in `data`
     //! \param eof the last byte of `data` will be the last byte in the entire stream
-    void push_substring(const std::string &data, const uint64_t index, const bool eof);
+    void push_substring(const std::string &data, const uint64_t index, const bool eof) {
+        push_substring(std::string_view(data), index, eof);
+    }
+    void push_substring(const std::string_view data, const uint64_t index, const bool eof);
+
+    //! \brief Same as above, but out-of-order bytes are kept as slices of `data` instead of being copied
+    void push_substring(const Buffer &data, const uint64_t index, const bool eof);
+
+    //! \brief Write `data`, which starts exactly at first_unassembled(), straight into the stream
+    //! \details A shortcut for the common case of in-order data. Only valid while nothing is held past a
+    //! hole (empty() is true). Bytes past the window, or past an end of stream already seen, are discarded,
+    //! and the stream is ended if `data` reaches that end, as with push_substring().
+    //! \returns the number of bytes written
+    size_t push_in_order(const std::string_view data);
 
     //! \name Access the reassembled byte stream
     //!@{
@@ -49,15 +102,26 @@ class StreamReassembler {
     //! should only be counted once for the purpose of this function.
     size_t unassembled_bytes() const;
 
+    //! \brief The ranges of stream indices held past a hole, as [start, end) pairs in increasing order
+    //! \param max_ranges stop after this many
+    std::vector<std::pair<uint64_t, uint64_t>> held_ranges(const size_t max_ranges = SIZE_MAX) const;
+
+    //! \brief Change the capacity, resizing the output stream and any placement bitmap to match
+    //! \details Bytes already accepted are never dropped: the capacity is raised as far as needed to
+    //! keep every stored byte inside the window.
+    //! \returns the capacity now in effect
+    size_t set_capacity(const size_t capacity);
+
     //! \brief Is the internal state empty (other than the output stream)?
     //! \returns `true` if no substrings are waiting to be assembled
     bool empty() const;
-    int try_write(size_t idx, std::string &s);
     size_t first_unacceptable() const;
     size_t first_unread() const;
     size_t first_unassembled() const;
     size_t capacity() const;
     bool eof() const;
+    //! \brief Has the substring with the last byte of the stream arrived, even if bytes before it are missing?
+    bool end_known() const { return _eof; }
 };
 
 #endif  // SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
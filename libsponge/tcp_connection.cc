@@ -1,6 +1,8 @@
 #include "tcp_connection.hh"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 
 // Dummy implementation of a TCP connection
@@ -13,18 +15,42 @@ void DUMMY_CODE(Targs &&.../* unused */) {}
 
 using namespace std;
 
+TCPConnection::TCPConnection(const TCPConfig &cfg, Timers *shared_timers)
+    : _cfg{cfg}
+    , _own_timers{shared_timers ? unique_ptr<Timers>{} : make_unique<Timers>()}
+    , _shared_timers{shared_timers}
+    , _sender_time{timers().now()}
+    , _last_segment_received_timestamp{timers().now()}
+    , _rcv_space_time{timers().now()} {
+    // 有 cookie 就把 connect() 之前写入的数据放进 SYN
+    if (_cfg.fast_open && _cfg.fast_open_cookie.has_value()) {
+        _sender.send_data_in_syn();
+    }
+}
+
 size_t TCPConnection::remaining_outbound_capacity() const { return _sender.stream_in().remaining_capacity(); }
 
 size_t TCPConnection::bytes_in_flight() const { return _sender.bytes_in_flight(); }
 
 size_t TCPConnection::unassembled_bytes() const { return _receiver.unassembled_bytes(); }
 
-size_t TCPConnection::time_since_last_segment_received() const { return _time_now - _last_segment_received_timestamp; }
+size_t TCPConnection::time_since_last_segment_received() const {
+    return timers().now() - _last_segment_received_timestamp;
+}
 
 void TCPConnection::segment_received(const TCPSegment &seg) {
+    sync_sender_time();
+    receive(seg);
+    update_timers();
+}
+
+void TCPConnection::receive(const TCPSegment &seg) {
     if (!_active) {
         return;
     }
+    if (predicted_segment_received(seg)) {
+        return;
+    }
     // rst
     if (seg.header().rst) {
         close();
@@ -32,9 +58,37 @@ void TCPConnection::segment_received(const TCPSegment &seg) {
         _receiver.stream_out().set_error();
         return;
     }
+    // 对方的第一个 SYN：记下它的窗口扩大、时间戳、SACK 选项（我们没开这个功能就不理会）
+    const bool first_syn = seg.header().syn && !_receiver.ackno().has_value();
+    if (first_syn && _cfg.window_scaling && seg.header().wscale.has_value()) {
+        _snd_wscale = min(seg.header().wscale.value(), TCPHeader::MAX_WSCALE);
+    }
+    if (first_syn && _cfg.timestamps && seg.header().timestamps.has_value()) {
+        _timestamps = true;
+    }
+    if (first_syn && _cfg.sack && seg.header().sack_permitted) {
+        _sack = true;
+    }
+    // Fast Open：对方要 cookie 的话 SYN-ACK 里给它；SYN 带的数据收下了，就不用等我们的 SYN 被确认再回复
+    if (first_syn && _cfg.fast_open && seg.header().fastopen.has_value()) {
+        _fast_open_requested = true;
+    }
+    if (first_syn && !seg.header().ack && _cfg.fast_open && seg.payload().size() > 0) {
+        _sender.fast_open_syn_received(seg.header().win);
+    }
+    // PAWS：时间戳太旧的段丢掉，带了时间戳的话回一个 ACK
+    if (_timestamps && !_receiver.check_timestamp(seg)) {
+        if (seg.header().timestamps.has_value()) {
+            _sender.send_empty_segment();
+            fill_window();
+        }
+        return;
+    }
     // _receiver接受seg
+    const optional<WrappingInt32> ackno_before = _receiver.ackno();
+    const bool held_before = _receiver.unassembled_bytes() > 0;
     _receiver.segment_received(seg);
-    _last_segment_received_timestamp = _time_now;
+    _last_segment_received_timestamp = timers().now();
 
     // keep-alive
     if (_receiver.ackno().has_value() && seg.length_in_sequence_space() == 0 &&
@@ -51,16 +105,40 @@ void TCPConnection::segment_received(const TCPSegment &seg) {
     }
     // 如果ACK标志位为真，通知TCPSender有segment被确认
     if (seg.header().ack) {
-        if (_sender.ack_received(seg.header().ackno, seg.header().win) < 0)
+        // SYN 里的窗口不移位
+        const uint64_t window = seg.header().syn ? seg.header().win
+                                                 : uint64_t{seg.header().win} << _snd_wscale.value_or(0);
+        optional<uint32_t> tsecr;
+        if (_timestamps && seg.header().timestamps.has_value()) {
+            tsecr = seg.header().timestamps.value().tsecr;
+        }
+        static const vector<TCPHeader::SackBlock> no_sack{};
+        const vector<TCPHeader::SackBlock> &sack = _sack ? seg.header().sack : no_sack;
+        if (_sender.ack_received(seg.header().ackno, window, seg.length_in_sequence_space() == 0, tsecr, sack) < 0)
             return;
     }
 
-    // 确保至少给这个segment回复一个ACK
-    _sender.fill_window(); // 放到sender的队列
-    size_t cnt = fill_window(); // 捎带ack和win, 放到connection的队列,返回发送的报文个数
+    // 确保至少给这个segment回复一个ACK；批量处理时发数据和确认按序数据都留到整批处理完
+    size_t cnt = 0;
+    if (!_batching) {
+        _sender.fill_window(); // 放到sender的队列
+        cnt = fill_window(); // 捎带ack和win, 放到connection的队列,返回发送的报文个数
+    }
     if (cnt == 0 && seg.length_in_sequence_space() > 0) { // 没有捎带的话，则发送空的 ACK 报文
-        _sender.send_empty_segment();
-        fill_window();
+        // 按序到达的数据可以晚点确认 (RFC 5681 4.2)：攒够两个满段或者定时器到期再发；乱序、填洞、SYN、FIN 马上确认
+        const uint32_t len = seg.length_in_sequence_space();
+        const bool in_order = !seg.header().syn && !seg.header().fin && !held_before &&
+                              _receiver.unassembled_bytes() == 0 && ackno_before.has_value() &&
+                              _receiver.ackno() == ackno_before.value() + len;
+        _unacked_bytes += seg.payload().size();
+        if (!in_order) { // 乱序的每个都要回，对方靠重复 ACK 发现丢包
+            _sender.send_empty_segment();
+            fill_window();
+        } else if (_batching) {
+            _batch_ack_pending = true;
+        } else {
+            ack_in_order_data();
+        }
     }
 
     // 出向字节流还没有到EOF的时候，入向stream就关闭了字节流, 就不需要linger了，“被动关闭”
@@ -75,55 +153,267 @@ void TCPConnection::segment_received(const TCPSegment &seg) {
 
 }
 
+// 首部预测 (Van Jacobson)：连接建立之后绝大多数段是两种之一——紧接着上一个的、不带标志的数据段，和确认了新数据的纯
+// ACK。几个比较认出它们，直接处理，不走 segment_received 的完整流程；别的段返回 false，照常处理
+bool TCPConnection::predicted_segment_received(const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    // 两种都要求：只有 ACK 标志、没有 SACK 块、正好是期待的下一个段、前面没有空洞、窗口没变，
+    // 而且对方的 FIN 还没到（包括空洞后面先到的 FIN：填洞的段会让字节流结束，要马上确认，走完整流程）
+    if (header.syn || header.fin || header.rst || !header.ack || !header.sack.empty() ||
+        !_receiver.ackno().has_value() || header.seqno != _receiver.ackno().value() ||
+        _receiver.unassembled_bytes() > 0 || _receiver.fin_received() ||
+        (uint64_t{header.win} << _snd_wscale.value_or(0)) != _sender.window_size()) {
+        return false;
+    }
+    // 用了时间戳的话还要带着、并且不比 TS.Recent 旧 (PAWS)
+    if (_timestamps && (!header.timestamps.has_value() ||
+                        (_receiver.ts_recent().has_value() &&
+                         static_cast<int32_t>(header.timestamps.value().tsval - _receiver.ts_recent().value()) < 0))) {
+        return false;
+    }
+    const int32_t newly_acked = header.ackno - _sender.unacked_seqno();
+    if (seg.payload().size() == 0) { // 纯 ACK：确认了新数据，但没有超出发出去的
+        if (newly_acked <= 0 || header.ackno - _sender.next_seqno() > 0) {
+            return false;
+        }
+    } else if (newly_acked != 0 || _sender.bytes_in_flight() > 0 || seg.payload().size() > _receiver.window_size()) {
+        // 数据段：没有确认新东西、我们这边没有数据在路上（发送方什么都不用做），并且整段放得进窗口
+        return false;
+    }
+
+    _predicted_segments++;
+    _last_segment_received_timestamp = timers().now();
+    if (_timestamps) {
+        _receiver.check_timestamp(seg);
+    }
+    if (seg.payload().size() == 0) {
+        optional<uint32_t> tsecr;
+        if (_timestamps) {
+            tsecr = header.timestamps.value().tsecr;
+        }
+        _sender.ack_received(header.ackno, _sender.window_size(), true, tsecr, {});
+        if (!_batching) {
+            _sender.fill_window();
+            fill_window();
+        }
+        return true;
+    }
+    _receiver.segment_received_in_order(seg);
+    _unacked_bytes += seg.payload().size();
+    if (_batching) {
+        _batch_ack_pending = true;
+    } else {
+        ack_in_order_data();
+    }
+    return true;
+}
+
+// 一批段挨个处理，按序数据只在最后回一个累计 ACK，要发的数据也只在最后发一次
+void TCPConnection::segments_received(const vector<TCPSegment> &segments) {
+    sync_sender_time();
+    _batching = true;
+    _batch_ack_pending = false;
+    for (const TCPSegment &seg : segments) {
+        receive(seg);
+    }
+    _batching = false;
+    if (_active) {
+        _sender.fill_window();
+        if (fill_window() == 0 && _batch_ack_pending) {
+            ack_in_order_data();
+        }
+    }
+    update_timers();
+}
+
+// 按序数据的 ACK：攒够两个满段就发，否则等定时器或者下一个出去的段捎带
+void TCPConnection::ack_in_order_data() {
+    if (_cfg.ack_delay == 0 || _unacked_bytes >= 2 * TCPConfig::MAX_PAYLOAD_SIZE) {
+        _sender.send_empty_segment();
+        fill_window();
+        return;
+    }
+    if (!_ack_deadline.has_value()) {
+        _ack_deadline = timers().now() + _cfg.ack_delay;
+    }
+    _acks_delayed++;
+}
+
+size_t TCPConnection::drain_segments_out(vector<TCPSegment> &out) {
+    const size_t cnt = _segments_out.size();
+    while (!_segments_out.empty()) {
+        out.push_back(move(_segments_out.front()));
+        _segments_out.pop();
+    }
+    return cnt;
+}
+
 bool TCPConnection::active() const { return _active; }
 
+// 两个方向都结束了、只是在 linger 的连接：交出重发 ACK 需要的几个值，自己关掉
+optional<TCPConnection::TimeWait> TCPConnection::release_time_wait() {
+    if (!_active || !_linger_after_streams_finish || !_sender.fin_acked() || !_receiver.stream_out().input_ended()) {
+        return {};
+    }
+    TimeWait time_wait;
+    time_wait.seqno = _sender.next_seqno();
+    time_wait.ackno = _receiver.ackno().value();
+    const size_t shift = _snd_wscale.has_value() ? _rcv_wscale : 0;
+    time_wait.win = min(_receiver.window_size() >> shift, size_t{UINT16_MAX});
+    sync_sender_time();
+    if (_timestamps) {
+        time_wait.timestamps = TCPHeader::Timestamps{_sender.timestamp(), _receiver.ts_recent().value_or(0)};
+    }
+    close();
+    update_timers();
+    return time_wait;
+}
+
 size_t TCPConnection::write(const string &data) { // 暴露给应用层的接口, 在这里发送
     if (!_active) {
         return 0;
     }
+    sync_sender_time();
     size_t len = _sender.stream_in().write(data);
     _sender.fill_window();
     fill_window();
+    update_timers();
+    return len;
+}
+
+size_t TCPConnection::write(Buffer &&data) { // 不拷贝，直接把 Buffer 交给出向字节流
+    if (!_active) {
+        return 0;
+    }
+    sync_sender_time();
+    size_t len = _sender.stream_in().write(move(data));
+    _sender.fill_window();
+    fill_window();
+    update_timers();
     return len;
 }
 
 //! \param[in] ms_since_last_tick number of milliseconds since the last call to this method
 void TCPConnection::tick(const size_t ms_since_last_tick) {
+    if (_shared_timers) {
+        tick(*_shared_timers, ms_since_last_tick);
+        return;
+    }
+    // 自己的时间轮上不用记是哪个连接，记下哪几种到期了就行
+    array<bool, 4> expired{};
+    _own_timers->advance(ms_since_last_tick,
+                         [&](const TimerEvent &event) { expired[static_cast<size_t>(event.timer)] = true; });
+    sync_sender_time();
+    for (size_t timer = 0; timer < expired.size(); timer++) {
+        if (expired[timer]) {
+            timer_expired(static_cast<Timer>(timer));
+        }
+    }
+}
+
+//! \details As with a single call to tick(size_t), the timers that fall due are run at the end of the interval,
+//! so each runs at most once per call, however long the interval.
+//! \param[in] timers the timers shared by the connections
+//! \param[in] ms_since_last_tick number of milliseconds since the last call to this method
+void TCPConnection::tick(Timers &timers, const size_t ms_since_last_tick) {
+    vector<TimerEvent> expired;
+    timers.advance(ms_since_last_tick, [&](const TimerEvent &event) { expired.push_back(event); });
+    for (const TimerEvent &event : expired) {
+        event.connection->timer_expired(event.timer);
+    }
+}
+
+// 先让发送方赶上来，它自己的定时器（重传、尾部探测、乱序窗口）在这里触发
+void TCPConnection::timer_expired(const Timer timer) {
     if (!_active) {
         return;
     }
-    _sender.tick(ms_since_last_tick); // 可能会发送数据(超时重传), 放到sender的队列
+    sync_sender_time();
     fill_window(); // 从sender的队列pop到conn的队列
-    _time_now += ms_since_last_tick;
     // 连续重传次数超过MAX_RETX_ATTEMPTS, 终止连接，发送rst
-    if (_active && _sender.consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS) {
+    if (_sender.consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS) {
         send_rst_segment();
-        return;
+    } else if (timer == Timer::DelayedAck && _ack_deadline.has_value()) { // 延迟的 ACK 到时间了
+        _sender.send_empty_segment();
+        fill_window();
+    } else if (timer == Timer::Linger) {
+        close();
+    } else if (timer == Timer::WindowTuning) {
+        tune_receive_window();
     }
-    if (_sender.fin_acked() && _receiver.stream_out().input_ended()) {
-        if (_linger_after_streams_finish) {
-            if (_time_now >= _last_segment_received_timestamp + 10 * _cfg.rt_timeout) {
-                close();
-            }
-        }
+    update_timers();
+}
+
+void TCPConnection::sync_sender_time() {
+    const uint64_t now = timers().now();
+    if (now != _sender_time) {
+        _sender.tick(now - _sender_time); // 可能会发送数据(超时重传), 放到sender的队列
+        _sender_time = now;
     }
+}
 
+// 每种定时器按现在的状态算出该什么时候到期，和已经设好的不一样才重设；连接不活跃了就全部取消
+void TCPConnection::update_timers() {
+    Timers &wheel = timers();
+    const uint64_t now = wheel.now();
+    const auto set = [&](const Timer timer, const optional<uint64_t> expiry) {
+        Timers::Handle &handle = _timer_handles[static_cast<size_t>(timer)];
+        if (_active && expiry.has_value() && wheel.expiry(handle) == max(expiry.value(), now)) {
+            return;
+        }
+        wheel.cancel(handle);
+        if (_active && expiry.has_value()) {
+            handle = wheel.arm(expiry.value() - min(expiry.value(), now),
+                               TimerEvent{_shared_timers ? this : nullptr, timer});
+        }
+    };
+    const optional<uint64_t> sender = _sender.next_deadline();
+    set(Timer::Sender, sender.has_value() ? optional<uint64_t>{now + sender.value()} : nullopt);
+    set(Timer::DelayedAck, _ack_deadline);
+    optional<uint64_t> linger{};
+    if (_sender.fin_acked() && _receiver.stream_out().input_ended() && _linger_after_streams_finish) {
+        linger = _last_segment_received_timestamp + 10 * _cfg.rt_timeout;
+    }
+    set(Timer::Linger, linger);
+    // 窗口自动调整每个 RTT 量一次；这段时间什么都没收到、窗口也不用缩，就不必为它醒来
+    optional<uint64_t> tuning{};
+    if (_cfg.recv_capacity_max > _cfg.recv_capacity && _receiver.ackno().has_value() &&
+        !_receiver.stream_out().input_ended() && _sender.srtt() > 0) {
+        const uint64_t received = _receiver.stream_out().bytes_written() + _receiver.unassembled_bytes();
+        if (received != _rcv_space_received || _receiver.capacity() >= 2 * _cfg.recv_capacity) {
+            tuning = _rcv_space_time + static_cast<uint64_t>(ceil(_sender.srtt()));
+        }
+    }
+    set(Timer::WindowTuning, tuning);
 }
 
 void TCPConnection::end_input_stream() {
+    sync_sender_time();
     _sender.stream_in().end_input();
     // 在输入流结束后，必须立即发送 FIN
     _sender.fill_window();
     fill_window();
+    update_timers();
+}
+
+// 应用层放弃连接（比如没人来 accept）：发 RST，立即关闭；RST 留在 segments_out 里等调用者发出
+void TCPConnection::abort() {
+    if (!_active) {
+        return;
+    }
+    send_rst_segment();
+    update_timers();
 }
 
 void TCPConnection::connect() {
     if (!_active) {
         return;
     }
+    sync_sender_time();
     // 第一次调用 _sender.fill_window 将会发送一个 syn 数据包
     _sender.fill_window();
     fill_window();
+    update_timers();
 }
 
 TCPConnection::~TCPConnection() {
@@ -132,6 +422,12 @@ TCPConnection::~TCPConnection() {
             cerr << "Warning: Unclean shutdown of TCPConnection\n";
             send_rst_segment();
         }
+        // 共用的时间轮比连接活得久，不能留下指向这里的定时器
+        if (_shared_timers) {
+            for (const Timers::Handle handle : _timer_handles) {
+                _shared_timers->cancel(handle);
+            }
+        }
     } catch (const exception &e) {
         std::cerr << "Exception destructing TCP FSM: " << e.what() << std::endl;
     }
@@ -141,18 +437,84 @@ TCPConnection::~TCPConnection() {
 size_t TCPConnection::fill_window() { 
     size_t cnt = _sender.segments_out().size();
     while (!_sender.segments_out().empty()) { // 把sender的segments_out队列的放到connection的队列
-        TCPSegment seg = _sender.segments_out().front();
+        TCPSegment seg = move(_sender.segments_out().front());
+        _sender.segments_out().pop();
         if (_receiver.ackno().has_value()) { // 捎带上 ACK 和 window_size
             seg.header().ackno = _receiver.ackno().value();
             seg.header().ack = true;
         }
-        seg.header().win = _receiver.window_size() > UINT16_MAX ? UINT16_MAX : _receiver.window_size();
-        _segments_out.push(seg);
-        _sender.segments_out().pop();
+        if (seg.header().syn) {
+            // 主动打开时提出窗口扩大、时间戳；被动打开时只有对方提出了才回应
+            const bool active_open = !_receiver.ackno().has_value();
+            if (_cfg.window_scaling && (active_open || _snd_wscale.has_value())) {
+                seg.header().wscale = _rcv_wscale;
+            }
+            if (_cfg.timestamps && (active_open || _timestamps)) {
+                seg.header().timestamps = TCPHeader::Timestamps{_sender.timestamp(), 0};
+            }
+            seg.header().sack_permitted = _cfg.sack && (active_open || _sack);
+            if (_cfg.fast_open && active_open) { // 没有 cookie 就发一个空的选项，向对方要
+                seg.header().fastopen = _cfg.fast_open_cookie.value_or("");
+            } else if (_fast_open_requested && _cfg.fast_open_cookie.has_value()) {
+                seg.header().fastopen = _cfg.fast_open_cookie;
+            }
+        }
+        if (_timestamps) { // 每个段都带上发送时间，回显对方最近的时间戳
+            seg.header().timestamps = TCPHeader::Timestamps{_sender.timestamp(), _receiver.ts_recent().value_or(0)};
+        }
+        if (_sack && _receiver.unassembled_bytes() > 0) { // 告诉对方空洞后面已经收到了哪些数据，选项放得下几块就放几块
+            const size_t room = TCPHeader::MAX_OPTIONS_LENGTH - seg.header().options_length();
+            seg.header().sack = _receiver.sack_blocks(room < 4 ? 0 : (room - 4) / 8);
+        }
+        seg.header().doff = (TCPHeader::LENGTH + seg.header().options_length()) / 4;
+        // SYN 里的窗口不移位，之后的窗口在启用了窗口扩大时右移 _rcv_wscale 位
+        const size_t shift = seg.header().syn || !_snd_wscale.has_value() ? 0 : _rcv_wscale;
+        seg.header().win = min(_receiver.window_size() >> shift, size_t{UINT16_MAX});
+        _receiver.window_advertised(size_t{seg.header().win} << shift);
+        if (seg.header().ack) { // 这个段带上了最新的 ackno，等着的 ACK 不用单独发了
+            _unacked_bytes = 0;
+            _ack_deadline.reset();
+        }
+        _segments_sent++;
+        _pure_acks_sent += seg.length_in_sequence_space() == 0;
+        _segments_out.push(move(seg));
     }
     return cnt;
 }
 
+// 和 Linux 的 DRS 类似：每个 RTT 量一次这段时间新收到了多少字节，容量调成它的两倍，这样窗口不会卡住发送方的拥塞窗口增长
+void TCPConnection::tune_receive_window() {
+    if (_cfg.recv_capacity_max <= _cfg.recv_capacity || !_receiver.ackno().has_value() ||
+        _receiver.stream_out().input_ended() || _sender.srtt() == 0 ||
+        double(timers().now() - _rcv_space_time) < _sender.srtt()) {
+        return;
+    }
+    // 数的是新收下的字节（不管有没有空洞），而不是应用读走的：填上空洞时一下子交付的一大片不代表路径变快了
+    const uint64_t received = _receiver.stream_out().bytes_written() + _receiver.unassembled_bytes();
+    const size_t target =
+        clamp<size_t>(2 * (received - _rcv_space_received), _cfg.recv_capacity, _cfg.recv_capacity_max);
+    _rcv_space_time = timers().now();
+    _rcv_space_received = received;
+
+    const size_t capacity = _receiver.capacity();
+    if (target > capacity) { // 超出初始容量的部分要从全局预算里拿，拿不到就不长
+        const size_t granted = _rcv_reserved.grow(target - capacity);
+        if (granted == 0) {
+            return;
+        }
+        const size_t window = _receiver.advertised_window();
+        _receiver.set_capacity(capacity + granted);
+        // 窗口至少翻倍了就马上告诉对方，不用等下一个 ACK
+        if (_receiver.window_size() >= 2 * max<size_t>(window, 1)) {
+            _sender.send_empty_segment();
+            fill_window();
+        }
+    } else if (2 * target <= capacity) { // 读得慢了，每个 RTT 最多减半；通告过的窗口不收回，可能减得少一些
+        const size_t shrunk = _receiver.set_capacity(max(target, capacity / 2));
+        _rcv_reserved.shrink(capacity - shrunk);
+    }
+}
+
 // 发送rst
 void TCPConnection::send_rst_segment() {
     while (!_sender.segments_out().empty()) {
@@ -167,6 +529,7 @@ void TCPConnection::send_rst_segment() {
     seg.header().rst = true;
     seg.header().ackno = _receiver.ackno().value();
     _segments_out.push(seg);
+    _segments_sent++;
     _active = false;
     _sender.stream_in().set_error();
     _receiver.stream_out().set_error();
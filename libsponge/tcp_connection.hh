@@ -5,13 +5,42 @@
 #include "tcp_receiver.hh"
 #include "tcp_sender.hh"
 #include "tcp_state.hh"
+#include "timer_wheel.hh"
+
+#include <array>
+#include <memory>
 
 //! \brief A complete endpoint of a TCP connection
 class TCPConnection {
+  public:
+    //! \name Timers
+    //!@{
+
+    //! \brief What a connection keeps a timer for
+    enum class Timer : uint8_t { Sender, WindowTuning, DelayedAck, Linger };
+
+    //! \brief A connection's timer on a timer wheel: which connection, if the wheel is shared, and which timer
+    struct TimerEvent {
+        TCPConnection *connection{nullptr};
+        Timer timer{Timer::Sender};
+    };
+
+    //! \brief The timers of one connection, or of all the connections of an owner such as TCPDemux
+    using Timers = TimerWheel<TimerEvent>;
+    //!@}
+
   private:
     TCPConfig _cfg;
-    TCPReceiver _receiver{_cfg.recv_capacity};
-    TCPSender _sender{_cfg.send_capacity, _cfg.rt_timeout, _cfg.fixed_isn};
+    TCPReceiver _receiver{_cfg.recv_capacity,
+                          _cfg.direct_placement ? StreamReassembler::Mode::DirectPlacement
+                                                : StreamReassembler::Mode::Intervals};
+    TCPSender _sender{_cfg.send_capacity,
+                      _cfg.rt_timeout,
+                      _cfg.fixed_isn,
+                      _cfg.congestion_control,
+                      _cfg.rto_min,
+                      _cfg.rto_max,
+                      _cfg.rack_tlp};
 
     //! outbound queue of segments that the TCPConnection wants sent
     std::queue<TCPSegment> _segments_out{};
@@ -21,13 +50,48 @@ class TCPConnection {
     //! in case the remote TCPConnection doesn't know we've received its whole stream?
     bool _linger_after_streams_finish{true};
 
-    // 现在的时间，每次调用tick累加
-    size_t _time_now{0};
+    // 定时器：自己的时间轮，或者所有者的、和别的连接共用的；时间轮的时间就是连接的时间，每种定时器一个句柄
+    std::unique_ptr<Timers> _own_timers;
+    Timers *_shared_timers;
+    std::array<Timers::Handle, 4> _timer_handles{};
+    // 发送方的时钟走到了时间轮上的哪个时刻；进入连接的时候再让它赶上来
+    uint64_t _sender_time;
+    Timers &timers() const { return _shared_timers ? *_shared_timers : *_own_timers; }
 
-    size_t _last_segment_received_timestamp{0};
+    size_t _last_segment_received_timestamp;
 
     bool _active{true};
 
+    // 窗口扩大选项 (RFC 7323)：通告窗口时右移的位数，由接收缓冲区大小决定
+    uint8_t _rcv_wscale{_cfg.window_scale()};
+    // 对方 SYN 里的移位数；双方的 SYN 都带了这个选项才启用窗口扩大，否则为空
+    std::optional<uint8_t> _snd_wscale{};
+    // 时间戳选项 (RFC 7323)：双方的 SYN 都带了才启用
+    bool _timestamps{false};
+    // 选择确认 (RFC 2018)：双方的 SYN 都带了 SACK-permitted 才启用
+    bool _sack{false};
+    // 对方的 SYN 带了 Fast Open 选项 (RFC 7413)，SYN-ACK 里要给它 cookie
+    bool _fast_open_requested{false};
+
+    // 延迟确认：上次发出 ACK 之后收到、还没确认的按序数据的字节数，以及最晚什么时候要发 ACK
+    size_t _unacked_bytes{0};
+    std::optional<size_t> _ack_deadline{};
+
+    // 正在 segments_received 里批量处理；这一批里有没有等着确认的按序数据
+    bool _batching{false};
+    bool _batch_ack_pending{false};
+
+    // 接收窗口自动调整：上次测量的时间和那时应用已经读走的字节数，以及超出初始容量的那部分从预算里拿到的内存
+    size_t _rcv_space_time;
+    uint64_t _rcv_space_received{0};
+    ReceiveBudget::Reservation _rcv_reserved{_cfg.recv_budget ? *_cfg.recv_budget : ReceiveBudget::global()};
+
+    // 统计
+    uint64_t _segments_sent{0};
+    uint64_t _pure_acks_sent{0};
+    uint64_t _acks_delayed{0};
+    uint64_t _predicted_segments{0};
+
   public:
     //! \name "Input" interface for the writer
     //!@{
@@ -39,11 +103,18 @@ class TCPConnection {
     //! \returns the number of bytes from `data` that were actually written.
     size_t write(const std::string &data);
 
+    //! \brief Write a Buffer to the outbound byte stream without copying it
+    //! \returns the number of bytes from `data` that were actually written.
+    size_t write(Buffer &&data);
+
     //! \returns the number of `bytes` that can be written right now.
     size_t remaining_outbound_capacity() const;
 
     //! \brief Shut down the outbound byte stream (still allows reading incoming data)
     void end_input_stream();
+
+    //! \brief Give up on the connection at once and send a RST, as the destructor would
+    void abort();
     //!@}
 
     //! \name "Output" interface for the reader
@@ -66,32 +137,100 @@ class TCPConnection {
     TCPState state() const { return {_sender, _receiver, active(), _linger_after_streams_finish}; };
     //!@}
 
+    //! \name Statistics
+    //!@{
+    //! \brief Number of segments retransmitted on duplicate or partial ACKs instead of after a timeout
+    uint64_t fast_retransmissions() const { return _sender.fast_retransmissions(); }
+    //! \brief Number of tail loss probes sent
+    uint64_t tail_loss_probes() const { return _sender.tail_loss_probes(); }
+    //! \brief Number of segments sent, including retransmissions and bare ACKs
+    uint64_t segments_sent() const { return _segments_sent; }
+    //! \brief Number of segments sent that occupied no sequence space (bare ACKs and window updates)
+    uint64_t pure_acks_sent() const { return _pure_acks_sent; }
+    //! \brief Number of received segments whose ACK was held back to share a segment with a later one
+    uint64_t acks_delayed() const { return _acks_delayed; }
+    //! \brief Number of received segments handled by header prediction instead of the full receive path
+    uint64_t predicted_segments() const { return _predicted_segments; }
+    //! \brief Current receive capacity in bytes, which bounds the advertised window
+    size_t receive_capacity() const { return _receiver.capacity(); }
+    //! \brief Smoothed round-trip time in milliseconds, as measured by the sender
+    double srtt() const { return _sender.srtt(); }
+    //! \brief Round-trip time variation in milliseconds, as measured by the sender
+    double rttvar() const { return _sender.rttvar(); }
+    //!@}
+
     //! \name Methods for the owner or operating system to call
     //!@{
 
     //! Called when a new segment has been received from the network
     void segment_received(const TCPSegment &seg);
 
-    //! Called periodically when time elapses
+    //! \brief Called with several segments received from the network at once
+    //! \details Equivalent to calling segment_received() on each, except that in-order data is acknowledged
+    //! by one cumulative ACK after the last segment, and new data is sent only once.
+    void segments_received(const std::vector<TCPSegment> &segments);
+
+    //! \brief Called periodically when time elapses
+    //! \details Runs the timers that fall due. A connection on shared timers advances them all, as tick(Timers &,
+    //! size_t) does.
     void tick(const size_t ms_since_last_tick);
 
+    //! \brief Let time pass on timers shared by several connections, and run the timers that fell due
+    //! \details Costs as much as the timers that fall due, however many connections are idle.
+    static void tick(Timers &timers, const size_t ms_since_last_tick);
+
+    //! \brief Milliseconds until tick() next has something to do, or empty if only a segment or a write can
+    //! change anything
+    //! \details Covers the sender's timers, the delayed ACK, the end of lingering and receive window tuning,
+    //! so that an owner can sleep until then instead of ticking at a fixed rate. On shared timers, covers
+    //! every connection on them.
+    std::optional<size_t> next_deadline() const { return timers().next_expiry(); }
+
     //! \brief TCPSegments that the TCPConnection has enqueued for transmission.
     //! \note The owner or operating system will dequeue these and
     //! put each one into the payload of a lower-layer datagram (usually Internet datagrams (IP),
     //! but could also be user datagrams (UDP) or any other kind).
     std::queue<TCPSegment> &segments_out() { return _segments_out; }
 
+    //! \brief Move every segment in segments_out() onto the end of `out`
+    //! \returns the number of segments moved
+    size_t drain_segments_out(std::vector<TCPSegment> &out);
+
+    //! \brief Has the three-way handshake finished, i.e. have both SYNs been received and our SYN acknowledged?
+    bool established() const {
+        return _receiver.ackno().has_value() && _sender.next_seqno_absolute() > _sender.bytes_in_flight();
+    }
+
+    //! \brief All that a connection lingering after both streams have finished still needs, to ACK the peer's
+    //! FIN again if it is retransmitted
+    struct TimeWait {
+        WrappingInt32 seqno{0};  //!< our next sequence number, just past our FIN
+        WrappingInt32 ackno{0};  //!< the ackno to send, just past the peer's FIN
+        uint16_t win{0};         //!< the window field to send
+        //! our TSval at hand-off and the TSecr to echo, if the timestamps option is in use
+        std::optional<TCPHeader::Timestamps> timestamps{};
+    };
+
+    //! \brief If the connection is only lingering, stop it and hand over what lingering needs
+    //! \details The caller takes over ACKing retransmitted FINs, and the connection becomes inactive without
+    //! sending anything, so its buffers can be freed at once.
+    //! \returns empty if the connection is not lingering
+    std::optional<TimeWait> release_time_wait();
+
     //! \brief Is the connection still alive in any way?
     //! \returns `true` if either stream is still running or if the TCPConnection is lingering
     //! after both streams have finished (e.g. to ACK retransmissions from the peer)
     bool active() const;
     //!@}
 
-    //! Construct a new connection from a configuration
-    explicit TCPConnection(const TCPConfig &cfg) : _cfg{cfg} {}
+    //! \brief Construct a new connection from a configuration
+    //! \param[in] shared_timers timers that the owner shares among its connections and advances itself, or null
+    //! for the connection to keep its own. A connection on shared timers must not be moved, since they point
+    //! to it.
+    explicit TCPConnection(const TCPConfig &cfg, Timers *shared_timers = nullptr);
 
     //! \name construction and destruction
-    //! moving is allowed; copying is disallowed; default construction not possible
+    //! moving is allowed (unless the timers are shared); copying is disallowed; default construction not possible
 
     //!@{
     ~TCPConnection();  //!< destructor sends a RST if the connection is still open
@@ -107,7 +246,28 @@ class TCPConnection {
 
     void send_rst_segment();
 
+    // 确认按序到达的数据，可能推迟
+    void ack_in_order_data();
+
+    // 处理一个收到的段；segment_received 和 segments_received 在前后同步时钟、设置定时器
+    void receive(const TCPSegment &seg);
+
+    // 首部预测：处理了这个段就返回 true
+    bool predicted_segment_received(const TCPSegment &seg);
+
+    // 接收窗口自动调整，每个 RTT 一次
+    void tune_receive_window();
+
     void close();
+
+    // 让发送方的时钟赶上时间轮
+    void sync_sender_time();
+
+    // 按现在的状态重新设置各个定时器，每个入口处理完之后调用
+    void update_timers();
+
+    // 一个定时器到期了
+    void timer_expired(const Timer timer);
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_FACTORED_HH
@@ -0,0 +1,173 @@
+#include "congestion_control.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! Initial window, per [RFC 6928](\ref rfc::rfc6928)
+static uint64_t initial_window(const size_t mss) { return 10 * mss; }
+
+optional<CongestionControlAlgorithm> congestion_control_from_name(const string_view name) {
+    if (name == "none") {
+        return CongestionControlAlgorithm::None;
+    }
+    if (name == "newreno" or name == "reno") {
+        return CongestionControlAlgorithm::NewReno;
+    }
+    if (name == "cubic") {
+        return CongestionControlAlgorithm::Cubic;
+    }
+    if (name == "bbr") {
+        return CongestionControlAlgorithm::BBR;
+    }
+    return {};
+}
+
+unique_ptr<CongestionController> CongestionController::make(const CongestionControlAlgorithm algorithm,
+                                                             const size_t mss) {
+    switch (algorithm) {
+        case CongestionControlAlgorithm::None:
+            return nullptr;
+        case CongestionControlAlgorithm::NewReno:
+            return make_unique<NewRenoController>(mss);
+        case CongestionControlAlgorithm::Cubic:
+            return make_unique<CubicController>(mss);
+        case CongestionControlAlgorithm::BBR:
+            return make_unique<BBRController>(mss);
+    }
+    throw runtime_error("CongestionController::make: unknown algorithm");
+}
+
+// NewReno
+
+NewRenoController::NewRenoController(const size_t mss) : CongestionController(mss), _cwnd(initial_window(mss)) {}
+
+//! \details In slow start cwnd grows by the bytes acknowledged, at most 2 MSS per ACK
+//! ([RFC 3465](\ref rfc::rfc3465) with L = 2); in congestion avoidance it grows by one MSS per window.
+void NewRenoController::on_ack(const uint64_t acked, const uint64_t /* in_flight */, const uint64_t /* now_ms */) {
+    if (_cwnd < _ssthresh) {
+        _cwnd += min<uint64_t>(acked, 2 * _mss);
+        return;
+    }
+    _acked_in_avoidance += acked;
+    while (_acked_in_avoidance >= _cwnd) {
+        _acked_in_avoidance -= _cwnd;
+        _cwnd += _mss;
+    }
+}
+
+void NewRenoController::on_loss(const LossEvent event, const uint64_t in_flight, const uint64_t /* now_ms */) {
+    _ssthresh = max<uint64_t>(in_flight / 2, 2 * _mss);
+    _cwnd = event == LossEvent::Timeout ? _mss : _ssthresh;
+    _acked_in_avoidance = 0;
+}
+
+// CUBIC
+
+CubicController::CubicController(const size_t mss) : CongestionController(mss), _cwnd(initial_window(mss)) {}
+
+uint64_t CubicController::cwnd() const { return static_cast<uint64_t>(_cwnd); }
+
+void CubicController::on_rtt_sample(const uint64_t rtt_ms, const uint64_t /* now_ms */) {
+    if (_min_rtt == 0 or rtt_ms < _min_rtt) {
+        _min_rtt = max<uint64_t>(rtt_ms, 1);
+    }
+}
+
+void CubicController::on_ack(const uint64_t acked, const uint64_t /* in_flight */, const uint64_t now_ms) {
+    if (_cwnd < _ssthresh) {
+        _cwnd += min<double>(acked, 2 * _mss);
+        return;
+    }
+
+    const double mss = _mss;
+    if (not _epoch) {
+        _epoch = now_ms;
+        if (_cwnd < _w_max) {
+            _k = cbrt((_w_max - _cwnd) / mss / C);
+            _origin = _w_max;
+        } else {
+            _k = 0;
+            _origin = _cwnd;
+        }
+        _w_est = _cwnd;
+    }
+
+    // Where the cubic curve will be one RTT from now
+    const double t = static_cast<double>(now_ms - *_epoch + _min_rtt) / 1000.0;
+    double target = _origin + C * pow(t - _k, 3) * mss;
+    target = clamp(target, _cwnd, 1.5 * _cwnd);
+
+    // A Reno flow would have grown this much; never do worse than it
+    _w_est += mss * (3 * (1 - BETA) / (1 + BETA)) * static_cast<double>(acked) / _cwnd;
+    target = max(target, _w_est);
+
+    _cwnd += (target - _cwnd) * static_cast<double>(acked) / _cwnd;
+}
+
+void CubicController::on_loss(const LossEvent event, const uint64_t in_flight, const uint64_t /* now_ms */) {
+    // cwnd keeps growing while the receiver's window is the limit, so size the reduction from what was in flight
+    const double window = min(_cwnd, static_cast<double>(in_flight));
+    // fast convergence: give up bandwidth sooner if the window is still shrinking
+    _w_max = window < _w_max ? window * (1 + BETA) / 2 : window;
+    _ssthresh = max(window * BETA, 2.0 * _mss);
+    _cwnd = event == LossEvent::Timeout ? _mss : _ssthresh;
+    _epoch.reset();
+}
+
+// BBR
+
+BBRController::BBRController(const size_t mss) : CongestionController(mss), _cwnd(initial_window(mss)) {}
+
+double BBRController::max_bw() const { return *max_element(_bw.begin(), _bw.end()); }
+
+uint64_t BBRController::target_cwnd() const {
+    const double bdp = max_bw() * static_cast<double>(_min_rtt);
+    return max<uint64_t>(static_cast<uint64_t>(CWND_GAIN * bdp), 4 * _mss);
+}
+
+void BBRController::on_rtt_sample(const uint64_t rtt_ms, const uint64_t now_ms) {
+    if (_min_rtt == 0 or rtt_ms <= _min_rtt or now_ms - _min_rtt_stamp > MIN_RTT_LIFETIME) {
+        _min_rtt = max<uint64_t>(rtt_ms, 1);
+        _min_rtt_stamp = now_ms;
+    }
+}
+
+//! \details One bandwidth sample is taken per round, a round being one min RTT of acknowledgments.
+void BBRController::on_ack(const uint64_t acked, const uint64_t /* in_flight */, const uint64_t now_ms) {
+    _delivered += acked;
+
+    if (_min_rtt > 0 and now_ms - _round_start >= _min_rtt) {
+        const double elapsed = static_cast<double>(now_ms - _round_start);
+        const double bw = static_cast<double>(_delivered - _round_delivered) / elapsed;
+        _bw[_round % BW_SAMPLES] = bw;
+        _round++;
+        _round_start = now_ms;
+        _round_delivered = _delivered;
+
+        if (_state == State::Startup) {
+            if (max_bw() >= 1.25 * _full_bw) {
+                _full_bw = max_bw();
+                _full_bw_rounds = 0;
+            } else if (++_full_bw_rounds >= 3) {
+                _state = State::ProbeBW;  // the pipe is full
+            }
+        }
+    }
+
+    if (_state == State::Startup) {
+        _cwnd += acked;
+        return;
+    }
+    // climb back towards the model after a timeout, or settle on it
+    _cwnd = min(_cwnd + acked, target_cwnd());
+}
+
+void BBRController::on_loss(const LossEvent event, const uint64_t /* in_flight */, const uint64_t /* now_ms */) {
+    if (event == LossEvent::Timeout) {
+        _cwnd = _mss;
+    }
+}
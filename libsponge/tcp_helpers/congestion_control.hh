@@ -0,0 +1,134 @@
+#ifndef SPONGE_LIBSPONGE_CONGESTION_CONTROL_HH
+#define SPONGE_LIBSPONGE_CONGESTION_CONTROL_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+//! Congestion control algorithms a TCPSender can run
+enum class CongestionControlAlgorithm {
+    None,     //!< No congestion window: send whatever the receiver's window allows
+    NewReno,  //!< [RFC 5681](\ref rfc::rfc5681) slow start and AIMD, [RFC 6582](\ref rfc::rfc6582) recovery
+    Cubic,    //!< [RFC 9438](\ref rfc::rfc9438) cubic window growth
+    BBR       //!< A simple model-based controller: cwnd follows twice the measured bandwidth-delay product
+};
+
+//! \brief Look up an algorithm by name ("none", "newreno", "reno", "cubic" or "bbr")
+//! \returns an empty optional if the name is not recognized
+std::optional<CongestionControlAlgorithm> congestion_control_from_name(const std::string_view name);
+
+//! How the TCPSender concluded that a segment was lost
+enum class LossEvent {
+    Timeout,        //!< The retransmission timer expired
+    FastRetransmit  //!< Duplicate ACKs (or SACK information) showed a hole
+};
+
+//! \brief Decides how many bytes a TCPSender may have in flight
+//! \details The sender reports acknowledgments, losses and RTT samples, all stamped with its
+//! own clock (the sum of the `ms_since_last_tick` values it has been given), and sends no
+//! more than `min(cwnd(), receiver window)` bytes past the last acknowledged byte.
+class CongestionController {
+  protected:
+    size_t _mss;  //!< Sender maximum segment size, the unit of window growth
+
+  public:
+    //! \param[in] mss is the largest payload the sender puts in one segment
+    explicit CongestionController(const size_t mss) : _mss(mss) {}
+    virtual ~CongestionController() = default;
+
+    //! \brief `acked` bytes were newly acknowledged, leaving `in_flight` outstanding
+    virtual void on_ack(const uint64_t acked, const uint64_t in_flight, const uint64_t now_ms) = 0;
+
+    //! \brief A segment was declared lost while `in_flight` bytes were outstanding
+    virtual void on_loss(const LossEvent event, const uint64_t in_flight, const uint64_t now_ms) = 0;
+
+    //! \brief An RTT was measured from a segment that was sent only once (Karn's algorithm)
+    virtual void on_rtt_sample(const uint64_t /* rtt_ms */, const uint64_t /* now_ms */) {}
+
+    //! \brief The congestion window, in bytes
+    virtual uint64_t cwnd() const = 0;
+
+    //! \brief Build the controller for `algorithm`, or nullptr for CongestionControlAlgorithm::None
+    static std::unique_ptr<CongestionController> make(const CongestionControlAlgorithm algorithm, const size_t mss);
+};
+
+//! \brief Slow start, congestion avoidance and multiplicative decrease as in [RFC 5681](\ref rfc::rfc5681)
+class NewRenoController : public CongestionController {
+  private:
+    uint64_t _cwnd;
+    uint64_t _ssthresh{UINT64_MAX};
+    uint64_t _acked_in_avoidance{0};  //!< Bytes acknowledged since cwnd last grew by one MSS in avoidance
+
+  public:
+    explicit NewRenoController(const size_t mss);
+
+    void on_ack(const uint64_t acked, const uint64_t in_flight, const uint64_t now_ms) override;
+    void on_loss(const LossEvent event, const uint64_t in_flight, const uint64_t now_ms) override;
+    uint64_t cwnd() const override { return _cwnd; }
+    uint64_t ssthresh() const { return _ssthresh; }
+};
+
+//! \brief CUBIC window growth as in [RFC 9438](\ref rfc::rfc9438), including the Reno-friendly region
+class CubicController : public CongestionController {
+  private:
+    static constexpr double C = 0.4;     //!< Cubic scaling constant, in MSS/s^3
+    static constexpr double BETA = 0.7;  //!< Multiplicative decrease factor
+
+    double _cwnd;
+    double _ssthresh{1e18};
+    double _w_max{0};                  //!< cwnd just before the last reduction, in bytes
+    double _w_est{0};                  //!< Window a Reno flow would have reached in this epoch
+    double _k{0};                      //!< Seconds the cubic function takes to climb back to its origin
+    double _origin{0};                 //!< Window the cubic function plateaus at
+    std::optional<uint64_t> _epoch{};  //!< When the current avoidance epoch started
+    uint64_t _min_rtt{0};
+
+  public:
+    explicit CubicController(const size_t mss);
+
+    void on_ack(const uint64_t acked, const uint64_t in_flight, const uint64_t now_ms) override;
+    void on_loss(const LossEvent event, const uint64_t in_flight, const uint64_t now_ms) override;
+    void on_rtt_sample(const uint64_t rtt_ms, const uint64_t now_ms) override;
+    uint64_t cwnd() const override;
+};
+
+//! \brief A pacing-free take on BBR: estimate bottleneck bandwidth and minimum RTT, keep 2 * BDP in flight
+//! \details Starts by doubling like slow start until the bandwidth estimate stops growing by 25% for
+//! three rounds, then steers cwnd to twice the bandwidth-delay product. Loss is not a congestion
+//! signal except after a timeout, when cwnd restarts from one MSS and climbs back to the model.
+class BBRController : public CongestionController {
+  private:
+    static constexpr size_t BW_SAMPLES = 10;             //!< Bandwidth max-filter length, in rounds
+    static constexpr uint64_t MIN_RTT_LIFETIME = 10000;  //!< How long a min RTT sample is trusted, in ms
+    static constexpr double CWND_GAIN = 2.0;
+
+    enum class State { Startup, ProbeBW };
+
+    State _state{State::Startup};
+    uint64_t _cwnd;
+    uint64_t _delivered{0};                //!< Total bytes acknowledged
+    uint64_t _round_start{0};              //!< When the current bandwidth sample started
+    uint64_t _round_delivered{0};          //!< _delivered when the current bandwidth sample started
+    std::array<double, BW_SAMPLES> _bw{};  //!< Recent delivery rates in bytes/ms, one per round
+    size_t _round{0};
+    double _full_bw{0};           //!< Bandwidth when Startup last saw 25% growth
+    unsigned _full_bw_rounds{0};  //!< Rounds since then
+    uint64_t _min_rtt{0};
+    uint64_t _min_rtt_stamp{0};
+
+    double max_bw() const;
+    uint64_t target_cwnd() const;
+
+  public:
+    explicit BBRController(const size_t mss);
+
+    void on_ack(const uint64_t acked, const uint64_t in_flight, const uint64_t now_ms) override;
+    void on_loss(const LossEvent event, const uint64_t in_flight, const uint64_t now_ms) override;
+    void on_rtt_sample(const uint64_t rtt_ms, const uint64_t now_ms) override;
+    uint64_t cwnd() const override { return _cwnd; }
+};
+
+#endif  // SPONGE_LIBSPONGE_CONGESTION_CONTROL_HH
@@ -6,23 +6,28 @@
 
 using namespace std;
 
-//! \details This function first attempts to parse a TCP segment from the next UDP
-//! payload recv()d from the socket.
-//!
-//! If this succeeds, it then checks that the received segment is related to the
-//! current connection. When a TCP connection has been established, this means
-//! checking that the source and destination ports in the TCP header are correct.
-//!
-//! If the TCP FSM is listening (i.e., TCPOverUDPSocketAdapter::_listen is `true`)
-//! and the TCP segment read from the wire includes a SYN, this function clears the
-//! `_listen` flag and calls calls connect() on the underlying UDP socket, with
-//! the result that future outgoing segments go to the sender of the SYN segment.
-//! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
+//! \details This function receives the next UDP payload from the socket, if one is waiting, and hands it
+//! to received(). It never blocks, so a caller can read until it gets an empty result.
+//! \returns a std::optional<TCPSegment> that is empty if no datagram was waiting, or if the segment was
+//! invalid or unrelated
 optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
-    auto datagram = _sock.recv();
+    UDPSocket::received_datagram datagram{{nullptr, 0}, ""};
+    if (not _sock.try_recv(datagram)) {
+        return {};
+    }
+    return received({move(datagram.payload), datagram.source_address});
+}
 
+//! \details This function first attempts to parse a TCP segment from the UDP payload.
+//!
+//! If this succeeds, it then checks that the received segment came from the
+//! connection's peer. A server, which takes segments from any peer, uses
+//! received_from_any() instead.
+//! \param[in] datagram is the UDP payload and its sender
+//! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
+optional<TCPSegment> TCPOverUDPSocketAdapter::received(EventLoop::Datagram &&datagram) {
     // is it for us?
-    if (not listening() and (datagram.source_address != config().destination)) {
+    if (datagram.source != config().destination) {
         return {};
     }
 
@@ -32,16 +37,6 @@ optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
         return {};
     }
 
-    // should we target this source in all future replies?
-    if (listening()) {
-        if (seg.header().syn and not seg.header().rst) {
-            config_mutable().destination = datagram.source_address;
-            set_listening(false);
-        } else {
-            return {};
-        }
-    }
-
     return seg;
 }
 
@@ -53,5 +48,57 @@ void TCPOverUDPSocketAdapter::write(TCPSegment &seg) {
     _sock.sendto(config().destination, seg.serialize(0));
 }
 
+//! \param[in] seg is the TCP segment to write
+//! \param[in] loop is the EventLoop that sends it
+void TCPOverUDPSocketAdapter::write(TCPSegment &seg, EventLoop &loop) {
+    seg.header().sport = config().source.port();
+    seg.header().dport = config().destination.port();
+    loop.send(_sock, seg.serialize(0), config().destination);
+}
+
+//! \returns a std::optional that is empty if no datagram was waiting or if it held no valid segment
+optional<pair<FourTuple, TCPSegment>> TCPOverUDPSocketAdapter::read_from_any() {
+    UDPSocket::received_datagram datagram{{nullptr, 0}, ""};
+    if (not _sock.try_recv(datagram)) {
+        return {};
+    }
+    return received_from_any({move(datagram.payload), datagram.source_address});
+}
+
+//! \details Unlike received(), this does not check who sent the datagram. The 4-tuple is made of the
+//! configured source address and port, and the sender's address and port; as with received(), the ports
+//! in the TCP header are not used, since UDP already carries them.
+//! \param[in] datagram is the UDP payload and its sender
+//! \returns a std::optional that is empty if the payload was not a valid TCP segment
+optional<pair<FourTuple, TCPSegment>> TCPOverUDPSocketAdapter::received_from_any(EventLoop::Datagram &&datagram) {
+    if (not datagram.source.has_value()) {
+        return {};
+    }
+    TCPSegment seg;
+    if (ParseResult::NoError != seg.parse(move(datagram.payload), 0)) {
+        return {};
+    }
+    const Address &peer = datagram.source.value();
+    const FourTuple tuple{config().source.ipv4_numeric(), peer.ipv4_numeric(), config().source.port(), peer.port()};
+    return make_pair(tuple, move(seg));
+}
+
+//! \param[in] tuple names the connection, and so the peer to send to
+//! \param[in] seg is the TCP segment to write
+void TCPOverUDPSocketAdapter::write_to(const FourTuple &tuple, TCPSegment &seg) {
+    seg.header().sport = tuple.local_port;
+    seg.header().dport = tuple.remote_port;
+    _sock.sendto(Address::from_ipv4_numeric(tuple.remote_address, tuple.remote_port), seg.serialize(0));
+}
+
+//! \param[in] tuple names the connection, and so the peer to send to
+//! \param[in] seg is the TCP segment to write
+//! \param[in] loop is the EventLoop that sends it
+void TCPOverUDPSocketAdapter::write_to(const FourTuple &tuple, TCPSegment &seg, EventLoop &loop) {
+    seg.header().sport = tuple.local_port;
+    seg.header().dport = tuple.remote_port;
+    loop.send(_sock, seg.serialize(0), Address::from_ipv4_numeric(tuple.remote_address, tuple.remote_port));
+}
+
 //! Specialize LossyFdAdapter to TCPOverUDPSocketAdapter
 template class LossyFdAdapter<TCPOverUDPSocketAdapter>;
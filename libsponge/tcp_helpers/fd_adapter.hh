@@ -1,10 +1,12 @@
 #ifndef SPONGE_LIBSPONGE_FD_ADAPTER_HH
 #define SPONGE_LIBSPONGE_FD_ADAPTER_HH
 
+#include "eventloop.hh"
 #include "file_descriptor.hh"
 #include "lossy_fd_adapter.hh"
 #include "socket.hh"
 #include "tcp_config.hh"
+#include "tcp_demux.hh"
 #include "tcp_header.hh"
 #include "tcp_segment.hh"
 
@@ -16,20 +18,11 @@
 class FdAdapterBase {
   private:
     FdAdapterConfig _cfg{};  //!< Configuration values
-    bool _listen = false;    //!< Is the connected TCP FSM in listen state?
 
   protected:
     FdAdapterConfig &config_mutable() { return _cfg; }
 
   public:
-    //! \brief Set the listening flag
-    //! \param[in] l is the new value for the flag
-    void set_listening(const bool l) { _listen = l; }
-
-    //! \brief Get the listening flag
-    //! \returns whether the FdAdapter is listening for a new connection
-    bool listening() const { return _listen; }
-
     //! \brief Get the current configuration
     //! \returns a const reference
     const FdAdapterConfig &config() const { return _cfg; }
@@ -40,6 +33,9 @@ class FdAdapterBase {
 
     //! Called periodically when time elapses
     void tick(const size_t) {}
+
+    //! Milliseconds until tick() next has something to do, or empty if never
+    std::optional<size_t> next_deadline() const { return {}; }
 };
 
 //! \brief A FD adaptor that reads and writes TCP segments in UDP payloads
@@ -51,12 +47,37 @@ class TCPOverUDPSocketAdapter : public FdAdapterBase {
     //! Construct from a UDPSocket sliced into a FileDescriptor
     explicit TCPOverUDPSocketAdapter(UDPSocket &&sock) : _sock(std::move(sock)) {}
 
-    //! Attempts to read and return a TCP segment related to the current connection from a UDP payload
+    //! Attempts to read and return a TCP segment related to the current connection from a UDP payload,
+    //! without waiting for one
     std::optional<TCPSegment> read();
 
+    //! Returns the TCP segment in a UDP payload that an EventLoop received, if related to the current connection
+    std::optional<TCPSegment> received(EventLoop::Datagram &&datagram);
+
     //! Writes a TCP segment into a UDP payload
     void write(TCPSegment &seg);
 
+    //! Queues a TCP segment in a UDP payload, to be sent by the next wait of `loop` (EventLoop::Backend::IoUring)
+    void write(TCPSegment &seg, EventLoop &loop);
+
+    //! \name
+    //! Unfiltered mode, for a TCPSpongeListener: segments from any peer, each with the 4-tuple it belongs to
+
+    //!@{
+
+    //! Attempts to read a TCP segment from a UDP payload sent by anyone, without waiting for one
+    std::optional<std::pair<FourTuple, TCPSegment>> read_from_any();
+
+    //! Returns the TCP segment in a UDP payload that an EventLoop received, and the connection it belongs to
+    std::optional<std::pair<FourTuple, TCPSegment>> received_from_any(EventLoop::Datagram &&datagram);
+
+    //! Writes a TCP segment of the connection named by `tuple` into a UDP payload to its peer
+    void write_to(const FourTuple &tuple, TCPSegment &seg);
+
+    //! Queues a TCP segment of the connection named by `tuple`, to be sent by the next wait of `loop`
+    void write_to(const FourTuple &tuple, TCPSegment &seg, EventLoop &loop);
+    //!@}
+
     //! Access the underlying UDP socket
     operator UDPSocket &() { return _sock; }
 
@@ -1,8 +1,10 @@
 #ifndef SPONGE_LIBSPONGE_LOSSY_FD_ADAPTER_HH
 #define SPONGE_LIBSPONGE_LOSSY_FD_ADAPTER_HH
 
+#include "eventloop.hh"
 #include "file_descriptor.hh"
 #include "tcp_config.hh"
+#include "tcp_demux.hh"
 #include "tcp_segment.hh"
 #include "util.hh"
 
@@ -38,7 +40,7 @@ class LossyFdAdapter {
 
     //! \brief Read from the underlying AdapterT instance, potentially dropping the read datagram
     //! \returns std::optional<TCPSegment> that is empty if the segment was dropped or if
-    //!          the underlying AdapterT returned an empty value
+    //!          the underlying AdapterT returned an empty value (e.g. because nothing was waiting)
     std::optional<TCPSegment> read() {
         auto ret = _adapter.read();
         if (_should_drop(false)) {
@@ -47,6 +49,16 @@ class LossyFdAdapter {
         return ret;
     }
 
+    //! \brief Pass a datagram received through an EventLoop to the underlying AdapterT instance, potentially
+    //!        dropping it
+    std::optional<TCPSegment> received(EventLoop::Datagram &&datagram) {
+        auto ret = _adapter.received(std::move(datagram));
+        if (_should_drop(false)) {
+            return {};
+        }
+        return ret;
+    }
+
     //! \brief Write to the underlying AdapterT instance, potentially dropping the datagram to be written
     //! \param[in] seg is the packet to either write or drop
     void write(TCPSegment &seg) {
@@ -56,16 +68,60 @@ class LossyFdAdapter {
         return _adapter.write(seg);
     }
 
+    //! \brief Queue a write on `loop` through the underlying AdapterT instance, potentially dropping it
+    void write(TCPSegment &seg, EventLoop &loop) {
+        if (_should_drop(true)) {
+            return;
+        }
+        return _adapter.write(seg, loop);
+    }
+
+    //! \brief Read from any peer through the underlying AdapterT instance, potentially dropping the read datagram
+    std::optional<std::pair<FourTuple, TCPSegment>> read_from_any() {
+        auto ret = _adapter.read_from_any();
+        if (_should_drop(false)) {
+            return {};
+        }
+        return ret;
+    }
+
+    //! \brief Pass a datagram from any peer to the underlying AdapterT instance, potentially dropping it
+    std::optional<std::pair<FourTuple, TCPSegment>> received_from_any(EventLoop::Datagram &&datagram) {
+        auto ret = _adapter.received_from_any(std::move(datagram));
+        if (_should_drop(false)) {
+            return {};
+        }
+        return ret;
+    }
+
+    //! \brief Write a segment of the connection named by `tuple`, potentially dropping it
+    void write_to(const FourTuple &tuple, TCPSegment &seg) {
+        if (_should_drop(true)) {
+            return;
+        }
+        return _adapter.write_to(tuple, seg);
+    }
+
+    //! \brief Queue a write of a segment of the connection named by `tuple` on `loop`, potentially dropping it
+    void write_to(const FourTuple &tuple, TCPSegment &seg, EventLoop &loop) {
+        if (_should_drop(true)) {
+            return;
+        }
+        return _adapter.write_to(tuple, seg, loop);
+    }
+
     //! \name
     //! Passthrough functions to the underlying AdapterT instance
 
     //!@{
-    void set_listening(const bool l) { _adapter.set_listening(l); }      //!< FdAdapterBase::set_listening passthrough
     const FdAdapterConfig &config() const { return _adapter.config(); }  //!< FdAdapterBase::config passthrough
     FdAdapterConfig &config_mut() { return _adapter.config_mut(); }      //!< FdAdapterBase::config_mut passthrough
     void tick(const size_t ms_since_last_tick) {
         _adapter.tick(ms_since_last_tick);
     }  //!< FdAdapterBase::tick passthrough
+    std::optional<size_t> next_deadline() const {
+        return _adapter.next_deadline();
+    }  //!< FdAdapterBase::next_deadline passthrough
     //!@}
 };
 
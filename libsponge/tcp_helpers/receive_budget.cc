@@ -0,0 +1,20 @@
+#include "receive_budget.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+size_t ReceiveBudget::reserve(const size_t bytes) {
+    size_t used = _used;
+    size_t granted = 0;
+    do {  // another thread may reserve between the load and the exchange; retry with what it left
+        const size_t limit = _limit;
+        granted = used < limit ? min(bytes, limit - used) : 0;
+    } while (granted > 0 and not _used.compare_exchange_weak(used, used + granted));
+    return granted;
+}
+
+ReceiveBudget &ReceiveBudget::global() {
+    static ReceiveBudget budget;
+    return budget;
+}
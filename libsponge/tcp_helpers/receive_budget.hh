@@ -0,0 +1,86 @@
+#ifndef SPONGE_LIBSPONGE_RECEIVE_BUDGET_HH
+#define SPONGE_LIBSPONGE_RECEIVE_BUDGET_HH
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+//! \brief Memory for receive buffers, shared by every TCPConnection that auto-tunes its receive window
+//! \details A connection starts with TCPConfig::recv_capacity bytes of its own. Whatever it grows past that
+//! is taken from a budget and given back when it shrinks or closes, so that many busy connections cannot
+//! together grow past the budget's limit. Connections may live on different threads (TCPSpongeSocket), so
+//! the accounting is atomic.
+class ReceiveBudget {
+  private:
+    std::atomic<size_t> _limit;
+    std::atomic<size_t> _used{0};
+
+  public:
+    static constexpr size_t DEFAULT_LIMIT = 64 * 1024 * 1024;  //!< Default limit, in bytes
+
+    //! \param[in] limit is the most bytes that may be reserved at one time
+    explicit ReceiveBudget(const size_t limit = DEFAULT_LIMIT) : _limit(limit) {}
+
+    //! \brief Reserve up to `bytes` bytes
+    //! \returns how many were granted, which is less than asked for once the limit is near
+    size_t reserve(const size_t bytes);
+
+    //! \brief Give back `bytes` bytes reserved earlier
+    void release(const size_t bytes) { _used -= bytes; }
+
+    //! \name Accessors
+    //!@{
+    size_t used() const { return _used; }
+    size_t limit() const { return _limit; }
+    //! \note Lowering the limit takes nothing back; it only stops further growth
+    void set_limit(const size_t limit) { _limit = limit; }
+    //!@}
+
+    //! \brief The budget used by connections whose TCPConfig does not name one
+    static ReceiveBudget &global();
+
+    class Reservation;
+};
+
+//! \brief The bytes one owner holds from a ReceiveBudget, given back when it is destroyed
+//! \details Moving hands the bytes over, so an owner can be moved without returning them twice.
+class ReceiveBudget::Reservation {
+  private:
+    ReceiveBudget *_budget;
+    size_t _bytes{0};
+
+  public:
+    explicit Reservation(ReceiveBudget &budget) : _budget(&budget) {}
+    ~Reservation() { _budget->release(_bytes); }
+
+    Reservation(Reservation &&other) noexcept : _budget(other._budget), _bytes(std::exchange(other._bytes, 0)) {}
+    Reservation &operator=(Reservation &&other) noexcept {
+        if (this != &other) {
+            _budget->release(_bytes);
+            _budget = other._budget;
+            _bytes = std::exchange(other._bytes, 0);
+        }
+        return *this;
+    }
+    Reservation(const Reservation &other) = delete;
+    Reservation &operator=(const Reservation &other) = delete;
+
+    //! \brief Reserve up to `bytes` more
+    //! \returns how many were granted
+    size_t grow(const size_t bytes) {
+        const size_t granted = _budget->reserve(bytes);
+        _bytes += granted;
+        return granted;
+    }
+
+    //! \brief Give back `bytes` of the bytes held (or all of them, if fewer are held)
+    void shrink(const size_t bytes) {
+        const size_t released = bytes < _bytes ? bytes : _bytes;
+        _budget->release(released);
+        _bytes -= released;
+    }
+
+    size_t bytes() const { return _bytes; }
+};
+
+#endif  // SPONGE_LIBSPONGE_RECEIVE_BUDGET_HH
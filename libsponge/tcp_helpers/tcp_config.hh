@@ -2,11 +2,17 @@
 #define SPONGE_LIBSPONGE_TCP_CONFIG_HH
 
 #include "address.hh"
+#include "congestion_control.hh"
+#include "receive_budget.hh"
+#include "tcp_header.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <string>
 
 //! Config for TCP sender and receiver
 class TCPConfig {
@@ -15,11 +21,73 @@ class TCPConfig {
     static constexpr size_t MAX_PAYLOAD_SIZE = 1000;   //!< Conservative max payload size for real Internet
     static constexpr uint16_t TIMEOUT_DFLT = 1000;     //!< Default re-transmit timeout is 1 second
     static constexpr unsigned MAX_RETX_ATTEMPTS = 8;   //!< Maximum re-transmit attempts before giving up
+    static constexpr uint64_t RTO_MIN_DFLT = 200;      //!< Default lower bound on a measured RTO, in milliseconds
+    static constexpr uint64_t RTO_MAX_DFLT = 60000;    //!< Default upper bound on the RTO, in milliseconds
+    static constexpr size_t RECV_CAPACITY_DFLT = 16 * 1024;          //!< Default initial receive capacity
+    static constexpr size_t RECV_CAPACITY_MAX_DFLT = 4 * 1024 * 1024;  //!< Default cap on receive auto-tuning
 
     uint16_t rt_timeout = TIMEOUT_DFLT;       //!< Initial value of the retransmission timeout, in milliseconds
-    size_t recv_capacity = DEFAULT_CAPACITY;  //!< Receive capacity, in bytes
+    uint64_t rto_min = RTO_MIN_DFLT;          //!< The RTO derived from RTT samples is never below this
+    uint64_t rto_max = RTO_MAX_DFLT;          //!< Nor above this (backoff after a timeout can still exceed it)
+    size_t recv_capacity = RECV_CAPACITY_DFLT;  //!< Receive capacity, in bytes; auto-tuning starts from here
     size_t send_capacity = DEFAULT_CAPACITY;  //!< Sender capacity, in bytes
     std::optional<WrappingInt32> fixed_isn{};
+    bool direct_placement = true;  //!< Reassemble out-of-order bytes in place in the receive ring buffer
+    //! Congestion control for the sender; `None` sends whatever the receiver's window allows
+    CongestionControlAlgorithm congestion_control = CongestionControlAlgorithm::None;
+    //! Offer the window scale option ([RFC 7323](\ref rfc::rfc7323)) so windows past 64 KiB can be advertised
+    bool window_scaling = true;
+    //! Offer the timestamps option ([RFC 7323](\ref rfc::rfc7323)) for RTT measurement and PAWS
+    bool timestamps = true;
+    //! Offer selective acknowledgment ([RFC 2018](\ref rfc::rfc2018)) so only missing segments are resent
+    bool sack = true;
+    //! Detect losses by time rather than by counting duplicate ACKs (RACK), and probe for lost tail
+    //! segments before the retransmission timer fires (TLP), as in [RFC 8985](\ref rfc::rfc8985)
+    bool rack_tlp = true;
+    //! Longest the ACK for in-order data may be held back to be combined with the next one, in milliseconds.
+    //! Every second full segment is still ACKed at once ([RFC 5681](\ref rfc::rfc5681) section 4.2); 0 ACKs
+    //! every segment.
+    uint16_t ack_delay = 40;
+    //! Auto-tuning sets the receive capacity, once per RTT, to twice the bytes newly received in the last RTT
+    //! (in order or not), up to this many bytes; when less arrives it shrinks, by at most half per RTT. No more
+    //! than recv_capacity turns auto-tuning off.
+    size_t recv_capacity_max = RECV_CAPACITY_MAX_DFLT;
+    //! Where auto-tuning reserves the memory it grows into; empty means ReceiveBudget::global()
+    std::shared_ptr<ReceiveBudget> recv_budget{};
+    //! TCP Fast Open ([RFC 7413](\ref rfc::rfc7413)). Actively opening, ask the peer for a cookie, or with
+    //! fast_open_cookie set, present it and send the data written before connect() in the SYN. Passively
+    //! opening, answer a SYN that asks with fast_open_cookie, and let data accepted with the SYN be answered
+    //! before the handshake completes. Checking the peer's cookie is up to whoever hands over the SYN
+    //! (TCPDemux does), since the cookie is tied to the peer's address.
+    bool fast_open = false;
+    //! The Fast Open cookie to present to the peer (actively opening) or to give it (passively opening)
+    std::optional<std::string> fast_open_cookie{};
+    //! In a TCPDemux, hand connections that are only lingering over to a compact TIME_WAIT table, which
+    //! keeps re-ACKing a retransmitted FIN, and free the rest of their state
+    bool compact_time_wait = true;
+
+    //! \brief The window scale shift we offer: the smallest that fits the largest receive capacity
+    //! (recv_capacity, or recv_capacity_max with auto-tuning) in the 16-bit window field
+    uint8_t window_scale() const {
+        const size_t capacity = std::max(recv_capacity, recv_capacity_max);
+        uint8_t shift = 0;
+        while (shift < TCPHeader::MAX_WSCALE and (capacity >> shift) > UINT16_MAX) {
+            shift++;
+        }
+        return shift;
+    }
+
+    //! \brief This config with the timers the original connection had: the RTO pinned to rt_timeout whatever
+    //! the RTT samples say (backoff still doubles it after each timeout), no RACK or tail loss probe timers,
+    //! no delayed ACKs, and a receive capacity that stays at recv_capacity
+    TCPConfig with_fixed_timers() const {
+        TCPConfig cfg{*this};
+        cfg.rto_min = cfg.rto_max = rt_timeout;
+        cfg.rack_tlp = false;
+        cfg.ack_delay = 0;
+        cfg.recv_capacity_max = recv_capacity;
+        return cfg;
+    }
 };
 
 //! Config for classes derived from FdAdapter
@@ -30,6 +98,8 @@ class FdAdapterConfig {
 
     uint16_t loss_rate_dn = 0;  //!< Downlink loss rate (for LossyFdAdapter)
     uint16_t loss_rate_up = 0;  //!< Uplink loss rate (for LossyFdAdapter)
+
+    bool io_uring = false;  //!< Receive and send datagrams through io_uring, if the kernel allows (TCPSpongeSocket)
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_CONFIG_HH
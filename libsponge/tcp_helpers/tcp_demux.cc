@@ -0,0 +1,454 @@
+#include "tcp_demux.hh"
+
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+static uint64_t rotl(const uint64_t x, const int bits) { return (x << bits) | (x >> (64 - bits)); }
+
+//! SipHash-2-4 of `words`, a keyed hash that an attacker who does not know the key cannot predict
+static uint64_t siphash(const array<uint64_t, 2> &key, const array<uint64_t, 3> &words) {
+    uint64_t v0 = key[0] ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = key[1] ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = key[0] ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = key[1] ^ 0x7465646279746573ULL;
+    const auto round = [&] {
+        v0 += v1;
+        v1 = rotl(v1, 13) ^ v0;
+        v0 = rotl(v0, 32);
+        v2 += v3;
+        v3 = rotl(v3, 16) ^ v2;
+        v0 += v3;
+        v3 = rotl(v3, 21) ^ v0;
+        v2 += v1;
+        v1 = rotl(v1, 17) ^ v2;
+        v2 = rotl(v2, 32);
+    };
+    const auto compress = [&](const uint64_t m) {
+        v3 ^= m;
+        round();
+        round();
+        v0 ^= m;
+    };
+    for (const uint64_t m : words) {
+        compress(m);
+    }
+    compress(uint64_t{words.size() * 8} << 56);
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++) {
+        round();
+    }
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+TCPDemux::TCPDemux(const TCPConfig &cfg) : _cfg(cfg), _cookie_key() {
+    auto rd = get_random_generator();
+    for (uint64_t &word : _cookie_key) {
+        word = (uint64_t{rd()} << 32) | rd();
+    }
+}
+
+TCPDemux::Listener *TCPDemux::listener(const uint16_t port) {
+    for (Listener &l : _listeners) {
+        if (l.port == port) {
+            return &l;
+        }
+    }
+    return nullptr;
+}
+
+void TCPDemux::release_pending(const uint16_t port, const Stage stage) {
+    Listener *l = listener(port);
+    if (l and l->pending > 0) {
+        l->pending--;
+    }
+    if (l and stage == Stage::Queued and l->queued > 0) {
+        l->queued--;
+    }
+}
+
+void TCPDemux::listen(const uint16_t port, const size_t backlog, const SynCookies syn_cookies) {
+    if (Listener *l = listener(port)) {
+        l->backlog = backlog;
+        l->syn_cookies = syn_cookies;
+        return;
+    }
+    _listeners.push_back({port, backlog, syn_cookies, 0, 0, {}});
+}
+
+//! \details The RSTs of the connections reset here go out with the next drain_segments_out(), and tick()
+//! removes the connections after that.
+void TCPDemux::unlisten(const uint16_t port) {
+    const auto l =
+        find_if(_listeners.begin(), _listeners.end(), [&](const Listener &each) { return each.port == port; });
+    if (l == _listeners.end()) {
+        return;
+    }
+    _listeners.erase(l);
+    for (auto &[tuple, entry] : _connections) {
+        if (tuple.local_port == port and entry.stage != Stage::Open) {
+            entry.connection->abort();
+            // no listener counts it any more
+            entry.stage = Stage::Open;
+        }
+    }
+}
+
+TCPConnection &TCPDemux::connect(const FourTuple &tuple, const string &data) {
+    if (_connections.contains(tuple) or _time_wait.contains(tuple)) {
+        throw runtime_error("TCPDemux::connect: 4-tuple already in use");
+    }
+    unique_ptr<TCPConnection> connection;
+    const string *cookie = _cfg.fast_open ? _fast_open_cookies.find(tuple.remote_address) : nullptr;
+    if (cookie) {
+        TCPConfig cfg = _cfg;
+        cfg.fast_open_cookie = *cookie;
+        connection = make_unique<TCPConnection>(cfg, _timers.get());
+    } else {
+        connection = make_unique<TCPConnection>(_cfg, _timers.get());
+    }
+    TCPConnection &conn = *_connections.try_emplace(tuple, Entry{move(connection), Stage::Open}).first->connection;
+    if (not data.empty()) {
+        conn.write(data);
+    }
+    conn.connect();
+    return conn;
+}
+
+//! \details Connections whose peer reset them or that have already finished are skipped.
+optional<FourTuple> TCPDemux::accept(const uint16_t port) {
+    Listener *l = listener(port);
+    while (l and not l->accept_queue.empty()) {
+        const FourTuple tuple = l->accept_queue.front();
+        l->accept_queue.pop_front();
+        Entry *entry = _connections.find(tuple);
+        if (entry and entry->stage == Stage::Queued) {
+            release_pending(port, entry->stage);
+            entry->stage = Stage::Open;
+            return tuple;
+        }
+    }
+    return {};
+}
+
+TCPConnection *TCPDemux::find(const FourTuple &tuple) {
+    Entry *entry = _connections.find(tuple);
+    return entry ? entry->connection.get() : nullptr;
+}
+
+void TCPDemux::store_fast_open_cookie(const uint32_t address, const string &cookie) {
+    if (string *known = _fast_open_cookies.find(address)) {
+        *known = cookie;
+        return;
+    }
+    if (_fast_open_cookies.size() >= MAX_FAST_OPEN_COOKIES) {
+        _fast_open_cookies.erase(_fast_open_servers.front());
+        _fast_open_servers.pop_front();
+    }
+    _fast_open_cookies.try_emplace(address, cookie);
+    _fast_open_servers.push_back(address);
+}
+
+void TCPDemux::segment_received(const FourTuple &tuple, const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    if (Entry *entry = _connections.find(tuple)) {
+        if (_cfg.fast_open and header.syn and header.ack and header.fastopen.has_value() and
+            not header.fastopen.value().empty()) {
+            store_fast_open_cookie(tuple.remote_address, header.fastopen.value());
+        }
+        entry->connection->segment_received(seg);
+        if (entry->stage == Stage::Handshake and entry->connection->established()) {
+            entry->stage = Stage::Queued;
+            Listener *l = listener(tuple.local_port);
+            l->accept_queue.push_back(tuple);
+            l->queued++;
+        }
+        return;
+    }
+
+    if (TimeWaitEntry *entry = _time_wait.find(tuple)) {
+        if (time_wait_received(tuple, *entry, seg)) {
+            return;
+        }
+        _time_wait.erase(tuple);
+    }
+
+    Listener *l = listener(tuple.local_port);
+    if (l and header.syn and not header.ack and not header.rst) {
+        const bool full = l->pending >= l->backlog;
+        if (l->syn_cookies == SynCookies::Always or (full and l->syn_cookies == SynCookies::WhenFull)) {
+            send_syn_cookie(tuple, seg);
+        } else if (full) {
+            _syns_dropped++;
+        } else {
+            accept_syn(*l, tuple, seg);
+        }
+        return;
+    }
+    if (l and l->syn_cookies != SynCookies::Off and header.ack and not header.syn and not header.rst and
+        accept_syn_cookie(*l, tuple, seg)) {
+        return;
+    }
+    send_reset(tuple, seg);
+}
+
+//! \details Only segments that occupy sequence space are answered: a retransmitted FIN means our ACK of it was
+//! lost. A SYN is newer than the old connection if its timestamp is later than the last one seen, or without
+//! timestamps, if its sequence number is past the old connection's.
+bool TCPDemux::time_wait_received(const FourTuple &tuple, TimeWaitEntry &entry, const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    const TCPConnection::TimeWait &state = entry.state;
+    if (header.rst) {
+        return true;
+    }
+    if (header.syn and not header.ack) {
+        const bool newer = state.timestamps.has_value() and header.timestamps.has_value()
+                               ? static_cast<int32_t>(header.timestamps->tsval - state.timestamps->tsecr) > 0
+                               : header.seqno - state.ackno > 0;
+        if (newer) {
+            return false;
+        }
+    }
+    if (seg.length_in_sequence_space() == 0) {
+        return true;
+    }
+
+    TCPSegment ack;
+    ack.header().ack = true;
+    ack.header().seqno = state.seqno;
+    ack.header().ackno = state.ackno;
+    ack.header().win = state.win;
+    if (state.timestamps.has_value()) {
+        const uint32_t tsval = state.timestamps->tsval + static_cast<uint32_t>(_timers->now() - entry.since);
+        ack.header().timestamps = TCPHeader::Timestamps{tsval, state.timestamps->tsecr};
+    }
+    ack.header().doff = (TCPHeader::LENGTH + ack.header().options_length()) / 4;
+    _stateless.emplace_back(tuple, move(ack));
+
+    entry.expiry = _timers->now() + 10 * _cfg.rt_timeout;
+    _time_wait_expiry.emplace_back(entry.expiry, tuple);
+    return true;
+}
+
+//! \details A SYN that presents a valid Fast Open cookie, while the accept queue has room, has its data accepted
+//! and its connection queued for accept() right away. Data in any other SYN is dropped, so the SYN-ACK
+//! acknowledges only the SYN and the peer sends the data again.
+void TCPDemux::accept_syn(Listener &l, const FourTuple &tuple, const TCPSegment &syn) {
+    const TCPHeader &header = syn.header();
+    unique_ptr<TCPConnection> connection;
+    bool fast_open = false;
+    if (_cfg.fast_open and header.fastopen.has_value()) {
+        TCPConfig cfg = _cfg;
+        cfg.fast_open_cookie = fast_open_cookie(tuple.remote_address);
+        fast_open = syn.payload().size() > 0 and header.fastopen == cfg.fast_open_cookie and l.queued < l.backlog;
+        connection = make_unique<TCPConnection>(cfg, _timers.get());
+    } else {
+        connection = make_unique<TCPConnection>(_cfg, _timers.get());
+    }
+
+    if (syn.payload().size() > 0 and not fast_open) {
+        TCPSegment bare{syn};
+        bare.payload() = Buffer{};
+        bare.header().fin = false;
+        connection->segment_received(bare);
+    } else {
+        connection->segment_received(syn);
+    }
+    _connections.try_emplace(tuple, Entry{move(connection), fast_open ? Stage::Queued : Stage::Handshake});
+    l.pending++;
+    if (fast_open) {
+        l.accept_queue.push_back(tuple);
+        l.queued++;
+        _fast_open_accepted++;
+    }
+}
+
+string TCPDemux::fast_open_cookie(const uint32_t address) const {
+    // a different last word from the SYN cookies', so the two hashes never coincide
+    const uint64_t hash = siphash(_cookie_key, {address, 0, UINT64_MAX});
+    string cookie(sizeof(hash), '\0');
+    for (size_t i = 0; i < cookie.size(); i++) {
+        cookie[i] = static_cast<char>(hash >> (8 * i));
+    }
+    return cookie;
+}
+
+WrappingInt32 TCPDemux::syn_cookie(const FourTuple &tuple, const WrappingInt32 peer_isn, const uint64_t clock) const {
+    const uint64_t addresses = (uint64_t{tuple.local_address} << 32) | tuple.remote_address;
+    const uint64_t ports =
+        (uint64_t{tuple.local_port} << 48) | (uint64_t{tuple.remote_port} << 32) | peer_isn.raw_value();
+    // the top 8 bits carry the clock, so the receiver knows which value to check against
+    const uint32_t hash = siphash(_cookie_key, {addresses, ports, clock}) & 0xffffff;
+    return WrappingInt32{static_cast<uint32_t>((clock & 0xff) << 24) | hash};
+}
+
+void TCPDemux::send_syn_cookie(const FourTuple &tuple, const TCPSegment &syn) {
+    TCPSegment syn_ack;
+    syn_ack.header().syn = syn_ack.header().ack = true;
+    syn_ack.header().seqno = syn_cookie(tuple, syn.header().seqno, _timers->now() / COOKIE_PERIOD_MS);
+    syn_ack.header().ackno = syn.header().seqno + 1;
+    syn_ack.header().win = min(_cfg.recv_capacity, size_t{UINT16_MAX});
+    _stateless.emplace_back(tuple, move(syn_ack));
+    _syn_cookies_sent++;
+}
+
+//! \details The connection is given the SYN the cookie stands for, and the SYN-ACK it answers with is
+//! discarded: the cookie already was that SYN-ACK. Then it gets `ack` like any other segment.
+bool TCPDemux::accept_syn_cookie(Listener &l, const FourTuple &tuple, const TCPSegment &ack) {
+    const WrappingInt32 isn = ack.header().ackno - 1;
+    const WrappingInt32 peer_isn = ack.header().seqno - 1;
+    const uint64_t clock = _timers->now() / COOKIE_PERIOD_MS;
+    const uint64_t age = (clock - (isn.raw_value() >> 24)) & 0xff;
+    if (age > 1 or clock < age or syn_cookie(tuple, peer_isn, clock - age) != isn) {
+        return false;
+    }
+    if (l.queued >= l.backlog) { // no room to accept it; the peer will retransmit
+        return true;
+    }
+
+    TCPConfig cfg = _cfg;
+    cfg.fixed_isn = isn;
+    auto connection = make_unique<TCPConnection>(cfg, _timers.get());
+    TCPSegment syn;
+    syn.header().syn = true;
+    syn.header().seqno = peer_isn;
+    syn.header().win = ack.header().win;
+    connection->segment_received(syn);
+    while (not connection->segments_out().empty()) {
+        connection->segments_out().pop();
+    }
+    connection->segment_received(ack);
+    if (not connection->established()) {
+        return false;
+    }
+    _connections.try_emplace(tuple, Entry{move(connection), Stage::Queued});
+    l.accept_queue.push_back(tuple);
+    l.pending++;
+    l.queued++;
+    _syn_cookies_accepted++;
+    return true;
+}
+
+// nobody is listening: answer with a RST, unless it is one ([RFC 793](\ref rfc::rfc793) section 3.4)
+void TCPDemux::send_reset(const FourTuple &tuple, const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    if (header.rst) {
+        return;
+    }
+    TCPSegment rst;
+    rst.header().rst = true;
+    if (header.ack) {
+        rst.header().seqno = header.ackno;
+    } else {
+        rst.header().ack = true;
+        rst.header().ackno = header.seqno + seg.length_in_sequence_space();
+    }
+    _stateless.emplace_back(tuple, move(rst));
+}
+
+void TCPDemux::datagram_received(const InternetDatagram &dgram) {
+    if (dgram.header().proto != IPv4Header::PROTO_TCP) {
+        return;
+    }
+    TCPSegment seg;
+    if (ParseResult::NoError != seg.parse(dgram.payload(), dgram.header().pseudo_cksum())) {
+        return;
+    }
+    segment_received({dgram.header().dst, dgram.header().src, seg.header().dport, seg.header().sport}, seg);
+}
+
+size_t TCPDemux::drain_segments_out(vector<pair<FourTuple, TCPSegment>> &out) {
+    const size_t before = out.size();
+    for (auto &[tuple, entry] : _connections) {
+        if (entry.connection->segments_out().empty()) {
+            continue;
+        }
+        entry.connection->drain_segments_out(_drained);
+        for (TCPSegment &seg : _drained) {
+            out.emplace_back(tuple, move(seg));
+        }
+        _drained.clear();
+    }
+    for (auto &stateless : _stateless) {
+        out.push_back(move(stateless));
+    }
+    _stateless.clear();
+    for (size_t i = before; i < out.size(); i++) {
+        out[i].second.header().sport = out[i].first.local_port;
+        out[i].second.header().dport = out[i].first.remote_port;
+    }
+    return out.size() - before;
+}
+
+size_t TCPDemux::drain_datagrams_out(vector<InternetDatagram> &out) {
+    vector<pair<FourTuple, TCPSegment>> segments;
+    drain_segments_out(segments);
+    for (auto &[tuple, seg] : segments) {
+        out.push_back(wrap(tuple, seg));
+    }
+    return segments.size();
+}
+
+//! \details A connection is removed once it is no longer active and everything it queued has been drained,
+//! so that its final segments (e.g. a RST) still go out. A connection that is only lingering moves to the
+//! TIME_WAIT table at that point, if compact_time_wait is set.
+void TCPDemux::tick(const size_t ms_since_last_tick) {
+    TCPConnection::tick(*_timers, ms_since_last_tick);
+    // erasing moves the last entry into the hole, so walk backwards to visit every entry once
+    for (size_t i = _connections.size(); i-- > 0;) {
+        const auto &[tuple, entry] = *(_connections.begin() + i);
+        if (not entry.connection->segments_out().empty()) {
+            continue;
+        }
+        if (entry.connection->active()) {
+            optional<TCPConnection::TimeWait> state;
+            if (not _cfg.compact_time_wait or not(state = entry.connection->release_time_wait())) {
+                continue;
+            }
+            const size_t expiry = _timers->now() + 10 * _cfg.rt_timeout;
+            _time_wait.try_emplace(tuple, TimeWaitEntry{*state, _timers->now(), expiry});
+            _time_wait_expiry.emplace_back(expiry, tuple);
+        }
+        if (entry.stage != Stage::Open) {
+            release_pending(tuple.local_port, entry.stage);
+        }
+        const FourTuple finished = tuple;
+        _connections.erase(finished);
+    }
+
+    while (not _time_wait_expiry.empty() and _time_wait_expiry.front().first <= _timers->now()) {
+        const auto [expiry, tuple] = _time_wait_expiry.front();
+        _time_wait_expiry.pop_front();
+        const TimeWaitEntry *entry = _time_wait.find(tuple);
+        if (entry and entry->expiry == expiry) {
+            _time_wait.erase(tuple);
+        }
+    }
+}
+
+optional<size_t> TCPDemux::next_deadline() const {
+    optional<size_t> deadline = _timers->next_expiry();
+    if (not _time_wait_expiry.empty()) {
+        const size_t expiry = _time_wait_expiry.front().first;
+        const size_t due = expiry - min<size_t>(expiry, _timers->now());
+        deadline = min(deadline.value_or(due), due);
+    }
+    return deadline;
+}
+
+InternetDatagram TCPDemux::wrap(const FourTuple &tuple, TCPSegment &seg) {
+    seg.header().sport = tuple.local_port;
+    seg.header().dport = tuple.remote_port;
+
+    InternetDatagram dgram;
+    dgram.header().src = tuple.local_address;
+    dgram.header().dst = tuple.remote_address;
+    dgram.header().len = dgram.header().hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+    dgram.payload() = seg.serialize(dgram.header().pseudo_cksum());
+    return dgram;
+}
@@ -0,0 +1,260 @@
+#ifndef SPONGE_LIBSPONGE_TCP_DEMUX_HH
+#define SPONGE_LIBSPONGE_TCP_DEMUX_HH
+
+#include "flat_hash_map.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+#include "wrapping_integers.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! \brief The addresses and ports that identify a TCP connection, as seen from this end
+struct FourTuple {
+    uint32_t local_address{0};   //!< IPv4 address, host byte order
+    uint32_t remote_address{0};  //!< IPv4 address, host byte order
+    uint16_t local_port{0};
+    uint16_t remote_port{0};
+
+    bool operator==(const FourTuple &other) const {
+        return local_address == other.local_address and remote_address == other.remote_address and
+               local_port == other.local_port and remote_port == other.remote_port;
+    }
+    bool operator!=(const FourTuple &other) const { return not(*this == other); }
+
+    //! \brief The same connection as seen from the other end
+    FourTuple reversed() const { return {remote_address, local_address, remote_port, local_port}; }
+};
+
+//! Hash for FourTuple; FlatHashMap mixes the bits further
+struct FourTupleHash {
+    size_t operator()(const FourTuple &tuple) const {
+        const uint64_t addresses = (uint64_t{tuple.local_address} << 32) | tuple.remote_address;
+        const uint64_t ports = (uint64_t{tuple.local_port} << 16) | tuple.remote_port;
+        return addresses ^ (ports * 0x9e3779b97f4a7c15ULL);
+    }
+};
+
+//! \brief Many TCPConnections behind one datagram interface
+//! \details Inbound segments are handed to the connection their 4-tuple names, found in a FlatHashMap.
+//! A segment for no connection either opens one, if it is a SYN to a port being listened on, or is
+//! answered with a RST. A passively opened connection is queued for accept() once its handshake
+//! completes; until accept() takes it, it counts against its listener's backlog. Connections that have
+//! finished are removed by tick() once their last segments have been drained. The connections share one
+//! timer wheel, which tick() advances once, so idle connections cost it nothing but the walk that finds
+//! finished ones.
+//!
+//! With TCPConfig::compact_time_wait, a connection that is only lingering after both streams finished is
+//! replaced by an entry in a TIME_WAIT table: its sequence numbers, window and timestamps, a few dozen bytes
+//! instead of its buffers. A retransmitted FIN is ACKed again from there and restarts the wait; RSTs are
+//! ignored ([RFC 1337](\ref rfc::rfc1337)), and a SYN that is clearly newer than the old connection may take
+//! the 4-tuple over ([RFC 6191](\ref rfc::rfc6191)). Every entry waits as long, so the order entries
+//! join in is the order they expire in, and tick() only looks at those that are due.
+//!
+//! A SYN that would exceed the backlog is dropped, or answered with a SYN cookie: a SYN-ACK whose
+//! sequence number is a keyed hash of the 4-tuple, the peer's ISN and a coarse clock, sent without
+//! creating any state. The connection is only created when an ACK comes back that acknowledges a valid
+//! cookie, so a flood of SYNs costs no memory; it joins the accept queue if fewer than `backlog`
+//! connections are waiting there, however many are still handshaking. As in other stacks, a connection
+//! opened this way does not use the window scale, timestamps or SACK options, since the SYN that asked
+//! for them was not kept.
+//!
+//! With TCPConfig::fast_open, the demultiplexer does both halves of TCP Fast Open
+//! ([RFC 7413](\ref rfc::rfc7413)). As a server, it gives each peer address a cookie (a keyed hash of the
+//! address), and a SYN that presents the right one has its data accepted: the connection is ready for
+//! accept() at once, and its reply can leave before the handshake completes. Data in any other SYN is
+//! dropped, to be sent again after the handshake. As a client, it remembers the cookie each server gave,
+//! and the next connect() to that server sends its data in the SYN. It remembers at most
+//! MAX_FAST_OPEN_COOKIES servers, forgetting the one it heard from first when a new one would exceed that;
+//! a forgotten server costs one more round trip, to fetch a fresh cookie.
+//!
+//! The demultiplexer does no I/O and runs no thread: its caller feeds it segments or datagrams, drains
+//! what it sends and calls tick(). In the socket layer, TCPSpongeListener does that for a server.
+class TCPDemux {
+  public:
+    //! When a listener answers SYNs with cookies instead of keeping state
+    enum class SynCookies {
+        Off,       //!< Never; SYNs past the backlog are dropped
+        WhenFull,  //!< For SYNs that arrive while the backlog is full
+        Always     //!< For every SYN
+    };
+
+    //! How long one value of the cookie clock lasts; a cookie is honored for one to two periods
+    static constexpr size_t COOKIE_PERIOD_MS = 64 * 1000;
+
+  private:
+    //! Where a connection is in its life, as far as the table is concerned
+    enum class Stage {
+        Handshake,  //!< Opened by a listener, handshake not complete yet
+        Queued,     //!< Handshake complete, waiting in the accept queue
+        Open        //!< Accepted, or opened with connect()
+    };
+
+    struct Entry {
+        //! Owned through a pointer, so that the table can move entries without moving connections
+        std::unique_ptr<TCPConnection> connection;
+        Stage stage;
+    };
+
+    struct TimeWaitEntry {
+        TCPConnection::TimeWait state;
+        size_t since;   //!< when it joined the table; our TSval has advanced by the time since
+        size_t expiry;  //!< when it leaves the table
+    };
+
+    struct Listener {
+        uint16_t port;
+        size_t backlog;
+        SynCookies syn_cookies;
+        size_t pending;  //!< connections in Handshake or Queued
+        size_t queued;   //!< connections in Queued
+        std::deque<FourTuple> accept_queue;
+    };
+
+    TCPConfig _cfg;
+    //! The timers of every connection; on the heap so that the demultiplexer can move, and declared before the
+    //! connections so that it outlives them
+    std::unique_ptr<TCPConnection::Timers> _timers{std::make_unique<TCPConnection::Timers>()};
+    FlatHashMap<FourTuple, Entry, FourTupleHash> _connections{};
+    std::vector<Listener> _listeners{};
+
+    //! Segments sent without a connection: RSTs, and SYN-ACKs carrying cookies
+    std::vector<std::pair<FourTuple, TCPSegment>> _stateless{};
+
+    //! Segments drained from one connection at a time, before they are tagged with its 4-tuple
+    std::vector<TCPSegment> _drained{};
+
+    uint64_t _syns_dropped{0};
+    uint64_t _syn_cookies_sent{0};
+    uint64_t _syn_cookies_accepted{0};
+    uint64_t _fast_open_accepted{0};
+
+    FlatHashMap<FourTuple, TimeWaitEntry, FourTupleHash> _time_wait{};
+    //! When each TIME_WAIT entry expires, in order; an entry whose wait was restarted appears again later on
+    std::deque<std::pair<size_t, FourTuple>> _time_wait_expiry{};
+
+    //! Fast Open cookies that servers have given us, by server address
+    FlatHashMap<uint32_t, std::string> _fast_open_cookies{};
+    //! The addresses in _fast_open_cookies, in the order they were added, to evict the oldest
+    std::deque<uint32_t> _fast_open_servers{};
+
+    //! Remember the Fast Open cookie the server at `address` gave us
+    void store_fast_open_cookie(const uint32_t address, const std::string &cookie);
+
+    //! Key for the SYN cookie hash, chosen at random
+    std::array<uint64_t, 2> _cookie_key;
+
+    //! The SYN cookie for a connection, at a given value of the cookie clock
+    WrappingInt32 syn_cookie(const FourTuple &tuple, const WrappingInt32 peer_isn, const uint64_t clock) const;
+
+    //! Answer a SYN with a cookie
+    void send_syn_cookie(const FourTuple &tuple, const TCPSegment &syn);
+
+    //! Create the connection whose cookie `ack` acknowledges, if the accept queue has room
+    //! \returns false if it acknowledges no valid cookie
+    bool accept_syn_cookie(Listener &l, const FourTuple &tuple, const TCPSegment &ack);
+
+    void send_reset(const FourTuple &tuple, const TCPSegment &seg);
+
+    //! Answer a segment for a connection in TIME_WAIT
+    //! \returns false if it is a SYN that may open a new connection with the same 4-tuple
+    bool time_wait_received(const FourTuple &tuple, TimeWaitEntry &entry, const TCPSegment &seg);
+
+    //! Create a connection for a SYN that fits in the listener's backlog
+    void accept_syn(Listener &l, const FourTuple &tuple, const TCPSegment &syn);
+
+    //! The Fast Open cookie we give the peer at `address`
+    std::string fast_open_cookie(const uint32_t address) const;
+
+    Listener *listener(const uint16_t port);
+
+    //! A connection left the Handshake or Queued `stage`
+    void release_pending(const uint16_t port, const Stage stage);
+
+  public:
+    //! The most servers whose Fast Open cookies a client remembers
+    static constexpr size_t MAX_FAST_OPEN_COOKIES = 1024;
+
+    //! \param[in] cfg configures every connection the demultiplexer creates
+    explicit TCPDemux(const TCPConfig &cfg);
+
+    //! \brief Accept connections to `port`, with at most `backlog` of them handshaking or waiting for accept()
+    void listen(const uint16_t port,
+                const size_t backlog = 128,
+                const SynCookies syn_cookies = SynCookies::WhenFull);
+
+    //! \brief Stop accepting connections to `port`
+    //! \details Later SYNs to it are answered with a RST, and connections that accept() has not taken are reset.
+    void unlisten(const uint16_t port);
+
+    //! \brief Open a connection and send its SYN
+    //! \param[in] data is written first, so that it goes in the SYN if the server gave us a Fast Open cookie
+    //! \throws std::runtime_error if the 4-tuple is already in use
+    TCPConnection &connect(const FourTuple &tuple, const std::string &data = {});
+
+    //! \brief Take a connection that has completed its handshake to `port`
+    //! \returns its 4-tuple, or empty if none is waiting
+    std::optional<FourTuple> accept(const uint16_t port);
+
+    //! \returns the connection named by `tuple`, or nullptr
+    TCPConnection *find(const FourTuple &tuple);
+
+    //! \name Inbound
+    //!@{
+
+    //! \brief Hand a segment to the connection named by `tuple`, whose local end is the segment's destination
+    void segment_received(const FourTuple &tuple, const TCPSegment &seg);
+
+    //! \brief Parse a TCP segment out of an IPv4 datagram and hand it on
+    void datagram_received(const InternetDatagram &dgram);
+    //!@}
+
+    //! \name Outbound
+    //!@{
+
+    //! \brief Move every connection's outgoing segments to `out`, with their ports filled in
+    //! \returns the number of segments moved
+    size_t drain_segments_out(std::vector<std::pair<FourTuple, TCPSegment>> &out);
+
+    //! \brief Same as drain_segments_out(), but wrapped in IPv4 datagrams
+    size_t drain_datagrams_out(std::vector<InternetDatagram> &out);
+    //!@}
+
+    //! \brief Tell every connection that time has passed, and remove those that have finished
+    void tick(const size_t ms_since_last_tick);
+
+    //! \brief Milliseconds until tick() next has something to do, or empty if only a segment or a write can
+    //! give it something
+    std::optional<size_t> next_deadline() const;
+
+    //! \name Accessors
+    //!@{
+    size_t size() const { return _connections.size(); }
+    //! \brief Connections in the TIME_WAIT table, which are not counted by size()
+    size_t time_wait_size() const { return _time_wait.size(); }
+    //! \brief SYNs dropped because their listener's backlog was full
+    uint64_t syns_dropped() const { return _syns_dropped; }
+    //! \brief SYNs answered with a cookie
+    uint64_t syn_cookies_sent() const { return _syn_cookies_sent; }
+    //! \brief Connections created from a valid cookie
+    uint64_t syn_cookies_accepted() const { return _syn_cookies_accepted; }
+    //! \brief SYNs whose data was accepted with a valid Fast Open cookie
+    uint64_t fast_open_accepted() const { return _fast_open_accepted; }
+    //! \brief Servers whose Fast Open cookies we remember, at most MAX_FAST_OPEN_COOKIES
+    size_t fast_open_cookies() const { return _fast_open_cookies.size(); }
+    //!@}
+
+    //! \brief Wrap a segment of the connection named by `tuple` in an IPv4 datagram
+    static InternetDatagram wrap(const FourTuple &tuple, TCPSegment &seg);
+};
+
+#endif  // SPONGE_LIBSPONGE_TCP_DEMUX_HH
@@ -14,6 +14,7 @@ using namespace std;
 //! - the header's `doff` field is shorter than the minimum allowed
 //! - there is less data in the header than the `doff` field claims
 //! - the checksum is bad
+//! - an option runs past the end of the header
 ParseResult TCPHeader::parse(NetParser &p) {
     sport = p.u16();                 // source port
     dport = p.u16();                 // destination port
@@ -37,8 +38,57 @@ ParseResult TCPHeader::parse(NetParser &p) {
         return ParseResult::HeaderTooShort;
     }
 
-    // skip any options or anything extra in the header
-    p.remove_prefix(doff * 4 - TCPHeader::LENGTH);
+    // options: kind, then (except for EOL and NOP) length and value
+    wscale.reset();
+    timestamps.reset();
+    sack_permitted = false;
+    sack.clear();
+    fastopen.reset();
+    size_t remaining = doff * 4 - TCPHeader::LENGTH;
+    while (remaining > 0 and not p.error()) {
+        const uint8_t kind = p.u8();
+        remaining--;
+        if (kind == OPT_EOL) {
+            break;
+        }
+        if (kind == OPT_NOP) {
+            continue;
+        }
+        if (remaining == 0) {
+            return ParseResult::HeaderTooShort;
+        }
+        const uint8_t len = p.u8();
+        remaining--;
+        if (len < 2 or len - 2u > remaining) {
+            return ParseResult::HeaderTooShort;
+        }
+        if (kind == OPT_WSCALE and len == 3) {
+            wscale = p.u8();
+        } else if (kind == OPT_TIMESTAMPS and len == 10) {
+            const uint32_t tsval = p.u32();
+            const uint32_t tsecr = p.u32();
+            timestamps = Timestamps{tsval, tsecr};
+        } else if (kind == OPT_SACK_PERMITTED and len == 2) {
+            sack_permitted = true;
+        } else if (kind == OPT_SACK and len > 2 and (len - 2) % 8 == 0) {
+            for (size_t i = 0; i < (len - 2u) / 8; i++) {
+                const WrappingInt32 left{p.u32()};
+                const WrappingInt32 right{p.u32()};
+                sack.push_back({left, right});
+            }
+        } else if (kind == OPT_FASTOPEN and len - 2u <= MAX_FASTOPEN_COOKIE) {
+            fastopen = string(len - 2, '\0');
+            for (char &c : fastopen.value()) {
+                c = static_cast<char>(p.u8());
+            }
+        } else {
+            p.remove_prefix(len - 2);  // unknown option
+        }
+        remaining -= len - 2;
+    }
+
+    // skip anything after the end of the option list
+    p.remove_prefix(remaining);
 
     if (p.error()) {
         return p.get_error();
@@ -47,12 +97,35 @@ ParseResult TCPHeader::parse(NetParser &p) {
     return ParseResult::NoError;
 }
 
+size_t TCPHeader::options_length() const {
+    size_t len = 0;
+    if (wscale.has_value()) {
+        len += 4;  // NOP, then kind, length, shift
+    }
+    if (timestamps.has_value()) {
+        len += 12;  // NOP, NOP, then kind, length, TSval, TSecr
+    }
+    if (sack_permitted) {
+        len += 4;  // NOP, NOP, then kind, length
+    }
+    if (not sack.empty()) {
+        len += 4 + 8 * sack.size();  // NOP, NOP, then kind, length, and the blocks
+    }
+    if (fastopen.has_value()) {
+        len += (fastopen.value().size() + 5) / 4 * 4;  // NOPs to pad, then kind, length, cookie
+    }
+    return len;
+}
+
 //! Serialize the TCPHeader to a string (does not recompute the checksum)
 string TCPHeader::serialize() const {
     // sanity check
     if (doff < 5) {
         throw runtime_error("TCP header too short");
     }
+    if (doff * 4u < LENGTH + options_length()) {
+        throw runtime_error("TCP header too short for its options");
+    }
 
     string ret;
     ret.reserve(4 * doff);
@@ -72,6 +145,45 @@ string TCPHeader::serialize() const {
 
     NetUnparser::u16(ret, uptr);  // urgent pointer
 
+    if (wscale.has_value()) {
+        NetUnparser::u8(ret, OPT_NOP);  // pad so the shift is the last byte of a word
+        NetUnparser::u8(ret, OPT_WSCALE);
+        NetUnparser::u8(ret, 3);
+        NetUnparser::u8(ret, wscale.value());
+    }
+    if (timestamps.has_value()) {
+        NetUnparser::u8(ret, OPT_NOP);  // pad so TSval and TSecr are word-aligned
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_TIMESTAMPS);
+        NetUnparser::u8(ret, 10);
+        NetUnparser::u32(ret, timestamps.value().tsval);
+        NetUnparser::u32(ret, timestamps.value().tsecr);
+    }
+    if (sack_permitted) {
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_SACK_PERMITTED);
+        NetUnparser::u8(ret, 2);
+    }
+    if (not sack.empty()) {
+        NetUnparser::u8(ret, OPT_NOP);  // pad so the blocks are word-aligned
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_SACK);
+        NetUnparser::u8(ret, 2 + 8 * sack.size());
+        for (const SackBlock &block : sack) {
+            NetUnparser::u32(ret, block.left.raw_value());
+            NetUnparser::u32(ret, block.right.raw_value());
+        }
+    }
+    if (fastopen.has_value()) {
+        for (size_t i = (fastopen.value().size() + 2) % 4; i % 4 != 0; i++) {
+            NetUnparser::u8(ret, OPT_NOP);  // pad in front so the option ends on a word boundary
+        }
+        NetUnparser::u8(ret, OPT_FASTOPEN);
+        NetUnparser::u8(ret, 2 + fastopen.value().size());
+        ret.append(fastopen.value());
+    }
+
     ret.resize(4 * doff);  // expand header to advertised size
 
     return ret;
@@ -90,13 +202,44 @@ string TCPHeader::to_string() const {
        << "TCP winsize: " << +win << '\n'
        << "TCP cksum: " << +cksum << '\n'
        << "TCP uptr: " << +uptr << '\n';
+    if (wscale.has_value()) {
+        ss << "TCP wscale: " << +wscale.value() << '\n';
+    }
+    if (timestamps.has_value()) {
+        ss << "TCP tsval: " << timestamps.value().tsval << " tsecr: " << timestamps.value().tsecr << '\n';
+    }
+    if (sack_permitted) {
+        ss << "TCP sack permitted\n";
+    }
+    for (const SackBlock &block : sack) {
+        ss << "TCP sack: " << block.left << "-" << block.right << '\n';
+    }
+    if (fastopen.has_value()) {
+        ss << "TCP fast open cookie length: " << fastopen.value().size() << '\n';
+    }
     return ss.str();
 }
 
 string TCPHeader::summary() const {
     stringstream ss{};
     ss << "Header(flags=" << (syn ? "S" : "") << (ack ? "A" : "") << (rst ? "R" : "") << (fin ? "F" : "")
-       << ",seqno=" << seqno << ",ack=" << ackno << ",win=" << win << ")";
+       << ",seqno=" << seqno << ",ack=" << ackno << ",win=" << win;
+    if (wscale.has_value()) {
+        ss << ",wscale=" << +wscale.value();
+    }
+    if (timestamps.has_value()) {
+        ss << ",ts=" << timestamps.value().tsval << "/" << timestamps.value().tsecr;
+    }
+    if (sack_permitted) {
+        ss << ",sackok";
+    }
+    for (const SackBlock &block : sack) {
+        ss << ",sack=" << block.left << "-" << block.right;
+    }
+    if (fastopen.has_value()) {
+        ss << ",tfo=" << fastopen.value().size();
+    }
+    ss << ")";
     return ss.str();
 }
 
@@ -104,5 +247,6 @@ bool TCPHeader::operator==(const TCPHeader &other) const {
     // TODO(aozdemir) more complete check (right now we omit cksum, src, dst
     return seqno == other.seqno && ackno == other.ackno && doff == other.doff && urg == other.urg && ack == other.ack &&
            psh == other.psh && rst == other.rst && syn == other.syn && fin == other.fin && win == other.win &&
-           uptr == other.uptr;
+           uptr == other.uptr && wscale == other.wscale && timestamps == other.timestamps &&
+           sack_permitted == other.sack_permitted && sack == other.sack && fastopen == other.fastopen;
 }
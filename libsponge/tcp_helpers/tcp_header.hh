@@ -4,10 +4,31 @@
 #include "parser.hh"
 #include "wrapping_integers.hh"
 
+#include <optional>
+#include <string>
+#include <vector>
+
 //! \brief [TCP](\ref rfc::rfc793) segment header
-//! \note TCP options are not supported
+//! \note Of the TCP options, only window scale, timestamps ([RFC 7323](\ref rfc::rfc7323)),
+//! selective acknowledgment ([RFC 2018](\ref rfc::rfc2018)) and Fast Open ([RFC 7413](\ref rfc::rfc7413))
+//! are understood; others are skipped when parsing and are never serialized.
 struct TCPHeader {
     static constexpr size_t LENGTH = 20;  //!< [TCP](\ref rfc::rfc793) header length, not including options
+    static constexpr size_t MAX_OPTIONS_LENGTH = 40;  //!< Most option bytes a header can hold (doff = 15)
+
+    //! \name TCP option kinds
+    //!@{
+    static constexpr uint8_t OPT_EOL = 0;             //!< end of option list
+    static constexpr uint8_t OPT_NOP = 1;             //!< no-operation (padding)
+    static constexpr uint8_t OPT_WSCALE = 3;          //!< window scale
+    static constexpr uint8_t OPT_SACK_PERMITTED = 4;  //!< selective acknowledgment permitted
+    static constexpr uint8_t OPT_SACK = 5;            //!< selective acknowledgment blocks
+    static constexpr uint8_t OPT_TIMESTAMPS = 8;      //!< timestamps
+    static constexpr uint8_t OPT_FASTOPEN = 34;       //!< Fast Open cookie
+    //!@}
+
+    static constexpr uint8_t MAX_WSCALE = 14;  //!< Largest window scale shift allowed by [RFC 7323](\ref rfc::rfc7323)
+    static constexpr size_t MAX_FASTOPEN_COOKIE = 16;  //!< Longest Fast Open cookie, in bytes
 
     //! \struct TCPHeader
     //! ~~~{.txt}
@@ -50,6 +71,38 @@ struct TCPHeader {
     uint16_t uptr = 0;          //!< urgent pointer
     //!@}
 
+    //! \name TCP options
+    //! \note `doff` must leave room for them; see options_length()
+    //!@{
+    std::optional<uint8_t> wscale{};  //!< window scale shift count, only meaningful on SYN segments
+
+    //! Values carried by the timestamps option
+    struct Timestamps {
+        uint32_t tsval = 0;  //!< sender's clock when the segment was sent
+        uint32_t tsecr = 0;  //!< most recent TSval received from the peer, echoed back
+
+        bool operator==(const Timestamps &other) const { return tsval == other.tsval && tsecr == other.tsecr; }
+    };
+    std::optional<Timestamps> timestamps{};  //!< timestamps option, if present
+
+    bool sack_permitted = false;  //!< SACK-permitted option, only meaningful on SYN segments
+
+    //! A block of sequence space the receiver holds past a hole: [left, right)
+    struct SackBlock {
+        WrappingInt32 left{0};   //!< first sequence number of the block
+        WrappingInt32 right{0};  //!< sequence number just past the block
+
+        bool operator==(const SackBlock &other) const { return left == other.left && right == other.right; }
+    };
+    std::vector<SackBlock> sack{};  //!< SACK blocks, at most (MAX_OPTIONS_LENGTH - 4) / 8 of them
+
+    //! Fast Open option, only meaningful on SYN segments: a cookie, or empty to ask for one
+    std::optional<std::string> fastopen{};
+    //!@}
+
+    //! Length of the serialized options, padded to a multiple of 4 bytes
+    size_t options_length() const;
+
     //! Parse the TCP fields from the provided NetParser
     ParseResult parse(NetParser &p);
 
@@ -4,7 +4,6 @@
 #include "ipv4_header.hh"
 #include "parser.hh"
 
-#include <arpa/inet.h>
 #include <stdexcept>
 #include <unistd.h>
 #include <utility>
@@ -15,23 +14,19 @@ using namespace std;
 //! the IP datagram's payload.
 //!
 //! If this succeeds, it then checks that the received segment is related to the
-//! current connection. When a TCP connection has been established, this means
-//! checking that the source and destination ports in the TCP header are correct.
-//!
-//! If the TCP connection is listening (i.e., TCPOverIPv4OverTunFdAdapter::_listen is `true`)
-//! and the TCP segment read from the wire includes a SYN, this function clears the
-//! `_listen` flag and records the source and destination addresses and port numbers
-//! from the TCP header; it uses this information to filter future reads.
+//! current connection, i.e. that the addresses in the IP header and the ports in
+//! the TCP header are correct. A server, which takes segments from any peer, uses
+//! unwrap_any_tcp_in_ip() instead.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram) {
     // is the IPv4 datagram for us?
     // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
-    if (not listening() and (ip_dgram.header().dst != config().source.ipv4_numeric())) {
+    if (ip_dgram.header().dst != config().source.ipv4_numeric()) {
         return {};
     }
 
     // is the IPv4 datagram from our peer?
-    if (not listening() and (ip_dgram.header().src != config().destination.ipv4_numeric())) {
+    if (ip_dgram.header().src != config().destination.ipv4_numeric()) {
         return {};
     }
 
@@ -51,17 +46,6 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
         return {};
     }
 
-    // should we target this source addr/port (and use its destination addr as our source) in reply?
-    if (listening()) {
-        if (tcp_seg.header().syn and not tcp_seg.header().rst) {
-            config_mutable().source = {inet_ntoa({htobe32(ip_dgram.header().dst)}), config().source.port()};
-            config_mutable().destination = {inet_ntoa({htobe32(ip_dgram.header().src)}), tcp_seg.header().sport};
-            set_listening(false);
-        } else {
-            return {};
-        }
-    }
-
     // is the TCP segment from our peer?
     if (tcp_seg.header().sport != config().destination.port()) {
         return {};
@@ -70,6 +54,33 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
     return tcp_seg;
 }
 
+//! \details Unlike unwrap_tcp_in_ip(), this does not check who sent the segment; a TCPSpongeListener
+//! tells connections apart by the 4-tuple. The destination address is
+//! checked unless the configured source address is "0" (INADDR_ANY).
+//! \returns a std::optional that is empty if the datagram held no valid TCP segment for us
+optional<pair<FourTuple, TCPSegment>> TCPOverIPv4Adapter::unwrap_any_tcp_in_ip(const InternetDatagram &ip_dgram) {
+    const uint32_t address = config().source.ipv4_numeric();
+    if (address != 0 and ip_dgram.header().dst != address) {
+        return {};
+    }
+
+    if (ip_dgram.header().proto != IPv4Header::PROTO_TCP) {
+        return {};
+    }
+
+    TCPSegment tcp_seg;
+    if (ParseResult::NoError != tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum())) {
+        return {};
+    }
+
+    if (tcp_seg.header().dport != config().source.port()) {
+        return {};
+    }
+
+    const FourTuple tuple{ip_dgram.header().dst, ip_dgram.header().src, tcp_seg.header().dport, tcp_seg.header().sport};
+    return make_pair(tuple, move(tcp_seg));
+}
+
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg) {
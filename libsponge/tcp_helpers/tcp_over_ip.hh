@@ -7,6 +7,7 @@
 #include "tcp_segment.hh"
 
 #include <optional>
+#include <utility>
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase {
@@ -14,6 +15,9 @@ class TCPOverIPv4Adapter : public FdAdapterBase {
     std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram);
 
     InternetDatagram wrap_tcp_in_ip(TCPSegment &seg);
+
+    //! Unfiltered mode: the TCP segment in a datagram for our address and port from any peer, and its 4-tuple
+    std::optional<std::pair<FourTuple, TCPSegment>> unwrap_any_tcp_in_ip(const InternetDatagram &ip_dgram);
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_OVER_IP_HH
@@ -0,0 +1,366 @@
+#include "tcp_sponge_listener.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <sys/socket.h>
+
+using namespace std;
+
+//! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain stream sockets
+static pair<FileDescriptor, FileDescriptor> stream_socket_pair() {
+    int fds[2];
+    SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_STREAM, 0, static_cast<int *>(fds)));
+    return {FileDescriptor(fds[0]), FileDescriptor(fds[1])};
+}
+
+//! \param[in] datagram_interface is the underlying interface (e.g. to UDP, IP, or Ethernet)
+//! \param[in] c_tcp is the TCPConfig for every TCPConnection
+//! \param[in] c_ad is the FdAdapterConfig for the FdAdapter; its source is the address to listen on
+template <typename AdaptT>
+TCPSpongeListener<AdaptT>::TCPSpongeListener(AdaptT &&datagram_interface,
+                                             const TCPConfig &c_tcp,
+                                             const FdAdapterConfig &c_ad,
+                                             const size_t backlog,
+                                             const TCPDemux::SynCookies syn_cookies)
+    : TCPSpongeListener(stream_socket_pair(), move(datagram_interface), c_tcp, c_ad, backlog, syn_cookies) {}
+
+template <typename AdaptT>
+TCPSpongeListener<AdaptT>::TCPSpongeListener(pair<FileDescriptor, FileDescriptor> wakeup_socket_pair,
+                                             AdaptT &&datagram_interface,
+                                             const TCPConfig &c_tcp,
+                                             const FdAdapterConfig &c_ad,
+                                             const size_t backlog,
+                                             const TCPDemux::SynCookies syn_cookies)
+    : _datagram_adapter(move(datagram_interface))
+    , _demux(c_tcp)
+    , _port(c_ad.source.port())
+    , _wakeup(move(wakeup_socket_pair.first))
+    , _wakeup_thread(move(wakeup_socket_pair.second)) {
+    _datagram_adapter.config_mut() = c_ad;
+    _demux.listen(_port, backlog, syn_cookies);
+    _wakeup_thread.set_blocking(false);
+
+    cerr << "DEBUG: Listening for incoming connections...\n";
+    _tcp_thread = thread(&TCPSpongeListener::_tcp_main, this);
+}
+
+template <typename AdaptT>
+TCPSpongeListener<AdaptT>::~TCPSpongeListener() {
+    try {
+        if (_tcp_thread.joinable()) {
+            cerr << "Warning: unclean shutdown of TCPSpongeListener\n";
+            // force the other side to exit
+            _abort.store(true);
+            _wakeup.write("!");
+            _tcp_thread.join();
+        }
+    } catch (const exception &e) {
+        cerr << "Exception destructing TCPSpongeListener: " << e.what() << endl;
+    }
+}
+
+//! \details The TCPConnection thread only takes a connection from the demultiplexer's accept queue for a
+//! call to accept() that is waiting, so connections nobody accepts count against the backlog.
+template <typename AdaptT>
+LocalStreamSocket TCPSpongeListener<AdaptT>::accept() {
+    unique_lock<mutex> lock(_mutex);
+    _accepts_waiting++;
+    _wakeup.write("a");
+    _accepted.wait(lock, [&] { return not _accepted_sockets.empty() or _finished; });
+    _accepts_waiting--;
+    if (_accepted_sockets.empty()) {
+        throw runtime_error("TCPSpongeListener::accept(): no longer listening");
+    }
+    LocalStreamSocket socket = move(_accepted_sockets.front());
+    _accepted_sockets.pop_front();
+    return socket;
+}
+
+//! \details Connections that have not been accepted yet are reset.
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::wait_until_closed() {
+    _closing.store(true);
+    _wakeup.write("c");
+    if (_tcp_thread.joinable()) {
+        cerr << "DEBUG: Waiting for clean shutdown... ";
+        _tcp_thread.join();
+        cerr << "done.\n";
+    }
+}
+
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_accept_pending() {
+    while (true) {
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (_accepted_sockets.size() >= _accepts_waiting) {
+                return;
+            }
+        }
+        const optional<FourTuple> tuple = _demux.accept(_port);
+        if (not tuple.has_value()) {
+            return;
+        }
+
+        _publish_stats();
+        auto [owner_end, thread_end] = stream_socket_pair();
+        auto stream = make_shared<Stream>(Stream{tuple.value(), LocalStreamSocket(move(thread_end))});
+        stream->socket.set_blocking(false);
+        _add_stream_rules(stream);
+        _streams.push_back(move(stream));
+        cerr << "New connection from "
+             << Address::from_ipv4_numeric(tuple->remote_address, tuple->remote_port).to_string() << ".\n";
+
+        {
+            lock_guard<mutex> lock(_mutex);
+            _accepted_sockets.emplace_back(move(owner_end));
+        }
+        _accepted.notify_all();
+    }
+}
+
+template <typename AdaptT>
+bool TCPSpongeListener<AdaptT>::_inbound_finished(const Stream &stream) {
+    TCPConnection *tcp = _demux.find(stream.tuple);
+    return tcp == nullptr or tcp->inbound_stream().eof() or tcp->inbound_stream().error();
+}
+
+//! \details The demultiplexer removes a connection once it has finished, or moves it to the TIME_WAIT table,
+//! whether or not the owner has read everything it received. It can only finish after the peer's FIN, so
+//! what is left then goes into the stream's leftover. If the owner has stopped reading, it is dropped.
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_save_leftovers() {
+    for (const auto &stream : _streams) {
+        TCPConnection *tcp = _demux.find(stream->tuple);
+        if (tcp == nullptr or tcp->inbound_stream().buffer_empty()) {
+            continue;
+        }
+        ByteStream &inbound = tcp->inbound_stream();
+        if (not stream->inbound_shutdown and inbound.input_ended()) {
+            stream->leftover.append(inbound.peek_output(inbound.buffer_size()));
+        }
+        if (stream->inbound_shutdown or inbound.input_ended()) {
+            inbound.pop_output(inbound.buffer_size());
+        }
+    }
+}
+
+//! \details Closing the TCPConnection thread's end of the stream socket cancels its rules. A connection that
+//! is still lingering stays in the demultiplexer after its stream has gone.
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_finish_streams() {
+    // NOTE: i is decremented in the loop header, so removing the stream at i moves one already visited
+    for (size_t i = _streams.size(); i-- > 0;) {
+        Stream &stream = *_streams[i];
+        if (stream.inbound_shutdown and (stream.outbound_shutdown or _demux.find(stream.tuple) == nullptr)) {
+            stream.socket.close();
+            _streams[i] = move(_streams.back());
+            _streams.pop_back();
+        }
+    }
+}
+
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_write_outbound() {
+    _outbound_batch.clear();
+    _demux.drain_segments_out(_outbound_batch);
+    for (auto &[tuple, seg] : _outbound_batch) {
+        if (_eventloop.backend() == EventLoop::Backend::IoUring) {
+            _datagram_adapter.write_to(tuple, seg, _eventloop);
+        } else {
+            _datagram_adapter.write_to(tuple, seg);
+        }
+    }
+}
+
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_add_rules() {
+    // rule 1: read from the unfiltered packet stream and hand each segment to the demultiplexer
+    if (_eventloop.backend() == EventLoop::Backend::IoUring) {
+        _eventloop.add_datagram_rule(_datagram_adapter, [&](vector<EventLoop::Datagram> &datagrams) {
+            for (auto &datagram : datagrams) {
+                auto seg = _datagram_adapter.received_from_any(move(datagram));
+                if (seg) {
+                    _demux.segment_received(seg->first, seg->second);
+                }
+            }
+            _accept_pending();
+        });
+    } else {
+        _eventloop.add_rule(_datagram_adapter, Direction::In, [&] {
+            // the adapter does not block, so an empty read means there is nothing more (or a segment to skip,
+            // and the loop wakes again for the rest)
+            for (size_t i = 0; i < MAX_INBOUND_BATCH; i++) {
+                auto seg = _datagram_adapter.read_from_any();
+                if (not seg) {
+                    break;
+                }
+                _demux.segment_received(seg->first, seg->second);
+            }
+            _accept_pending();
+        });
+    }
+
+    // rule 2: the owner is waiting in accept(), or wants the thread to finish
+    _eventloop.add_rule(_wakeup_thread, Direction::In, [&] {
+        _wakeup_thread.read();
+        _accept_pending();
+    });
+}
+
+//! \param[in] stream is the accepted connection; the rules share it, and find its TCPConnection by 4-tuple
+//! each time, since the demultiplexer may have removed it
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_add_stream_rules(const shared_ptr<Stream> &stream) {
+    // read from the owner into the connection's outbound stream
+    _eventloop.add_rule(
+        stream->socket,
+        Direction::In,
+        [this, stream] {
+            TCPConnection &tcp = *_demux.find(stream->tuple);
+            auto data = stream->socket.read(tcp.remaining_outbound_capacity());
+            const auto len = data.size();
+            const auto amount_written = tcp.write(Buffer(move(data)));
+            if (amount_written != len) {
+                throw runtime_error("TCPConnection::write() accepted less than advertised length");
+            }
+            if (stream->socket.eof()) {
+                tcp.end_input_stream();
+                stream->outbound_shutdown = true;
+            }
+        },
+        [this, stream] {
+            const TCPConnection *tcp = _demux.find(stream->tuple);
+            return tcp != nullptr and tcp->active() and not stream->outbound_shutdown and
+                   tcp->remaining_outbound_capacity() > 0;
+        },
+        [this, stream] {
+            TCPConnection *tcp = _demux.find(stream->tuple);
+            if (tcp != nullptr and not stream->outbound_shutdown) {
+                tcp->end_input_stream();
+            }
+            stream->outbound_shutdown = true;
+        });
+
+    // write what the connection received (or its leftover) to the owner
+    _eventloop.add_rule(
+        stream->socket,
+        Direction::Out,
+        [this, stream] {
+            TCPConnection *tcp = _demux.find(stream->tuple);
+            if (not stream->leftover.empty()) {
+                const size_t bytes_written = stream->socket.write(stream->leftover, false);
+                stream->leftover.erase(0, bytes_written);
+            } else if (tcp != nullptr) {
+                ByteStream &inbound = tcp->inbound_stream();
+                const size_t amount_to_write = min(size_t(65536), inbound.buffer_size());
+                inbound.pop_output(stream->socket.write(inbound.peek_views(amount_to_write), false));
+            }
+            if (stream->leftover.empty() and _inbound_finished(*stream)) {
+                stream->socket.shutdown(SHUT_WR);
+                stream->inbound_shutdown = true;
+            }
+        },
+        [this, stream] {
+            if (stream->inbound_shutdown) {
+                return false;
+            }
+            TCPConnection *tcp = _demux.find(stream->tuple);
+            return not stream->leftover.empty() or (tcp != nullptr and not tcp->inbound_stream().buffer_empty()) or
+                   _inbound_finished(*stream);
+        },
+        [stream] {
+            stream->inbound_shutdown = true;
+            stream->leftover.clear();
+        });
+}
+
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_publish_stats() {
+    _connections.store(_demux.size());
+    _time_wait_connections.store(_demux.time_wait_size());
+    _syn_cookies_sent.store(_demux.syn_cookies_sent());
+    _syn_cookies_accepted.store(_demux.syn_cookies_accepted());
+}
+
+//! \details As in TCPSpongeSocket, the loop sleeps until the first timer is due or there is I/O to handle.
+//! After the owner calls wait_until_closed(), it stops listening, and returns once every stream has
+//! finished and the demultiplexer holds no connection, not even in TIME_WAIT.
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_tcp_main() {
+    try {
+        // the kernel completes io_uring requests through the thread that submitted them, so this thread
+        // sets up its own ring
+        if (_datagram_adapter.config().io_uring) {
+            try {
+                EventLoop loop{EventLoop::Backend::IoUring};
+                _eventloop = move(loop);
+            } catch (const unix_error &e) {
+                cerr << "DEBUG: io_uring is not available (" << e.what() << "), staying on epoll.\n";
+            }
+        }
+        _add_rules();
+
+        bool listening = true;
+        auto base_time = timestamp_ms();
+        while (not _abort) {
+            size_t timeout = MAX_SLEEP_MS;
+            for (const auto &deadline : {_demux.next_deadline(), _datagram_adapter.next_deadline()}) {
+                timeout = min(timeout, deadline.value_or(MAX_SLEEP_MS));
+            }
+            // the deadlines are counted from the last tick
+            const size_t elapsed = timestamp_ms() - base_time;
+            auto ret = _eventloop.wait_next_event(static_cast<int>(timeout - min(timeout, elapsed)));
+            if (ret == EventLoop::Result::Exit or _abort) {
+                break;
+            }
+
+            if (_closing and listening) {
+                _demux.unlisten(_port);
+                listening = false;
+            }
+
+            // what the events produced goes out before the tick, which removes connections that are drained
+            _save_leftovers();
+            _write_outbound();
+            const auto next_time = timestamp_ms();
+            _demux.tick(next_time - base_time);
+            _datagram_adapter.tick(next_time - base_time);
+            base_time = next_time;
+            _write_outbound();
+
+            _finish_streams();
+            _publish_stats();
+            if (not listening and _streams.empty() and _demux.size() == 0 and _demux.time_wait_size() == 0) {
+                break;
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception in TCPSpongeListener runner thread: " << e.what() << "\n";
+    }
+
+    {
+        lock_guard<mutex> lock(_mutex);
+        _finished = true;
+    }
+    _accepted.notify_all();
+}
+
+//! Specialization of TCPSpongeListener for TCPOverUDPSocketAdapter
+template class TCPSpongeListener<TCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPSpongeListener for TCPOverIPv4OverTunFdAdapter
+template class TCPSpongeListener<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialization of TCPSpongeListener for TCPOverIPv4OverEthernetAdapter
+template class TCPSpongeListener<TCPOverIPv4OverEthernetAdapter>;
+
+//! Specialization of TCPSpongeListener for LossyTCPOverUDPSocketAdapter
+template class TCPSpongeListener<LossyTCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPSpongeListener for LossyTCPOverIPv4OverTunFdAdapter
+template class TCPSpongeListener<LossyTCPOverIPv4OverTunFdAdapter>;
@@ -0,0 +1,204 @@
+#ifndef SPONGE_LIBSPONGE_TCP_SPONGE_LISTENER_HH
+#define SPONGE_LIBSPONGE_TCP_SPONGE_LISTENER_HH
+
+#include "eventloop.hh"
+#include "fd_adapter.hh"
+#include "file_descriptor.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_demux.hh"
+#include "tuntap_adapter.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! Multithreaded server that accepts many TCP connections over one datagram interface
+template <typename AdaptT>
+class TCPSpongeListener {
+  private:
+    //! Longest the loop sleeps when no timer is running, so that it still notices `_abort`
+    static constexpr size_t MAX_SLEEP_MS = 1000;
+
+    //! Most datagrams read per wakeup before other events get a turn
+    static constexpr size_t MAX_INBOUND_BATCH = 64;
+
+    //! An accepted connection, as the TCP thread sees it
+    struct Stream {
+        FourTuple tuple;
+        //! The TCP thread's end of the stream socket that accept() gave the owner
+        LocalStreamSocket socket;
+        //! Inbound bytes taken out of a connection that may be removed before the owner has read them
+        std::string leftover{};
+        bool outbound_shutdown{false};  //!< Has the owner shut down the outbound data to the connection?
+        bool inbound_shutdown{false};   //!< Has the incoming data to the owner been shut down?
+    };
+
+  protected:
+    //! Adapter to underlying datagram socket (e.g., UDP or IP), used in its unfiltered mode
+    AdaptT _datagram_adapter;
+
+  private:
+    //! The connections, and the listener on the port in the adapter's source address
+    TCPDemux _demux;
+
+    //! The port being listened on
+    uint16_t _port;
+
+    //! Segments drained from the demultiplexer, to write
+    std::vector<std::pair<FourTuple, TCPSegment>> _outbound_batch{};
+
+    //! The accepted connections that still move data to or from their owner
+    std::vector<std::shared_ptr<Stream>> _streams{};
+
+    //! eventloop that handles all the events (new inbound datagram, bytes from or to an owner, wakeups)
+    EventLoop _eventloop{};
+
+    //! The owner writes to one end to wake the TCP thread, which reads the other
+    LocalStreamSocket _wakeup;
+    LocalStreamSocket _wakeup_thread;
+
+    //! Guards the members below, which both threads use
+    std::mutex _mutex{};
+
+    //! Signalled when _accepted_sockets grows, or the TCPConnection thread finishes
+    std::condition_variable _accepted{};
+
+    //! Calls to accept() waiting for a connection
+    size_t _accepts_waiting{0};
+
+    //! Owner ends of the connections taken for them
+    std::deque<LocalStreamSocket> _accepted_sockets{};
+
+    //! Has the TCPConnection thread finished?
+    bool _finished{false};
+
+    std::atomic_bool _closing{false};  //!< Has the owner stopped accepting, to wait for the connections to finish?
+
+    std::atomic_bool _abort{false};  //!< Flag used by the owner to force the TCPConnection thread to shut down
+
+    //! \name
+    //! Copies of the demultiplexer's counters, which the owner may read while the TCPConnection thread runs
+
+    //!@{
+    std::atomic<size_t> _connections{0};
+    std::atomic<size_t> _time_wait_connections{0};
+    std::atomic<uint64_t> _syn_cookies_sent{0};
+    std::atomic<uint64_t> _syn_cookies_accepted{0};
+    //!@}
+
+    //! Handle to the TCPConnection thread; owner thread calls join() in the destructor
+    std::thread _tcp_thread{};
+
+    //! Add the rules for the adapter and the wakeups to `_eventloop`
+    void _add_rules();
+
+    //! Add the rules that move data between an accepted connection and its owner
+    void _add_stream_rules(const std::shared_ptr<Stream> &stream);
+
+    //! Take connections from the demultiplexer for the calls to accept() waiting for one
+    void _accept_pending();
+
+    //! Is everything the connection received, or will receive, already with its owner (or in the leftover)?
+    bool _inbound_finished(const Stream &stream);
+
+    //! Move the remaining inbound bytes of connections whose peer has finished out of them
+    void _save_leftovers();
+
+    //! Close the streams that have finished in both directions
+    void _finish_streams();
+
+    //! Write the segments the connections have to send, or with io_uring queue them for the next wait
+    void _write_outbound();
+
+    //! Copy the demultiplexer's counters for the owner
+    void _publish_stats();
+
+    //! Main loop of TCPConnection thread
+    void _tcp_main();
+
+    //! Construct the wakeup sockets from socket pair, listen, and start the TCPConnection thread
+    TCPSpongeListener(std::pair<FileDescriptor, FileDescriptor> wakeup_socket_pair,
+                      AdaptT &&datagram_interface,
+                      const TCPConfig &c_tcp,
+                      const FdAdapterConfig &c_ad,
+                      const size_t backlog,
+                      const TCPDemux::SynCookies syn_cookies);
+
+  public:
+    //! \brief Listen on the address and port in `c_ad.source`, through `datagram_interface`
+    //! \param[in] backlog is the most connections that may be handshaking or waiting for accept()
+    //! \param[in] syn_cookies says when a SYN is answered with a cookie rather than a connection
+    TCPSpongeListener(AdaptT &&datagram_interface,
+                      const TCPConfig &c_tcp,
+                      const FdAdapterConfig &c_ad,
+                      const size_t backlog = 128,
+                      const TCPDemux::SynCookies syn_cookies = TCPDemux::SynCookies::WhenFull);
+
+    //! \brief Wait for a connection to complete its handshake
+    //! \returns the owner's end of a stream socket that reads and writes the connection
+    //! \throws std::runtime_error if the TCPConnection thread has finished
+    LocalStreamSocket accept();
+
+    //! Stop accepting connections, and wait for the accepted ones to finish
+    //! \note The owner should close the sockets that accept() returned first, or else this may wait forever
+    //! for them.
+    void wait_until_closed();
+
+    //! \name Accessors
+    //!@{
+    //! \brief Connections with a TCPConnection, including those handshaking or waiting for accept()
+    size_t connections() const { return _connections; }
+    //! \brief Connections that have finished but still linger, each as a small entry rather than a TCPConnection
+    size_t time_wait_connections() const { return _time_wait_connections; }
+    //! \brief SYNs answered with a cookie
+    uint64_t syn_cookies_sent() const { return _syn_cookies_sent; }
+    //! \brief Connections created from a valid cookie; a connection that accept() returned is already counted
+    uint64_t syn_cookies_accepted() const { return _syn_cookies_accepted; }
+    //!@}
+
+    //! When a listener is destructed, its connections are dropped
+    ~TCPSpongeListener();
+
+    //! \name
+    //! This object cannot be safely moved or copied, since it is in use by two threads simultaneously
+
+    //!@{
+    TCPSpongeListener(const TCPSpongeListener &) = delete;
+    TCPSpongeListener(TCPSpongeListener &&) = delete;
+    TCPSpongeListener &operator=(const TCPSpongeListener &) = delete;
+    TCPSpongeListener &operator=(TCPSpongeListener &&) = delete;
+    //!@}
+};
+
+using TCPOverUDPSpongeListener = TCPSpongeListener<TCPOverUDPSocketAdapter>;
+using TCPOverIPv4SpongeListener = TCPSpongeListener<TCPOverIPv4OverTunFdAdapter>;
+using TCPOverIPv4OverEthernetSpongeListener = TCPSpongeListener<TCPOverIPv4OverEthernetAdapter>;
+
+using LossyTCPOverUDPSpongeListener = TCPSpongeListener<LossyTCPOverUDPSocketAdapter>;
+using LossyTCPOverIPv4SpongeListener = TCPSpongeListener<LossyTCPOverIPv4OverTunFdAdapter>;
+
+//! \class TCPSpongeListener
+//! This is the server side of the socket layer: where a TCPSpongeSocket carries one connection, a
+//! TCPSpongeListener carries every connection to one port, through a TCPDemux.
+//!
+//! As with TCPSpongeSocket, two threads are involved. The owner calls the public methods: accept() returns
+//! a stream socket for each connection, which the owner reads and writes like a TCP socket. The
+//! TCPConnection thread reads datagrams from the adapter in its unfiltered mode, which hands over segments
+//! from any peer together with their 4-tuple, and gives them to the demultiplexer. It writes out what the
+//! demultiplexer drains, ticks it, and copies bytes between each connection and its stream socket.
+//!
+//! Since the demultiplexer is what listens, a SYN that would overflow the backlog is answered with a SYN
+//! cookie, and a connection that has finished but must still linger moves to its compact TIME_WAIT table.
+//! There its TCPConnection is freed, while a retransmitted FIN from the peer is still acknowledged; a busy
+//! server thus holds a few words, not a whole connection, for each of the many it closed recently.
+
+#endif  // SPONGE_LIBSPONGE_TCP_SPONGE_LISTENER_HH
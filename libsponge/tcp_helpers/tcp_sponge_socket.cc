@@ -18,14 +18,32 @@
 
 using namespace std;
 
-static constexpr size_t TCP_TICK_MS = 10;
+//! Longest the loop sleeps when no timer is running, so that it still notices `_abort`
+static constexpr size_t MAX_SLEEP_MS = 1000;
+
+//! Most datagrams read per wakeup before other events get a turn
+static constexpr size_t MAX_INBOUND_BATCH = 64;
 
 //! \param[in] condition is a function returning true if loop should continue
+//! \details Instead of waking at a fixed rate to tick the connection, the loop sleeps until the first of
+//! the connection's and the adapter's timers is due, or until there is I/O to handle.
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_tcp_loop(const function<bool()> &condition) {
     auto base_time = timestamp_ms();
     while (condition()) {
-        auto ret = _eventloop.wait_next_event(TCP_TICK_MS);
+        // with io_uring, what the last round produced goes out in the same system call as the wait
+        if (_eventloop.backend() == EventLoop::Backend::IoUring) {
+            _write_outbound();
+            _write_inbound();
+        }
+
+        size_t timeout = MAX_SLEEP_MS;
+        for (const auto &deadline : {_tcp.value().next_deadline(), _datagram_adapter.next_deadline()}) {
+            timeout = min(timeout, deadline.value_or(MAX_SLEEP_MS));
+        }
+        // the deadlines are counted from the last tick
+        const size_t elapsed = timestamp_ms() - base_time;
+        auto ret = _eventloop.wait_next_event(static_cast<int>(timeout - min(timeout, elapsed)));
         if (ret == EventLoop::Result::Exit or _abort) {
             break;
         }
@@ -50,9 +68,89 @@ TCPSpongeSocket<AdaptT>::TCPSpongeSocket(pair<FileDescriptor, FileDescriptor> da
     _thread_data.set_blocking(false);
 }
 
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_deliver_inbound() {
+    if (_inbound_batch.size() == 1) {
+        _tcp->segment_received(_inbound_batch.front());
+    } else if (not _inbound_batch.empty()) {
+        _tcp->segments_received(_inbound_batch);
+    }
+
+    // debugging output:
+    if (_outbound_shutdown and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
+        cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
+             << " has been fully acknowledged.\n";
+        _fully_acked = true;
+    }
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_write_outbound() {
+    _outbound_batch.clear();
+    _tcp->drain_segments_out(_outbound_batch);
+    for (auto &seg : _outbound_batch) {
+        if (_eventloop.backend() == EventLoop::Backend::IoUring) {
+            _datagram_adapter.write(seg, _eventloop);
+        } else {
+            _datagram_adapter.write(seg);
+        }
+    }
+}
+
+//! \details The bytes are taken out of the inbound stream when the write is queued, so the receive window
+//! reopens by one write's worth before the owner has them, as it does for what the kernel buffers.
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_write_inbound() {
+    if (_inbound_writing or _inbound_shutdown) {
+        return;
+    }
+    ByteStream &inbound = _tcp->inbound_stream();
+    if (not inbound.buffer_empty()) {
+        _inbound_writing = true;
+        _eventloop.write(_thread_data, inbound.read_buffers(min(size_t(65536), inbound.buffer_size())), [&] {
+            _inbound_writing = false;
+        });
+    } else if (inbound.eof() or inbound.error()) {
+        _finish_inbound();
+    }
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_finish_outbound() {
+    _tcp->end_input_stream();
+    _outbound_shutdown = true;
+
+    // debugging output:
+    cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string() << " finished ("
+         << _tcp.value().bytes_in_flight() << " byte" << (_tcp.value().bytes_in_flight() == 1 ? "" : "s")
+         << " still in flight).\n";
+}
+
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_finish_inbound() {
+    const ByteStream &inbound = _tcp->inbound_stream();
+    _thread_data.shutdown(SHUT_WR);
+    _inbound_shutdown = true;
+
+    // debugging output:
+    cerr << "DEBUG: Inbound stream from " << _datagram_adapter.config().destination.to_string() << " finished "
+         << (inbound.error() ? "with an error/reset.\n" : "cleanly.\n");
+    if (_tcp.value().state() == TCPState::State::TIME_WAIT) {
+        cerr << "DEBUG: Waiting for lingering segments (e.g. retransmissions of FIN) from peer...\n";
+    }
+}
+
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _tcp.emplace(config);
+    _add_rules(_eventloop);
+}
+
+//! \param[in] loop is the event loop to set up; with EventLoop::Backend::IoUring, it also receives and
+//!                 sends the datagrams
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_add_rules(EventLoop &loop) {
+    const bool io_uring = loop.backend() == EventLoop::Backend::IoUring;
 
     // Set up the event loop
 
@@ -71,95 +169,117 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     //
     // 4) Outbound segment generated by TCP (needs to be
     //    given to underlying datagram socket)
+    //
+    // With io_uring, the loop keeps receives posted for (1) and (2) and hands over what they
+    // received, and _tcp_loop queues (3) and (4) before each wait instead of waiting to write.
 
     // rule 1: read from filtered packet stream and dump into TCPConnection
-    _eventloop.add_rule(_datagram_adapter,
-                        Direction::In,
-                        [&] {
-                            auto seg = _datagram_adapter.read();
-                            if (seg) {
-                                _tcp->segment_received(move(seg.value()));
-                            }
-
-                            // debugging output:
-                            if (_thread_data.eof() and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
-                                cerr << "DEBUG: Outbound stream to "
-                                     << _datagram_adapter.config().destination.to_string()
-                                     << " has been fully acknowledged.\n";
-                                _fully_acked = true;
-                            }
-                        },
-                        [&] { return _tcp->active(); });
+    if (io_uring) {
+        loop.add_datagram_rule(
+            _datagram_adapter,
+            [&](vector<EventLoop::Datagram> &datagrams) {
+                _inbound_batch.clear();
+                for (auto &datagram : datagrams) {
+                    auto seg = _datagram_adapter.received(move(datagram));
+                    if (seg) {
+                        _inbound_batch.push_back(move(seg.value()));
+                    }
+                }
+                _deliver_inbound();
+            },
+            [&] { return _tcp->active(); });
+    } else {
+        loop.add_rule(_datagram_adapter,
+                      Direction::In,
+                      [&] {
+                          // take everything already queued (up to a limit) and hand it over in one batch; the
+                          // adapter does not block, so an empty read means there is nothing more (or a segment
+                          // to skip, and the loop wakes again for the rest)
+                          _inbound_batch.clear();
+                          while (_inbound_batch.size() < MAX_INBOUND_BATCH) {
+                              auto seg = _datagram_adapter.read();
+                              if (not seg) {
+                                  break;
+                              }
+                              _inbound_batch.push_back(move(seg.value()));
+                          }
+                          _deliver_inbound();
+                      },
+                      [&] { return _tcp->active(); });
+    }
 
     // rule 2: read from pipe into outbound buffer
-    _eventloop.add_rule(
-        _thread_data,
-        Direction::In,
-        [&] {
-            const auto data = _thread_data.read(_tcp->remaining_outbound_capacity());
-            const auto len = data.size();
-            const auto amount_written = _tcp->write(move(data));
-            if (amount_written != len) {
-                throw runtime_error("TCPConnection::write() accepted less than advertised length");
-            }
+    if (io_uring) {
+        loop.add_stream_rule(
+            _thread_data,
+            [&](string &data) {
+                if (data.empty()) {
+                    _finish_outbound();
+                    return;
+                }
+                // what a receive read after the connection ended has nowhere to go
+                const auto len = data.size();
+                if (_tcp->write(Buffer(move(data))) != len and _tcp->active()) {
+                    throw runtime_error("TCPConnection::write() accepted less than advertised length");
+                }
+            },
+            [&] { return _tcp->active() and not _outbound_shutdown ? _tcp->remaining_outbound_capacity() : 0; });
+    } else {
+        loop.add_rule(
+            _thread_data,
+            Direction::In,
+            [&] {
+                auto data = _thread_data.read(_tcp->remaining_outbound_capacity());
+                const auto len = data.size();
+                const auto amount_written = _tcp->write(Buffer(move(data)));
+                if (amount_written != len) {
+                    throw runtime_error("TCPConnection::write() accepted less than advertised length");
+                }
 
-            if (_thread_data.eof()) {
+                if (_thread_data.eof()) {
+                    _finish_outbound();
+                }
+            },
+            [&] {
+                return (_tcp->active()) and (not _outbound_shutdown) and (_tcp->remaining_outbound_capacity() > 0);
+            },
+            [&] {
                 _tcp->end_input_stream();
                 _outbound_shutdown = true;
-
-                // debugging output:
-                cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
-                     << " finished (" << _tcp.value().bytes_in_flight() << " byte"
-                     << (_tcp.value().bytes_in_flight() == 1 ? "" : "s") << " still in flight).\n";
-            }
-        },
-        [&] { return (_tcp->active()) and (not _outbound_shutdown) and (_tcp->remaining_outbound_capacity() > 0); },
-        [&] {
-            _tcp->end_input_stream();
-            _outbound_shutdown = true;
-        });
+            });
+    }
 
     // rule 3: read from inbound buffer into pipe
-    _eventloop.add_rule(
-        _thread_data,
-        Direction::Out,
-        [&] {
-            ByteStream &inbound = _tcp->inbound_stream();
-            // Write from the inbound_stream into
-            // the pipe, handling the possibility of a partial
-            // write (i.e., only pop what was actually written).
-            const size_t amount_to_write = min(size_t(65536), inbound.buffer_size());
-            const std::string buffer = inbound.peek_output(amount_to_write);
-            const auto bytes_written = _thread_data.write(move(buffer), false);
-            inbound.pop_output(bytes_written);
-
-            if (inbound.eof() or inbound.error()) {
-                _thread_data.shutdown(SHUT_WR);
-                _inbound_shutdown = true;
-
-                // debugging output:
-                cerr << "DEBUG: Inbound stream from " << _datagram_adapter.config().destination.to_string()
-                     << " finished " << (inbound.error() ? "with an error/reset.\n" : "cleanly.\n");
-                if (_tcp.value().state() == TCPState::State::TIME_WAIT) {
-                    cerr << "DEBUG: Waiting for lingering segments (e.g. retransmissions of FIN) from peer...\n";
+    if (not io_uring) {
+        loop.add_rule(
+            _thread_data,
+            Direction::Out,
+            [&] {
+                ByteStream &inbound = _tcp->inbound_stream();
+                // Write from the inbound_stream into
+                // the pipe, handling the possibility of a partial
+                // write (i.e., only pop what was actually written).
+                const size_t amount_to_write = min(size_t(65536), inbound.buffer_size());
+                const auto bytes_written = _thread_data.write(inbound.peek_views(amount_to_write), false);
+                inbound.pop_output(bytes_written);
+
+                if (inbound.eof() or inbound.error()) {
+                    _finish_inbound();
                 }
-            }
-        },
-        [&] {
-            return (not _tcp->inbound_stream().buffer_empty()) or
-                   ((_tcp->inbound_stream().eof() or _tcp->inbound_stream().error()) and not _inbound_shutdown);
-        });
+            },
+            [&] {
+                return (not _tcp->inbound_stream().buffer_empty()) or
+                       ((_tcp->inbound_stream().eof() or _tcp->inbound_stream().error()) and not _inbound_shutdown);
+            });
+    }
 
     // rule 4: read outbound segments from TCPConnection and send as datagrams
-    _eventloop.add_rule(_datagram_adapter,
-                        Direction::Out,
-                        [&] {
-                            while (not _tcp->segments_out().empty()) {
-                                _datagram_adapter.write(_tcp->segments_out().front());
-                                _tcp->segments_out().pop();
-                            }
-                        },
-                        [&] { return not _tcp->segments_out().empty(); });
+    if (not io_uring) {
+        loop.add_rule(_datagram_adapter,
+                      Direction::Out,
+                      [&] { _write_outbound(); },
+                      [&] { return not _tcp->segments_out().empty(); });
+    }
 }
 
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
@@ -228,35 +348,25 @@ void TCPSpongeSocket<AdaptT>::connect(const TCPConfig &c_tcp, const FdAdapterCon
     _tcp_thread = thread(&TCPSpongeSocket::_tcp_main, this);
 }
 
-//! \param[in] c_tcp is the TCPConfig for the TCPConnection
-//! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
-template <typename AdaptT>
-void TCPSpongeSocket<AdaptT>::listen_and_accept(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad) {
-    if (_tcp) {
-        throw runtime_error("listen_and_accept() with TCPConnection already initialized");
-    }
-
-    _initialize_TCP(c_tcp);
-
-    _datagram_adapter.config_mut() = c_ad;
-    _datagram_adapter.set_listening(true);
-
-    cerr << "DEBUG: Listening for incoming connection...\n";
-    _tcp_loop([&] {
-        const auto s = _tcp->state();
-        return (s == TCPState::State::LISTEN or s == TCPState::State::SYN_RCVD or s == TCPState::State::SYN_SENT);
-    });
-    cerr << "New connection from " << _datagram_adapter.config().destination.to_string() << ".\n";
-
-    _tcp_thread = thread(&TCPSpongeSocket::_tcp_main, this);
-}
-
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_tcp_main() {
     try {
         if (not _tcp.has_value()) {
             throw runtime_error("no TCP");
         }
+        // the kernel completes io_uring requests through the thread that submitted them, interrupting
+        // whatever it waits for, so the handshake ran on epoll and this thread sets up its own ring
+        if (_datagram_adapter.config().io_uring) {
+            try {
+                EventLoop loop{EventLoop::Backend::IoUring};
+                _add_rules(loop);
+                _eventloop = move(loop);
+                // the ring waits for the owner's end itself, rather than being told it would block
+                _thread_data.set_blocking(true);
+            } catch (const unix_error &e) {
+                cerr << "DEBUG: io_uring is not available (" << e.what() << "), staying on epoll.\n";
+            }
+        }
         _tcp_loop([] { return true; });
         shutdown(SHUT_RDWR);
         if (not _tcp.value().active()) {
@@ -31,12 +31,34 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Set up the TCPConnection and the event loop
     void _initialize_TCP(const TCPConfig &config);
 
+    //! Add the rules that move data between the TCPConnection, the adapter and the owner to `loop`
+    void _add_rules(EventLoop &loop);
+
     //! TCP state machine
     std::optional<TCPConnection> _tcp{};
 
+    //! Segments read from the adapter in one wakeup, and segments drained from the TCPConnection to write
+    std::vector<TCPSegment> _inbound_batch{};
+    std::vector<TCPSegment> _outbound_batch{};
+
     //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
     EventLoop _eventloop{};
 
+    //! Give the segments in _inbound_batch to the TCPConnection
+    void _deliver_inbound();
+
+    //! Write the segments the TCPConnection has to send, or with io_uring queue them for the next wait
+    void _write_outbound();
+
+    //! With io_uring, queue the next inbound bytes to write to the owner, or shut the stream down once all are
+    void _write_inbound();
+
+    //! The owner has shut down the outbound data: end the TCPConnection's outbound stream
+    void _finish_outbound();
+
+    //! All the inbound data has been written to the owner: shut down its stream
+    void _finish_inbound();
+
     //! Process events while specified condition is true
     void _tcp_loop(const std::function<bool()> &condition);
 
@@ -53,6 +75,8 @@ class TCPSpongeSocket : public LocalStreamSocket {
 
     bool _inbound_shutdown{false};  //!< Has TCPSpongeSocket shut down the incoming data to the owner?
 
+    bool _inbound_writing{false};  //!< With io_uring, is a write of incoming data to the owner in progress?
+
     bool _outbound_shutdown{false};  //!< Has the owner shut down the outbound data to the TCP connection?
 
     bool _fully_acked{false};  //!< Has the outbound data been fully acknowledged by the peer?
@@ -69,9 +93,6 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Connect using the specified configurations; blocks until connect succeeds or fails
     void connect(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad);
 
-    //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
-    void listen_and_accept(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad);
-
     //! When a connected socket is destructed, it will send a RST
     ~TCPSpongeSocket();
 
@@ -107,7 +128,7 @@ using LossyTCPOverIPv4SpongeSocket = TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAd
 //! This class involves the simultaneous operation of two threads.
 //!
 //! One, the "owner" or foreground thread, interacts with this class in much the
-//! same way as one would interact with a TCPSocket: it connects or listens, writes to
+//! same way as one would interact with a TCPSocket: it connects, writes to
 //! and reads from a reliable data stream, etc. Only the owner thread calls public
 //! methods of this class.
 //!
@@ -117,9 +138,8 @@ using LossyTCPOverIPv4SpongeSocket = TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAd
 //!
 //! There are a few notable differences between the TCPSpongeSocket and TCPSocket interfaces:
 //!
-//! - a TCPSpongeSocket can only accept a single connection
-//! - listen_and_accept() is a blocking function call that acts as both [listen(2)](\ref man2::listen)
-//!   and [accept(2)](\ref man2::accept)
+//! - a TCPSpongeSocket can only connect; a server uses a TCPSpongeListener, whose accept() returns a
+//!   stream socket for each connection
 //! - if TCPSpongeSocket is destructed while a TCP connection is open, the connection is
 //!   immediately terminated with a RST (call `wait_until_closed` to avoid this)
 
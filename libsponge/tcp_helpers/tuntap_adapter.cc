@@ -11,15 +11,17 @@ TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
                                                                const Address &ip_address,
                                                                const Address &next_hop)
     : _tap(move(tap)), _interface(eth_address, ip_address), _next_hop(next_hop) {
+    _tap.set_blocking(false);
+
     // Linux seems to ignore the first frame sent on a TAP device, so send a dummy frame to prime the pump :-(
     EthernetFrame dummy_frame;
     _tap.write(dummy_frame.serialize());
 }
 
-optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
-    // Read Ethernet frame from the raw device
+//! \details ARP messages in the frame are answered at once, by writing to the device directly.
+optional<InternetDatagram> TCPOverIPv4OverEthernetAdapter::receive_frame(EventLoop::Datagram &&datagram) {
     EthernetFrame frame;
-    if (frame.parse(_tap.read()) != ParseResult::NoError) {
+    if (frame.parse(move(datagram.payload)) != ParseResult::NoError) {
         return {};
     }
 
@@ -29,13 +31,27 @@ optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
     // The incoming frame may have caused the NetworkInterface to send a frame.
     send_pending();
 
+    return ip_dgram;
+}
+
+optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::received(EventLoop::Datagram &&datagram) {
     // Try to interpret IPv4 datagram as TCP
+    optional<InternetDatagram> ip_dgram = receive_frame(move(datagram));
     if (ip_dgram) {
         return unwrap_tcp_in_ip(ip_dgram.value());
     }
     return {};
 }
 
+optional<pair<FourTuple, TCPSegment>> TCPOverIPv4OverEthernetAdapter::received_from_any(
+    EventLoop::Datagram &&datagram) {
+    optional<InternetDatagram> ip_dgram = receive_frame(move(datagram));
+    if (ip_dgram) {
+        return unwrap_any_tcp_in_ip(ip_dgram.value());
+    }
+    return {};
+}
+
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void TCPOverIPv4OverEthernetAdapter::tick(const size_t ms_since_last_tick) {
     _interface.tick(ms_since_last_tick);
@@ -48,6 +64,35 @@ void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg) {
     send_pending();
 }
 
+//! \param[in] seg the TCPSegment to send
+//! \param[in] loop is the EventLoop that sends the frames ready to go (any that wait for ARP are sent by tick())
+void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg, EventLoop &loop) {
+    _interface.send_datagram(wrap_tcp_in_ip(seg), _next_hop);
+    send_ready(loop);
+}
+
+//! \param[in] tuple names the connection the segment belongs to
+//! \param[in] seg the TCPSegment to send
+void TCPOverIPv4OverEthernetAdapter::write_to(const FourTuple &tuple, TCPSegment &seg) {
+    _interface.send_datagram(TCPDemux::wrap(tuple, seg), _next_hop);
+    send_pending();
+}
+
+//! \param[in] tuple names the connection the segment belongs to
+//! \param[in] seg the TCPSegment to send
+//! \param[in] loop is the EventLoop that sends the frames ready to go
+void TCPOverIPv4OverEthernetAdapter::write_to(const FourTuple &tuple, TCPSegment &seg, EventLoop &loop) {
+    _interface.send_datagram(TCPDemux::wrap(tuple, seg), _next_hop);
+    send_ready(loop);
+}
+
+void TCPOverIPv4OverEthernetAdapter::send_ready(EventLoop &loop) {
+    while (not _interface.frames_out().empty()) {
+        loop.send(_tap, _interface.frames_out().front().serialize());
+        _interface.frames_out().pop();
+    }
+}
+
 void TCPOverIPv4OverEthernetAdapter::send_pending() {
     while (not _interface.frames_out().empty()) {
         _tap.write(_interface.frames_out().front().serialize());
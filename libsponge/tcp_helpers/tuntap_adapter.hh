@@ -2,6 +2,7 @@
 #define SPONGE_LIBSPONGE_TUNFD_ADAPTER_HH
 
 #include "ethernet_header.hh"
+#include "eventloop.hh"
 #include "network_interface.hh"
 #include "tun.hh"
 
@@ -15,13 +16,17 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
     TunFD _tun;
 
   public:
-    //! Construct from a TunFD
-    explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) {}
+    //! Construct from a TunFD, which it makes non-blocking
+    explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) { _tun.set_blocking(false); }
 
-    //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
-    std::optional<TCPSegment> read() {
+    //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection,
+    //! without waiting for one
+    std::optional<TCPSegment> read() { return received({_tun.read(), {}}); }
+
+    //! Parses an IPv4 datagram that an EventLoop read, and returns the TCP segment in it if related to the connection
+    std::optional<TCPSegment> received(EventLoop::Datagram &&datagram) {
         InternetDatagram ip_dgram;
-        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
+        if (ip_dgram.parse(std::move(datagram.payload)) != ParseResult::NoError) {
             return {};
         }
         return unwrap_tcp_in_ip(ip_dgram);
@@ -30,6 +35,35 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
     //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
     void write(TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg).serialize()); }
 
+    //! Creates an IPv4 datagram from a TCP segment, to be written by the next wait of `loop`
+    void write(TCPSegment &seg, EventLoop &loop) { loop.send(_tun, wrap_tcp_in_ip(seg).serialize()); }
+
+    //! \name
+    //! Unfiltered mode, for a TCPSpongeListener: segments from any peer, each with the 4-tuple it belongs to
+
+    //!@{
+
+    //! Attempts to read an IPv4 datagram containing a TCP segment for our address and port, without waiting
+    std::optional<std::pair<FourTuple, TCPSegment>> read_from_any() { return received_from_any({_tun.read(), {}}); }
+
+    //! Parses an IPv4 datagram that an EventLoop read, and returns the TCP segment in it and its 4-tuple
+    std::optional<std::pair<FourTuple, TCPSegment>> received_from_any(EventLoop::Datagram &&datagram) {
+        InternetDatagram ip_dgram;
+        if (ip_dgram.parse(std::move(datagram.payload)) != ParseResult::NoError) {
+            return {};
+        }
+        return unwrap_any_tcp_in_ip(ip_dgram);
+    }
+
+    //! Wraps a TCP segment of the connection named by `tuple` in an IPv4 datagram and writes it
+    void write_to(const FourTuple &tuple, TCPSegment &seg) { _tun.write(TCPDemux::wrap(tuple, seg).serialize()); }
+
+    //! Wraps a TCP segment of the connection named by `tuple`, to be written by the next wait of `loop`
+    void write_to(const FourTuple &tuple, TCPSegment &seg, EventLoop &loop) {
+        loop.send(_tun, TCPDemux::wrap(tuple, seg).serialize());
+    }
+    //!@}
+
     //! Access the underlying TUN device
     operator TunFD &() { return _tun; }
 
@@ -51,21 +85,55 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
 
     void send_pending();  //!< Sends any pending Ethernet frames
 
+    //! Queues the frames ready to go on `loop` (any that wait for ARP are sent by tick())
+    void send_ready(EventLoop &loop);
+
+    //! Gives a frame to the NetworkInterface, and returns the IPv4 datagram it carried, if any
+    std::optional<InternetDatagram> receive_frame(EventLoop::Datagram &&datagram);
+
   public:
-    //! Construct from a TapFD
+    //! Construct from a TapFD, which it makes non-blocking
     explicit TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
                                             const EthernetAddress &eth_address,
                                             const Address &ip_address,
                                             const Address &next_hop);
-    //! Attempts to read and parse an Ethernet frame containing an IPv4 datagram that contains a TCP segment
-    std::optional<TCPSegment> read();
+    //! Attempts to read and parse an Ethernet frame containing an IPv4 datagram that contains a TCP segment,
+    //! without waiting for one
+    std::optional<TCPSegment> read() { return received({_tap.read(), {}}); }
+
+    //! Parses an Ethernet frame that an EventLoop read, and returns the TCP segment in it, if any
+    std::optional<TCPSegment> received(EventLoop::Datagram &&datagram);
 
     //! Sends a TCP segment (in an IPv4 datagram, in an Ethernet frame).
     void write(TCPSegment &seg);
 
+    //! Queues a TCP segment (in an IPv4 datagram, in an Ethernet frame) to be sent by the next wait of `loop`
+    void write(TCPSegment &seg, EventLoop &loop);
+
+    //! \name
+    //! Unfiltered mode, for a TCPSpongeListener: segments from any peer, each with the 4-tuple it belongs to
+
+    //!@{
+
+    //! Attempts to read an Ethernet frame containing a TCP segment for our address and port, without waiting
+    std::optional<std::pair<FourTuple, TCPSegment>> read_from_any() { return received_from_any({_tap.read(), {}}); }
+
+    //! Parses an Ethernet frame that an EventLoop read, and returns the TCP segment in it and its 4-tuple
+    std::optional<std::pair<FourTuple, TCPSegment>> received_from_any(EventLoop::Datagram &&datagram);
+
+    //! Sends a TCP segment of the connection named by `tuple` (in an IPv4 datagram, in an Ethernet frame)
+    void write_to(const FourTuple &tuple, TCPSegment &seg);
+
+    //! Queues a TCP segment of the connection named by `tuple` to be sent by the next wait of `loop`
+    void write_to(const FourTuple &tuple, TCPSegment &seg, EventLoop &loop);
+    //!@}
+
     //! Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
 
+    //! Milliseconds until tick() next has something to do: the interface's ARP timers
+    std::optional<size_t> next_deadline() const { return _interface.next_deadline(); }
+
     //! Access the underlying raw Ethernet connection
     operator TapFD &() { return _tap; }
 
@@ -1,6 +1,7 @@
 #include "tcp_receiver.hh"
 #include "tcp_state.hh"
 
+#include <algorithm>
 #include <cassert>
 
 // Dummy implementation of a TCP receiver
@@ -29,19 +30,89 @@ void TCPReceiver::segment_received(const TCPSegment &seg) {
         if (seg.header().syn) { // TCP 报文头部的 SYN 标志位为true, 收到 SYN 包
             _isn = seg.header().seqno;
             // SYN 包中的 payload 不能被丢弃, 不过 SYN 包一般不会放数据，后面再看
-            _reassembler.push_substring(seg.payload().copy(), 0, seg.header().fin);
+            _reassembler.push_substring(seg.payload(), 0, seg.header().fin);
             update_ack_no();
         }
         return; // SYN包之前的数据包必须全部丢弃
     }
     // SYN_RECV 状态, 如果发来的是 FIN 包, 则关闭 _reassembler的_output字节流
     uint64_t  abs_seqno = unwrap(seg.header().seqno, _isn.value(), _reassembler.first_unassembled());
-    _reassembler.push_substring(seg.payload().copy(), abs_seqno - 1, seg.header().fin);
+    _reassembler.push_substring(seg.payload(), abs_seqno - 1, seg.header().fin);
     update_ack_no();
+    // 前面还有空洞，这个段被暂存了
+    if (seg.payload().size() > 0 && abs_seqno - 1 > _reassembler.first_unassembled() &&
+        abs_seqno - 1 < _reassembler.first_unacceptable()) {
+        _last_held = abs_seqno - 1;
+    }
+}
+
+// 首部预测命中的按序数据段，不用走重组器的通用流程
+void TCPReceiver::segment_received_in_order(const TCPSegment &seg) {
+    _reassembler.push_in_order(seg.payload().str());
+    update_ack_no();
+}
+
+vector<TCPHeader::SackBlock> TCPReceiver::sack_blocks(const size_t max_blocks) const {
+    vector<TCPHeader::SackBlock> blocks;
+    if (!_isn.has_value() || max_blocks == 0) {
+        return blocks;
+    }
+    const auto ranges = _reassembler.held_ranges();
+    // 字节流下标 + 1 是绝对 seqno（算上 SYN）
+    const auto to_block = [&](const pair<uint64_t, uint64_t> &range) {
+        return TCPHeader::SackBlock{wrap(range.first + 1, _isn.value()), wrap(range.second + 1, _isn.value())};
+    };
+    size_t latest = ranges.size();
+    for (size_t i = 0; _last_held.has_value() && i < ranges.size(); i++) {
+        if (ranges[i].first <= _last_held.value() && _last_held.value() < ranges[i].second) {
+            latest = i;
+            blocks.push_back(to_block(ranges[i]));
+            break;
+        }
+    }
+    for (size_t i = 0; i < ranges.size() && blocks.size() < max_blocks; i++) {
+        if (i != latest) {
+            blocks.push_back(to_block(ranges[i]));
+        }
+    }
+    return blocks;
+}
+
+bool TCPReceiver::check_timestamp(const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    if (!header.timestamps.has_value()) { // 协商好了时间戳，不带的段丢掉 (RST 除外)
+        return header.rst;
+    }
+    const uint32_t tsval = header.timestamps.value().tsval;
+    // PAWS：时间戳比 TS.Recent 旧，说明是序号已经绕回一圈的旧段
+    const bool older = _ts_recent.has_value() && static_cast<int32_t>(tsval - _ts_recent.value()) < 0;
+    if (older && !header.rst) {
+        return false;
+    }
+    // 只有覆盖了上次发出的 ackno 的段才更新 TS.Recent，这样回显的是最早引起这个 ACK 的段的时间戳
+    if (!older && (!_ackno.has_value() || header.seqno - _ackno.value() <= 0)) {
+        _ts_recent = tsval;
+    }
+    return true;
 }
 
 optional<WrappingInt32> TCPReceiver::ackno() const { return _ackno;}
 
+size_t TCPReceiver::set_capacity(const size_t capacity) {
+    // 窗口右沿 = 已读字节数 + 容量，不能小于通告过的右沿
+    const uint64_t unread = _reassembler.first_unread();
+    _capacity = _reassembler.set_capacity(max<uint64_t>(capacity, max(_window_edge, unread) - unread));
+    return _capacity;
+}
+
+void TCPReceiver::window_advertised(const size_t window) {
+    _window_edge = max<uint64_t>(_window_edge, _reassembler.first_unassembled() + window);
+}
+
+size_t TCPReceiver::advertised_window() const {
+    return max<uint64_t>(_window_edge, _reassembler.first_unassembled()) - _reassembler.first_unassembled();
+}
+
 size_t TCPReceiver::window_size() const { return _reassembler.first_unacceptable() -  _reassembler.first_unassembled(); }
 
 void TCPReceiver::update_ack_no() {
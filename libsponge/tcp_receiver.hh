@@ -7,6 +7,7 @@
 #include "wrapping_integers.hh"
 
 #include <optional>
+#include <vector>
 
 //! \brief The "receiver" part of a TCP implementation.
 
@@ -25,12 +26,23 @@ class TCPReceiver {
 
     std::optional<WrappingInt32> _isn = {};
 
+    // 对方最近的 TSval (RFC 7323 的 TS.Recent)，在 TSecr 里回显，也用来做 PAWS 检查
+    std::optional<uint32_t> _ts_recent = {};
+
+    // 最近一个因为前面有空洞而暂存的段的起点（字节流下标），SACK 的第一个块要包含它
+    std::optional<uint64_t> _last_held = {};
+
+    // 通告过的窗口右沿（字节流下标），缩小容量时不能让窗口右沿往回退
+    uint64_t _window_edge = 0;
+
   public:
     //! \brief Construct a TCP receiver
     //!
     //! \param capacity the maximum number of bytes that the receiver will
     //!                 store in its buffers at any give time.
-    TCPReceiver(const size_t capacity) : _reassembler(capacity), _capacity(capacity) {}
+    //! \param mode where the reassembler keeps out-of-order bytes
+    TCPReceiver(const size_t capacity, const StreamReassembler::Mode mode = StreamReassembler::Mode::Intervals)
+        : _reassembler(capacity, mode), _capacity(capacity) {}
 
     //! \name Accessors to provide feedback to the remote TCPSender
     //!@{
@@ -58,9 +70,53 @@ class TCPReceiver {
     //! \brief number of bytes stored but not yet reassembled
     size_t unassembled_bytes() const { return _reassembler.unassembled_bytes(); }
 
+    //! \brief Has the peer's FIN arrived, even one still waiting for a hole before it to be filled?
+    bool fin_received() const { return _reassembler.end_known(); }
+
+    //! \name Receive buffer sizing
+    //!@{
+
+    //! \brief The most bytes the receiver will hold, reassembled or not
+    size_t capacity() const { return _capacity; }
+
+    //! \brief Grow or shrink the capacity, and with it the window and the memory behind it
+    //! \details A window already advertised is never retracted, so a shrink may stop short of `capacity`
+    //! until the reader has caught up.
+    //! \returns the capacity now in effect
+    size_t set_capacity(const size_t capacity);
+
+    //! \brief Note that a segment advertising a `window` of this many bytes from the current ackno was sent
+    void window_advertised(const size_t window);
+
+    //! \brief The window most recently advertised, as counted from the current ackno
+    size_t advertised_window() const;
+    //!@}
+
     //! \brief handle an inbound segment
     void segment_received(const TCPSegment &seg);
 
+    //! \brief handle an inbound segment that starts exactly at ackno(), carries no SYN or FIN, and arrives
+    //! while no bytes are held past a hole (the caller has checked all three)
+    void segment_received_in_order(const TCPSegment &seg);
+
+    //! \name Timestamps option ([RFC 7323](\ref rfc::rfc7323)), once both sides have agreed to use it
+    //!@{
+
+    //! \brief Check an inbound segment's timestamp before segment_received(), remembering it for echoing
+    //! \returns false if the segment must be dropped: it carries no timestamp, or an older one
+    //! than the peer has already sent (PAWS, protection against wrapped sequence numbers)
+    bool check_timestamp(const TCPSegment &seg);
+
+    //! \brief The TSecr to echo to the peer (TS.Recent)
+    std::optional<uint32_t> ts_recent() const { return _ts_recent; }
+    //!@}
+
+    //! \brief SACK blocks ([RFC 2018](\ref rfc::rfc2018)) describing the data held past a hole
+    //! \details The block holding the most recently received segment comes first, the others follow in
+    //! sequence order.
+    //! \param max_blocks the most blocks that fit in the segment's options
+    std::vector<TCPHeader::SackBlock> sack_blocks(const size_t max_blocks) const;
+
     //! \name "Output" interface for the reader
     //!@{
     ByteStream &stream_out() { return _reassembler.stream_out(); }
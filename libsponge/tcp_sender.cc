@@ -5,7 +5,7 @@
 #include "tcp_state.hh"
 
 #include <random>
-#include <cassert>
+#include <cmath>
 // Dummy implementation of a TCP sender
 
 // For Lab 3, please replace with a real implementation that passes the
@@ -19,20 +19,54 @@ using namespace std;
 //! \param[in] capacity the capacity of the outgoing byte stream
 //! \param[in] retx_timeout the initial amount of time to wait before retransmitting the oldest outstanding segment
 //! \param[in] fixed_isn the Initial Sequence Number to use, if set (otherwise uses a random ISN)
-TCPSender::TCPSender(const size_t capacity, const uint16_t retx_timeout, const std::optional<WrappingInt32> fixed_isn)
+//! \param[in] congestion_control the algorithm that limits bytes in flight beyond the receiver's window
+//! \param[in] rto_min the lower bound on a retransmission timeout derived from RTT samples
+//! \param[in] rto_max the upper bound on a retransmission timeout derived from RTT samples
+//! \param[in] rack_tlp whether to detect losses by time and send tail loss probes ([RFC 8985](\ref rfc::rfc8985))
+TCPSender::TCPSender(const size_t capacity,
+                     const uint16_t retx_timeout,
+                     const std::optional<WrappingInt32> fixed_isn,
+                     const CongestionControlAlgorithm congestion_control,
+                     const uint64_t rto_min,
+                     const uint64_t rto_max,
+                     const bool rack_tlp)
     : _isn(fixed_isn.value_or(WrappingInt32{random_device()()}))
     , _initial_retransmission_timeout{retx_timeout}
-    , _stream(capacity) {
+    , _stream(capacity, ByteStream::Mode::Chunked)
+    , _congestion_controller(CongestionController::make(congestion_control, TCPConfig::MAX_PAYLOAD_SIZE))
+    , _rack_tlp(rack_tlp)
+    , _rto_min(rto_min)
+    , _rto_max(max(rto_max, rto_min)) {
         _retransmission_timeout = retx_timeout;
     }
 
 uint64_t TCPSender::bytes_in_flight() const { return _next_seqno - _abs_ackno; }
 
+uint64_t TCPSender::congestion_window() const {
+    return _congestion_controller ? _congestion_controller->cwnd() : UINT64_MAX;
+}
+
+uint64_t TCPSender::send_window() const {
+    if (!_congestion_controller) {
+        return _window_size;
+    }
+    // 拥塞窗口按整段使用，不然零头会被发成一个个小段
+    const uint64_t cwnd = _congestion_controller->cwnd() + _recovery_inflation;
+    return min(_window_size, max(cwnd - cwnd % TCPConfig::MAX_PAYLOAD_SIZE, uint64_t{TCPConfig::MAX_PAYLOAD_SIZE}));
+}
+
 void TCPSender::fill_window() {
+    if (send_new_data(send_window())) {
+        arm_pto();
+    }
+}
+
+bool TCPSender::send_new_data(const uint64_t window) {
     if (_fin_sent) { // 如果已经发送了fin，直接返回
-        return;
+        return false;
     }
-    while (bytes_in_flight() < _window_size) {
+    const uint64_t next_seqno = _next_seqno;
+    while (bytes_in_flight() < window) {
         TCPSegment seg = TCPSegment();
         // 判断是否要发送 syn 
         if (!_syn_sent) {
@@ -41,14 +75,21 @@ void TCPSender::fill_window() {
             _syn_sent = true;
         }
         // 从字节流中读 len 个字节塞到TCP报文中
-        size_t len = min(_window_size - bytes_in_flight() - seg.length_in_sequence_space(), TCPConfig::MAX_PAYLOAD_SIZE);
+        size_t len = min(window - bytes_in_flight() - seg.length_in_sequence_space(), uint64_t{TCPConfig::MAX_PAYLOAD_SIZE});
+        if (seg.header().syn && _syn_data) { // Fast Open：还不知道对方的窗口，SYN 最多带一个段的数据
+            len = TCPConfig::MAX_PAYLOAD_SIZE;
+        }
         seg.header().seqno = wrap(_next_seqno, _isn);
-        seg.payload() = _stream.read(len);
+        // 负载和应用写入的 Buffer 共享存储，只有跨越多个 Buffer 时才需要拼接（拷贝）。
+        // 不在 Buffer 边界处切段：那样每个 Buffer 末尾都会多出一个小段，而拼接每个 Buffer 最多只拷贝一个 MSS；
+        // 负载也不改成 BufferList：发送和接收两端都把 TCPSegment 的负载当作一整块连续的内存来用
+        BufferList payload = _stream.read_buffers(len);
+        seg.payload() = payload.buffers().size() <= 1 ? Buffer(payload) : Buffer(payload.concatenate());
 
         // 判断当前是否可以发送 fin 
         if (!_fin_sent && _stream.eof()) { // 字节流终止了，可以发送 fin 了
             // 但是要保证接收方接收到的字节(已经发了但没收到确认的 + 现在要发的)不能超过它的窗口大小
-            if (bytes_in_flight() + seg.length_in_sequence_space() < _window_size) { // 加了 FIN 之后最多相等，不能超过
+            if (bytes_in_flight() + seg.length_in_sequence_space() < window) { // 加了 FIN 之后最多相等，不能超过
                 seg.header().fin = true;
                 _fin_sent = true;
             }
@@ -56,25 +97,36 @@ void TCPSender::fill_window() {
 
         // 发送 + "缓存"
         if (seg.length_in_sequence_space() > 0) { // 只有传递一些数据的网段才被追踪（包括SYN和FIN），缓存起来（实际上是采用智能指针、引用计数的只读字符串），一个空的ACK不需要被记住，也不用重传
-            _segment_vector.push_back(seg);
-            _segments_out.push(seg);
+            const uint64_t seqno = _next_seqno;
+            if (bytes_in_flight() == 0) { // 第一个在途的段，开始计时
+                _rto_deadline = _time_now + _retransmission_timeout;
+            }
             _next_seqno += seg.length_in_sequence_space();
+            _segments_out.push(seg);
+            _outstanding.push_back({seqno, move(seg), _time_now});
         }
         else {
             break;
         }
 
     }
-
-
+    return _next_seqno > next_seqno;
 }
 
 //! \param ackno The remote receiver's ackno (acknowledgment number)
-//! \param window_size The remote receiver's advertised window size
-int TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_size) {
+//! \param window_size The remote receiver's advertised window size in bytes, after window scaling
+//! \param pure_ack whether the segment carrying the ACK was otherwise empty
+//! \param tsecr the timestamp the remote receiver echoed, if any
+//! \param sack the SACK blocks the remote receiver sent, if any
+int TCPSender::ack_received(const WrappingInt32 ackno,
+                            const uint64_t window_size,
+                            const bool pure_ack,
+                            const optional<uint32_t> tsecr,
+                            const vector<TCPHeader::SackBlock> &sack) {
     if (!_syn_sent) {
         return -1;
     }
+    const uint64_t previous_window = _window_size;
     // When filling window, treat a '0' window size as equal to '1' but don't back off RTO
     // 零窗口探测，当接收方的接收窗口为0时，每隔一段时间，发送方会主动发送探测包(1字节)，通过迫使对端响应来得知其接收窗口有无打开。
     if (window_size == 0) {
@@ -85,16 +137,41 @@ int TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_siz
         _zero_window = false;
     }
     uint64_t abs_ackno = unwrap(ackno, _isn, _abs_ackno);
+    const uint64_t newly_acked = abs_ackno - _abs_ackno;
+    const uint64_t flight_before_ack = bytes_in_flight();
     if (abs_ackno > _abs_ackno && abs_ackno <= _next_seqno) { //只有收到最新的ackno才更新
         _ackno = ackno;
         _abs_ackno = abs_ackno;
     } else {
+        if (abs_ackno != _abs_ackno) {
+            return 0;
+        }
+        update_scoreboard(sack, tsecr);
+        // 重复 ACK：没有带数据、窗口没变、还有数据没确认 (RFC 5681 3.2)
+        if (pure_ack && !_zero_window && _window_size == previous_window && bytes_in_flight() > 0) {
+            duplicate_ack_received();
+        }
+        if (rack_detect_loss()) {
+            rack_recover();
+        }
+        arm_pto();
         return 0;
     }
-    // 每次收到ack就重置重传超时时间(初始的)、重传次数、定时时间
-    _retransmission_timeout = _initial_retransmission_timeout;
+    // Fast Open 的 SYN 带的数据对方没有收下（cookie 不对，或者对方不支持），只确认了 SYN：数据改成普通的段马上重发，
+    // 不用等超时
+    if (!_outstanding.empty() && _outstanding.front().segment.header().syn &&
+        _outstanding.front().segment.payload().size() > 0 && _abs_ackno == _outstanding.front().abs_seqno + 1) {
+        OutstandingSegment &o = _outstanding.front();
+        o.segment.header().syn = false;
+        o.segment.header().seqno = wrap(_abs_ackno, _isn);
+        o.abs_seqno = _abs_ackno;
+        o.sent_time = _time_now;
+        o.retransmitted = true;
+        _segments_out.push(o.segment);
+    }
+    _dup_acks = 0;
+    // 每次收到ack就重置重传次数；重传定时器在下面测完 RTT、算好新的超时时间之后重新开始
     _consecutive_retransmissions = 0;
-    _ticks = 0;
 
     // 更新状态
     if (!_syn_acked && _syn_sent && _next_seqno > bytes_in_flight() && !_stream.eof()) {
@@ -102,49 +179,427 @@ int TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_siz
     }
     if (!_fin_acked && _fin_sent && _stream.eof() && _abs_ackno == _stream.bytes_read() + 2 && bytes_in_flight() == 0) {
         _fin_acked = true;
-        _segment_vector.clear();
     }
 
-    // delete, 收到确认的不用追踪了
-    vector<TCPSegment> segs = vector<TCPSegment>();
-    for (const auto &seg : _segment_vector) {
-        uint64_t seqno = unwrap(seg.header().seqno, _isn, _abs_ackno);
-        if (seqno + seg.length_in_sequence_space() > _abs_ackno) {
-            segs.push_back(seg);
+    // delete, 收到确认的不用追踪了。队列按 seqno 排好序，只需要看队头
+    // 顺便用最后一个被确认、且没有重传过的段测一次 RTT
+    optional<uint64_t> rtt_sample;
+    while (!_outstanding.empty() &&
+           _outstanding.front().abs_seqno + _outstanding.front().segment.length_in_sequence_space() <= _abs_ackno) {
+        if (!_outstanding.front().retransmitted) {
+            rtt_sample = _time_now - _outstanding.front().sent_time;
+        }
+        if (_outstanding.front().sacked) {
+            _sacked_bytes -= _outstanding.front().segment.length_in_sequence_space();
+        } else {
+            rack_update(_outstanding.front(), tsecr);
+        }
+        _outstanding.pop_front();
+    }
+    update_scoreboard(sack, tsecr);
+
+    // 有时间戳的话每个 ACK 都能测 RTT，重传过的段也不会有歧义 (RFC 7323 4.1)
+    uint64_t samples_per_rtt = 1;
+    if (tsecr.has_value()) {
+        rtt_sample = static_cast<uint32_t>(timestamp() - tsecr.value());
+        // 一个窗口的数据大约每两个段回一个 ACK (RFC 7323 附录 G)
+        samples_per_rtt = max<uint64_t>(1, (flight_before_ack + 2 * TCPConfig::MAX_PAYLOAD_SIZE - 1) /
+                                               (2 * TCPConfig::MAX_PAYLOAD_SIZE));
+    }
+    if (rtt_sample) {
+        _min_rtt = min(_min_rtt, *rtt_sample);
+        update_rtt(*rtt_sample, samples_per_rtt);
+        if (_congestion_controller) {
+            _congestion_controller->on_rtt_sample(*rtt_sample, _time_now);
+        }
+    }
+    // 退避的 RTO 收到新的确认之后就不要了 (RFC 6298 5.7)
+    _retransmission_timeout = base_rto();
+    if (bytes_in_flight() > 0) {
+        _rto_deadline = _time_now + _retransmission_timeout;
+    } else {
+        _rto_deadline.reset();
+    }
+
+    // 探测包被确认了，这一轮探测结束 (RFC 8985 7.4)
+    if (_tlp_end_seq.has_value() && _abs_ackno >= _tlp_end_seq.value()) {
+        // 没有 DSACK 分不清原来那个段是不是也到了，只好当作探测修好了一次尾部丢包，照样减小拥塞窗口
+        if (_tlp_retransmitted && !_in_fast_recovery && _abs_ackno >= _recovery_point && _congestion_controller) {
+            _congestion_controller->on_loss(LossEvent::FastRetransmit, flight_before_ack, _time_now);
+        }
+        _tlp_end_seq.reset();
+    }
+
+    if (_in_fast_recovery) {
+        if (_abs_ackno >= _recovery_point) { // 全部确认，退出快速恢复，窗口回到 ssthresh
+            _in_fast_recovery = false;
+            _recovery_inflation = 0;
+            if (rack_detect_loss()) { // 恢复点之后的段也丢了
+                rack_recover();
+            }
+            arm_pto();
+        } else if (_sack_seen) { // 部分确认说明队头是空洞，没重传过就马上重传（RACK 按时间判断），其余的看记分板
+            if (!rack_active() && _outstanding.front().abs_seqno >= _high_rxt) {
+                retransmit_first_outstanding();
+                _fast_retransmissions++;
+            }
+            rack_detect_loss();
+            retransmit_lost();
+        } else { // 部分确认 (RFC 6582)：下一个空洞也丢了，马上重传；窗口减去确认的部分，再加回重传的一个段
+            retransmit_first_outstanding();
+            _fast_retransmissions++;
+            _recovery_inflation -= min(_recovery_inflation, newly_acked);
+            _recovery_inflation += TCPConfig::MAX_PAYLOAD_SIZE;
         }
+        return 0; // 恢复期间不增大拥塞窗口
+    }
+    if (rack_detect_loss()) {
+        rack_recover();
+        if (_in_fast_recovery) {
+            return 0;
+        }
+    } else if (_sack_seen && _abs_ackno < _recovery_point && !_outstanding.empty()) {
+        // 超时之后的恢复：有记分板的话把其余的空洞也补上，不用一个 RTO 补一个
+        retransmit_lost();
+    }
+
+    if (_congestion_controller) {
+        _congestion_controller->on_ack(newly_acked, bytes_in_flight(), _time_now);
     }
-    _segment_vector = segs;
+    arm_pto();
     return 0;
+}
+
+void TCPSender::duplicate_ack_received() {
+    _dup_acks++;
+    if (_in_fast_recovery) {
+        if (_sack_seen) { // 记分板知道哪些段离开了网络，哪些丢了
+            retransmit_lost();
+        } else { // 又一个段离开了网络，可以再发一个新段
+            _recovery_inflation += TCPConfig::MAX_PAYLOAD_SIZE;
+        }
+        return;
+    }
+    if (rack_active()) { // 乱序也会产生重复 ACK，交给 RACK 按时间判断
+        return;
+    }
+    // 有 SACK 的话，队头后面被 SACK 的数据够多也说明队头丢了 (RFC 6675 的 IsLost)
+    const bool lost = _dup_acks >= DUP_ACK_THRESHOLD ||
+                      (_sack_seen && _sacked_bytes > (DUP_ACK_THRESHOLD - 1) * TCPConfig::MAX_PAYLOAD_SIZE);
+    // 上次恢复还没结束时收到的重复 ACK 可能是那次丢包引起的，不再触发 (RFC 6582 4.1)
+    if (!lost || _abs_ackno < _recovery_point) {
+        return;
+    }
+    enter_fast_recovery();
+    retransmit_first_outstanding();
+    _fast_retransmissions++;
+    if (_sack_seen) {
+        retransmit_lost();
+    }
+}
+
+void TCPSender::enter_fast_recovery() {
+    if (_congestion_controller) {
+        _congestion_controller->on_loss(LossEvent::FastRetransmit, bytes_in_flight(), _time_now);
+    }
+    _recovery_point = _next_seqno;
+    _in_fast_recovery = true;
+    _recovery_inflation = DUP_ACK_THRESHOLD * TCPConfig::MAX_PAYLOAD_SIZE;
+    _high_rxt = _abs_ackno;
+    _pto_deadline.reset();
+}
+
+//! \details Blocks that are malformed or lie outside the outstanding data are ignored. Only segments that
+//! lie entirely inside a block are marked.
+void TCPSender::update_scoreboard(const vector<TCPHeader::SackBlock> &sack, const optional<uint32_t> tsecr) {
+    for (const TCPHeader::SackBlock &block : sack) {
+        const uint64_t left = unwrap(block.left, _isn, _abs_ackno);
+        const uint64_t right = unwrap(block.right, _isn, _abs_ackno);
+        if (left >= right || left < _abs_ackno || right > _next_seqno) {
+            continue;
+        }
+        _sack_seen = true;
+        // 二分找第一个起点不小于 left 的段
+        size_t lo = 0, hi = _outstanding.size();
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (_outstanding[mid].abs_seqno < left) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (size_t i = lo; i < _outstanding.size(); i++) {
+            OutstandingSegment &o = _outstanding[i];
+            const uint64_t len = o.segment.length_in_sequence_space();
+            if (o.abs_seqno + len > right) {
+                break;
+            }
+            if (!o.sacked) {
+                o.sacked = true;
+                o.lost = false;
+                _sacked_bytes += len;
+                rack_update(o, tsecr);
+            }
+        }
+    }
+}
+
+//! \details Follows the spirit of [RFC 6675](\ref rfc::rfc6675): in fast recovery a segment is lost once more
+//! than (DUP_ACK_THRESHOLD - 1) * MSS bytes after it have been SACKed. After a timeout, any SACKed byte after
+//! it is enough. With RACK, fast recovery goes by the segments rack_detect_loss() marked instead. The pipe
+//! counts segments that are neither SACKed nor lost, plus retransmissions made in this recovery. Lost segments
+//! are retransmitted in order while the pipe is below the congestion window. Any room that is left over goes
+//! to new data through _recovery_inflation.
+void TCPSender::retransmit_lost() {
+    const bool by_sacked_bytes = !_in_fast_recovery || !rack_active();
+    const uint64_t threshold = _in_fast_recovery ? (DUP_ACK_THRESHOLD - 1) * TCPConfig::MAX_PAYLOAD_SIZE : 0;
+    uint64_t sacked_above = 0;
+    uint64_t pipe = 0;
+    for (size_t i = _outstanding.size(); i-- > 0;) {
+        OutstandingSegment &o = _outstanding[i];
+        const uint64_t len = o.segment.length_in_sequence_space();
+        if (o.sacked) {
+            sacked_above += len;
+            continue;
+        }
+        const bool lost = o.lost || (by_sacked_bytes && sacked_above > threshold);
+        if (lost && o.abs_seqno >= _high_rxt) { // 这次恢复中还没重传过
+            o.lost = true;
+        }
+        if (!lost) {
+            pipe += len;
+        }
+        if (o.abs_seqno < _high_rxt && !o.lost) { // 重传的那一份还在路上（RACK 没说它也丢了）
+            pipe += len;
+        }
+    }
+
+    const uint64_t cwnd = congestion_window();
+    for (size_t i = 0; i < _outstanding.size() && pipe < cwnd; i++) {
+        OutstandingSegment &o = _outstanding[i];
+        const uint64_t len = o.segment.length_in_sequence_space();
+        if (!o.lost) {
+            continue;
+        }
+        o.lost = false;
+        o.retransmitted = true;
+        o.sent_time = _time_now;
+        _segments_out.push(o.segment);
+        _fast_retransmissions++;
+        _high_rxt = max(_high_rxt, o.abs_seqno + len);
+        pipe += len;
+    }
+
+    if (_in_fast_recovery) { // fill_window 看的是 bytes_in_flight < cwnd + inflation，也就是 pipe < cwnd
+        _recovery_inflation = bytes_in_flight() - min(pipe, bytes_in_flight());
+    }
+}
+
+//! \details Steps 1 to 3 of [RFC 8985](\ref rfc::rfc8985) section 6.2. A retransmitted segment whose ACK
+//! echoes a timestamp from before the retransmission, or that was acknowledged sooner than the minimum RTT,
+//! was most likely delivered by an earlier transmission. It says nothing about when the last one was sent,
+//! so it is skipped.
+void TCPSender::rack_update(const OutstandingSegment &o, const optional<uint32_t> tsecr) {
+    const uint64_t end = o.abs_seqno + o.segment.length_in_sequence_space();
+    const uint64_t rtt = _time_now - o.sent_time;
+    if (o.retransmitted) {
+        const bool echoes_earlier =
+            tsecr.has_value() && static_cast<int32_t>(tsecr.value() - static_cast<uint32_t>(o.sent_time)) < 0;
+        if (echoes_earlier || (_min_rtt != UINT64_MAX && rtt < _min_rtt)) {
+            return;
+        }
+    }
+    if (!o.retransmitted && end < _rack_fack) { // 后发的段先到了
+        _reordering_seen = true;
+    }
+    _rack_fack = max(_rack_fack, end);
+    if (o.sent_time > _rack_xmit_time || (o.sent_time == _rack_xmit_time && end > _rack_end_seq)) {
+        _rack_xmit_time = o.sent_time;
+        _rack_end_seq = end;
+        _rack_rtt = rtt;
+    }
+}
+
+//! \details Zero once a loss is likely and no reordering has been seen (RFC 8985 section 6.2 step 4),
+//! otherwise a quarter of the minimum RTT, capped at SRTT. It is at least one clock tick so that segments
+//! sent in the same millisecond are not declared lost the moment a later one is acknowledged.
+uint64_t TCPSender::rack_reorder_window() const {
+    if (!_reordering_seen && (_in_fast_recovery || _sacked_bytes >= DUP_ACK_THRESHOLD * TCPConfig::MAX_PAYLOAD_SIZE)) {
+        return 0;
+    }
+    const uint64_t quarter_min_rtt = _min_rtt == UINT64_MAX ? 0 : _min_rtt / 4;
+    return max<uint64_t>(1, min(quarter_min_rtt, static_cast<uint64_t>(_srtt)));
+}
+
+//! \details A segment is lost if it was sent before the most recently delivered one and has gone unacknowledged
+//! for longer than that segment's RTT plus the reordering window (RFC 8985 section 6.2 step 5).
+bool TCPSender::rack_detect_loss() {
+    _reorder_deadline.reset();
+    if (!rack_active() || _rack_end_seq == 0) {
+        return false;
+    }
+    const uint64_t reo_wnd = rack_reorder_window();
+    bool lost = false;
+    // 只看 RACK 段之前的段：之后的段除非重传过，都比它发得晚；重传过的留给后面送达的段或者 RTO 去判断
+    for (size_t i = 0; i < _outstanding.size() && _outstanding[i].abs_seqno < _rack_end_seq; i++) {
+        OutstandingSegment &o = _outstanding[i];
+        const uint64_t end = o.abs_seqno + o.segment.length_in_sequence_space();
+        if (o.sacked || o.lost || o.sent_time > _rack_xmit_time ||
+            (o.sent_time == _rack_xmit_time && end >= _rack_end_seq)) {
+            continue;
+        }
+        const uint64_t deadline = o.sent_time + _rack_rtt + reo_wnd;
+        if (deadline <= _time_now) {
+            o.lost = true;
+            lost = true;
+        } else if (!_reorder_deadline.has_value() || deadline < _reorder_deadline.value()) {
+            _reorder_deadline = deadline;
+        }
+    }
+    return lost;
+}
+
+void TCPSender::rack_recover() {
+    // 同一个窗口里只减一次拥塞窗口；超时之后的恢复中直接重传
+    if (!_in_fast_recovery && _abs_ackno >= _recovery_point) {
+        enter_fast_recovery();
+    }
+    retransmit_lost();
+}
+
+//! \details [RFC 8985](\ref rfc::rfc8985) section 7.2: two SRTTs, or long enough for a delayed ACK when only one
+//! segment is in flight. The probe timer is not armed during loss recovery, while a probe is outstanding, or
+//! when the retransmission timer would fire first anyway.
+void TCPSender::arm_pto() {
+    _pto_deadline.reset();
+    if (!_rack_tlp || !_rtt_measured || _in_fast_recovery || _abs_ackno < _recovery_point || _tlp_end_seq.has_value() ||
+        _zero_window || bytes_in_flight() == 0) {
+        return;
+    }
+    uint64_t pto = max<uint64_t>(1, static_cast<uint64_t>(ceil(2 * _srtt)));
+    if (bytes_in_flight() <= TCPConfig::MAX_PAYLOAD_SIZE) {
+        pto = max(pto, static_cast<uint64_t>(ceil(1.5 * _srtt)) + MAX_ACK_DELAY);
+    }
+    if (_rto_deadline.has_value() && _time_now + pto >= _rto_deadline.value()) {
+        return;
+    }
+    _pto_deadline = _time_now + pto;
+}
+
+//! \details RFC 8985 section 7.3: a new segment if the receiver's window has room for one (the congestion
+//! window does not apply to the probe), else the last segment sent again. Either way the ACK it elicits
+//! tells RACK about any hole before it.
+void TCPSender::send_tail_loss_probe() {
+    _tail_loss_probes++;
+    _tlp_retransmitted = !send_new_data(min(_window_size, bytes_in_flight() + TCPConfig::MAX_PAYLOAD_SIZE));
+    if (_tlp_retransmitted) {
+        OutstandingSegment &o = _outstanding.back();
+        o.retransmitted = true;
+        o.sent_time = _time_now;
+        _segments_out.push(o.segment);
+    }
+    _tlp_end_seq = _next_seqno;
+    _rto_deadline = _time_now + _retransmission_timeout; // 探测包发出后重新等一个 RTO
+}
+
+//! \details SRTT and RTTVAR follow [RFC 6298](\ref rfc::rfc6298) section 2, with a clock granularity of 1 ms.
+//! With several samples per round trip, alpha and beta are divided by their number, as suggested in
+//! appendix G of [RFC 7323](\ref rfc::rfc7323), so that a window's worth of samples weighs as much as one.
+void TCPSender::update_rtt(const uint64_t rtt, const uint64_t samples_per_rtt) {
+    const double r = static_cast<double>(rtt);
+    const double alpha = 0.125 / static_cast<double>(samples_per_rtt);
+    const double beta = 0.25 / static_cast<double>(samples_per_rtt);
+    if (!_rtt_measured) { // 第一次采样
+        _srtt = r;
+        _rttvar = r / 2;
+        _rtt_measured = true;
+    } else { // 先用旧的 SRTT 更新 RTTVAR
+        _rttvar = (1 - beta) * _rttvar + beta * abs(_srtt - r);
+        _srtt = (1 - alpha) * _srtt + alpha * r;
+    }
+}
 
+uint64_t TCPSender::base_rto() const {
+    if (!_rtt_measured) { // 还没有采样，用配置的初始值
+        return _initial_retransmission_timeout;
+    }
+    const uint64_t rto = static_cast<uint64_t>(ceil(_srtt + max(1.0, 4 * _rttvar)));
+    return clamp(rto, _rto_min, _rto_max);
+}
+
+void TCPSender::retransmit_first_outstanding() {
+    _outstanding.front().retransmitted = true;
+    _outstanding.front().lost = false;
+    _outstanding.front().sent_time = _time_now;
+    _segments_out.push(_outstanding.front().segment);
+    _high_rxt = max(_high_rxt, _outstanding.front().abs_seqno + _outstanding.front().segment.length_in_sequence_space());
+}
 
+optional<uint64_t> TCPSender::next_deadline() const {
+    if (bytes_in_flight() == 0) { // 没有在途的段，什么定时器都没开
+        return nullopt;
+    }
+    optional<uint64_t> deadline{};
+    for (const auto &timer : {_rto_deadline, _reorder_deadline, _pto_deadline}) {
+        if (timer.has_value()) {
+            const uint64_t wait = timer.value() - min(timer.value(), _time_now);
+            deadline = min(deadline.value_or(wait), wait);
+        }
+    }
+    return deadline;
 }
 
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void TCPSender::tick(const size_t ms_since_last_tick) { // 参数是自上次调用该方法以来已经过了多少毫秒
-    if (bytes_in_flight() == 0) { // 全都收到确认了，不用重传了，直接返回
-        if (!_segment_vector.empty()) {
-            printf("!_segment_vector.empty()\n");
-            assert(0);
-        }
-        _ticks = 0;
+    _time_now += ms_since_last_tick;
+    // 全都收到确认了，不用重传了，直接返回。在途字节数为 0 和追踪表为空是一回事，按追踪表判断，后面才能放心取队头
+    if (_outstanding.empty()) {
+        _rto_deadline.reset();
+        _pto_deadline.reset();
+        _reorder_deadline.reset();
         return;
     }
-    if (_segment_vector.empty()) { // 追踪表为空了，报错
-        printf("_segment_vector.empty()\n");
-        assert(0);
+    // 乱序窗口到期，还没送达的段算丢了
+    if (_reorder_deadline.has_value() && _time_now >= _reorder_deadline.value() && rack_detect_loss()) {
+        rack_recover();
     }
-    _ticks += ms_since_last_tick;
-    if (_ticks >= _retransmission_timeout) {
-        _ticks = 0;
-        _segments_out.push(_segment_vector[0]);
+    // 尾部丢包探测
+    if (_pto_deadline.has_value() && _time_now >= _pto_deadline.value()) {
+        _pto_deadline.reset();
+        send_tail_loss_probe();
+    }
+    if (_rto_deadline.has_value() && _time_now >= _rto_deadline.value()) {
+        _pto_deadline.reset();
+        _tlp_end_seq.reset();
+        _high_rxt = _abs_ackno; // 之前的重传也当作丢了
+        retransmit_first_outstanding();
+        // 零窗口探测超时不是拥塞；同一窗口里的多次丢包只算一次拥塞事件，否则窗口会被反复减小
+        // 快速恢复中超时说明快速恢复失败了，照样要把窗口降到一个段
+        if (!_zero_window && (_abs_ackno >= _recovery_point || _in_fast_recovery)) {
+            if (_congestion_controller) {
+                _congestion_controller->on_loss(LossEvent::Timeout, bytes_in_flight(), _time_now);
+            }
+            _recovery_point = _next_seqno;
+        }
+        _in_fast_recovery = false;
+        _recovery_inflation = 0;
+        _dup_acks = 0;
         if (!_zero_window) { // 零窗口不用“指数回退”
             // When filling window, treat a '0' window size as equal to '1' but don't back off RTO
             _retransmission_timeout *= 2; // 超时重传时间 x 2, 拥塞控制
         }
+        _rto_deadline = _time_now + _retransmission_timeout;
         _consecutive_retransmissions++;
     }
 }
 
+void TCPSender::fast_open_syn_received(const uint64_t window_size) {
+    if (!_syn_sent && window_size > 0) {
+        _window_size = window_size;
+    }
+}
+
 unsigned int TCPSender::consecutive_retransmissions() const { return _consecutive_retransmissions; }
 
 void TCPSender::send_empty_segment() {
@@ -2,13 +2,17 @@
 #define SPONGE_LIBSPONGE_TCP_SENDER_HH
 
 #include "byte_stream.hh"
+#include "ring_queue.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
 #include "wrapping_integers.hh"
 
 #include <functional>
 #include <map>
+#include <memory>
+#include <optional>
 #include <queue>
+#include <vector>
 
 //! \brief The "sender" part of a TCP implementation.
 
@@ -51,6 +55,9 @@ class TCPSender {
 
     // 收到对方对syn的确认
     bool _syn_acked{false};
+
+    // TCP Fast Open：SYN 里带上数据
+    bool _syn_data{false};
     
     // fin已经发送
     bool _fin_sent{false};
@@ -58,13 +65,23 @@ class TCPSender {
     // 收到对方对fin的确认
     bool _fin_acked{false};
     
-    // 定时时间
-    size_t _ticks{0};
+    // 重传定时器到期的时间，有在途的段时才开着
+    std::optional<uint64_t> _rto_deadline{};
 
     // 超时重传时间
     size_t _retransmission_timeout{0};
 
-    std::vector<TCPSegment> _segment_vector{std::vector<TCPSegment>()};
+    // 已发送但还没有完全确认的段，按绝对 seqno 从小到大排列
+    struct OutstandingSegment {
+        uint64_t abs_seqno{0};
+        TCPSegment segment{};
+        uint64_t sent_time{0};     // 最近一次发送的时间（没重传过的段就是第一次发送的时间）
+        bool retransmitted{false}; // 重传过的段不能用来测 RTT（Karn 算法）
+        bool sacked{false};        // 对方用 SACK 块说已经收到了
+        bool lost{false};          // 判定为丢失，等着重传
+    };
+    // 收到确认时只需要从队头弹出，负载和 _segments_out 里的那份共享同一个 Buffer
+    RingQueue<OutstandingSegment> _outstanding{};
 
     // 连续重传次数
     size_t _consecutive_retransmissions{0}; 
@@ -72,13 +89,121 @@ class TCPSender {
     // 零窗口探测
     bool _zero_window{false};
 
+    // 现在的时间，每次调用 tick 累加，给 RTT 采样和拥塞控制用
+    uint64_t _time_now{0};
+
+    // 拥塞控制，为空表示不限制（只看接收方窗口）
+    std::unique_ptr<CongestionController> _congestion_controller;
+
+    // 上次拥塞事件时的 _next_seqno，在它被确认之前再发现丢包不再减小窗口
+    uint64_t _recovery_point{0};
+
+    // 收到几个重复 ACK 触发快速重传
+    static constexpr unsigned DUP_ACK_THRESHOLD = 3;
+
+    // 对方可能推迟 ACK 的最长时间，单位毫秒 (RFC 8985 的 WCDelAckT)
+    static constexpr uint64_t MAX_ACK_DELAY = 200;
+
+    // 连续收到的重复 ACK 个数
+    unsigned _dup_acks{0};
+
+    // 正在快速恢复（NewReno），直到 _recovery_point 被确认
+    bool _in_fast_recovery{false};
+
+    // 快速恢复期间临时加到拥塞窗口上的字节数：每个重复 ACK 说明有一个段离开了网络
+    uint64_t _recovery_inflation{0};
+
+    // 没有等到超时就重传的段数（快速重传 + 部分确认）
+    uint64_t _fast_retransmissions{0};
+
+    // SACK 记分板 (RFC 6675)：_outstanding 里被 SACK 的段打上标记，丢包恢复时只重传真正丢了的段
+    bool _sack_seen{false};     // 对方发过 SACK 块
+    uint64_t _sacked_bytes{0};  // 标记为 sacked 的段的总长度
+    uint64_t _high_rxt{0};      // 这次恢复中重传到的位置（绝对 seqno），之前的空洞已经重传过了
+
+    // RACK-TLP (RFC 8985)：按发送时间判断丢包，尾部丢包发探测包而不是等 RTO
+    bool _rack_tlp;
+    uint64_t _rack_xmit_time{0};  // 最近一次发送的、已经送达（确认或 SACK）的段的发送时间
+    uint64_t _rack_end_seq{0};    // 这个段的结束位置，0 表示还没有段送达
+    uint64_t _rack_rtt{0};        // 这个段的 RTT
+    uint64_t _rack_fack{0};       // 送达的最高位置，没重传过的段在它之前送达说明网络有乱序
+    bool _reordering_seen{false};
+    uint64_t _min_rtt{UINT64_MAX};
+    std::optional<uint64_t> _reorder_deadline{};  // 乱序窗口到期，再检查一次丢包
+    std::optional<uint64_t> _pto_deadline{};      // 到期发尾部丢包探测 (TLP)
+    std::optional<uint64_t> _tlp_end_seq{};       // 探测包发出时的 _next_seqno，确认到这里之前不再探测
+    bool _tlp_retransmitted{false};               // 探测包是重传的最后一个段（没有新数据可发）
+    uint64_t _tail_loss_probes{0};
+
+    // RFC 6298 的 RTT 估计，单位毫秒，只用没有重传过的段采样（Karn 算法）
+    bool _rtt_measured{false};
+    double _srtt{0};
+    double _rttvar{0};
+
+    // 由 RTT 算出的 RTO 的上下界（超时后的指数退避不受上界限制，重传次数到了就放弃连接）
+    uint64_t _rto_min;
+    uint64_t _rto_max;
+
+    // 用一个 RTT 样本更新 SRTT 和 RTTVAR；每个 RTT 有多个样本时（时间戳），每个样本的权重相应减小
+    void update_rtt(const uint64_t rtt, const uint64_t samples_per_rtt = 1);
+
+    // 不算退避的 RTO：还没有采样时是初始值，否则是 SRTT + 4 * RTTVAR
+    uint64_t base_rto() const;
+
+    // 可以发出去的字节数上限：min(cwnd, 接收方窗口)
+    uint64_t send_window() const;
+
+    // 重传最早的未确认段
+    void retransmit_first_outstanding();
+
+    // 用 SACK 块给记分板打标记
+    void update_scoreboard(const std::vector<TCPHeader::SackBlock> &sack, const std::optional<uint32_t> tsecr);
+
+    // 重传记分板判定为丢失、这次恢复中还没重传过的段，直到网络中的字节数 (pipe) 达到拥塞窗口
+    void retransmit_lost();
+
+    // 处理一个重复 ACK
+    void duplicate_ack_received();
+
+    // 进入快速恢复：减小拥塞窗口，记下恢复点
+    void enter_fast_recovery();
+
+    // 按接收方窗口 window 发新数据，返回是否发了
+    bool send_new_data(const uint64_t window);
+
+    // RACK 要靠 SACK 才知道空洞后面哪些段送达了；对方没发过 SACK 的话还是数重复 ACK
+    bool rack_active() const { return _rack_tlp && _sack_seen; }
+
+    // 一个段送达了，更新 RACK 的状态；tsecr 是这个 ACK 回显的时间戳
+    void rack_update(const OutstandingSegment &o, const std::optional<uint32_t> tsecr);
+
+    // RACK 的乱序窗口
+    uint64_t rack_reorder_window() const;
+
+    // 比最近送达的段发得早、过了 RTT + 乱序窗口还没送达的段标记为丢失，返回是否有新的丢失；
+    // 还没到时间的设好乱序定时器
+    bool rack_detect_loss();
+
+    // RACK 发现了丢包：进入快速恢复（如果还没有），重传丢了的段
+    void rack_recover();
+
+    // 设置尾部丢包探测定时器 (RFC 8985 7.2)
+    void arm_pto();
+
+    // 探测定时器到期：发一个新段，没有的话重传最后一个段
+    void send_tail_loss_probe();
+
 
 
   public:
     //! Initialize a TCPSender
     TCPSender(const size_t capacity = TCPConfig::DEFAULT_CAPACITY,
               const uint16_t retx_timeout = TCPConfig::TIMEOUT_DFLT,
-              const std::optional<WrappingInt32> fixed_isn = {});
+              const std::optional<WrappingInt32> fixed_isn = {},
+              const CongestionControlAlgorithm congestion_control = CongestionControlAlgorithm::None,
+              const uint64_t rto_min = TCPConfig::RTO_MIN_DFLT,
+              const uint64_t rto_max = TCPConfig::RTO_MAX_DFLT,
+              const bool rack_tlp = true);
 
     //! \name "Input" interface for the writer
     //!@{
@@ -90,7 +215,25 @@ class TCPSender {
     //!@{
 
     //! \brief A new acknowledgment was received
-    int ack_received(const WrappingInt32 ackno, const uint16_t window_size);
+    //! \param pure_ack the segment carried no data, SYN or FIN, so a repeated ackno counts as a duplicate ACK
+    //! \param tsecr the timestamp echoed by the peer, if the timestamps option is in use
+    //! \param sack the SACK blocks the peer sent, if the SACK option is in use
+    int ack_received(const WrappingInt32 ackno,
+                     const uint64_t window_size,
+                     const bool pure_ack = true,
+                     const std::optional<uint32_t> tsecr = {},
+                     const std::vector<TCPHeader::SackBlock> &sack = {});
+
+    //! \brief The sender's clock, in milliseconds, to put in the TSval of outgoing segments
+    uint32_t timestamp() const { return static_cast<uint32_t>(_time_now); }
+
+    //! \brief Put up to one segment of data in the SYN, for TCP Fast Open ([RFC 7413](\ref rfc::rfc7413))
+    //! \details If the peer acknowledges only the SYN, the data is sent again right away.
+    void send_data_in_syn() { _syn_data = true; }
+
+    //! \brief The peer's SYN carried data that was accepted with a Fast Open cookie: take the window it
+    //! advertised, so that data can be sent before our SYN is acknowledged
+    void fast_open_syn_received(const uint64_t window_size);
 
     //! \brief Generate an empty-payload segment (useful for creating empty ACK segments)
     void send_empty_segment();
@@ -101,6 +244,10 @@ class TCPSender {
     //! \brief Notifies the TCPSender of the passage of time
     // 告诉TCPSender时间正在流逝, 看看是否需要超时重传
     void tick(const size_t ms_since_last_tick);
+
+    //! \brief Milliseconds until tick() next has something to do (the RTO, the probe or the reorder timer),
+    //! or empty if no timer is running
+    std::optional<uint64_t> next_deadline() const;
     //!@}
 
     //! \name Accessors
@@ -115,6 +262,33 @@ class TCPSender {
     //! \brief Number of consecutive retransmissions that have occurred in a row
     unsigned int consecutive_retransmissions() const;
 
+    //! \brief The oldest sequence number not yet acknowledged (SND.UNA)
+    WrappingInt32 unacked_seqno() const { return wrap(_abs_ackno, _isn); }
+
+    //! \brief The peer's window in bytes as last advertised, or 1 while it is zero
+    uint64_t window_size() const { return _window_size; }
+
+    //! \brief Congestion window in bytes (UINT64_MAX when no congestion control is configured)
+    uint64_t congestion_window() const;
+
+    //! \brief Number of segments retransmitted because of duplicate or partial ACKs rather than a timeout
+    uint64_t fast_retransmissions() const { return _fast_retransmissions; }
+
+    //! \brief Number of tail loss probes sent
+    uint64_t tail_loss_probes() const { return _tail_loss_probes; }
+
+    //! \brief Bytes of outstanding data the peer has selectively acknowledged
+    uint64_t sacked_bytes() const { return _sacked_bytes; }
+
+    //! \brief Smoothed round-trip time in milliseconds (0 until the first sample)
+    double srtt() const { return _srtt; }
+
+    //! \brief Round-trip time variation in milliseconds (0 until the first sample)
+    double rttvar() const { return _rttvar; }
+
+    //! \brief The retransmission timeout currently armed, including any backoff, in milliseconds
+    uint64_t retransmission_timeout() const { return _retransmission_timeout; }
+
     //! \brief TCPSegments that the TCPSender has enqueued for transmission.
     //! \note These must be dequeued and sent by the TCPConnection,
     //! which will need to fill in the fields that are set by the TCPReceiver
@@ -3,6 +3,7 @@
 #include "util.hh"
 
 #include <arpa/inet.h>
+#include <array>
 #include <cstring>
 #include <memory>
 #include <netdb.h>
@@ -116,10 +117,11 @@ uint32_t Address::ipv4_numeric() const {
     return be32toh(ipv4_addr.sin_addr.s_addr);
 }
 
-Address Address::from_ipv4_numeric(const uint32_t ip_address) {
+Address Address::from_ipv4_numeric(const uint32_t ip_address, const uint16_t port) {
     sockaddr_in ipv4_addr{};
     ipv4_addr.sin_family = AF_INET;
     ipv4_addr.sin_addr.s_addr = htobe32(ip_address);
+    ipv4_addr.sin_port = htobe16(port);
 
     return {reinterpret_cast<sockaddr *>(&ipv4_addr), sizeof(ipv4_addr)};
 }
@@ -7,8 +7,20 @@ void Buffer::remove_prefix(const size_t n) {
         throw out_of_range("Buffer::remove_prefix");
     }
     _starting_offset += n;
-    if (_storage and _starting_offset == _storage->size()) {
+    if (_storage and str().empty()) {
         _storage.reset();
+        _starting_offset = _ending_trim = 0;
+    }
+}
+
+void Buffer::remove_suffix(const size_t n) {
+    if (n > str().size()) {
+        throw out_of_range("Buffer::remove_suffix");
+    }
+    _ending_trim += n;
+    if (_storage and str().empty()) {
+        _storage.reset();
+        _starting_offset = _ending_trim = 0;
     }
 }
 
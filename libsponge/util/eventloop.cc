@@ -1,31 +1,410 @@
 #include "eventloop.hh"
 
+#include "io_uring.hh"
 #include "util.hh"
 
+#include <algorithm>
 #include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
 #include <stdexcept>
+#include <sys/socket.h>
 #include <system_error>
 #include <utility>
 #include <vector>
 
 using namespace std;
 
+//! \brief Backend::IoUring state
+//! \details Each request carries its kind and an id in its `user_data`: a poll the Rule::poll_id of its rule, a
+//! receive the buffer group of its datagram rule, a read the key of its stream rule in `streams`, and a send or
+//! a write the key of its buffers in `sends` or `writes`. A completion whose id is no longer known (e.g. a poll
+//! whose rule has been cancelled) is dropped.
+struct EventLoop::IoUringState {
+    enum class Kind : uint8_t { Poll, Receive, Send, Cancel, Read, Write };
+
+    static uint64_t user_data(const Kind kind, const uint32_t id) { return (uint64_t(kind) << 32) | id; }
+
+    //! A rule added with EventLoop::add_datagram_rule()
+    struct DatagramRule {
+        FileDescriptor fd;
+        DatagramCallbackT callback;
+        InterestT interest;
+        bool socket;                                 //!< received with recvmsg, which reports the sender; else read
+        std::unique_ptr<IoUring::BufferRing> buffers;
+        msghdr message{};                            //!< what a multishot recvmsg is to report besides the payload
+        unsigned posted{0};                          //!< receives submitted and not finished
+        bool cancelling{false};                      //!< the receives have been cancelled, and are not re-posted
+        bool removed{false};                         //!< fd was closed; erased once the receives have finished
+        std::vector<Datagram> received{};            //!< received since the callback was last called
+
+        bool wants_events() const { return not interest or interest(); }
+    };
+
+    //! A rule added with EventLoop::add_stream_rule()
+    struct StreamRule {
+        FileDescriptor fd;
+        StreamCallbackT callback;
+        CapacityT capacity;
+        uint32_t id;
+        std::string buffer{};    //!< what the receive in progress reads into
+        bool posted{false};      //!< a receive has been submitted and not finished
+        bool cancelling{false};  //!< the receive has been cancelled, and is not re-posted
+        bool removed{false};     //!< fd was closed or reached EOF; erased once the receive has finished
+    };
+
+    //! A write in progress, and the rest of the data it is to write
+    struct Write {
+        FileDescriptor fd;
+        BufferList data;
+        CallbackT written;
+        std::vector<iovec> iovecs{};
+        msghdr message{};
+    };
+
+    //! A send in progress, and the buffers it reads from
+    struct Send {
+        BufferList payload{};
+        std::vector<iovec> iovecs{};
+        sockaddr_storage destination{};
+        msghdr message{};
+    };
+
+    //! A completion, copied out of the queue before anything is done about it
+    struct Completion {
+        uint64_t user_data;
+        int32_t res;
+        uint32_t flags;
+        bool done;  //!< the request has finished, and will not complete again
+    };
+
+    static constexpr unsigned ENTRIES = 256;
+    static constexpr unsigned BUFFERS = 64;   //!< provided buffers per datagram rule
+    static constexpr unsigned READS = 8;      //!< reads kept posted on a datagram rule's fd that is not a socket
+    static constexpr size_t MAX_PAYLOAD = 65536;
+
+    IoUring ring{ENTRIES};  //!< first, so that it is destroyed last
+    FlatHashMap<uint32_t, RuleIt> polls{};
+    std::vector<RuleIt> unarmed{};  //!< rules without an interest callback, and no poll in progress
+    std::list<DatagramRule> datagram_rules{};
+    FlatHashMap<uint16_t, std::list<DatagramRule>::iterator> groups{};
+    FlatHashMap<uint32_t, std::unique_ptr<Send>> sends{};
+    std::list<StreamRule> stream_rules{};
+    FlatHashMap<uint32_t, std::list<StreamRule>::iterator> streams{};
+    FlatHashMap<uint32_t, std::unique_ptr<Write>> writes{};
+    std::vector<Completion> completions{};
+    uint32_t next_id{0};
+    uint16_t next_group{0};
+    size_t in_flight{0};  //!< requests that will still complete, other than cancellations
+
+    //! Cancel every request with `user_data`
+    void cancel(const uint64_t key) {
+        io_uring_sqe &sqe = ring.prepare(IORING_OP_ASYNC_CANCEL, -1, user_data(Kind::Cancel, 0));
+        sqe.addr = key;
+        sqe.cancel_flags = IORING_ASYNC_CANCEL_ALL;
+    }
+
+    //! Keep receives posted on a datagram rule's fd
+    void post_receives(DatagramRule &rule);
+
+    //! Take in a receive's completion
+    void received(DatagramRule &rule, const Completion &completion);
+
+    //! Submit the rest of a write
+    void post_write(const uint32_t id, Write &write) {
+        write.iovecs = BufferViewList{write.data}.as_iovecs();
+        write.iovecs.resize(std::min<size_t>(write.iovecs.size(), IOV_MAX));  // the rest goes in the next round
+        write.message.msg_iov = write.iovecs.data();
+        write.message.msg_iovlen = write.iovecs.size();
+        io_uring_sqe &sqe = ring.prepare(IORING_OP_SENDMSG, write.fd.fd_num(), user_data(Kind::Write, id));
+        sqe.addr = reinterpret_cast<uint64_t>(&write.message);
+        sqe.msg_flags = MSG_NOSIGNAL;
+        in_flight++;
+    }
+
+    //! A new id for a poll, a stream rule, a send or a write
+    uint32_t new_id() {
+        do {
+            next_id++;
+        } while (next_id == 0 or polls.contains(next_id) or streams.contains(next_id) or sends.contains(next_id) or
+                 writes.contains(next_id));
+        return next_id;
+    }
+
+    //! \brief Account for a completion, and release a finished send's buffers
+    //! \returns whether the request it belongs to has finished
+    bool finished(const io_uring_cqe &cqe) {
+        const bool done = not(cqe.flags & IORING_CQE_F_MORE);
+        const Kind kind = Kind(cqe.user_data >> 32);
+        if (done and kind != Kind::Cancel) {
+            in_flight--;
+        }
+        if (done and kind == Kind::Send) {
+            sends.erase(static_cast<uint32_t>(cqe.user_data));
+        }
+        return done;
+    }
+
+    //! Remove a stream rule whose fd has been closed or reached EOF, once its receive has finished
+    void remove(const std::list<StreamRule>::iterator rule) {
+        rule->removed = true;
+        if (rule->posted) {
+            if (not rule->cancelling) {
+                cancel(user_data(Kind::Read, rule->id));
+                rule->cancelling = true;
+            }
+            return;
+        }
+        streams.erase(rule->id);
+        stream_rules.erase(rule);
+    }
+
+    //! Remove a datagram rule whose fd has been closed, once its receives have finished
+    void remove(const std::list<DatagramRule>::iterator rule) {
+        rule->removed = true;
+        if (rule->posted > 0) {
+            if (not rule->cancelling) {
+                cancel(user_data(Kind::Receive, rule->buffers->group()));
+                rule->cancelling = true;
+            }
+            return;
+        }
+        groups.erase(rule->buffers->group());
+        datagram_rules.erase(rule);
+    }
+
+    IoUringState() = default;
+    ~IoUringState();
+    IoUringState(const IoUringState &other) = delete;
+    IoUringState &operator=(const IoUringState &other) = delete;
+};
+
+//! \details The kernel reads a send's buffers and writes into the provided buffers until the requests finish,
+//! so this waits for the sends to go out, then cancels the polls, receives and writes (which may wait for a
+//! reader that never comes) and waits for them to finish.
+EventLoop::IoUringState::~IoUringState() {
+    try {
+        bool cancelled = false;
+        while (in_flight > 0) {
+            if (sends.size() == 0 and not cancelled) {
+                io_uring_sqe &sqe = ring.prepare(IORING_OP_ASYNC_CANCEL, -1, user_data(Kind::Cancel, 0));
+                sqe.cancel_flags = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_ANY;
+                cancelled = true;
+            }
+            ring.enter(1);
+            ring.for_each_completion([&](const io_uring_cqe &cqe) { finished(cqe); });
+        }
+    } catch (const exception &e) {
+        cerr << "Exception destructing EventLoop: " << e.what() << endl;
+    }
+}
+
+void EventLoop::IoUringState::post_receives(DatagramRule &rule) {
+    const uint64_t key = user_data(Kind::Receive, rule.buffers->group());
+    if (rule.socket) {
+        if (rule.posted > 0) {
+            return;
+        }
+        io_uring_sqe &sqe = ring.prepare(IORING_OP_RECVMSG, rule.fd.fd_num(), key);
+        sqe.addr = reinterpret_cast<uint64_t>(&rule.message);
+        sqe.ioprio = IORING_RECV_MULTISHOT;
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = rule.buffers->group();
+        rule.posted++;
+        in_flight++;
+        return;
+    }
+    // no multishot read in the kernels this is written for, so several reads wait for a packet each
+    for (; rule.posted < READS; rule.posted++, in_flight++) {
+        io_uring_sqe &sqe = ring.prepare(IORING_OP_READ, rule.fd.fd_num(), key);
+        sqe.off = UINT64_MAX;  // at the file position, which a device does not have
+        sqe.len = static_cast<uint32_t>(rule.buffers->buffer_size());
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = rule.buffers->group();
+    }
+}
+
+//! \details A socket's buffer holds an io_uring_recvmsg_out, then the sender's address in the room that
+//! DatagramRule::message leaves for it, then the payload.
+void EventLoop::IoUringState::received(DatagramRule &rule, const Completion &completion) {
+    if (completion.done) {
+        rule.posted--;
+    }
+    if (completion.flags & IORING_CQE_F_BUFFER) {
+        const auto id = static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+        const string_view buffer = rule.buffers->buffer(id, max(completion.res, 0));
+        if (not rule.socket) {
+            rule.received.push_back({string{buffer}, {}});
+        } else {
+            const auto *out = reinterpret_cast<const io_uring_recvmsg_out *>(buffer.data());
+            if (out->flags & MSG_TRUNC) {
+                rule.buffers->recycle(id);
+                throw runtime_error("recvfrom (oversized datagram)");
+            }
+            const char *name = buffer.data() + sizeof(io_uring_recvmsg_out);
+            const string_view payload{name + rule.message.msg_namelen + rule.message.msg_controllen, out->payloadlen};
+            rule.received.push_back(
+                {string{payload},
+                 Address{reinterpret_cast<const sockaddr *>(name), min(out->namelen, rule.message.msg_namelen)}});
+        }
+        rule.buffers->recycle(id);
+        return;
+    }
+    // out of buffers: the receive stops, and is posted again before the next wait
+    if (completion.res < 0 and completion.res != -ENOBUFS and completion.res != -ECANCELED) {
+        throw unix_error(rule.socket ? "recvmsg" : "read", -completion.res);
+    }
+}
+
 unsigned int EventLoop::Rule::service_count() const {
     return direction == Direction::In ? fd.read_count() : fd.write_count();
 }
 
+//! \param[in] backend is Backend::Epoll to keep the rules registered with the kernel, Backend::Poll to
+//!                    pass all of them to [poll(2)](\ref man2::poll) on every call, or Backend::IoUring to
+//!                    submit them to [io_uring(7)](\ref man7::io_uring), which throws unix_error if the kernel
+//!                    does not support it
+EventLoop::EventLoop(const Backend backend) : _backend(backend) {
+    if (_backend == Backend::Epoll) {
+        _epoll.emplace(SystemCall("epoll_create1", ::epoll_create1(EPOLL_CLOEXEC)));
+    }
+    if (_backend == Backend::IoUring) {
+        _io_uring = make_unique<IoUringState>();
+    }
+}
+
+EventLoop::~EventLoop() = default;
+EventLoop::EventLoop(EventLoop &&other) = default;
+EventLoop &EventLoop::operator=(EventLoop &&other) = default;
+
 //! \param[in] fd is the FileDescriptor to be polled
 //! \param[in] direction indicates whether to poll for reading (Direction::In) or writing (Direction::Out)
 //! \param[in] callback is called when `fd` is ready.
 //! \param[in] interest is called by EventLoop::wait_next_event. If it returns `true`, `fd` will
 //!                     be polled, otherwise `fd` will be ignored only for this execution of `wait_next_event.
+//!                     If it is empty, `fd` is always polled, and with Backend::Epoll nothing needs to be
+//!                     called before each wait.
 //! \param[in] cancel is called when the rule is cancelled (e.g. on hangup, EOF, or closure).
 void EventLoop::add_rule(const FileDescriptor &fd,
                          const Direction direction,
                          const CallbackT &callback,
                          const InterestT &interest,
                          const CallbackT &cancel) {
-    _rules.push_back({fd.duplicate(), direction, callback, interest, cancel});
+    if (_backend == Backend::Epoll) {  // a registration left by a closed fd with the same number must go first
+        cancel_closed_rules();
+    }
+    _rules.push_back({fd.duplicate(), direction, callback, interest, cancel, false, 0});
+    if (_backend == Backend::IoUring) {  // polled once the interest callback says so, or at the next wait
+        (interest ? _dynamic : _io_uring->unarmed).push_back(prev(_rules.end()));
+        return;
+    }
+    if (_backend != Backend::Epoll) {
+        return;
+    }
+
+    const RuleIt rule = prev(_rules.end());
+    const int fd_num = rule->fd.fd_num();
+    const auto [registration, inserted] = _registrations.try_emplace(fd_num, Registration{{}, 0, false});
+    registration->rules.push_back(rule);
+    if (inserted) {  // registered with no events for now, which still reports errors and hangups
+        epoll_event event{};
+        event.data.fd = fd_num;
+        _system_calls++;
+        if (SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_ADD, fd_num, &event), EPERM) < 0) {
+            registration->unpollable = true;
+            _unpollable.push_back(fd_num);
+        }
+    }
+    if (rule->interest) {  // registered for its direction once the interest callback says so
+        _dynamic.push_back(rule);
+        return;
+    }
+    rule->interested = true;
+    _interested++;
+    update_registration(fd_num);
+}
+
+void EventLoop::update_registration(const int fd_num) {
+    Registration &registration = *_registrations.find(fd_num);
+    uint32_t events = 0;
+    for (const RuleIt &rule : registration.rules) {
+        if (rule->interested) {
+            events |= rule->direction == Direction::In ? EPOLLIN : EPOLLOUT;
+        }
+    }
+    if (events == registration.events) {
+        return;
+    }
+    registration.events = events;
+    if (registration.unpollable) {
+        return;
+    }
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd_num;
+    _system_calls++;
+    SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_MOD, fd_num, &event));
+}
+
+//! \details A closed fd has already left the epoll instance, so it is not touched.
+void EventLoop::cancel_rule(const RuleIt rule) {
+    rule->cancel();
+    if (_backend == Backend::IoUring) {
+        if (rule->poll_id != 0) {
+            _io_uring->polls.erase(rule->poll_id);
+            _io_uring->cancel(IoUringState::user_data(IoUringState::Kind::Poll, rule->poll_id));
+        }
+        vector<RuleIt> &unarmed = _io_uring->unarmed;
+        unarmed.erase(remove(unarmed.begin(), unarmed.end(), rule), unarmed.end());
+        if (rule->interest) {
+            _dynamic.erase(find(_dynamic.begin(), _dynamic.end(), rule));
+        }
+        _rules.erase(rule);
+        return;
+    }
+    const int fd_num = rule->fd.fd_num();
+    const bool closed = rule->fd.closed();
+    if (rule->interested) {
+        _interested--;
+    }
+    if (rule->interest) {
+        _dynamic.erase(find(_dynamic.begin(), _dynamic.end(), rule));
+    }
+    Registration &registration = *_registrations.find(fd_num);
+    registration.rules.erase(find(registration.rules.begin(), registration.rules.end(), rule));
+    _rules.erase(rule);
+
+    if (not registration.rules.empty()) {
+        if (not closed) {
+            update_registration(fd_num);
+        }
+        return;
+    }
+    if (registration.unpollable) {
+        _unpollable.erase(find(_unpollable.begin(), _unpollable.end(), fd_num));
+    } else if (not closed) {
+        _system_calls++;
+        SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_DEL, fd_num, nullptr));
+    }
+    _registrations.erase(fd_num);
+}
+
+//! \details Closing an fd is rare next to waiting, so the rules are only walked when FileDescriptor::close_count()
+//! has moved since the last walk.
+void EventLoop::cancel_closed_rules() {
+    const uint64_t closes = FileDescriptor::close_count();
+    if (closes == _closes_seen) {
+        return;
+    }
+    _closes_seen = closes;
+    // NOTE: it is incremented before the rule it named may be erased
+    for (auto it = _rules.begin(); it != _rules.end();) {
+        const RuleIt rule = it++;
+        if (rule->fd.closed()) {
+            cancel_rule(rule);
+        }
+    }
 }
 
 //! \param[in] timeout_ms is the timeout value passed to [poll(2)](\ref man2::poll); `wait_next_event`
@@ -59,6 +438,17 @@ void EventLoop::add_rule(const FileDescriptor &fd,
 //! will result in a busy loop (poll returns on a ready file descriptor; file descriptor is not read or
 //! written, so it is still ready; the next call to poll will immediately return).
 EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
+    switch (_backend) {
+        case Backend::Epoll:
+            return wait_next_event_epoll(timeout_ms);
+        case Backend::IoUring:
+            return wait_next_event_io_uring(timeout_ms);
+        default:
+            return wait_next_event_poll(timeout_ms);
+    }
+}
+
+EventLoop::Result EventLoop::wait_next_event_poll(const int timeout_ms) {
     vector<pollfd> pollfds{};
     pollfds.reserve(_rules.size());
     bool something_to_poll = false;
@@ -79,7 +469,7 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
             continue;
         }
 
-        if (this_rule.interest()) {
+        if (this_rule.wants_events()) {
             pollfds.push_back({this_rule.fd.fd_num(), static_cast<short>(this_rule.direction), 0});
             something_to_poll = true;
         } else {
@@ -95,6 +485,7 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
 
     // call poll -- wait until one of the fds satisfies one of the rules (writeable/readable)
     try {
+        _system_calls++;
         if (0 == SystemCall("poll", ::poll(pollfds.data(), pollfds.size(), timeout_ms))) {
             return Result::Timeout;
         }
@@ -132,7 +523,7 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
             this_rule.callback();
 
             // only check for busy wait if we're not canceling or exiting
-            if (count_before == this_rule.service_count() and this_rule.interest()) {
+            if (count_before == this_rule.service_count() and this_rule.wants_events()) {
                 throw runtime_error(
                     "EventLoop: busy wait detected: callback did not read/write fd and is still interested");
             }
@@ -143,3 +534,430 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
 
     return Result::Success;
 }
+
+//! \details Only the rules with an interest callback are asked before waiting, and only the fds that
+//! epoll reports ready are visited afterwards. The events are level triggered, as with poll.
+//!
+//! An fd that epoll reports hung up or in error is never writable again, so its Direction::Out rules are
+//! cancelled, and so are its Direction::In rules unless there is something left to read. Unlike with
+//! Backend::Poll, an error is not thrown.
+EventLoop::Result EventLoop::wait_next_event_epoll(const int timeout_ms) {
+    cancel_closed_rules();
+
+    // NOTE: i is incremented in the loop body unless the rule is canceled, which removes it from _dynamic
+    for (size_t i = 0; i < _dynamic.size();) {
+        const RuleIt rule = _dynamic[i];
+        if ((rule->direction == Direction::In and rule->fd.eof()) or rule->fd.closed()) {
+            cancel_rule(rule);
+            continue;
+        }
+        const bool interested = rule->interest();
+        if (interested != rule->interested) {
+            rule->interested = interested;
+            interested ? _interested++ : _interested--;
+            update_registration(rule->fd.fd_num());
+        }
+        ++i;
+    }
+
+    // quit if there is nothing left to wait for
+    if (_interested == 0) {
+        return Result::Exit;
+    }
+
+    // fds that epoll refused are ready for whatever their rules are interested in, so don't wait if there are any
+    bool always_ready = false;
+    for (const int fd_num : _unpollable) {
+        always_ready |= _registrations.find(fd_num)->events != 0;
+    }
+
+    constexpr size_t MAX_EVENTS = 1024;
+    _ready.resize(clamp<size_t>(_registrations.size(), 1, MAX_EVENTS));
+    int ready = 0;
+    try {
+        _system_calls++;
+        ready = SystemCall("epoll_wait",
+                           ::epoll_wait(_epoll->fd_num(), _ready.data(), _ready.size(), always_ready ? 0 : timeout_ms));
+    } catch (unix_error const &e) {
+        if (e.code().value() == EINTR) {
+            return Result::Exit;
+        }
+        throw;
+    }
+    for (const int fd_num : _unpollable) {
+        const uint32_t events = _registrations.find(fd_num)->events;
+        if (events != 0) {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = fd_num;
+            _ready.resize(max<size_t>(_ready.size(), ready + 1));
+            _ready[ready++] = event;
+        }
+    }
+    if (ready == 0) {
+        return Result::Timeout;
+    }
+
+    for (int k = 0; k < ready; k++) {
+        const epoll_event event = _ready[k];
+        const bool defunct = event.events & (EPOLLHUP | EPOLLERR);
+
+        // look the registration up again each time, since a callback may add rules and move it
+        // NOTE: j is incremented in the loop body unless the rule is canceled
+        for (size_t j = 0;;) {
+            Registration *registration = _registrations.find(event.data.fd);
+            if (not registration or j >= registration->rules.size()) {
+                break;
+            }
+            const RuleIt rule = registration->rules[j];
+            const uint32_t wanted = rule->direction == Direction::In ? EPOLLIN : EPOLLOUT;
+            const bool ready_for_rule =
+                rule->interested and (event.events & wanted) and not(defunct and rule->direction == Direction::Out);
+            if (rule->interested and defunct and not ready_for_rule) {
+                // hangup and nothing to read, or never writable again: the fd is defunct for this rule
+                cancel_rule(rule);
+                continue;
+            }
+
+            if (ready_for_rule) {
+                const auto count_before = rule->service_count();
+                rule->callback();
+                if (count_before == rule->service_count() and rule->wants_events()) {
+                    throw runtime_error(
+                        "EventLoop: busy wait detected: callback did not read/write fd and is still interested");
+                }
+                // the poll backend would find this out before its next wait
+                if ((rule->direction == Direction::In and rule->fd.eof()) or rule->fd.closed()) {
+                    cancel_rule(rule);
+                    continue;
+                }
+            }
+            ++j;
+        }
+    }
+
+    return Result::Success;
+}
+
+//! \param[in] fd is the socket or device to receive datagrams (or packets) from
+//! \param[in] callback is given the datagrams received since it was last called, after each wait in which
+//!                     some were received, and may move them out of the vector
+//! \param[in] interest is called by EventLoop::wait_next_event. While it returns `false`, no receives are
+//!                     posted on `fd`, so datagrams wait in the kernel. If it is empty, receives always are.
+//! \details The rule is cancelled when `fd` is closed.
+void EventLoop::add_datagram_rule(const FileDescriptor &fd,
+                                  const DatagramCallbackT &callback,
+                                  const InterestT &interest) {
+    if (_backend != Backend::IoUring) {
+        throw runtime_error("EventLoop: datagram rules need Backend::IoUring");
+    }
+    IoUringState &state = *_io_uring;
+    while (state.groups.contains(state.next_group)) {
+        state.next_group++;
+    }
+    const uint16_t group = state.next_group++;
+
+    int type = 0;
+    socklen_t len = sizeof(type);
+    const bool socket = ::getsockopt(fd.fd_num(), SOL_SOCKET, SO_TYPE, &type, &len) == 0;
+    const size_t buffer_size = IoUringState::MAX_PAYLOAD + sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage);
+    state.datagram_rules.push_back(
+        {fd.duplicate(),
+         callback,
+         interest,
+         socket,
+         make_unique<IoUring::BufferRing>(state.ring, group, IoUringState::BUFFERS, buffer_size),
+         {},
+         0,
+         false,
+         false,
+         {}});
+    state.datagram_rules.back().message.msg_namelen = sizeof(sockaddr_storage);
+    state.groups.try_emplace(group, prev(state.datagram_rules.end()));
+}
+
+//! \param[in] fd is the socket or device to send on
+//! \param[in] payload is the datagram, which the EventLoop keeps until the send has finished
+//! \param[in] destination is where to send it; if empty, `fd` must be connected or be a device
+//! \details A send that fails throws unix_error from the wait that finds out.
+void EventLoop::send(const FileDescriptor &fd, BufferList &&payload, const optional<Address> &destination) {
+    if (_backend != Backend::IoUring) {
+        throw runtime_error("EventLoop: send needs Backend::IoUring");
+    }
+    IoUringState &state = *_io_uring;
+    const uint32_t id = state.new_id();
+    auto send = make_unique<IoUringState::Send>();
+    send->payload = move(payload);
+    send->iovecs = BufferViewList{send->payload}.as_iovecs();
+
+    const uint64_t key = IoUringState::user_data(IoUringState::Kind::Send, id);
+    if (destination) {
+        memcpy(&send->destination, static_cast<const sockaddr *>(*destination), destination->size());
+        send->message.msg_name = &send->destination;
+        send->message.msg_namelen = destination->size();
+        send->message.msg_iov = send->iovecs.data();
+        send->message.msg_iovlen = send->iovecs.size();
+        state.ring.prepare(IORING_OP_SENDMSG, fd.fd_num(), key).addr = reinterpret_cast<uint64_t>(&send->message);
+    } else {
+        io_uring_sqe &sqe = state.ring.prepare(IORING_OP_WRITEV, fd.fd_num(), key);
+        sqe.addr = reinterpret_cast<uint64_t>(send->iovecs.data());
+        sqe.len = static_cast<uint32_t>(send->iovecs.size());
+        sqe.off = UINT64_MAX;
+    }
+    state.sends.try_emplace(id, move(send));
+    state.in_flight++;
+}
+
+//! \param[in] fd is the stream socket to read from
+//! \param[in] callback is given the bytes each receive read, after the wait in which it finished, and may move
+//!                     them out of the string; it is given an empty string when `fd` reaches EOF
+//! \param[in] capacity is called by EventLoop::wait_next_event when no receive is posted on `fd`, and a receive
+//!                     for as many bytes as it returns is posted. If it returns 0, none is, and one still posted
+//!                     is cancelled; the callback must still take what a receive read before it was cancelled.
+//! \details The rule is cancelled when `fd` is closed or reaches EOF.
+void EventLoop::add_stream_rule(const FileDescriptor &fd, const StreamCallbackT &callback, const CapacityT &capacity) {
+    if (_backend != Backend::IoUring) {
+        throw runtime_error("EventLoop: stream rules need Backend::IoUring");
+    }
+    IoUringState &state = *_io_uring;
+    const uint32_t id = state.new_id();
+    state.stream_rules.push_back({fd.duplicate(), callback, capacity, id});
+    state.streams.try_emplace(id, prev(state.stream_rules.end()));
+}
+
+//! \param[in] fd is the stream socket to write to
+//! \param[in] data is what to write, which the EventLoop keeps until it has all been written
+//! \param[in] written is called, after the wait in which the last of `data` was written
+//! \details A write that fails throws unix_error from the wait that finds out.
+void EventLoop::write(const FileDescriptor &fd, BufferList &&data, const CallbackT &written) {
+    if (_backend != Backend::IoUring) {
+        throw runtime_error("EventLoop: write needs Backend::IoUring");
+    }
+    IoUringState &state = *_io_uring;
+    const uint32_t id = state.new_id();
+    auto write = make_unique<IoUringState::Write>(IoUringState::Write{fd.duplicate(), move(data), written});
+    state.post_write(id, *write);
+    state.writes.try_emplace(id, move(write));
+}
+
+//! \details Each interested rule without a poll in progress gets a one-shot poll, each interested datagram
+//! rule gets its receives posted again if they have stopped, and each stream rule with room gets a receive if it
+//! has none; these and the queued sends and writes are submitted in the system call that waits for the first
+//! completion. As with Backend::Epoll, only the rules with an interest callback are asked, and a rule without one
+//! is visited only when its poll completes. The callback of each rule whose poll found its fd ready, of each
+//! stream rule whose receive finished, and of each finished write is called as its completion is taken in, and
+//! then the callback of each datagram rule that received something.
+EventLoop::Result EventLoop::wait_next_event_io_uring(const int timeout_ms) {
+    using Kind = IoUringState::Kind;
+    IoUringState &state = *_io_uring;
+    bool something_to_wait_for = _rules.size() > _dynamic.size();  // the rules without an interest callback
+    bool held = false;  // datagrams received while their rule was not interested, to be delivered now
+
+    const auto defunct = [](const RuleIt rule) {
+        return (rule->direction == Direction::In and rule->fd.eof()) or rule->fd.closed();
+    };
+    const auto arm = [&](const RuleIt rule) {
+        rule->poll_id = state.new_id();
+        const uint64_t key = IoUringState::user_data(Kind::Poll, rule->poll_id);
+        state.ring.prepare(IORING_OP_POLL_ADD, rule->fd.fd_num(), key).poll32_events =
+            static_cast<uint16_t>(rule->direction);
+        state.polls.try_emplace(rule->poll_id, rule);
+        state.in_flight++;
+    };
+    // NOTE: i is incremented in the loop body unless the rule is canceled, which removes it from _dynamic
+    for (size_t i = 0; i < _dynamic.size();) {
+        const RuleIt rule = _dynamic[i];
+        if (defunct(rule)) {
+            cancel_rule(rule);
+            continue;
+        }
+        if (rule->interest()) {
+            something_to_wait_for = true;
+            if (rule->poll_id == 0) {
+                arm(rule);
+            }
+        }
+        ++i;
+    }
+    while (not state.unarmed.empty()) {
+        const RuleIt rule = state.unarmed.back();
+        state.unarmed.pop_back();
+        defunct(rule) ? cancel_rule(rule) : arm(rule);
+    }
+    for (auto it = state.datagram_rules.begin(); it != state.datagram_rules.end();) {
+        const auto rule = it++;
+        if (rule->removed) {
+            continue;
+        }
+        if (rule->fd.closed()) {
+            state.remove(rule);
+            continue;
+        }
+        if (rule->wants_events()) {
+            something_to_wait_for = true;
+            held |= not rule->received.empty();
+            if (not rule->cancelling) {
+                state.post_receives(*rule);
+            }
+        } else if (rule->posted > 0 and not rule->cancelling) {
+            state.cancel(IoUringState::user_data(Kind::Receive, rule->buffers->group()));
+            rule->cancelling = true;
+        }
+    }
+
+    for (auto it = state.stream_rules.begin(); it != state.stream_rules.end();) {
+        const auto rule = it++;
+        if (rule->removed) {
+            continue;
+        }
+        if (rule->fd.closed()) {
+            state.remove(rule);
+            continue;
+        }
+        const size_t capacity = rule->capacity();
+        if (rule->posted) {
+            something_to_wait_for = true;
+            if (capacity == 0 and not rule->cancelling) {
+                state.cancel(IoUringState::user_data(Kind::Read, rule->id));
+                rule->cancelling = true;
+            }
+        } else if (capacity > 0) {
+            something_to_wait_for = true;
+            rule->buffer.resize(min(capacity, IoUringState::MAX_PAYLOAD));
+            io_uring_sqe &sqe =
+                state.ring.prepare(IORING_OP_RECV, rule->fd.fd_num(), IoUringState::user_data(Kind::Read, rule->id));
+            sqe.addr = reinterpret_cast<uint64_t>(rule->buffer.data());
+            sqe.len = static_cast<uint32_t>(rule->buffer.size());
+            rule->posted = true;
+            state.in_flight++;
+        }
+    }
+    something_to_wait_for |= not state.writes.empty();
+
+    // quit if there is nothing left to wait for, but still send what has been queued
+    if (not something_to_wait_for) {
+        state.ring.enter();
+        return Result::Exit;
+    }
+
+    try {
+        state.ring.enter(1, held ? 0 : timeout_ms);
+    } catch (unix_error const &e) {
+        if (e.code().value() == EINTR) {
+            return Result::Exit;
+        }
+        throw;
+    }
+
+    // accounted for before any callback runs, so that an exception from one leaves the state consistent
+    state.completions.clear();
+    state.ring.for_each_completion([&](const io_uring_cqe &cqe) {
+        state.completions.push_back({cqe.user_data, cqe.res, cqe.flags, state.finished(cqe)});
+    });
+
+    for (const IoUringState::Completion &completion : state.completions) {
+        const auto id = static_cast<uint32_t>(completion.user_data);
+        const Kind kind = Kind(completion.user_data >> 32);
+        if (kind == Kind::Send and completion.res < 0) {
+            throw unix_error("sendmsg", -completion.res);
+        }
+        if (kind == Kind::Receive) {
+            const auto rule = *state.groups.find(static_cast<uint16_t>(id));
+            state.received(*rule, completion);
+            if (rule->posted == 0) {
+                rule->cancelling = false;
+                if (rule->removed) {
+                    state.remove(rule);
+                }
+            }
+            continue;
+        }
+        if (kind == Kind::Read) {
+            const auto rule = *state.streams.find(id);
+            rule->posted = false;
+            rule->cancelling = false;
+            if (completion.res < 0 and completion.res != -ECANCELED) {
+                throw unix_error("recv", -completion.res);
+            }
+            if (completion.res >= 0 and not(rule->removed and rule->fd.closed())) {
+                rule->buffer.resize(completion.res);
+                if (completion.res == 0) {
+                    rule->removed = true;
+                }
+                rule->callback(rule->buffer);
+            }
+            if (rule->removed) {
+                state.remove(rule);
+            }
+            continue;
+        }
+        if (kind == Kind::Write) {
+            IoUringState::Write &write = **state.writes.find(id);
+            if (completion.res < 0) {
+                throw unix_error("sendmsg", -completion.res);
+            }
+            write.data.remove_prefix(completion.res);
+            if (write.data.size() > 0) {
+                state.post_write(id, write);
+                continue;
+            }
+            const CallbackT written = move(write.written);
+            state.writes.erase(id);
+            written();
+            continue;
+        }
+        // NOTE: a poll whose rule has been cancelled is not found
+        if (kind != Kind::Poll or not state.polls.contains(id)) {
+            continue;
+        }
+        const RuleIt rule = *state.polls.find(id);
+        state.polls.erase(id);
+        rule->poll_id = 0;
+        if (not rule->interest) {
+            state.unarmed.push_back(rule);
+        }
+        if (completion.res == -ECANCELED) {
+            continue;
+        }
+        if (completion.res < 0) {
+            throw unix_error("poll", -completion.res);
+        }
+        const auto events = static_cast<unsigned>(completion.res);
+        if (events & (POLLERR | POLLNVAL)) {
+            throw runtime_error("EventLoop: error on polled file descriptor");
+        }
+        const bool ready = events & static_cast<unsigned>(rule->direction);
+        if ((events & POLLHUP) and not ready) {
+            // hangup and nothing to read, or never writable again: the fd is defunct for this rule
+            cancel_rule(rule);
+            continue;
+        }
+        // the rule may have lost interest since its poll was submitted
+        if (not ready or not rule->wants_events()) {
+            continue;
+        }
+        const auto count_before = rule->service_count();
+        rule->callback();
+        if (count_before == rule->service_count() and rule->wants_events()) {
+            throw runtime_error(
+                "EventLoop: busy wait detected: callback did not read/write fd and is still interested");
+        }
+        if (defunct(rule)) {
+            cancel_rule(rule);
+        }
+    }
+
+    bool delivered = false;
+    for (auto &rule : state.datagram_rules) {
+        if (not rule.removed and not rule.received.empty() and rule.wants_events()) {
+            rule.callback(rule.received);
+            rule.received.clear();
+            delivered = true;
+        }
+    }
+
+    return state.completions.empty() and not delivered ? Result::Timeout : Result::Success;
+}
+
+//! \details With Backend::IoUring these are the calls to io_uring_enter, which submit as well as wait.
+uint64_t EventLoop::system_calls() const { return _system_calls + (_io_uring ? _io_uring->ring.enters() : 0); }
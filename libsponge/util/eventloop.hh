@@ -1,12 +1,21 @@
 #ifndef SPONGE_LIBSPONGE_EVENTLOOP_HH
 #define SPONGE_LIBSPONGE_EVENTLOOP_HH
 
+#include "address.hh"
+#include "buffer.hh"
 #include "file_descriptor.hh"
+#include "flat_hash_map.hh"
 
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <list>
+#include <memory>
+#include <optional>
 #include <poll.h>
+#include <string>
+#include <sys/epoll.h>
+#include <vector>
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop {
@@ -17,6 +26,35 @@ class EventLoop {
         Out = POLLOUT  //!< Callback will be triggered when Rule::fd is writable.
     };
 
+    //! Returned by each call to EventLoop::wait_next_event.
+    enum class Result {
+        Success,  //!< At least one Rule was triggered.
+        Timeout,  //!< No rules were triggered before timeout.
+        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
+    };
+
+    //! How EventLoop::wait_next_event waits for the rules' file descriptors.
+    enum class Backend {
+        Poll,   //!< Build the [poll(2)](\ref man2::poll) set from every Rule on every call.
+        Epoll,  //!< Keep the rules registered with [epoll(7)](\ref man7::epoll) and visit only ready ones.
+        IoUring  //!< Submit polls, receives and sends to [io_uring(7)](\ref man7::io_uring) in the call that waits.
+    };
+
+    //! A datagram received for a rule added with EventLoop::add_datagram_rule().
+    struct Datagram {
+        std::string payload{};
+        std::optional<Address> source{};  //!< The sender, if the fd is a socket (not, e.g., a TUN device).
+    };
+
+    //! Callback for the datagrams received on a datagram rule's fd since its last call.
+    using DatagramCallbackT = std::function<void(std::vector<Datagram> &)>;
+
+    //! Callback for the bytes a stream rule read from its fd; an empty string means the fd reached EOF.
+    using StreamCallbackT = std::function<void(std::string &)>;
+
+    //! How many bytes a stream rule may read from its fd now; 0 means none.
+    using CapacityT = std::function<size_t(void)>;
+
   private:
     using CallbackT = std::function<void(void)>;  //!< Callback for ready Rule::fd
     using InterestT = std::function<bool(void)>;  //!< `true` return indicates Rule::fd should be polled.
@@ -28,43 +66,138 @@ class EventLoop {
         FileDescriptor fd;    //!< FileDescriptor to monitor for activity.
         Direction direction;  //!< Direction::In for reading from fd, Direction::Out for writing to fd.
         CallbackT callback;   //!< A callback that reads or writes fd.
-        InterestT interest;   //!< A callback that returns `true` whenever fd should be polled.
+        InterestT interest;   //!< A callback that returns `true` whenever fd should be polled; empty means always.
         CallbackT cancel;     //!< A callback that is called when the rule is cancelled (e.g. on hangup)
+        bool interested;      //!< Whether fd is registered for Rule::direction (Backend::Epoll only).
+        uint32_t poll_id;     //!< The poll submitted for fd and not yet completed, or 0 (Backend::IoUring only).
+
+        //! Calls Rule::interest, if there is one.
+        bool wants_events() const { return not interest or interest(); }
 
         //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
         //! \details This function is used internally by EventLoop; you will not need to call it
         unsigned int service_count() const;
     };
 
+    using RuleIt = std::list<Rule>::iterator;
+
+    //! The rules on one file descriptor, and the events they are registered for with epoll.
+    struct Registration {
+        std::vector<RuleIt> rules;
+        uint32_t events;
+        bool unpollable;  //!< epoll refused the fd (e.g. a regular file); it is always ready, as with poll.
+    };
+
+    Backend _backend;
     std::list<Rule> _rules{};  //!< All rules that have been added and not canceled.
+    uint64_t _system_calls{0};  //!< Calls to poll, epoll_wait and epoll_ctl (io_uring_enter is counted by IoUring).
+
+    //! \name Backend::Epoll state
+    //!@{
+    std::optional<FileDescriptor> _epoll{};           //!< The epoll instance.
+    FlatHashMap<int, Registration> _registrations{};  //!< By file descriptor number.
+    std::vector<RuleIt> _dynamic{};                   //!< Rules with a Rule::interest callback (also IoUring).
+    std::vector<int> _unpollable{};                   //!< Fds that epoll refused.
+    size_t _interested{0};                            //!< Rules currently registered for events.
+    std::vector<epoll_event> _ready{};                //!< Filled in by epoll_wait.
+    uint64_t _closes_seen{0};                         //!< FileDescriptor::close_count() at the last check.
+    //!@}
+
+    //! Backend::IoUring state, defined with the backend.
+    struct IoUringState;
+    std::unique_ptr<IoUringState> _io_uring{};
+
+    //! Tell the kernel which events the rules on `fd_num` are now interested in.
+    void update_registration(const int fd_num);
+
+    //! Remove a rule, calling its Rule::cancel callback (Backend::Epoll and Backend::IoUring only).
+    void cancel_rule(const RuleIt rule);
+
+    //! Cancel the rules whose fds have been closed, if any fd has been closed since the last call (Backend::Epoll).
+    void cancel_closed_rules();
+
+    Result wait_next_event_poll(const int timeout_ms);
+    Result wait_next_event_epoll(const int timeout_ms);
+    Result wait_next_event_io_uring(const int timeout_ms);
 
   public:
-    //! Returned by each call to EventLoop::wait_next_event.
-    enum class Result {
-        Success,  //!< At least one Rule was triggered.
-        Timeout,  //!< No rules were triggered before timeout.
-        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
-    };
+    //! \param[in] backend chooses how to wait for events
+    explicit EventLoop(const Backend backend = Backend::Epoll);
+
+    //! With Backend::IoUring, waits for the sends still in progress, so that their buffers outlive them.
+    ~EventLoop();
+
+    //! \name
+    //! An EventLoop can be moved, but not copied (the rules own duplicates of their fds).
+
+    //!@{
+    EventLoop(EventLoop &&other);
+    EventLoop &operator=(EventLoop &&other);
+    //!@}
+
+    //! How the EventLoop waits for events
+    Backend backend() const { return _backend; }
 
     //! Add a rule whose callback will be called when `fd` is ready in the specified Direction.
     void add_rule(
         const FileDescriptor &fd,
         const Direction direction,
         const CallbackT &callback,
-        const InterestT &interest = [] { return true; },
+        const InterestT &interest = {},
         const CallbackT &cancel = [] {});
 
-    //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+    //! \brief Add a rule whose callback will be given the datagrams received on `fd` (Backend::IoUring only).
+    //! \details The EventLoop keeps receives posted on `fd` while the `interest` callback returns `true`.
+    //! `fd` may also be a device, such as a TUN device, each of whose reads returns one packet.
+    void add_datagram_rule(const FileDescriptor &fd, const DatagramCallbackT &callback, const InterestT &interest = {});
+
+    //! \brief Send `payload` as one datagram on `fd`, to `destination` if given (Backend::IoUring only).
+    //! \details The send is submitted by the next wait, together with any other sends queued by then.
+    void send(const FileDescriptor &fd, BufferList &&payload, const std::optional<Address> &destination = {});
+
+    //! \brief Add a rule whose callback will be given what is read from the stream socket `fd`
+    //! (Backend::IoUring only).
+    //! \details The EventLoop keeps one receive posted on `fd`, for as many bytes as `capacity` returns.
+    void add_stream_rule(const FileDescriptor &fd, const StreamCallbackT &callback, const CapacityT &capacity);
+
+    //! \brief Write all of `data` to the stream socket `fd`, then call `written` (Backend::IoUring only).
+    //! \details The write is submitted by the next wait. Only one write should be in progress on an fd at a time.
+    void write(const FileDescriptor &fd, BufferList &&data, const CallbackT &written = [] {});
+
+    //! Waits for the rules' fds to be ready, then executes callback for each ready fd.
     Result wait_next_event(const int timeout_ms);
+
+    //! The system calls made so far to wait for events and to register interest in them
+    uint64_t system_calls() const;
 };
 
 using Direction = EventLoop::Direction;
 
 //! \class EventLoop
 //!
-//! An EventLoop holds a std::list of Rule objects. Each time EventLoop::wait_next_event is
+//! An EventLoop holds a std::list of Rule objects. With Backend::Poll, each time EventLoop::wait_next_event is
 //! executed, the EventLoop uses the Rule objects to construct a call to [poll(2)](\ref man2::poll).
 //!
+//! With Backend::Epoll (the default), each Rule::fd is registered with an [epoll(7)](\ref man7::epoll)
+//! instance once, when the rule is added, and EventLoop::wait_next_event only calls the Rule::interest
+//! callbacks of the rules that have one, changing a registration when an answer changes. After waiting, it
+//! visits only the fds that are ready, so a wakeup costs time in proportion to the ready fds and the rules
+//! with an interest callback, not to all rules. A rule without one is checked for EOF or closure after its
+//! callback runs, and walked over only when some FileDescriptor has been closed since the last wait, rather
+//! than before every wait. A closed fd leaves the epoll instance without a word, so this is how its rules are
+//! cancelled, and why a rule added on a reused fd number is registered afresh.
+//!
+//! With Backend::IoUring, an [io_uring(7)](\ref man7::io_uring) instance carries a one-shot poll for each
+//! interested Rule, submitted in the same system call that waits for completions, so a wakeup costs one
+//! system call in all. Datagram rules added with EventLoop::add_datagram_rule keep receives posted that the
+//! kernel completes into buffers provided up front (a multishot receive for a socket), and datagrams queued with
+//! EventLoop::send go out together with the next wait. Stream rules added with EventLoop::add_stream_rule, and
+//! writes queued with EventLoop::write, do the same for a byte stream: the receive reads into the rule's own
+//! buffer, and a write that the kernel takes only part of is posted again for the rest. None of these costs a
+//! system call of its own. The kernel
+//! completes requests through the thread that submitted them, interrupting any system call it is in, so only one
+//! thread should wait on such an EventLoop.
+//!
 //! When a Rule is installed using EventLoop::add_rule, it will be polled for the specified Rule::direction
 //! whenver the Rule::interest callback returns `true`, until Rule::fd is no longer readable
 //! (for Rule::direction == Direction::In) or writable (for Rule::direction == Direction::Out).
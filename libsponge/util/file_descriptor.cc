@@ -3,6 +3,7 @@
 #include "util.hh"
 
 #include <algorithm>
+#include <atomic>
 #include <fcntl.h>
 #include <iostream>
 #include <stdexcept>
@@ -11,6 +12,9 @@
 
 using namespace std;
 
+//! Counts every call to FDWrapper::close, so that an EventLoop can tell when one of its fds may have been closed
+static atomic<uint64_t> closes{0};
+
 //! \param[in] fd is the file descriptor number returned by [open(2)](\ref man2::open) or similar
 FileDescriptor::FDWrapper::FDWrapper(const int fd) : _fd(fd) {
     if (fd < 0) {
@@ -21,6 +25,7 @@ FileDescriptor::FDWrapper::FDWrapper(const int fd) : _fd(fd) {
 void FileDescriptor::FDWrapper::close() {
     SystemCall("close", ::close(_fd));
     _eof = _closed = true;
+    closes++;
 }
 
 FileDescriptor::FDWrapper::~FDWrapper() {
@@ -41,6 +46,8 @@ FileDescriptor::FileDescriptor(const int fd) : _internal_fd(make_shared<FDWrappe
 //! Private constructor used by duplicate()
 FileDescriptor::FileDescriptor(shared_ptr<FDWrapper> other_shared_ptr) : _internal_fd(move(other_shared_ptr)) {}
 
+uint64_t FileDescriptor::close_count() { return closes; }
+
 //! \returns a copy of this FileDescriptor
 FileDescriptor FileDescriptor::duplicate() const { return FileDescriptor(_internal_fd); }
 
@@ -51,7 +58,11 @@ void FileDescriptor::read(std::string &str, const size_t limit) {
     const size_t size_to_read = min(BUFFER_SIZE, limit);
     str.resize(size_to_read);
 
-    ssize_t bytes_read = SystemCall("read", ::read(fd_num(), str.data(), size_to_read));
+    ssize_t bytes_read = SystemCall("read", ::read(fd_num(), str.data(), size_to_read), EAGAIN);
+    if (bytes_read < 0) {  // non-blocking, and nothing to read yet
+        str.clear();
+        return;
+    }
     if (limit > 0 && bytes_read == 0) {
         _internal_fd->_eof = true;
     }
@@ -98,6 +109,40 @@ size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
     return total_bytes_written;
 }
 
+//! \param[in] views are written in order with [writev(2)](\ref man2::writev), using iovecs on the stack
+//! \param[in] write_all keeps writing until both views are exhausted
+//! \returns the number of bytes written
+size_t FileDescriptor::write(array<string_view, 2> views, const bool write_all) {
+    size_t total_bytes_written = 0;
+
+    do {
+        array<iovec, 2> iovecs{};
+        for (size_t i = 0; i < iovecs.size(); i++) {
+            iovecs[i] = {const_cast<char *>(views[i].data()), views[i].size()};
+        }
+        const size_t size = views[0].size() + views[1].size();
+
+        const ssize_t bytes_written = SystemCall("writev", ::writev(fd_num(), iovecs.data(), iovecs.size()));
+        if (bytes_written == 0 and size != 0) {
+            throw runtime_error("write returned 0 given non-empty input buffer");
+        }
+
+        if (bytes_written > ssize_t(size)) {
+            throw runtime_error("write wrote more than length of input buffer");
+        }
+
+        register_write();
+
+        const size_t from_first = min(size_t(bytes_written), views[0].size());
+        views[0].remove_prefix(from_first);
+        views[1].remove_prefix(bytes_written - from_first);
+
+        total_bytes_written += bytes_written;
+    } while (write_all and (views[0].size() or views[1].size()));
+
+    return total_bytes_written;
+}
+
 void FileDescriptor::set_blocking(const bool blocking_state) {
     int flags = SystemCall("fcntl", fcntl(fd_num(), F_GETFL));
     if (blocking_state) {
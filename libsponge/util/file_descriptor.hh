@@ -5,8 +5,10 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
+#include <string_view>
 
 //! A reference-counted handle to a file descriptor
 class FileDescriptor {
@@ -59,6 +61,7 @@ class FileDescriptor {
     std::string read(const size_t limit = std::numeric_limits<size_t>::max());
 
     //! Read up to `limit` bytes into `str` (caller can allocate storage)
+    //! \note If the fd is non-blocking and has nothing to read, `str` is left empty without reaching EOF
     void read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
 
     //! Write a string, possibly blocking until all is written
@@ -70,6 +73,9 @@ class FileDescriptor {
     //! Write a buffer (or list of buffers), possibly blocking until all is written
     size_t write(BufferViewList buffer, const bool write_all = true);
 
+    //! Write up to two contiguous pieces (e.g. from ByteStream::peek_views) without allocating
+    size_t write(std::array<std::string_view, 2> views, const bool write_all = true);
+
     //! Close the underlying file descriptor
     void close() { _internal_fd->close(); }
 
@@ -98,6 +104,9 @@ class FileDescriptor {
     unsigned int write_count() const { return _internal_fd->_write_count; }
     //!@}
 
+    //! The number of file descriptors closed so far, by any thread
+    static uint64_t close_count();
+
     //! \name Copy/move constructor/assignment operators
     //! FileDescriptor can be moved, but cannot be copied (but see duplicate())
     //!@{
@@ -0,0 +1,168 @@
+#ifndef SPONGE_LIBSPONGE_FLAT_HASH_MAP_HH
+#define SPONGE_LIBSPONGE_FLAT_HASH_MAP_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+//! \brief A hash map with open addressing, for lookups on a per-packet path
+//! \details Entries are kept contiguously (erasing moves the last entry into the hole), and the table that
+//! finds them holds only a 32-bit hash and an index per slot, probed linearly. A lookup touches a cache
+//! line or two of slots and then the entry itself, and iterating visits a dense array. Erasing shifts
+//! the rest of a probe run back instead of leaving tombstones, so lookups do not slow down as entries come
+//! and go. Insertion and erasure invalidate pointers and iterators to entries.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap {
+  public:
+    using value_type = std::pair<Key, Value>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+  private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t index;
+    };
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    std::vector<value_type> _entries{};
+    std::vector<Slot> _slots;
+    size_t _mask;
+    Hash _hash{};
+
+    //! Mix the bits of the key's hash, so that a weak one (e.g. the identity) still spreads over the slots
+    uint32_t hash_of(const Key &key) const {
+        uint64_t h = _hash(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<uint32_t>(h);
+    }
+
+    //! The slot holding `key`, or the empty slot where it would go
+    size_t probe(const Key &key, const uint32_t hash) const {
+        for (size_t i = hash & _mask;; i = (i + 1) & _mask) {
+            const Slot &slot = _slots[i];
+            if (slot.index == EMPTY or (slot.hash == hash and _entries[slot.index].first == key)) {
+                return i;
+            }
+        }
+    }
+
+    //! Rebuild the slots with `count` of them, a power of two
+    void rehash(const size_t count) {
+        _slots.assign(count, Slot{0, EMPTY});
+        _mask = count - 1;
+        for (size_t index = 0; index < _entries.size(); index++) {
+            const uint32_t hash = hash_of(_entries[index].first);
+            size_t i = hash & _mask;
+            while (_slots[i].index != EMPTY) {
+                i = (i + 1) & _mask;
+            }
+            _slots[i] = {hash, static_cast<uint32_t>(index)};
+        }
+    }
+
+  public:
+    //! \param[in] initial_slots is rounded up to a power of two
+    explicit FlatHashMap(const size_t initial_slots = 16) : _slots(), _mask() {
+        size_t n = 1;
+        while (n < initial_slots) {
+            n <<= 1;
+        }
+        rehash(n);
+    }
+
+    //! \name Lookup
+    //!@{
+    //! \returns the value stored for `key`, or nullptr
+    Value *find(const Key &key) {
+        const Slot &slot = _slots[probe(key, hash_of(key))];
+        return slot.index == EMPTY ? nullptr : &_entries[slot.index].second;
+    }
+    const Value *find(const Key &key) const { return const_cast<FlatHashMap *>(this)->find(key); }
+    bool contains(const Key &key) const { return find(key) != nullptr; }
+    //!@}
+
+    //! \name Modifiers
+    //!@{
+
+    //! \brief Insert a value constructed from `args` unless `key` is already present
+    //! \returns the value stored for `key`, and whether it was inserted
+    template <typename... Args>
+    std::pair<Value *, bool> try_emplace(const Key &key, Args &&...args) {
+        const uint32_t hash = hash_of(key);
+        size_t i = probe(key, hash);
+        if (_slots[i].index != EMPTY) {
+            return {&_entries[_slots[i].index].second, false};
+        }
+        if (_entries.size() >= EMPTY - 1) {
+            throw std::length_error("FlatHashMap: too many entries");
+        }
+        // keep the load factor below 7/8, or probe runs get long
+        if ((_entries.size() + 1) * 8 > _slots.size() * 7) {
+            rehash(_slots.size() * 2);
+            i = probe(key, hash);
+        }
+        _entries.emplace_back(std::piecewise_construct,
+                              std::forward_as_tuple(key),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+        _slots[i] = {hash, static_cast<uint32_t>(_entries.size() - 1)};
+        return {&_entries.back().second, true};
+    }
+
+    //! \brief Remove `key` and its value
+    //! \returns whether it was present
+    bool erase(const Key &key) {
+        size_t hole = probe(key, hash_of(key));
+        const uint32_t index = _slots[hole].index;
+        if (index == EMPTY) {
+            return false;
+        }
+        // backward-shift deletion: move up every later slot of the run that may sit at or before the hole
+        for (size_t j = (hole + 1) & _mask; _slots[j].index != EMPTY; j = (j + 1) & _mask) {
+            const size_t home = _slots[j].hash & _mask;
+            if (((j - home) & _mask) >= ((j - hole) & _mask)) {
+                _slots[hole] = _slots[j];
+                hole = j;
+            }
+        }
+        _slots[hole].index = EMPTY;
+
+        // move the last entry into the erased one's place, and point its slot there
+        const uint32_t last = static_cast<uint32_t>(_entries.size() - 1);
+        if (index != last) {
+            size_t i = hash_of(_entries[last].first) & _mask;
+            while (_slots[i].index != last) {
+                i = (i + 1) & _mask;
+            }
+            _slots[i].index = index;
+            std::swap(_entries[index], _entries[last]);
+        }
+        _entries.pop_back();
+        return true;
+    }
+
+    void clear() {
+        _entries.clear();
+        _slots.assign(_slots.size(), Slot{0, EMPTY});
+    }
+    //!@}
+
+    //! \name Iteration over the entries, in no particular order
+    //!@{
+    iterator begin() { return _entries.begin(); }
+    iterator end() { return _entries.end(); }
+    const_iterator begin() const { return _entries.begin(); }
+    const_iterator end() const { return _entries.end(); }
+    //!@}
+
+    size_t size() const { return _entries.size(); }
+    bool empty() const { return _entries.empty(); }
+};
+
+#endif  // SPONGE_LIBSPONGE_FLAT_HASH_MAP_HH
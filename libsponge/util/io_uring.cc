@@ -0,0 +1,149 @@
+#include "io_uring.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+//! \param[in] size is the number of bytes to map
+//! \param[in] fd is the io_uring instance whose memory to map, or -1 for anonymous memory
+//! \param[in] offset is which of the instance's regions to map (e.g. `IORING_OFF_SQ_RING`)
+IoUring::Mapping::Mapping(const size_t size, const int fd, const off_t offset)
+    : _address(fd < 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                      : ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset))
+    , _size(size) {
+    if (_address == MAP_FAILED) {
+        throw unix_error("mmap");
+    }
+}
+
+IoUring::Mapping::~Mapping() { ::munmap(_address, _size); }
+
+//! Set up an instance, filling in `params`
+static int setup(const unsigned entries, io_uring_params &params) {
+    const long fd = ::syscall(__NR_io_uring_setup, entries, &params);
+    SystemCall("io_uring_setup", static_cast<int>(fd));
+    // without a single mapping for both rings, the kernel also lacks the operations EventLoop uses
+    if (not(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ::close(static_cast<int>(fd));
+        throw unix_error("io_uring_setup", EOPNOTSUPP);
+    }
+    return static_cast<int>(fd);
+}
+
+static io_uring_params setup_params(const unsigned entries) {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = 4 * entries;
+    return params;
+}
+
+IoUring::IoUring(const unsigned entries) : IoUring(entries, setup_params(entries)) {}
+
+//! \details Delegated to with the parameters to set up with, so that the members can be initialized from
+//! what the kernel writes back into them.
+IoUring::IoUring(const unsigned entries, io_uring_params params)
+    : _fd(setup(entries, params))
+    , _rings(max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                 params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe)),
+             _fd.fd_num(),
+             IORING_OFF_SQ_RING)
+    , _sqe_memory(params.sq_entries * sizeof(io_uring_sqe), _fd.fd_num(), IORING_OFF_SQES)
+    , _sq_head(_rings.at<unsigned>(params.sq_off.head))
+    , _sq_tail(_rings.at<unsigned>(params.sq_off.tail))
+    , _sq_array(_rings.at<unsigned>(params.sq_off.array))
+    , _sqes(_sqe_memory.at<io_uring_sqe>(0))
+    , _sq_mask(*_rings.at<unsigned>(params.sq_off.ring_mask))
+    , _sq_entries(params.sq_entries)
+    , _sq_local_tail(*_sq_tail)
+    , _cq_head(_rings.at<unsigned>(params.cq_off.head))
+    , _cq_tail(_rings.at<unsigned>(params.cq_off.tail))
+    , _cqes(_rings.at<io_uring_cqe>(params.cq_off.cqes))
+    , _cq_mask(*_rings.at<unsigned>(params.cq_off.ring_mask)) {}
+
+//! \details If the submission queue is full, the entries in it are submitted first.
+io_uring_sqe &IoUring::prepare(const uint8_t opcode, const int fd, const uint64_t user_data) {
+    if (_sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) == _sq_entries) {
+        enter();
+    }
+    const unsigned index = _sq_local_tail & _sq_mask;
+    io_uring_sqe &sqe = _sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.user_data = user_data;
+    _sq_array[index] = index;
+    _sq_local_tail++;
+    return sqe;
+}
+
+//! \details Waits with a timeout through `IORING_ENTER_EXT_ARG` (Linux 5.11), so the timeout needs no entry of
+//! its own. A wait interrupted by a signal throws unix_error with `EINTR`.
+bool IoUring::enter(const unsigned wait_for, const int timeout_ms) {
+    __atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+    const unsigned to_submit = _sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    if (to_submit == 0 and wait_for == 0) {
+        return true;
+    }
+
+    unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+    __kernel_timespec timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000000LL};
+    io_uring_getevents_arg arg{};
+    if (wait_for > 0 and timeout_ms >= 0) {
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    _enters++;
+    const long ret = ::syscall(__NR_io_uring_enter,
+                               _fd.fd_num(),
+                               to_submit,
+                               wait_for,
+                               flags,
+                               (flags & IORING_ENTER_EXT_ARG) ? &arg : nullptr,
+                               sizeof(arg));
+    return SystemCall("io_uring_enter", static_cast<int>(ret), ETIME) >= 0;
+}
+
+//! \param[in] ring is the instance to register with
+//! \param[in] group is the buffer group id that receives name in `sqe.buf_group`
+//! \param[in] count is the number of buffers, a power of two no more than 32768
+//! \param[in] size is the size of each buffer
+IoUring::BufferRing::BufferRing(IoUring &ring, const uint16_t group, const unsigned count, const size_t size)
+    : _ring(ring)
+    , _group(group)
+    , _count(count)
+    , _size(size)
+    , _entries(count * sizeof(io_uring_buf))
+    , _buffers(count * size) {
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(_entries.at<io_uring_buf>(0));
+    reg.ring_entries = count;
+    reg.bgid = group;
+    const long ret = ::syscall(__NR_io_uring_register, _ring._fd.fd_num(), IORING_REGISTER_PBUF_RING, &reg, 1);
+    SystemCall("io_uring_register", static_cast<int>(ret));
+    for (unsigned id = 0; id < count; id++) {
+        recycle(static_cast<uint16_t>(id));
+    }
+}
+
+IoUring::BufferRing::~BufferRing() {
+    io_uring_buf_reg reg{};
+    reg.bgid = _group;
+    ::syscall(__NR_io_uring_register, _ring._fd.fd_num(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+}
+
+void IoUring::BufferRing::recycle(const uint16_t id) {
+    io_uring_buf &entry = _entries.at<io_uring_buf>(0)[_tail & (_count - 1)];
+    entry.addr = reinterpret_cast<uint64_t>(_buffers.at<char>(size_t{id} * _size));
+    entry.len = static_cast<uint32_t>(_size);
+    entry.bid = id;
+    _tail++;
+    // the ring's tail overlays a reserved field of its first entry (struct io_uring_buf_ring)
+    __atomic_store_n(&_entries.at<io_uring_buf>(0)->resv, _tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,130 @@
+#ifndef SPONGE_LIBSPONGE_IO_URING_HH
+#define SPONGE_LIBSPONGE_IO_URING_HH
+
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <string_view>
+#include <sys/types.h>
+
+//! \brief An [io_uring(7)](\ref man7::io_uring) instance, used through its system calls
+//! \details Entries prepared with prepare() are handed to the kernel together by the next call to enter(),
+//! which can also wait for completions; a batch of operations costs one system call. The submission queue
+//! is flushed early if it fills up.
+class IoUring {
+  private:
+    //! Memory shared with the kernel, or anonymous memory handed to it, unmapped on destruction
+    class Mapping {
+        void *_address;
+        size_t _size;
+
+      public:
+        //! Map `size` bytes of `fd` at `offset`, or anonymous memory if `fd` is negative
+        Mapping(const size_t size, const int fd = -1, const off_t offset = 0);
+        ~Mapping();
+        Mapping(const Mapping &other) = delete;
+        Mapping &operator=(const Mapping &other) = delete;
+
+        template <typename T>
+        T *at(const size_t offset) const {
+            return reinterpret_cast<T *>(static_cast<char *>(_address) + offset);
+        }
+    };
+
+    FileDescriptor _fd;
+    Mapping _rings;
+    Mapping _sqe_memory;
+
+    //! \name The submission queue
+    //!@{
+    unsigned *_sq_head;
+    unsigned *_sq_tail;
+    unsigned *_sq_array;
+    io_uring_sqe *_sqes;
+    unsigned _sq_mask;
+    unsigned _sq_entries;
+    unsigned _sq_local_tail{0};  //!< past the last entry prepared; published to the kernel by enter()
+    //!@}
+
+    //! \name The completion queue
+    //!@{
+    unsigned *_cq_head;
+    unsigned *_cq_tail;
+    io_uring_cqe *_cqes;
+    unsigned _cq_mask;
+    //!@}
+
+    uint64_t _enters{0};  //!< calls to io_uring_enter
+
+    IoUring(const unsigned entries, io_uring_params params);
+
+  public:
+    //! \brief Set up an instance with room for `entries` submissions, and four times as many completions
+    //! \details Throws unix_error if the kernel does not support io_uring or does not allow it.
+    explicit IoUring(const unsigned entries);
+    IoUring(const IoUring &other) = delete;
+    IoUring &operator=(const IoUring &other) = delete;
+
+    //! \brief An empty submission queue entry for `opcode` on `fd`, to be submitted by the next enter()
+    //! \details `user_data` comes back in the entry's completions.
+    io_uring_sqe &prepare(const uint8_t opcode, const int fd, const uint64_t user_data);
+
+    //! \brief Submit the prepared entries, and wait for at least `wait_for` completions
+    //! \param[in] wait_for is the number of completions to wait for, if 0 only submit
+    //! \param[in] timeout_ms is how long to wait at most, or -1 to wait as long as it takes
+    //! \returns false if the timeout expired
+    bool enter(const unsigned wait_for = 0, const int timeout_ms = -1);
+
+    //! The system calls enter() has made; one that had nothing to submit or wait for made none
+    uint64_t enters() const { return _enters; }
+
+    //! \brief Call `f(cqe)` on each completion that has arrived, then give them back to the kernel
+    //! \returns the number of completions
+    template <typename F>
+    size_t for_each_completion(F &&f) {
+        unsigned head = *_cq_head;
+        const unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        const size_t count = tail - head;
+        for (; head != tail; head++) {
+            f(static_cast<const io_uring_cqe &>(_cqes[head & _cq_mask]));
+        }
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    //! \brief Buffers that the kernel fills for receives that select one from the group, instead of the
+    //! receive naming one ([io_uring_register_buf_ring(3)](\ref man3::io_uring_register_buf_ring))
+    //! \details A completion that used a buffer names it; the caller hands it back with recycle() once it
+    //! has taken the data out. Must be destroyed before the IoUring it is registered with.
+    class BufferRing {
+        IoUring &_ring;
+        uint16_t _group;
+        unsigned _count;
+        size_t _size;
+        Mapping _entries;  //!< the ring of io_uring_buf the kernel takes buffers from
+        Mapping _buffers;  //!< the buffers themselves
+        uint16_t _tail{0};
+
+      public:
+        //! Register `count` buffers of `size` bytes as group `group`; `count` must be a power of two
+        BufferRing(IoUring &ring, const uint16_t group, const unsigned count, const size_t size);
+        ~BufferRing();
+        BufferRing(const BufferRing &other) = delete;
+        BufferRing &operator=(const BufferRing &other) = delete;
+
+        uint16_t group() const { return _group; }
+        size_t buffer_size() const { return _size; }
+
+        //! The first `length` bytes of buffer `id`
+        std::string_view buffer(const uint16_t id, const size_t length) const {
+            return {_buffers.at<char>(size_t{id} * _size), length};
+        }
+
+        //! Give buffer `id` back to the kernel
+        void recycle(const uint16_t id);
+    };
+};
+
+#endif  // SPONGE_LIBSPONGE_IO_URING_HH
@@ -0,0 +1,87 @@
+#ifndef SPONGE_LIBSPONGE_RING_QUEUE_HH
+#define SPONGE_LIBSPONGE_RING_QUEUE_HH
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//! \brief A FIFO queue stored in a power-of-two ring of slots
+//! \details Once the ring has grown to the largest number of elements held at one time,
+//! push_back() and pop_front() never allocate. Elements can also be visited by position,
+//! 0 being the front.
+template <typename T>
+class RingQueue {
+  private:
+    std::vector<T> _slots;
+    size_t _mask;
+    size_t _head{0};
+    size_t _size{0};
+
+    //! Double the number of slots, moving the elements to the front of the new ring
+    void grow() {
+        std::vector<T> slots(_slots.size() * 2);
+        for (size_t i = 0; i < _size; i++) {
+            slots[i] = std::move((*this)[i]);
+        }
+        _slots = std::move(slots);
+        _mask = _slots.size() - 1;
+        _head = 0;
+    }
+
+  public:
+    //! \param[in] initial_slots is rounded up to a power of two
+    explicit RingQueue(const size_t initial_slots = 16) : _slots(), _mask() {
+        size_t n = 1;
+        while (n < initial_slots) {
+            n <<= 1;
+        }
+        _slots.resize(n);
+        _mask = n - 1;
+    }
+
+    //! \name Queue operations
+    //!@{
+    void push_back(T &&value) {
+        if (_size == _slots.size()) {
+            grow();
+        }
+        _slots[(_head + _size) & _mask] = std::move(value);
+        _size++;
+    }
+    void push_back(const T &value) { push_back(T(value)); }
+
+    //! \note The slot is reset to `T{}` so that any resources the element holds are released now.
+    void pop_front() {
+        if (_size == 0) {
+            throw std::out_of_range("RingQueue::pop_front");
+        }
+        _slots[_head] = T{};
+        _head = (_head + 1) & _mask;
+        _size--;
+    }
+
+    void clear() {
+        while (_size > 0) {
+            pop_front();
+        }
+    }
+    //!@}
+
+    //! \name Accessors
+    //!@{
+    T &front() { return _slots[_head]; }
+    const T &front() const { return _slots[_head]; }
+    T &back() { return _slots[(_head + _size - 1) & _mask]; }
+    const T &back() const { return _slots[(_head + _size - 1) & _mask]; }
+
+    //! \brief The element `i` positions behind the front
+    T &operator[](const size_t i) { return _slots[(_head + i) & _mask]; }
+    const T &operator[](const size_t i) const { return _slots[(_head + i) & _mask]; }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_RING_QUEUE_HH
@@ -85,17 +85,33 @@ void Socket::shutdown(const int how) {
 }
 
 //! \note If `mtu` is too small to hold the received datagram, this method throws a std::runtime_error
-void UDPSocket::recv(received_datagram &datagram, const size_t mtu) {
+void UDPSocket::recv(received_datagram &datagram, const size_t mtu) { recvfrom_helper(datagram, mtu, 0); }
+
+//! \details Passes `MSG_DONTWAIT` to [recvfrom(2)](\ref man2::recvfrom), so the socket itself may stay blocking.
+bool UDPSocket::try_recv(received_datagram &datagram, const size_t mtu) {
+    return recvfrom_helper(datagram, mtu, MSG_DONTWAIT);
+}
+
+//! \returns false if `flags` include `MSG_DONTWAIT` and no datagram was waiting
+bool UDPSocket::recvfrom_helper(received_datagram &datagram, const size_t mtu, const int flags) {
     // receive source address and payload
     Address::Raw datagram_source_address;
     datagram.payload.resize(mtu);
 
     socklen_t fromlen = sizeof(datagram_source_address);
 
-    const ssize_t recv_len = SystemCall(
-        "recvfrom",
-        ::recvfrom(
-            fd_num(), datagram.payload.data(), datagram.payload.size(), MSG_TRUNC, datagram_source_address, &fromlen));
+    const ssize_t recv_len = SystemCall("recvfrom",
+                                        ::recvfrom(fd_num(),
+                                                   datagram.payload.data(),
+                                                   datagram.payload.size(),
+                                                   MSG_TRUNC | flags,
+                                                   datagram_source_address,
+                                                   &fromlen),
+                                        (flags & MSG_DONTWAIT) ? EAGAIN : 0);
+    if (recv_len < 0) {
+        datagram.payload.clear();
+        return false;
+    }
 
     if (recv_len > ssize_t(mtu)) {
         throw runtime_error("recvfrom (oversized datagram)");
@@ -104,6 +120,7 @@ void UDPSocket::recv(received_datagram &datagram, const size_t mtu) {
     register_read();
     datagram.source_address = {datagram_source_address, fromlen};
     datagram.payload.resize(recv_len);
+    return true;
 }
 
 UDPSocket::received_datagram UDPSocket::recv(const size_t mtu) {
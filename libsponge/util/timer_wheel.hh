@@ -0,0 +1,274 @@
+#ifndef SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+#define SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//! \brief Many timers, of which few are due at a time, in a hierarchical timing wheel
+//! \details Time is counted in milliseconds. Level 0 has a slot for each millisecond of the current block of 64,
+//! level 1 a slot for each block of 64 ms in the current block of 4096, and so on up six levels (about two
+//! years); a timer further off waits in a list of its own. When time enters a block, the timers in its slot move
+//! down to the levels below, so a timer moves at most six times before it fires, however far off it was armed.
+//! Arming and cancelling link or unlink one node, and advancing jumps straight to the next occupied slot using
+//! a bitmap per level, so time that passes without a timer due costs nothing.
+//!
+//! The wheel holds values rather than callbacks: advance() hands the value of each timer that is due to a
+//! function of the caller's, so what it names can move in between, and a wheel of copyable values can itself
+//! be copied. Timers due at the same time fire in no particular order. A Handle names one arming of a timer;
+//! it is safe to cancel or look up after that timer has fired or been cancelled. `T` must be default
+//! constructible, so that a cancelled timer's value can be released at once.
+template <typename T>
+class TimerWheel {
+  public:
+    //! Names an armed timer
+    struct Handle {
+        uint32_t index{UINT32_MAX};
+        uint32_t generation{0};
+    };
+
+  private:
+    static constexpr unsigned LEVEL_BITS = 6;
+    static constexpr unsigned SLOTS = 1 << LEVEL_BITS;
+    static constexpr unsigned LEVELS = 6;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    //! \name Lists of timers: a slot per level, then timers due now, then timers past the top level
+    //!@{
+    static constexpr uint32_t DUE_LIST = LEVELS * SLOTS;
+    static constexpr uint32_t FAR_LIST = DUE_LIST + 1;
+    static constexpr uint32_t LISTS = FAR_LIST + 1;
+    static constexpr uint32_t FREE = LISTS;  //!< the "list" of a node that holds no timer
+    //!@}
+
+    struct Node {
+        T value;
+        uint64_t expiry;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;
+        uint32_t list;
+    };
+
+    struct List {
+        uint32_t head{NONE};
+        uint32_t tail{NONE};
+    };
+
+    std::vector<Node> _nodes{};
+    uint32_t _free{NONE};  //!< free nodes, chained through `next`
+    std::array<List, LISTS> _lists{};
+    std::array<uint64_t, LEVELS> _occupied{};  //!< a bit for each slot whose list is not empty
+    uint64_t _now;
+    size_t _size{0};
+
+    //! The list for a timer that expires at `expiry`
+    uint32_t list_for(const uint64_t expiry) const {
+        if (expiry <= _now) {
+            return DUE_LIST;
+        }
+        // the lowest level whose current block contains the expiry; its slot there is after the current one
+        for (unsigned level = 0; level < LEVELS; level++) {
+            const unsigned shift = LEVEL_BITS * (level + 1);
+            if ((expiry >> shift) == (_now >> shift)) {
+                return level * SLOTS + ((expiry >> (LEVEL_BITS * level)) & (SLOTS - 1));
+            }
+        }
+        return FAR_LIST;
+    }
+
+    void link(const uint32_t index, const uint32_t list) {
+        Node &node = _nodes[index];
+        List &l = _lists[list];
+        node.list = list;
+        node.prev = l.tail;
+        node.next = NONE;
+        (l.tail == NONE ? l.head : _nodes[l.tail].next) = index;
+        l.tail = index;
+        if (list < DUE_LIST) {
+            _occupied[list / SLOTS] |= uint64_t{1} << (list % SLOTS);
+        }
+    }
+
+    void unlink(const uint32_t index) {
+        Node &node = _nodes[index];
+        List &l = _lists[node.list];
+        (node.prev == NONE ? l.head : _nodes[node.prev].next) = node.next;
+        (node.next == NONE ? l.tail : _nodes[node.next].prev) = node.prev;
+        if (node.list < DUE_LIST and l.head == NONE) {
+            _occupied[node.list / SLOTS] &= ~(uint64_t{1} << (node.list % SLOTS));
+        }
+    }
+
+    //! Unlink a node and put it on the free list; its value is left for the caller to take
+    void release(const uint32_t index) {
+        unlink(index);
+        Node &node = _nodes[index];
+        node.list = FREE;
+        node.generation++;
+        node.next = _free;
+        _free = index;
+        _size--;
+    }
+
+    //! Move every timer in `list` to where it belongs now
+    void cascade(const uint32_t list) {
+        uint32_t index = _lists[list].head;
+        _lists[list] = List{};
+        if (list < DUE_LIST) {
+            _occupied[list / SLOTS] &= ~(uint64_t{1} << (list % SLOTS));
+        }
+        while (index != NONE) {
+            const uint32_t next = _nodes[index].next;
+            link(index, list_for(_nodes[index].expiry));
+            index = next;
+        }
+    }
+
+    //! The next time after now at which a slot must fire or cascade, if any
+    std::optional<uint64_t> next_event() const {
+        std::optional<uint64_t> next{};
+        for (unsigned level = 0; level < LEVELS; level++) {
+            if (_occupied[level] == 0) {
+                continue;
+            }
+            // every occupied slot is after the current one, within the current block of the level above
+            const unsigned shift = LEVEL_BITS * (level + 1);
+            const uint64_t block = (_now >> shift) << shift;
+            const uint64_t time = block + (uint64_t(__builtin_ctzll(_occupied[level])) << (LEVEL_BITS * level));
+            next = next ? std::min(*next, time) : time;
+        }
+        if (_lists[FAR_LIST].head != NONE) {
+            const unsigned shift = LEVEL_BITS * LEVELS;
+            const uint64_t time = ((_now >> shift) + 1) << shift;
+            next = next ? std::min(*next, time) : time;
+        }
+        return next;
+    }
+
+    //! Fire every timer in `list`, including any that firing adds to it
+    template <typename F>
+    void fire(const uint32_t list, F &fire_timer) {
+        while (_lists[list].head != NONE) {
+            const uint32_t index = _lists[list].head;
+            T value = std::move(_nodes[index].value);
+            _nodes[index].value = T{};
+            release(index);
+            fire_timer(value);
+        }
+    }
+
+    const Node *find(const Handle handle) const {
+        if (handle.index >= _nodes.size()) {
+            return nullptr;
+        }
+        const Node &node = _nodes[handle.index];
+        return node.list != FREE and node.generation == handle.generation ? &node : nullptr;
+    }
+
+  public:
+    //! \param[in] now is the time the wheel starts at
+    explicit TimerWheel(const uint64_t now = 0) : _now(now) {}
+
+    //! \brief Arm a timer that expires `delay` milliseconds from now
+    //! \details A timer armed with no delay fires at the next call to advance(), even one that advances by 0.
+    Handle arm(const uint64_t delay, T value) {
+        uint32_t index = _free;
+        if (index != NONE) {
+            _free = _nodes[index].next;
+            _nodes[index].value = std::move(value);
+        } else {
+            if (_nodes.size() >= NONE) {
+                throw std::length_error("TimerWheel: too many timers");
+            }
+            index = static_cast<uint32_t>(_nodes.size());
+            _nodes.push_back(Node{std::move(value), 0, NONE, NONE, 0, FREE});
+        }
+        Node &node = _nodes[index];
+        node.expiry = delay > UINT64_MAX - _now ? UINT64_MAX : _now + delay;
+        link(index, list_for(node.expiry));
+        _size++;
+        return {index, node.generation};
+    }
+
+    //! \brief Disarm a timer
+    //! \returns whether it was still armed
+    bool cancel(const Handle handle) {
+        if (not find(handle)) {
+            return false;
+        }
+        _nodes[handle.index].value = T{};
+        release(handle.index);
+        return true;
+    }
+
+    //! \returns when the timer will fire, or empty if it is not armed
+    std::optional<uint64_t> expiry(const Handle handle) const {
+        const Node *node = find(handle);
+        return node ? std::optional<uint64_t>{node->expiry} : std::nullopt;
+    }
+
+    bool armed(const Handle handle) const { return find(handle) != nullptr; }
+
+    //! \brief Let `ms` milliseconds pass, calling `fire_timer(value)` for each timer as it falls due
+    //! \details now() is the timer's expiry while `fire_timer` runs, and `fire_timer` may arm and cancel timers;
+    //! those it arms to fire by the end of the advance fire in it too.
+    template <typename F>
+    void advance(const uint64_t ms, F &&fire_timer) {
+        const uint64_t target = _now + ms;
+        fire(DUE_LIST, fire_timer);
+        for (auto next = next_event(); next and *next <= target; next = next_event()) {
+            _now = *next;
+            if (_now % (uint64_t{1} << (LEVEL_BITS * LEVELS)) == 0) {
+                cascade(FAR_LIST);
+            }
+            // from the top down, since a timer may move down several levels at once
+            for (unsigned level = LEVELS; level-- > 1;) {
+                const unsigned shift = LEVEL_BITS * level;
+                if (_now % (uint64_t{1} << shift) == 0) {
+                    cascade(level * SLOTS + ((_now >> shift) & (SLOTS - 1)));
+                }
+            }
+            fire(_now & (SLOTS - 1), fire_timer);
+            fire(DUE_LIST, fire_timer);
+        }
+        _now = target;
+    }
+
+    //! \brief Milliseconds until the next timer fires, or empty if none is armed
+    //! \details Looks at the first occupied slot of each level, so it costs as much as the timers there.
+    std::optional<uint64_t> next_expiry() const {
+        if (_lists[DUE_LIST].head != NONE) {
+            return 0;
+        }
+        std::optional<uint64_t> first{};
+        const auto scan = [&](const uint32_t list) {
+            for (uint32_t index = _lists[list].head; index != NONE; index = _nodes[index].next) {
+                first = first ? std::min(*first, _nodes[index].expiry) : _nodes[index].expiry;
+            }
+        };
+        for (unsigned level = 0; level < LEVELS; level++) {
+            if (_occupied[level] != 0) {
+                scan(level * SLOTS + __builtin_ctzll(_occupied[level]));
+            }
+        }
+        scan(FAR_LIST);
+        return first ? std::optional<uint64_t>{*first - _now} : std::nullopt;
+    }
+
+    //! \name Accessors
+    //!@{
+    //! \brief The current time, in milliseconds
+    uint64_t now() const { return _now; }
+    //! \brief Timers armed
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_TIMER_WHEEL_HH
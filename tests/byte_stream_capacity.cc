@@ -104,6 +104,20 @@ int main() {
             test.execute(Eof{true});
         }
 
+        {
+            ByteStreamTestHarness test{"pop-past-buffered", 4};
+
+            test.execute(Write{"cat"}.with_bytes_written(3));
+            test.execute(Pop{5});
+
+            test.execute(BufferEmpty{true});
+            test.execute(BytesRead{3});
+            test.execute(RemainingCapacity{4});
+            test.execute(EndInput{});
+            test.execute(Eof{true});
+            test.execute(BytesRead{3});
+        }
+
     } catch (const exception &e) {
         cerr << "Exception: " << e.what() << endl;
         return EXIT_FAILURE;
@@ -0,0 +1,81 @@
+#include "byte_stream.hh"
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main() {
+    try {
+        {
+            ByteStreamTestHarness test{"chunked write-write-pop", 15, ByteStream::Mode::Chunked};
+
+            test.execute(Write{"cat"}.with_bytes_written(3));
+            test.execute(WriteBuffer{"tac"}.with_bytes_written(3));
+
+            test.execute(BytesWritten{6});
+            test.execute(RemainingCapacity{9});
+            test.execute(BufferSize{6});
+            test.execute(Peek{"cattac"});
+            test.execute(PeekBuffers{"cattac", 2});
+            test.execute(PeekBuffers{"catt", 2});
+            test.execute(PeekBuffers{"ca", 1});
+
+            test.execute(Pop{2});
+
+            test.execute(BytesRead{2});
+            test.execute(BufferSize{4});
+            test.execute(Peek{"ttac"});
+            test.execute(PeekBuffers{"ttac", 2});
+
+            test.execute(Pop{1});
+
+            test.execute(Peek{"tac"});
+            test.execute(PeekBuffers{"tac", 1});
+
+            test.execute(EndInput{});
+            test.execute(Pop{3});
+
+            test.execute(BufferEmpty{true});
+            test.execute(Eof{true});
+            test.execute(BytesRead{6});
+        }
+
+        {
+            ByteStreamTestHarness test{"chunked overwrite", 4, ByteStream::Mode::Chunked};
+
+            test.execute(WriteBuffer{"cat"}.with_bytes_written(3));
+            test.execute(WriteBuffer{"tac"}.with_bytes_written(1));
+            test.execute(WriteBuffer{"dog"}.with_bytes_written(0));
+
+            test.execute(RemainingCapacity{0});
+            test.execute(BufferSize{4});
+            test.execute(PeekBuffers{"catt", 2});
+
+            test.execute(Pop{3});
+            test.execute(Write{"god"}.with_bytes_written(3));
+
+            test.execute(Peek{"tgod"});
+            test.execute(PeekBuffers{"tgod", 2});
+            test.execute(PeekViews{"t", "god"});
+        }
+
+        {
+            ByteStreamTestHarness test{"ring peek_buffers", 4};
+
+            test.execute(Write{"cat"}.with_bytes_written(3));
+            test.execute(Pop{2});
+            test.execute(WriteBuffer{"tacs"}.with_bytes_written(3));
+
+            test.execute(Peek{"ttac"});
+            test.execute(PeekBuffers{"ttac", 1});
+            test.execute(PeekViews{"tt", "ac"});
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -45,11 +45,13 @@ void ByteStreamAction::execute(ByteStream &) const {}
 
 ByteStreamAction::~ByteStreamAction() {}
 
-ByteStreamTestHarness::ByteStreamTestHarness(const std::string &test_name, const size_t capacity)
-    : _test_name(test_name), _byte_stream(capacity) {
+ByteStreamTestHarness::ByteStreamTestHarness(const std::string &test_name,
+                                             const size_t capacity,
+                                             const ByteStream::Mode mode)
+    : _test_name(test_name), _byte_stream(capacity, mode) {
     std::ostringstream ss;
     ss << "Initialized with ("
-       << "capacity=" << capacity << ")";
+       << "capacity=" << capacity << ", mode=" << (mode == ByteStream::Mode::Ring ? "ring" : "chunked") << ")";
     _steps_executed.emplace_back(ss.str());
 }
 
@@ -97,6 +99,20 @@ void Write::execute(ByteStream &bs) const {
     }
 }
 
+// WriteBuffer
+WriteBuffer::WriteBuffer(const std::string &data) : _data(data) {}
+WriteBuffer &WriteBuffer::with_bytes_written(const size_t bytes_written) {
+    _bytes_written = bytes_written;
+    return *this;
+}
+std::string WriteBuffer::description() const { return "write Buffer \"" + _data + "\" to the stream"; }
+void WriteBuffer::execute(ByteStream &bs) const {
+    auto bytes_written = bs.write(Buffer(std::string(_data)));
+    if (_bytes_written and bytes_written != _bytes_written.value()) {
+        throw ByteStreamExpectationViolation::property("bytes_written", _bytes_written.value(), bytes_written);
+    }
+}
+
 // Pop
 Pop::Pop(const size_t len) : _len(len) {}
 std::string Pop::description() const { return "pop " + to_string(_len); }
@@ -182,3 +198,35 @@ void Peek::execute(ByteStream &bs) const {
                                              output + "\"");
     }
 }
+
+// PeekBuffers
+PeekBuffers::PeekBuffers(const std::string &output, const size_t buffer_count)
+    : _output(output), _buffer_count(buffer_count) {}
+std::string PeekBuffers::description() const {
+    return "\"" + _output + "\" in " + to_string(_buffer_count) + " Buffer(s) at the front of the stream";
+}
+void PeekBuffers::execute(ByteStream &bs) const {
+    const auto buffers = bs.peek_buffers(_output.size());
+    const auto output = buffers.concatenate();
+    if (output != _output) {
+        throw ByteStreamExpectationViolation("Expected \"" + _output + "\" at the front of the stream, but found \"" +
+                                             output + "\"");
+    }
+    if (buffers.buffers().size() != _buffer_count) {
+        throw ByteStreamExpectationViolation::property("buffer count", _buffer_count, buffers.buffers().size());
+    }
+}
+
+// PeekViews
+PeekViews::PeekViews(const std::string &first, const std::string &second) : _first(first), _second(second) {}
+std::string PeekViews::description() const {
+    return "\"" + _first + "\" and \"" + _second + "\" as the views at the front of the stream";
+}
+void PeekViews::execute(ByteStream &bs) const {
+    const auto views = bs.peek_views(_first.size() + _second.size());
+    if (views[0] != _first or views[1] != _second) {
+        throw ByteStreamExpectationViolation("Expected views \"" + _first + "\" and \"" + _second +
+                                             "\" at the front of the stream, but found \"" + std::string(views[0]) +
+                                             "\" and \"" + std::string(views[1]) + "\"");
+    }
+}
@@ -56,6 +56,16 @@ struct Write : public ByteStreamAction {
     void execute(ByteStream &) const override;
 };
 
+struct WriteBuffer : public ByteStreamAction {
+    std::string _data;
+    std::optional<size_t> _bytes_written{};
+
+    WriteBuffer(const std::string &data);
+    WriteBuffer &with_bytes_written(const size_t bytes_written);
+    std::string description() const override;
+    void execute(ByteStream &) const override;
+};
+
 struct Pop : public ByteStreamAction {
     size_t _len;
 
@@ -128,13 +138,33 @@ struct Peek : public ByteStreamExpectation {
     void execute(ByteStream &) const override;
 };
 
+struct PeekBuffers : public ByteStreamExpectation {
+    std::string _output;
+    size_t _buffer_count;
+
+    PeekBuffers(const std::string &output, const size_t buffer_count);
+    std::string description() const override;
+    void execute(ByteStream &) const override;
+};
+
+struct PeekViews : public ByteStreamExpectation {
+    std::string _first;
+    std::string _second;
+
+    PeekViews(const std::string &first, const std::string &second);
+    std::string description() const override;
+    void execute(ByteStream &) const override;
+};
+
 class ByteStreamTestHarness {
     std::string _test_name;
     ByteStream _byte_stream;
     std::vector<std::string> _steps_executed{};
 
   public:
-    ByteStreamTestHarness(const std::string &test_name, const size_t capacity);
+    ByteStreamTestHarness(const std::string &test_name,
+                          const size_t capacity,
+                          const ByteStream::Mode mode = ByteStream::Mode::Ring);
 
     void execute(const ByteStreamTestStep &step);
 };
@@ -0,0 +1,77 @@
+#include "eventloop.hh"
+#include "socket.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <utility>
+
+using namespace std;
+
+static pair<LocalStreamSocket, LocalStreamSocket> socket_pair() {
+    int fds[2];
+    SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_STREAM, 0, static_cast<int *>(fds)));
+    return {LocalStreamSocket{FileDescriptor{fds[0]}}, LocalStreamSocket{FileDescriptor{fds[1]}}};
+}
+
+int main() {
+    try {
+        // rules without an interest callback are cancelled when the peer closes, whichever their direction
+        {
+            EventLoop loop;
+            auto [a, b] = socket_pair();
+            string data;
+            unsigned cancelled = 0;
+            loop.add_rule(a, Direction::In, [&, &a = a] { data += a.read(); }, {}, [&] { cancelled++; });
+            loop.add_rule(a, Direction::Out, [&, &a = a] { a.write("never"); }, {}, [&] { cancelled++; });
+            b.write("bye");
+            b.close();
+            EventLoop::Result result;
+            while ((result = loop.wait_next_event(1000)) == EventLoop::Result::Success) {
+            }
+            test_should_be(result == EventLoop::Result::Exit, true);
+            test_should_be(data == "bye", true);
+            test_should_be(cancelled, 2U);
+        }
+
+        // a rule whose fd is closed elsewhere is cancelled, rather than waited on forever
+        {
+            EventLoop loop;
+            auto [a, b] = socket_pair();
+            bool cancelled = false;
+            loop.add_rule(a, Direction::In, [&, &a = a] { a.read(); }, {}, [&] { cancelled = true; });
+            test_should_be(loop.wait_next_event(0) == EventLoop::Result::Timeout, true);
+            a.close();
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Exit, true);
+            test_should_be(cancelled, true);
+        }
+
+        // a rule added on a reused fd number is registered, though the rule on the closed fd was not yet cancelled
+        {
+            EventLoop loop;
+            auto [a, b] = socket_pair();
+            bool cancelled = false;
+            loop.add_rule(a, Direction::In, [&, &a = a] { a.read(); }, {}, [&] { cancelled = true; });
+            const int fd_num = a.fd_num();
+            a.close();
+            b.close();
+            auto [c, d] = socket_pair();
+            test_should_be(c.fd_num(), fd_num);
+            string data;
+            loop.add_rule(c, Direction::In, [&, &c = c] { data += c.read(); });
+            test_should_be(cancelled, true);
+            d.write("hello");
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+            test_should_be(data == "hello", true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
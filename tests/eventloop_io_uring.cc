@@ -0,0 +1,137 @@
+#include "address.hh"
+#include "eventloop.hh"
+#include "socket.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+
+int main() {
+    try {
+        optional<EventLoop> maybe_loop{};
+        try {
+            maybe_loop.emplace(EventLoop::Backend::IoUring);
+        } catch (const unix_error &e) {
+            cerr << "skipping: " << e.what() << endl;
+            return EXIT_SUCCESS;
+        }
+        EventLoop &loop = *maybe_loop;
+
+        UDPSocket sender, receiver;
+        sender.bind(Address{"127.0.0.1", 0});
+        receiver.bind(Address{"127.0.0.1", 0});
+        vector<EventLoop::Datagram> received;
+        bool interested = true;
+        loop.add_datagram_rule(
+            receiver,
+            [&](vector<EventLoop::Datagram> &datagrams) {
+                for (auto &datagram : datagrams) {
+                    received.push_back(move(datagram));
+                }
+            },
+            [&] { return interested; });
+
+        // datagrams sent in one batch arrive in one wakeup, with their sender
+        for (const string payload : {"one", "two", "three"}) {
+            loop.send(sender, string{payload}, receiver.local_address());
+        }
+        while (received.size() < 3) {
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        }
+        test_should_be(received[0].payload == "one" and received[2].payload == "three", true);
+        test_should_be(received[1].source.value() == sender.local_address(), true);
+
+        // a datagram sent with sendto is received too, and so is one the size of the largest payload
+        sender.sendto(receiver.local_address(), string(65507, 'x'));
+        while (received.size() < 4) {
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        }
+        test_should_be(received[3].payload.size(), size_t{65507});
+
+        // while the rule is not interested, datagrams wait; then they are delivered
+        interested = false;
+        test_should_be(loop.wait_next_event(0) == EventLoop::Result::Exit, true);
+        sender.sendto(receiver.local_address(), string{"later"});
+        interested = true;
+        while (received.size() < 5) {
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        }
+        test_should_be(received[4].payload == "later", true);
+
+        // readiness rules work alongside, and are cancelled on EOF
+        int fds[2];
+        SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_STREAM, 0, static_cast<int *>(fds)));
+        LocalStreamSocket a{FileDescriptor{fds[0]}}, b{FileDescriptor{fds[1]}};
+        string data;
+        bool cancelled = false;
+        loop.add_rule(b, Direction::In, [&] { data += b.read(); }, {}, [&] { cancelled = true; });
+        a.write("hello");
+        test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        test_should_be(data == "hello", true);
+        test_should_be(loop.wait_next_event(0) == EventLoop::Result::Timeout, true);
+        a.shutdown(SHUT_WR);
+        test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        test_should_be(cancelled, true);
+
+        // a stream rule reads no more than its capacity, and is given an empty string at EOF
+        SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_STREAM, 0, static_cast<int *>(fds)));
+        LocalStreamSocket c{FileDescriptor{fds[0]}}, d{FileDescriptor{fds[1]}};
+        string from_c;
+        size_t capacity = 3;
+        bool eof = false;
+        loop.add_stream_rule(
+            d,
+            [&](string &bytes) {
+                eof = bytes.empty();
+                from_c += bytes;
+            },
+            [&] { return capacity - from_c.size(); });
+        c.write("hello");
+        while (from_c.size() < 3) {
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        }
+        test_should_be(loop.wait_next_event(0) == EventLoop::Result::Timeout, true);
+        test_should_be(from_c == "hel", true);
+        capacity = 16;
+        while (from_c.size() < 5) {
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        }
+        test_should_be(from_c == "hello", true);
+
+        // a write bigger than the socket's buffer goes out whole, in the order it was queued
+        const string big = string(1 << 20, 'z') + "end";
+        string to_c;
+        bool written = false;
+        loop.write(d, string{big}, [&] { written = true; });
+        loop.add_rule(c, Direction::In, [&] { to_c += c.read(); });
+        while (to_c.size() < big.size() or not written) {
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        }
+        test_should_be(to_c == big, true);
+
+        c.shutdown(SHUT_WR);
+        while (not eof) {
+            test_should_be(loop.wait_next_event(1000) == EventLoop::Result::Success, true);
+        }
+        test_should_be(from_c == "hello", true);
+
+        // sends still in progress are waited for when the loop goes away
+        for (unsigned i = 0; i < 100; i++) {
+            loop.send(sender, string(1000, 'y'), receiver.local_address());
+        }
+        maybe_loop.reset();
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -56,7 +56,7 @@ int main() {
         // test #1: in ESTABLISHED, send unacceptable segments and ACKs
         {
             cerr << "Test 1" << endl;
-            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg, base_seq - 1, base_seq - 1);
+            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg.with_fixed_timers(), base_seq - 1, base_seq - 1);
 
             // acceptable ack---no response
             test_1.send_ack(base_seq, base_seq);
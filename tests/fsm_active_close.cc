@@ -149,7 +149,7 @@ int main() {
 
         // test 6: start in ESTABLISHED, get FIN, get FIN re-tx, send FIN, get ACK, send ACK, time out
         {
-            TCPTestHarness test_6 = TCPTestHarness::in_established(cfg);
+            TCPTestHarness test_6 = TCPTestHarness::in_established(cfg.with_fixed_timers());
 
             test_6.execute(Close{});
             test_6.execute(Tick(1));
@@ -0,0 +1,139 @@
+#include "receive_budget.hh"
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        const WrappingInt32 isn(rd());
+        const WrappingInt32 peer_isn(rd());
+        const auto budget = make_shared<ReceiveBudget>(6000);
+        const auto data = [&](const WrappingInt32 seqno, string &&payload) {
+            return SendSegment{}.with_ack(true).with_seqno(seqno).with_ackno(isn + 1).with_win(60000).with_data(
+                move(payload));
+        };
+
+        TCPConfig cfg;
+        cfg.fixed_isn = isn;
+        cfg.ack_delay = 0;
+        cfg.recv_capacity = 4000;
+        cfg.recv_capacity_max = 64000;
+        cfg.recv_budget = budget;
+
+        // test 1: the receive buffer grows with what arrives in an RTT, within the budget, and shrinks when idle
+        {
+            TCPTestHarness test_1(cfg);
+            test_1.execute(Connect{});
+            test_1.execute(ExpectOneSegment{}.with_syn(true).with_seqno(isn));
+
+            // the handshake gives a 10 ms RTT
+            test_1.execute(Tick(10));
+            test_1.execute(
+                SendSegment{}.with_syn(true).with_ack(true).with_seqno(peer_isn).with_ackno(isn + 1).with_win(60000));
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 1).with_win(4000));
+            test_1.execute(ExpectState{State::ESTABLISHED});
+
+            // a full window arrives within one RTT: the capacity doubles, and the peer hears of it at once
+            WrappingInt32 next = peer_isn + 1;
+            string expected;
+            for (char c = 'a'; c < 'e'; c++, next = next + 1000) {
+                test_1.execute(data(next, string(1000, c)));
+                test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next + 1000));
+                expected += string(1000, c);
+            }
+            test_1.execute(ExpectData{}.with_data(expected));
+            test_1.execute(Tick(10));
+            test_1.execute(ExpectReceiveCapacity{8000}, "test 1 failed: a full window in one RTT should double it");
+            test_err_if(budget->used() != 4000, "test 1 failed: the growth was not taken from the budget");
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next).with_win(8000),
+                           "test 1 failed: the bigger window should be advertised at once");
+
+            // a hole, and more than the window's worth of data past it in one RTT: growing again moves the
+            // held bytes into the bigger buffer, but stops at the budget
+            test_1.execute(data(next, string(1000, 'e')));
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next + 1000));
+            test_1.execute(ExpectData{}.with_data(string(1000, 'e')));
+            for (char c = 'g'; c < 'l'; c++) {
+                test_1.execute(data(next + 1000 * (c - 'e'), string(1000, c)));
+                test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next + 1000));
+            }
+            test_1.execute(Tick(10));
+            test_1.execute(ExpectReceiveCapacity{10000}, "test 1 failed: growth should stop at the budget");
+            test_err_if(budget->used() != 6000, "test 1 failed: the whole budget should be in use");
+            test_1.execute(ExpectNoSegment{});
+            test_1.execute(data(next + 1000, string(1000, 'f')));
+            next = next + 7000;
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next).with_win(4000),
+                           "test 1 failed: filling the hole should deliver the held bytes");
+
+            // the window just advertised is not taken back while the data is still unread
+            test_1.execute(Tick(10));
+            test_1.execute(ExpectReceiveCapacity{10000}, "test 1 failed: the buffer shrank under unread data");
+            expected.clear();
+            for (char c = 'f'; c < 'l'; c++) {
+                expected += string(1000, c);
+            }
+            test_1.execute(ExpectData{}.with_data(expected));
+
+            // an idle RTT halves the buffer
+            test_1.execute(Tick(10));
+            test_1.execute(ExpectReceiveCapacity{5000}, "test 1 failed: an idle RTT should halve the buffer");
+            test_err_if(budget->used() != 1000, "test 1 failed: the shrunk buffer should go back to the budget");
+            test_1.execute(Tick(10));
+            test_1.execute(ExpectReceiveCapacity{5000});
+            test_1.execute(ExpectNoSegment{});
+        }
+        // and everything goes back to it when the connection is gone
+        test_err_if(budget->used() != 0, "test 1 failed: the connection's buffer was not given back");
+
+        // test 2: a reader that keeps up lets the capacity double each RTT until recv_capacity_max, and no further
+        cfg.recv_capacity_max = 10000;
+        cfg.recv_budget = make_shared<ReceiveBudget>(1 << 20);
+        {
+            TCPTestHarness test_2(cfg);
+            test_2.execute(Connect{});
+            test_2.execute(ExpectOneSegment{}.with_syn(true).with_seqno(isn));
+            test_2.execute(Tick(10));
+            test_2.execute(
+                SendSegment{}.with_syn(true).with_ack(true).with_seqno(peer_isn).with_ackno(isn + 1).with_win(60000));
+            test_2.execute(ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 1));
+
+            WrappingInt32 next = peer_isn + 1;
+            for (const size_t expected : {8000, 10000, 10000, 10000}) {
+                const size_t window = test_2._fsm.receive_capacity();
+                for (size_t sent = 0; sent < window; sent += 1000, next = next + 1000) {
+                    test_2.execute(data(next, string(1000, 'x')));
+                    test_2.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next + 1000));
+                }
+                test_2.execute(ExpectData{}.with_data(string(window, 'x')));
+                test_2.execute(Tick(10));
+                test_2.execute(ExpectReceiveCapacity{expected}, "test 2 failed: wrong capacity after an RTT");
+                while (test_2.can_read()) {
+                    test_2.expect_seg(ExpectSegment{}.with_ack(true).with_ackno(next));
+                }
+            }
+            test_2.execute(data(next, string(1000, 'x')));
+            test_2.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next + 1000).with_win(9000),
+                           "test 2 failed: the window should stay at recv_capacity_max");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
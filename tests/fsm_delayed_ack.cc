@@ -0,0 +1,120 @@
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        const size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+        // test 1: a receiver delays its pure ACKs, except where the peer is waiting on one
+        {
+            const WrappingInt32 isn(rd());
+            const WrappingInt32 peer_isn(rd());
+            TCPConfig cfg{};
+            cfg.fixed_isn = isn;
+            cfg.ack_delay = 40;
+            TCPTestHarness test_1(cfg);
+            const auto data = [&](const WrappingInt32 seqno, string &&payload) {
+                return SendSegment{}.with_ack(true).with_seqno(seqno).with_ackno(isn + 1).with_win(60000).with_data(
+                    move(payload));
+            };
+
+            test_1.execute(Connect{});
+            test_1.execute(ExpectOneSegment{}.with_syn(true).with_seqno(isn));
+
+            // the SYN is acknowledged at once
+            test_1.execute(
+                SendSegment{}.with_syn(true).with_ack(true).with_seqno(peer_isn).with_ackno(isn + 1).with_win(60000));
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 1),
+                           "test 1 failed: the SYN should be acknowledged at once");
+            test_1.execute(ExpectState{State::ESTABLISHED});
+
+            // every second full segment is acknowledged at once
+            WrappingInt32 next = peer_isn + 1;
+            test_1.execute(data(next, string(MSS, 'a')));
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: a lone full segment should wait for the next");
+            test_1.execute(data(next + MSS, string(MSS, 'b')));
+            next = next + 2 * MSS;
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next),
+                           "test 1 failed: the second full segment should be acknowledged at once");
+
+            // a lone segment waits for the timer
+            test_1.execute(data(next, "abc"));
+            next = next + 3;
+            test_1.execute(ExpectNextDeadline{40});
+            test_1.execute(Tick(39));
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: ACK sent before the delay ran out");
+            test_1.execute(ExpectNextDeadline{1});
+            test_1.execute(Tick(1));
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next).with_payload_size(0),
+                           "test 1 failed: the delayed ACK should be sent when its timer fires");
+            test_1.execute(ExpectNextDeadline{nullopt});
+
+            // outgoing data carries the pending ACK, so the timer has nothing left to send
+            test_1.execute(data(next, "def"));
+            next = next + 3;
+            test_1.execute(Write{"reply"});
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next).with_data("reply"),
+                           "test 1 failed: the reply should carry the ACK");
+            test_err_if(not test_1._fsm.next_deadline().has_value(), "test 1 failed: the reply is not timed");
+            test_1.execute(Tick(40));
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: the ACK the reply carried was sent again");
+            test_1.execute(data(next, "").with_ackno(isn + 6));
+
+            // out-of-order data, and the segment that fills the hole, are acknowledged at once
+            test_1.execute(data(next + 3, "jkl").with_ackno(isn + 6));
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next),
+                           "test 1 failed: out-of-order data should be acknowledged at once");
+            test_1.execute(data(next, "ghi").with_ackno(isn + 6));
+            next = next + 6;
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next),
+                           "test 1 failed: the segment that fills the hole should be acknowledged at once");
+
+            // a batch of in-order data shares one ACK, which still waits for the timer if the batch is small
+            test_1.execute(
+                SendSegments{{data(next, "pqr").with_ackno(isn + 6), data(next + 3, "stu").with_ackno(isn + 6)}});
+            next = next + 6;
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: a small batch should wait for the timer");
+            test_1.execute(Tick(40));
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next),
+                           "test 1 failed: the small batch should be acknowledged when the timer fires");
+            vector<SendSegment> batch;
+            for (char c = 'a'; c < 'd'; c++, next = next + MSS) {
+                batch.push_back(data(next, string(MSS, c)).with_ackno(isn + 6));
+            }
+            test_1.execute(SendSegments{move(batch)});
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next),
+                           "test 1 failed: a batch of full segments should share one ACK, sent at once");
+
+            // so is a FIN
+            test_1.execute(data(next, "mno").with_ackno(isn + 6).with_fin(true));
+            next = next + 4;
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next),
+                           "test 1 failed: a FIN should be acknowledged at once");
+
+            test_err_if(test_1._fsm.acks_delayed() != 4, "test 1 failed: wrong number of delayed ACKs");
+            test_err_if(test_1._fsm.pure_acks_sent() != 8, "test 1 failed: wrong number of pure ACKs");
+            test_err_if(test_1._fsm.segments_sent() != 10, "test 1 failed: wrong number of segments sent");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,294 @@
+#include "address.hh"
+#include "flat_hash_map.hh"
+#include "ipv4_datagram.hh"
+#include "parser.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_demux.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+#include "wrapping_integers.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! Serialize everything `from` has to send and parse it back in at `to`, as a network would
+static size_t deliver(TCPDemux &from, TCPDemux &to) {
+    vector<InternetDatagram> dgrams;
+    from.drain_datagrams_out(dgrams);
+    for (const auto &dgram : dgrams) {
+        InternetDatagram parsed;
+        test_should_be(parsed.parse(dgram.serialize().concatenate()) == ParseResult::NoError, true);
+        to.datagram_received(parsed);
+    }
+    return dgrams.size();
+}
+
+static void exchange(TCPDemux &a, TCPDemux &b) {
+    while (deliver(a, b) + deliver(b, a) > 0) {
+    }
+}
+
+static void test_map() {
+    FlatHashMap<uint32_t, uint32_t> map;
+    for (uint32_t i = 0; i < 5000; i++) {
+        test_should_be(map.try_emplace(i, i * 3).second, true);
+    }
+    test_should_be(map.try_emplace(7, 0).second, false);
+    for (uint32_t i = 1; i < 5000; i += 2) {
+        test_should_be(map.erase(i), true);
+    }
+    test_should_be(map.erase(1), false);
+    test_should_be(map.size(), size_t{2500});
+    for (uint32_t i = 0; i < 5000; i++) {
+        const uint32_t *value = map.find(i);
+        test_should_be(value != nullptr, i % 2 == 0);
+        if (value) {
+            test_should_be(*value, i * 3);
+        }
+    }
+    uint64_t sum = 0;
+    for (const auto &[key, value] : map) {
+        sum += value - key * 3;
+    }
+    test_should_be(sum, uint64_t{0});
+}
+
+//! A listener that answers every SYN with a cookie keeps no state until the handshake completes
+static void test_syn_cookies(const uint32_t server_ip, const uint32_t client_ip) {
+    TCPConfig cfg;
+    TCPDemux server{cfg}, client{cfg};
+    server.listen(80, 8, TCPDemux::SynCookies::Always);
+
+    const FourTuple tuple{client_ip, server_ip, 1000, 80};
+    client.connect(tuple);
+    deliver(client, server);
+    test_should_be(server.size(), size_t{0});
+    test_should_be(server.syn_cookies_sent(), uint64_t{1});
+
+    // the ACK of the cookie creates the connection, ready to accept
+    deliver(server, client);
+    client.find(tuple)->write("request");
+    deliver(client, server);
+    test_should_be(server.syn_cookies_accepted(), uint64_t{1});
+    const auto accepted = server.accept(80);
+    test_should_be(accepted.has_value(), true);
+    test_should_be(server.find(*accepted)->inbound_stream().read(100) == "request", true);
+    server.find(*accepted)->write("response");
+    exchange(server, client);
+    test_should_be(client.find(tuple)->inbound_stream().read(100) == "response", true);
+
+    // an ACK that acknowledges no cookie is reset
+    const FourTuple forged{client_ip, server_ip, 1001, 80};
+    TCPSegment ack;
+    ack.header().ack = true;
+    ack.header().seqno = WrappingInt32{12345};
+    ack.header().ackno = WrappingInt32{67890};
+    server.segment_received(forged.reversed(), ack);
+    test_should_be(server.size(), size_t{1});
+    vector<pair<FourTuple, TCPSegment>> out;
+    server.drain_segments_out(out);
+    test_should_be(out.size(), size_t{1});
+    test_should_be(out.front().second.header().rst, true);
+
+    // cookies expire after two clock periods
+    client.connect({client_ip, server_ip, 1002, 80});
+    deliver(client, server);
+    deliver(server, client);
+    server.tick(2 * TCPDemux::COOKIE_PERIOD_MS);
+    deliver(client, server);
+    test_should_be(server.syn_cookies_accepted(), uint64_t{1});
+    test_should_be(server.size(), size_t{1});
+}
+
+//! The first connection to a server fetches a Fast Open cookie; the next one sends its request in the SYN
+static void test_fast_open(const uint32_t server_ip, const uint32_t client_ip) {
+    TCPConfig cfg;
+    cfg.fast_open = true;
+    TCPDemux server{cfg}, client{cfg};
+    server.listen(80);
+
+    const FourTuple first{client_ip, server_ip, 1000, 80};
+    client.connect(first, "first");
+    vector<pair<FourTuple, TCPSegment>> out;
+    client.drain_segments_out(out);
+    test_should_be(out.size(), size_t{1});
+    test_should_be(out.front().second.header().fastopen == string{}, true);
+    test_should_be(out.front().second.payload().size(), size_t{0});
+    server.segment_received(first.reversed(), out.front().second);
+    exchange(server, client);
+    test_should_be(server.find(*server.accept(80))->inbound_stream().read(100) == "first", true);
+    test_should_be(server.fast_open_accepted(), uint64_t{0});
+
+    // the request is in the SYN, so the server can answer before the handshake completes
+    const FourTuple second{client_ip, server_ip, 1001, 80};
+    client.connect(second, "second");
+    deliver(client, server);
+    test_should_be(server.fast_open_accepted(), uint64_t{1});
+    const auto accepted = server.accept(80);
+    test_should_be(accepted.has_value(), true);
+    test_should_be(server.find(*accepted)->inbound_stream().read(100) == "second", true);
+    server.find(*accepted)->write("reply");
+    deliver(server, client);
+    test_should_be(client.find(second)->inbound_stream().read(100) == "reply", true);
+
+    // data in a SYN with a wrong cookie is not acknowledged, and the client sends it again at once
+    TCPConfig forged_cfg = cfg;
+    forged_cfg.fast_open_cookie = string(8, 'x');
+    TCPConnection forged{forged_cfg};
+    forged.write("third");
+    const FourTuple third{client_ip, server_ip, 1002, 80};
+    const TCPSegment syn = forged.segments_out().front();
+    forged.segments_out().pop();
+    test_should_be(syn.payload().str() == "third", true);
+    server.segment_received(third.reversed(), syn);
+    out.clear();
+    server.drain_segments_out(out);
+    test_should_be(out.size(), size_t{1});
+    test_should_be(out.front().second.header().ackno == syn.header().seqno + 1, true);
+    test_should_be(server.fast_open_accepted(), uint64_t{1});
+    forged.segment_received(out.front().second);
+    test_should_be(forged.segments_out().front().payload().str() == "third", true);
+    server.segment_received(third.reversed(), forged.segments_out().front());
+    test_should_be(server.find(*server.accept(80))->inbound_stream().read(100) == "third", true);
+}
+
+//! A client remembers the cookies of at most MAX_FAST_OPEN_COOKIES servers, forgetting the oldest first
+static void test_fast_open_cookie_cap(const uint32_t server_ip, const uint32_t client_ip) {
+    TCPConfig cfg;
+    cfg.fast_open = true;
+    cfg.compact_time_wait = true;
+    TCPDemux server{cfg}, client{cfg};
+    server.listen(80);
+
+    // each connection is closed once it has fetched its cookie, so that only the cookies remain
+    const uint32_t servers = TCPDemux::MAX_FAST_OPEN_COOKIES + 1;
+    for (uint32_t i = 0; i < servers; i++) {
+        const FourTuple tuple{client_ip, server_ip + i, 1000, 80};
+        client.connect(tuple);
+        exchange(client, server);
+        const auto accepted = server.accept(80);
+        test_should_be(accepted.has_value(), true);
+        client.find(tuple)->end_input_stream();
+        exchange(client, server);
+        server.find(*accepted)->end_input_stream();
+        exchange(client, server);
+        client.tick(1);
+        server.tick(1);
+        test_should_be(client.size() + server.size(), size_t{0});
+        test_should_be(client.fast_open_cookies(), min(size_t{i} + 1, TCPDemux::MAX_FAST_OPEN_COOKIES));
+    }
+
+    // the first server was forgotten, so its request waits for the handshake; the last one's goes in the SYN
+    vector<pair<FourTuple, TCPSegment>> out;
+    client.connect({client_ip, server_ip, 1001, 80}, "forgotten");
+    client.connect({client_ip, server_ip + servers - 1, 1001, 80}, "remembered");
+    client.drain_segments_out(out);
+    test_should_be(out.size(), size_t{2});
+    for (const auto &[tuple, seg] : out) {
+        test_should_be(seg.payload().str() == (tuple.remote_address == server_ip ? "" : "remembered"), true);
+        server.segment_received(tuple.reversed(), seg);
+    }
+    exchange(client, server);
+}
+
+int main() {
+    try {
+        test_map();
+        test_syn_cookies(Address("10.0.0.1").ipv4_numeric(), Address("10.0.0.2").ipv4_numeric());
+        test_fast_open(Address("10.0.0.1").ipv4_numeric(), Address("10.0.0.2").ipv4_numeric());
+        test_fast_open_cookie_cap(Address("10.0.0.1").ipv4_numeric(), Address("10.0.0.2").ipv4_numeric());
+
+        const uint32_t server_ip = Address("10.0.0.1").ipv4_numeric();
+        const uint32_t client_ip = Address("10.0.0.2").ipv4_numeric();
+        TCPConfig cfg;
+        TCPDemux server{cfg}, client{cfg};
+        server.listen(80, 2, TCPDemux::SynCookies::Off);
+
+        // three clients connect, but only two fit in the backlog
+        for (uint16_t port = 1000; port < 1003; port++) {
+            client.connect({client_ip, server_ip, port, 80});
+        }
+        exchange(client, server);
+        test_should_be(server.size(), size_t{2});
+        test_should_be(server.syns_dropped(), uint64_t{1});
+
+        vector<FourTuple> accepted;
+        for (auto tuple = server.accept(80); tuple; tuple = server.accept(80)) {
+            accepted.push_back(*tuple);
+        }
+        test_should_be(accepted.size(), size_t{2});
+
+        // the third SYN is retransmitted and gets in now that the backlog has room
+        client.tick(cfg.rt_timeout);
+        exchange(client, server);
+        const auto third = server.accept(80);
+        test_should_be(third.has_value(), true);
+        accepted.push_back(*third);
+
+        // each connection carries its own data
+        for (const FourTuple &tuple : accepted) {
+            server.find(tuple)->write("hello " + to_string(tuple.remote_port));
+            server.find(tuple)->end_input_stream();
+        }
+        exchange(server, client);
+        for (uint16_t port = 1000; port < 1003; port++) {
+            TCPConnection *conn = client.find({client_ip, server_ip, port, 80});
+            test_should_be(conn->inbound_stream().read(100) == "hello " + to_string(port), true);
+            test_should_be(conn->inbound_stream().eof(), true);
+            conn->end_input_stream();
+        }
+        vector<pair<FourTuple, TCPSegment>> fins;
+        client.drain_segments_out(fins);
+        for (const auto &[tuple, seg] : fins) {
+            server.segment_received(tuple.reversed(), seg);
+        }
+        exchange(client, server);
+
+        // a segment for no connection and no listener is answered with a RST
+        client.connect({client_ip, server_ip, 2000, 81});
+        deliver(client, server);
+        test_should_be(server.size(), size_t{3});
+        deliver(server, client);
+        test_should_be(client.find({client_ip, server_ip, 2000, 81})->active(), false);
+
+        // finished connections leave the tables; the server closed first, so it lingers in TIME_WAIT
+        server.tick(1);
+        client.tick(1);
+        test_should_be(client.size(), size_t{0});
+        test_should_be(server.size(), size_t{0});
+        test_should_be(server.time_wait_size(), size_t{3});
+
+        // a retransmitted FIN is ACKed again from the TIME_WAIT table, and a RST does not end the wait
+        const auto &[fin_tuple, fin] = fins.front();
+        test_should_be(fin.header().fin, true);
+        server.segment_received(fin_tuple.reversed(), fin);
+        vector<pair<FourTuple, TCPSegment>> out;
+        server.drain_segments_out(out);
+        test_should_be(out.size(), size_t{1});
+        test_should_be(out.front().second.header().ack, true);
+        test_should_be(out.front().second.header().ackno == fin.header().seqno + 1, true);
+        test_should_be(out.front().second.header().seqno == fin.header().ackno, true);
+        TCPSegment rst;
+        rst.header().rst = true;
+        rst.header().seqno = fin.header().seqno + 1;
+        server.segment_received(fin_tuple.reversed(), rst);
+        test_should_be(server.time_wait_size(), size_t{3});
+        server.tick(10 * cfg.rt_timeout);
+        test_should_be(server.time_wait_size(), size_t{0});
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include "stream_reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        const WrappingInt32 isn(rd());
+        const WrappingInt32 peer_isn(rd());
+        const auto seg = [&](const WrappingInt32 seqno, const WrappingInt32 ackno, string &&payload) {
+            return SendSegment{}.with_ack(true).with_seqno(seqno).with_ackno(ackno).with_win(60000).with_data(
+                move(payload));
+        };
+        const SendSegment syn_ack =
+            SendSegment{}.with_syn(true).with_ack(true).with_seqno(peer_isn).with_ackno(isn + 1).with_win(60000);
+
+        TCPConfig cfg;
+        cfg.fixed_isn = isn;
+        cfg.ack_delay = 0;
+        cfg.window_scaling = false;
+        cfg.timestamps = false;
+
+        // test 1: in-order data and pure ACKs take the fast path; anything else takes the full one
+        {
+            TCPTestHarness test_1(cfg);
+            test_1.execute(Connect{});
+            test_1.execute(ExpectOneSegment{}.with_syn(true).with_seqno(isn));
+
+            // the handshake takes the full path
+            test_1.execute(syn_ack);
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 1));
+            test_1.execute(ExpectState{State::ESTABLISHED});
+            test_err_if(test_1._fsm.predicted_segments() != 0, "test 1 failed: the SYN/ACK was predicted");
+
+            // in-order data is predicted, and still acknowledged and delivered
+            WrappingInt32 next = peer_isn + 1;
+            test_1.execute(seg(next, isn + 1, "abc"));
+            next = next + 3;
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next));
+            test_1.execute(seg(next, isn + 1, "def"));
+            next = next + 3;
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next));
+            test_err_if(test_1._fsm.predicted_segments() != 2, "test 1 failed: in-order data was not predicted");
+            test_1.execute(ExpectData{}.with_data("abcdef"));
+
+            // so is a pure ACK for our data
+            test_1.execute(Write{"hello"});
+            test_1.execute(ExpectOneSegment{}.with_data("hello"));
+            test_1.execute(seg(next, isn + 6, ""));
+            test_1.execute(ExpectNoSegment{});
+            test_1.execute(ExpectBytesInFlight{0});
+            test_err_if(test_1._fsm.predicted_segments() != 3, "test 1 failed: the pure ACK was not predicted");
+
+            // a changed window, out-of-order data, and a FIN all take the full path
+            test_1.execute(Write{"world"});
+            test_1.execute(ExpectOneSegment{}.with_data("world"));
+            test_1.execute(seg(next, isn + 11, "").with_win(30000));
+            test_1.execute(ExpectNoSegment{});
+            test_1.execute(seg(next + 3, isn + 11, "jkl").with_win(30000));
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next));
+            test_1.execute(seg(next, isn + 11, "ghi").with_win(30000));
+            next = next + 6;
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next));
+            test_1.execute(seg(next, isn + 11, "").with_win(30000).with_fin(true));
+            next = next + 1;
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(next));
+            test_err_if(test_1._fsm.predicted_segments() != 3, "test 1 failed: a full-path segment was predicted");
+            test_1.execute(ExpectData{}.with_data("ghijkl"));
+            test_err_if(not test_1._fsm.inbound_stream().eof(), "test 1 failed: the FIN did not end the stream");
+        }
+
+        // test 2: a FIN that arrives before a hole is filled: the segment filling it ends the stream and is ACKed
+        // together with the FIN
+        {
+            TCPTestHarness test_2(cfg);
+            test_2.execute(Connect{});
+            test_2.execute(ExpectOneSegment{}.with_syn(true).with_seqno(isn));
+            test_2.execute(syn_ack);
+            test_2.execute(ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 1));
+            test_2.execute(seg(peer_isn + 4, isn + 1, "").with_fin(true));
+            test_2.execute(ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 1));
+            test_2.execute(seg(peer_isn + 1, isn + 1, "abc"));
+            test_2.execute(ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 5),
+                           "test 2 failed: the data and the FIN should be ACKed together");
+            test_err_if(test_2._fsm.predicted_segments() != 0, "test 2 failed: the hole's filler was predicted");
+            test_2.execute(ExpectData{}.with_data("abc"));
+            test_err_if(not test_2._fsm.inbound_stream().eof(), "test 2 failed: the early FIN did not end the stream");
+        }
+
+        // the reassembler's in-order shortcut also ends the stream at an end seen earlier
+        {
+            StreamReassembler reassembler{16};
+            reassembler.push_substring(string{"c"}, 2, true);
+            reassembler.push_substring(string{"ab"}, 0, false);
+            test_should_be(reassembler.stream_out().input_ended(), true);
+
+            StreamReassembler shortcut{16};
+            shortcut.push_substring(string{}, 3, true);
+            test_should_be(shortcut.push_in_order("abcdef"), size_t{3});
+            test_should_be(shortcut.stream_out().input_ended(), true);
+            test_should_be(shortcut.stream_out().read(16) == "abc", true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
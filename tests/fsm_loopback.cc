@@ -29,7 +29,8 @@ int main() {
         // loop segments back into the same FSM
         for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
             const WrappingInt32 rx_offset(rd());
-            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg, rx_offset - 1, rx_offset - 1);
+            TCPTestHarness test_1 =
+                TCPTestHarness::in_established(cfg.with_fixed_timers(), rx_offset - 1, rx_offset - 1);
             test_1.send_ack(rx_offset, rx_offset, 65000);
 
             string d(cfg.recv_capacity, 0);
@@ -33,7 +33,7 @@ int main() {
 
         // test #2: start in CLOSE_WAIT, close(), throw away first FIN, ack re-tx FIN
         {
-            TCPTestHarness test_2 = TCPTestHarness::in_close_wait(cfg);
+            TCPTestHarness test_2 = TCPTestHarness::in_close_wait(cfg.with_fixed_timers());
 
             test_2.execute(Tick(4 * cfg.rt_timeout));
 
@@ -34,7 +34,7 @@ int main() {
         for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
             const WrappingInt32 rx_isn(rd());
             const WrappingInt32 tx_isn(rd());
-            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg.with_fixed_timers(), tx_isn, rx_isn);
             vector<tuple<size_t, size_t>> seq_size;
             size_t datalen = 0;
             while (datalen < cfg.recv_capacity) {
@@ -75,7 +75,7 @@ int main() {
         for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
             WrappingInt32 rx_isn(rd());
             WrappingInt32 tx_isn(rd());
-            TCPTestHarness test_2 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+            TCPTestHarness test_2 = TCPTestHarness::in_established(cfg.with_fixed_timers(), tx_isn, rx_isn);
 
             vector<tuple<size_t, size_t>> seq_size;
             size_t datalen = 0;
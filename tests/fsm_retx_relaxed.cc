@@ -27,7 +27,7 @@ int main() {
         // single segment re-transmit
         {
             WrappingInt32 tx_ackno(rd());
-            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg, tx_ackno - 1, tx_ackno - 1);
+            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg.with_fixed_timers(), tx_ackno - 1, tx_ackno - 1);
 
             string data = "asdf";
             test_1.execute(Write{data});
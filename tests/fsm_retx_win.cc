@@ -19,7 +19,7 @@ int main() {
         // multiple segments with intervening ack
         {
             WrappingInt32 tx_ackno(rd());
-            TCPTestHarness test_2 = TCPTestHarness::in_established(cfg, tx_ackno - 1, tx_ackno - 1);
+            TCPTestHarness test_2 = TCPTestHarness::in_established(cfg.with_fixed_timers(), tx_ackno - 1, tx_ackno - 1);
 
             string d1 = "asdf";
             string d2 = "qwer";
@@ -53,7 +53,7 @@ int main() {
         // multiple segments without intervening ack
         {
             WrappingInt32 tx_ackno(rd());
-            TCPTestHarness test_3 = TCPTestHarness::in_established(cfg, tx_ackno - 1, tx_ackno - 1);
+            TCPTestHarness test_3 = TCPTestHarness::in_established(cfg.with_fixed_timers(), tx_ackno - 1, tx_ackno - 1);
 
             string d1 = "asdf";
             string d2 = "qwer";
@@ -83,7 +83,7 @@ int main() {
         // check that ACK of new data resets exponential backoff and restarts timer
         auto backoff_test = [&](const unsigned int num_backoffs) {
             WrappingInt32 tx_ackno(rd());
-            TCPTestHarness test_4 = TCPTestHarness::in_established(cfg, tx_ackno - 1, tx_ackno - 1);
+            TCPTestHarness test_4 = TCPTestHarness::in_established(cfg.with_fixed_timers(), tx_ackno - 1, tx_ackno - 1);
 
             string d1 = "asdf";
             string d2 = "qwer";
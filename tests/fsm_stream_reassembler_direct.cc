@@ -0,0 +1,105 @@
+#include "byte_stream.hh"
+#include "stream_reassembler.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static constexpr unsigned NREPS = 64;
+static constexpr unsigned NSEGS = 2048;
+
+// Push random, overlapping, partly out-of-window segments into both reassembler modes with a
+// small capacity (so the ring buffer wraps many times) and check they agree byte for byte.
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        // bytes past the end of the stream are not placed, so the stream's count stays in step
+        {
+            StreamReassembler direct{16, StreamReassembler::Mode::DirectPlacement};
+            direct.push_substring(string{"c"}, 2, true);
+            direct.push_substring(string{"abcyz"}, 0, false);
+            direct.push_substring(string{"ghi"}, 6, false);
+            direct.push_substring(string{"fgh"}, 5, true);
+            if (direct.stream_out().bytes_written() != 3 or direct.first_unassembled() != 3 or
+                not direct.stream_out().input_ended() or direct.unassembled_bytes() != 0) {
+                throw runtime_error("bytes past the end of the stream were placed");
+            }
+            if (direct.stream_out().read(16) != "abc") {
+                throw runtime_error("reassembled bytes are incorrect");
+            }
+
+            ByteStream stream{8};
+            stream.write_ahead(0, "xy");
+            stream.end_input();
+            bool threw = false;
+            try {
+                stream.commit(2);
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            if (not threw or stream.bytes_written() != 0) {
+                throw runtime_error("commit() after end_input() did not throw");
+            }
+        }
+
+        for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
+            const size_t capacity = 1 + rd() % 300;
+            StreamReassembler intervals{capacity, StreamReassembler::Mode::Intervals};
+            StreamReassembler direct{capacity, StreamReassembler::Mode::DirectPlacement};
+
+            const size_t total = 20 * capacity + rd() % 1000;
+            string d(total, 0);
+            generate(d.begin(), d.end(), [&] { return rd(); });
+
+            string out_intervals, out_direct;
+            for (unsigned i = 0; i < NSEGS && !direct.stream_out().input_ended(); ++i) {
+                const size_t base = direct.first_unassembled();
+                const size_t off = min(total - 1, base + rd() % (capacity + 16));
+                const size_t len = min(total - off, size_t(rd() % (capacity + 1)));
+                const bool eof = off + len == total;
+                intervals.push_substring(d.substr(off, len), off, eof);
+                direct.push_substring(d.substr(off, len), off, eof);
+
+                if (direct.unassembled_bytes() != intervals.unassembled_bytes()) {
+                    throw runtime_error("unassembled_bytes differs between modes");
+                }
+                if (direct.empty() != intervals.empty()) {
+                    throw runtime_error("empty() differs between modes");
+                }
+                if (direct.stream_out().buffer_size() != intervals.stream_out().buffer_size()) {
+                    throw runtime_error("buffer_size differs between modes");
+                }
+                if (rd() % 3 == 0) {
+                    const size_t n = rd() % (direct.stream_out().buffer_size() + 1);
+                    out_intervals += intervals.stream_out().read(n);
+                    out_direct += direct.stream_out().read(n);
+                }
+            }
+            out_intervals += intervals.stream_out().read(intervals.stream_out().buffer_size());
+            out_direct += direct.stream_out().read(direct.stream_out().buffer_size());
+
+            if (out_direct != out_intervals) {
+                throw runtime_error("reassembled bytes differ between modes");
+            }
+            if (out_direct != d.substr(0, out_direct.size())) {
+                throw runtime_error("reassembled bytes are incorrect");
+            }
+            if (direct.stream_out().input_ended() != intervals.stream_out().input_ended()) {
+                throw runtime_error("input_ended differs between modes");
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+//! Expect one segment and check the timestamps it carries
+static TCPSegment expect_ts(TCPTestHarness &test, ExpectSegment exp, const uint32_t tsval, const uint32_t tsecr) {
+    TCPSegment seg = test.expect_seg(exp, "segment missing");
+    test_err_if(not seg.header().timestamps.has_value(), "segment carries no timestamps");
+    test_err_if(seg.header().timestamps.value().tsval != tsval, "wrong TSval");
+    test_err_if(seg.header().timestamps.value().tsecr != tsecr, "wrong TSecr");
+    return seg;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        TCPConfig cfg{};
+
+        // test 1: active open with timestamps, echoing and PAWS
+        {
+            const WrappingInt32 isn(rd());
+            const WrappingInt32 peer_isn(rd());
+            TCPConfig c{cfg};
+            c.fixed_isn = isn;
+            TCPTestHarness test_1(c.with_fixed_timers());
+
+            test_1.execute(Connect{});
+            expect_ts(test_1, ExpectOneSegment{}.with_syn(true).with_seqno(isn), 0, 0);
+
+            test_1.execute(Tick(20));
+            test_1.execute(SendSegment{}
+                               .with_syn(true)
+                               .with_ack(true)
+                               .with_seqno(peer_isn)
+                               .with_ackno(isn + 1)
+                               .with_win(1000)
+                               .with_timestamps(1000, 0));
+            expect_ts(test_1, ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 1), 20, 1000);
+            test_1.execute(ExpectState{State::ESTABLISHED});
+            test_err_if(test_1._fsm.srtt() != 20, "SYN/ACK should give a 20 ms RTT sample");
+
+            // in-order data: echo its TSval
+            test_1.execute(SendSegment{}
+                               .with_ack(true)
+                               .with_seqno(peer_isn + 1)
+                               .with_ackno(isn + 1)
+                               .with_win(1000)
+                               .with_data("abc")
+                               .with_timestamps(1010, 20));
+            expect_ts(test_1, ExpectOneSegment{}.with_ackno(peer_isn + 4), 20, 1010);
+            test_1.execute(ExpectData{}.with_data("abc"));
+
+            // an older timestamp means an old duplicate from a previous trip around the sequence space
+            test_1.execute(SendSegment{}
+                               .with_ack(true)
+                               .with_seqno(peer_isn + 4)
+                               .with_ackno(isn + 1)
+                               .with_win(1000)
+                               .with_data("old")
+                               .with_timestamps(900, 20));
+            expect_ts(test_1, ExpectOneSegment{}.with_ackno(peer_isn + 4), 20, 1010);
+            test_err_if(test_1._fsm.inbound_stream().buffer_size() != 0, "PAWS should have dropped the segment");
+
+            // once negotiated, a segment without timestamps is dropped silently
+            test_1.execute(SendSegment{}
+                               .with_ack(true)
+                               .with_seqno(peer_isn + 4)
+                               .with_ackno(isn + 1)
+                               .with_win(1000)
+                               .with_data("bad"));
+            test_1.execute(ExpectNoSegment{});
+            test_err_if(test_1._fsm.inbound_stream().buffer_size() != 0, "segment without timestamps accepted");
+
+            test_1.execute(SendSegment{}
+                               .with_ack(true)
+                               .with_seqno(peer_isn + 4)
+                               .with_ackno(isn + 1)
+                               .with_win(1000)
+                               .with_data("xyz")
+                               .with_timestamps(1020, 20));
+            expect_ts(test_1, ExpectOneSegment{}.with_ackno(peer_isn + 7), 20, 1020);
+            test_1.execute(ExpectData{}.with_data("xyz"));
+
+            // the echoed timestamp gives an RTT sample even for a retransmitted segment
+            test_1.execute(Write{"hi"});
+            expect_ts(test_1, ExpectOneSegment{}.with_seqno(isn + 1).with_data("hi"), 20, 1020);
+            test_1.execute(Tick(cfg.rt_timeout));
+            expect_ts(test_1, ExpectOneSegment{}.with_seqno(isn + 1).with_data("hi"), 20 + cfg.rt_timeout, 1020);
+            test_1.execute(Tick(10));
+            test_1.execute(SendSegment{}
+                               .with_ack(true)
+                               .with_seqno(peer_isn + 7)
+                               .with_ackno(isn + 3)
+                               .with_win(1000)
+                               .with_timestamps(1030, 20 + cfg.rt_timeout));
+            test_err_if(test_1._fsm.srtt() != 0.875 * 20 + 0.125 * 10, "echoed timestamp should give a 10 ms sample");
+        }
+
+        // test 2: passive open, the peer does not use timestamps
+        {
+            const WrappingInt32 peer_isn(rd());
+            TCPTestHarness test_2 = TCPTestHarness::in_listen(cfg);
+            test_2.send_syn(peer_isn);
+            TCPSegment seg = test_2.expect_seg(ExpectOneSegment{}.with_syn(true).with_ack(true), "no SYN/ACK");
+            test_err_if(seg.header().timestamps.has_value(), "SYN/ACK must not carry timestamps unasked");
+
+            test_2.send_ack(peer_isn + 1, seg.header().seqno + 1);
+            test_2.execute(ExpectState{State::ESTABLISHED});
+            test_2.execute(Write{"hello"});
+            seg = test_2.expect_seg(ExpectOneSegment{}.with_data("hello"), "no data segment");
+            test_err_if(seg.header().timestamps.has_value(), "data must not carry timestamps unasked");
+        }
+
+        // test 3: passive open with timestamps
+        {
+            const WrappingInt32 peer_isn(rd());
+            TCPTestHarness test_3 = TCPTestHarness::in_listen(cfg);
+            test_3.execute(Tick(7));
+            test_3.execute(SendSegment{}.with_syn(true).with_seqno(peer_isn).with_win(1000).with_timestamps(500, 0));
+            expect_ts(test_3, ExpectOneSegment{}.with_syn(true).with_ack(true), 7, 500);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return err_num;
+    }
+
+    return EXIT_SUCCESS;
+}
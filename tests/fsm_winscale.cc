@@ -0,0 +1,131 @@
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+//! Read every segment the TCP has sent, checking the advertised window, and count their payload bytes
+static size_t drain(TCPTestHarness &test, const uint16_t win) {
+    size_t bytes = 0;
+    while (test.can_read()) {
+        bytes += test.expect_seg(ExpectSegment{}.with_win(win), "data segment has the wrong window").payload().size();
+    }
+    return bytes;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        TCPConfig cfg{};
+        cfg.recv_capacity = 1 << 20;  // needs a shift of 5 to fit in 16 bits
+        cfg.recv_capacity_max = cfg.recv_capacity;  // no auto-tuning past it
+        cfg.send_capacity = 1 << 16;
+        test_err_if(cfg.window_scale() != 5, "wrong window scale for a 1 MiB receive buffer");
+
+        // test 1: active open, both sides scale
+        {
+            const WrappingInt32 isn(rd());
+            const WrappingInt32 peer_isn(rd());
+            TCPConfig c{cfg};
+            c.fixed_isn = isn;
+            TCPTestHarness test_1(c.with_fixed_timers());
+
+            test_1.execute(Connect{});
+            // the window in a SYN is never scaled
+            test_1.execute(ExpectOneSegment{}.with_syn(true).with_seqno(isn).with_wscale(5).with_win(UINT16_MAX),
+                           "test 1 failed: SYN should offer window scaling");
+
+            test_1.execute(SendSegment{}
+                               .with_syn(true)
+                               .with_ack(true)
+                               .with_seqno(peer_isn)
+                               .with_ackno(isn + 1)
+                               .with_win(1000)
+                               .with_wscale(2));
+            test_1.execute(ExpectOneSegment{}.with_ack(true).with_ackno(peer_isn + 1).with_win((1 << 20) >> 5),
+                           "test 1 failed: ACK should advertise the scaled window");
+            test_1.execute(ExpectState{State::ESTABLISHED});
+
+            // the peer's window of 2000 means 2000 << 2 bytes
+            test_1.execute(SendSegment{}.with_ack(true).with_seqno(peer_isn + 1).with_ackno(isn + 1).with_win(2000));
+            test_1.execute(Write{string(10000, 'x')});
+            test_1.execute(Tick(1));
+            test_err_if(drain(test_1, (1 << 20) >> 5) != 8000, "test 1 failed: sender should fill the scaled window");
+        }
+
+        // test 2: passive open, the peer does not offer window scaling
+        {
+            const WrappingInt32 peer_isn(rd());
+            TCPTestHarness test_2 = TCPTestHarness::in_listen(cfg.with_fixed_timers());
+            test_2.send_syn(peer_isn);
+            TCPSegment seg = test_2.expect_seg(ExpectOneSegment{}.with_syn(true).with_ack(true).with_win(UINT16_MAX),
+                                               "test 2 failed: no SYN/ACK");
+            test_err_if(seg.header().wscale.has_value(), "test 2 failed: SYN/ACK must not offer scaling unasked");
+
+            const WrappingInt32 isn = seg.header().seqno;
+            test_2.send_ack(peer_isn + 1, isn + 1, 3000);
+            test_2.execute(ExpectState{State::ESTABLISHED});
+            test_2.execute(Write{string(10000, 'x')});
+            test_2.execute(Tick(1));
+            // the window is clamped, not scaled, in both directions
+            test_err_if(drain(test_2, UINT16_MAX) != 3000, "test 2 failed: window should not be scaled");
+        }
+
+        // test 3: passive open, the peer offers window scaling
+        {
+            const WrappingInt32 peer_isn(rd());
+            TCPTestHarness test_3 = TCPTestHarness::in_listen(cfg.with_fixed_timers());
+            test_3.execute(SendSegment{}.with_syn(true).with_seqno(peer_isn).with_win(1000).with_wscale(3));
+            TCPSegment seg = test_3.expect_seg(
+                ExpectOneSegment{}.with_syn(true).with_ack(true).with_wscale(5).with_win(UINT16_MAX),
+                "test 3 failed: SYN/ACK should accept window scaling");
+
+            const WrappingInt32 isn = seg.header().seqno;
+            test_3.send_ack(peer_isn + 1, isn + 1, 1000);
+            test_3.execute(ExpectState{State::ESTABLISHED});
+            test_3.execute(Write{string(10000, 'x')});
+            test_3.execute(Tick(1));
+            test_err_if(drain(test_3, (1 << 20) >> 5) != 8000, "test 3 failed: sender should fill the scaled window");
+        }
+
+        // options survive a serialize/parse round trip, and unknown ones are skipped
+        {
+            TCPHeader h{};
+            h.syn = true;
+            h.wscale = 7;
+            h.doff = (TCPHeader::LENGTH + h.options_length()) / 4;
+            string raw = h.serialize();
+            TCPHeader parsed{};
+            NetParser p{Buffer{string{raw}}};
+            test_err_if(parsed.parse(p) != ParseResult::NoError or not(parsed == h), "wscale round trip failed");
+
+            // an 8-byte unknown option (kind 254) before the window scale, and EOL after it
+            raw[12] = static_cast<char>(((TCPHeader::LENGTH + 16) / 4) << 4);
+            raw.insert(TCPHeader::LENGTH, string{"\xfe\x08\x00\x00\x00\x00\x00\x00", 8});
+            raw.append(string{"\x00\x00\x00\x00", 4});
+            NetParser p2{Buffer{string{raw}}};
+            test_err_if(parsed.parse(p2) != ParseResult::NoError or parsed.wscale != 7, "unknown option not skipped");
+
+            // an option running past the header is an error
+            raw[TCPHeader::LENGTH + 1] = 100;
+            NetParser p3{Buffer{string{raw}}};
+            test_err_if(parsed.parse(p3) == ParseResult::NoError, "oversized option accepted");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return err_num;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -34,7 +34,7 @@ int main() {
         for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
             cfg.recv_capacity = 2048 + (rd() % 32768);
             const WrappingInt32 seq_base(rd());
-            TCPTestHarness test_1(cfg);
+            TCPTestHarness test_1(cfg.with_fixed_timers());
 
             // connect
             test_1.execute(Listen{});
@@ -0,0 +1,67 @@
+#include "address.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_sponge_listener.hh"
+#include "tcp_sponge_socket.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+
+using namespace std;
+
+static string read_exactly(FileDescriptor &fd, const size_t len) {
+    string ret;
+    while (ret.size() < len and not fd.eof()) {
+        ret += fd.read(len - ret.size());
+    }
+    return ret;
+}
+
+int main() {
+    try {
+        TCPConfig cfg{};
+        cfg.rt_timeout = 20;
+
+        // a server that answers every SYN with a cookie only creates the connection from the client's ACK
+        {
+            UDPSocket server_sock;
+            server_sock.bind(Address{"127.0.0.1", 0});
+            FdAdapterConfig server_cfg{};
+            server_cfg.source = server_sock.local_address();
+            TCPOverUDPSpongeListener listener(
+                TCPOverUDPSocketAdapter(move(server_sock)), cfg, server_cfg, 128, TCPDemux::SynCookies::Always);
+
+            FdAdapterConfig client_cfg{};
+            client_cfg.destination = server_cfg.source;
+            TCPOverUDPSpongeSocket client(TCPOverUDPSocketAdapter(UDPSocket{}));
+            client.connect(cfg, client_cfg);
+
+            LocalStreamSocket connection = listener.accept();
+            test_should_be(listener.syn_cookies_sent(), uint64_t{1});
+            test_should_be(listener.syn_cookies_accepted(), uint64_t{1});
+
+            client.write("hello");
+            test_should_be(read_exactly(connection, 5) == "hello", true);
+            connection.write("world");
+            test_should_be(read_exactly(client, 5) == "world", true);
+
+            client.shutdown(SHUT_WR);
+            test_should_be(read_exactly(connection, 1).empty(), true);
+            connection.close();
+            test_should_be(read_exactly(client, 1).empty(), true);
+
+            client.wait_until_closed();
+            listener.wait_until_closed();
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include "address.hh"
+#include "parser.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_sponge_listener.hh"
+#include "test_should_be.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! A TCPConnection driven by hand over a UDP socket, so that the test can repeat its segments
+class Peer {
+    UDPSocket _sock{};
+    Address _server;
+    TCPConnection _tcp;
+
+  public:
+    //! The last FIN the connection sent
+    optional<TCPSegment> fin{};
+
+    //! Every segment that arrived
+    vector<TCPSegment> received{};
+
+    Peer(const Address &server, const TCPConfig &cfg) : _server(server), _tcp(cfg) {
+        _sock.bind(Address{"127.0.0.1", 0});
+    }
+
+    TCPConnection &tcp() { return _tcp; }
+
+    void send(TCPSegment seg) {
+        seg.header().sport = _sock.local_address().port();
+        seg.header().dport = _server.port();
+        _sock.sendto(_server, seg.serialize(0));
+    }
+
+    //! Send what the connection queued and hand it what arrives, until `done` or a second has passed
+    void run(const function<bool()> &done) {
+        for (size_t ms = 0;; ms++) {
+            while (not _tcp.segments_out().empty()) {
+                if (_tcp.segments_out().front().header().fin) {
+                    fin = _tcp.segments_out().front();
+                }
+                send(move(_tcp.segments_out().front()));
+                _tcp.segments_out().pop();
+            }
+            if (done() or ms == 1000) {
+                return;
+            }
+            UDPSocket::received_datagram datagram{{nullptr, 0}, ""};
+            while (_sock.try_recv(datagram)) {
+                TCPSegment seg;
+                if (seg.parse(move(datagram.payload), 0) != ParseResult::NoError) {
+                    continue;
+                }
+                if (_tcp.active()) {
+                    _tcp.segment_received(seg);
+                }
+                received.push_back(move(seg));
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+            _tcp.tick(1);
+        }
+    }
+};
+
+int main() {
+    try {
+        TCPConfig cfg{};
+        cfg.rt_timeout = 100;
+
+        // the server closes first, so it lingers; its TCPConnection is freed, but the peer's FIN is still ACKed
+        {
+            UDPSocket server_sock;
+            server_sock.bind(Address{"127.0.0.1", 0});
+            FdAdapterConfig server_cfg{};
+            server_cfg.source = server_sock.local_address();
+            TCPOverUDPSpongeListener listener(TCPOverUDPSocketAdapter(move(server_sock)), cfg, server_cfg);
+
+            Peer peer{server_cfg.source, cfg};
+            peer.tcp().connect();
+            optional<LocalStreamSocket> connection;
+            thread accepter([&] { connection.emplace(listener.accept()); });
+            peer.run([&] { return peer.tcp().state() == TCPState::State::ESTABLISHED; });
+            accepter.join();
+            test_should_be(peer.tcp().state() == TCPState::State::ESTABLISHED, true);
+
+            connection->close();
+            peer.run([&] { return peer.tcp().inbound_stream().input_ended(); });
+            peer.tcp().end_input_stream();
+            peer.run([&] { return not peer.tcp().active(); });
+            test_should_be(peer.tcp().active(), false);
+            test_should_be(peer.fin.has_value(), true);
+
+            peer.run([&] { return listener.connections() == 0; });
+            test_should_be(listener.connections(), size_t{0});
+            test_should_be(listener.time_wait_connections(), size_t{1});
+
+            // the peer did not hear the ACK of its FIN, and sends it again
+            const WrappingInt32 fin_ackno = peer.fin->header().seqno + peer.fin->length_in_sequence_space();
+            const auto re_acked = [&] {
+                for (const auto &seg : peer.received) {
+                    if (seg.header().ack and seg.header().ackno == fin_ackno) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            peer.received.clear();
+            peer.send(peer.fin.value());
+            peer.run(re_acked);
+            test_should_be(re_acked(), true);
+            test_should_be(listener.connections(), size_t{0});
+            test_should_be(listener.time_wait_connections(), size_t{1});
+
+            listener.wait_until_closed();
+            test_should_be(listener.time_wait_connections(), size_t{0});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
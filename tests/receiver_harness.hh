@@ -13,6 +13,8 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 struct ReceiverTestStep {
     virtual std::string to_string() const { return "ReceiverTestStep"; }
@@ -100,6 +102,37 @@ struct ExpectUnassembledBytes : public ReceiverExpectation {
     }
 };
 
+struct ExpectSackBlocks : public ReceiverExpectation {
+    std::vector<std::pair<WrappingInt32, WrappingInt32>> _blocks;
+
+    ExpectSackBlocks(std::vector<std::pair<WrappingInt32, WrappingInt32>> blocks) : _blocks(std::move(blocks)) {}
+    std::string description() const {
+        std::ostringstream ss;
+        ss << _blocks.size() << " SACK blocks";
+        for (const auto &[left, right] : _blocks) {
+            ss << " " << left << "-" << right;
+        }
+        return ss.str();
+    }
+
+    void execute(TCPReceiver &receiver) const {
+        const auto blocks = receiver.sack_blocks((TCPHeader::MAX_OPTIONS_LENGTH - 4) / 8);
+        bool same = blocks.size() == _blocks.size();
+        for (size_t i = 0; same and i < blocks.size(); i++) {
+            same = blocks[i].left == _blocks[i].first and blocks[i].right == _blocks[i].second;
+        }
+        if (not same) {
+            std::ostringstream ss;
+            ss << "The TCPReceiver reported SACK blocks";
+            for (const auto &block : blocks) {
+                ss << " " << block.left << "-" << block.right;
+            }
+            ss << ", but " << description() << " were expected";
+            throw ReceiverExpectationViolation(ss.str());
+        }
+    }
+};
+
 struct ExpectTotalAssembledBytes : public ReceiverExpectation {
     size_t _n_bytes;
 
@@ -140,6 +140,25 @@ int main() {
             test.execute(ExpectTotalAssembledBytes{8});
         }
 
+        // Held data is reported as SACK blocks, the most recent first
+        {
+            uint32_t isn = uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+            TCPReceiverTestHarness test{2358};
+            test.execute(SegmentArrives{}.with_syn().with_seqno(isn).with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectSackBlocks{{}});
+            test.execute(SegmentArrives{}.with_seqno(isn + 3).with_data("cd").with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectSackBlocks{{{WrappingInt32{isn + 3}, WrappingInt32{isn + 5}}}});
+            test.execute(SegmentArrives{}.with_seqno(isn + 8).with_data("h").with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectSackBlocks{
+                {{WrappingInt32{isn + 8}, WrappingInt32{isn + 9}}, {WrappingInt32{isn + 3}, WrappingInt32{isn + 5}}}});
+            test.execute(SegmentArrives{}.with_seqno(isn + 5).with_data("e").with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectSackBlocks{
+                {{WrappingInt32{isn + 3}, WrappingInt32{isn + 6}}, {WrappingInt32{isn + 8}, WrappingInt32{isn + 9}}}});
+            test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("ab").with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectAckno{WrappingInt32{isn + 6}});
+            test.execute(ExpectSackBlocks{{{WrappingInt32{isn + 8}, WrappingInt32{isn + 9}}}});
+        }
+
     } catch (const exception &e) {
         cerr << e.what() << endl;
         return 1;
@@ -73,7 +73,7 @@ int main() {
             WrappingInt32 isn(rd());
             cfg.fixed_isn = isn;
 
-            TCPSenderTestHarness test{"FIN retx test", cfg};
+            TCPSenderTestHarness test{"FIN retx test", cfg.with_fixed_timers()};
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(AckReceived{WrappingInt32{isn + 1}});
             test.execute(ExpectState{TCPSenderStateSummary::SYN_ACKED});
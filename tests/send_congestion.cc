@@ -0,0 +1,101 @@
+#include "congestion_control.hh"
+#include "sender_harness.hh"
+#include "test_should_be.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        const size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.congestion_control = CongestionControlAlgorithm::NewReno;
+
+            TCPSenderTestHarness test{"NewReno slow start and timeout", cfg.with_fixed_timers()};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(60000));
+            test.execute(WriteBytes{string(30 * MSS, 'a')});
+            // initial window is 10 segments even though the receiver allows 60
+            for (unsigned i = 0; i < 10; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectBytesInFlight{10 * MSS});
+
+            // slow start: acknowledging 2 segments opens room for 4
+            test.execute(AckReceived{WrappingInt32{isn + 1 + 2 * MSS}}.with_win(60000));
+            for (unsigned i = 10; i < 14; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(ExpectNoSegment{});
+
+            // a timeout collapses the window to one segment...
+            test.execute(Tick{cfg.rt_timeout});
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + 2 * MSS));
+            test.execute(ExpectNoSegment{});
+
+            // ...and slow start begins again from there
+            test.execute(AckReceived{WrappingInt32{isn + 1 + 14 * MSS}}.with_win(60000));
+            for (unsigned i = 14; i < 17; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(ExpectNoSegment{});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.congestion_control = CongestionControlAlgorithm::Cubic;
+
+            TCPSenderTestHarness test{"Receiver window still applies under congestion control", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1500));
+            test.execute(WriteBytes{string(30 * MSS, 'a')});
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1));
+            test.execute(ExpectSegment{}.with_payload_size(500).with_seqno(isn + 1 + MSS));
+            test.execute(ExpectNoSegment{});
+        }
+
+        {
+            CubicController cubic{MSS};
+            cubic.on_loss(LossEvent::FastRetransmit, 20 * MSS, 0);
+            test_should_be(cubic.cwnd(), uint64_t{7 * MSS});  // beta = 0.7 of the initial window
+
+            NewRenoController reno{MSS};
+            reno.on_loss(LossEvent::FastRetransmit, 8 * MSS, 0);
+            test_should_be(reno.cwnd(), uint64_t{4 * MSS});
+            reno.on_ack(4 * MSS, 0, 0);
+            test_should_be(reno.cwnd(), uint64_t{5 * MSS});  // congestion avoidance: one MSS per window
+
+            BBRController bbr{MSS};
+            bbr.on_loss(LossEvent::FastRetransmit, 10 * MSS, 0);
+            test_should_be(bbr.cwnd(), uint64_t{10 * MSS});  // isolated loss is not a congestion signal
+            bbr.on_loss(LossEvent::Timeout, 10 * MSS, 0);
+            test_should_be(bbr.cwnd(), uint64_t{MSS});
+
+            if (congestion_control_from_name("reno") != CongestionControlAlgorithm::NewReno or
+                congestion_control_from_name("vegas").has_value()) {
+                throw runtime_error("congestion_control_from_name");
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -22,7 +22,8 @@ int main() {
             cfg.fixed_isn = isn;
             cfg.rt_timeout = rto;
 
-            TCPSenderTestHarness test{"If already running, timer stays running when new segment sent", cfg};
+            TCPSenderTestHarness test{"If already running, timer stays running when new segment sent",
+                                      cfg.with_fixed_timers()};
 
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
@@ -45,7 +46,8 @@ int main() {
             cfg.fixed_isn = isn;
             cfg.rt_timeout = rto;
 
-            TCPSenderTestHarness test{"Retransmission still happens when expiration time not hit exactly", cfg};
+            TCPSenderTestHarness test{"Retransmission still happens when expiration time not hit exactly",
+                                      cfg.with_fixed_timers()};
 
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
@@ -68,7 +70,7 @@ int main() {
             cfg.fixed_isn = isn;
             cfg.rt_timeout = rto;
 
-            TCPSenderTestHarness test{"Timer restarts on ACK of new data", cfg};
+            TCPSenderTestHarness test{"Timer restarts on ACK of new data", cfg.with_fixed_timers()};
 
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
@@ -92,7 +94,7 @@ int main() {
             cfg.fixed_isn = isn;
             cfg.rt_timeout = rto;
 
-            TCPSenderTestHarness test{"Timer doesn't restart without ACK of new data", cfg};
+            TCPSenderTestHarness test{"Timer doesn't restart without ACK of new data", cfg.with_fixed_timers()};
 
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
@@ -120,7 +122,7 @@ int main() {
             cfg.fixed_isn = isn;
             cfg.rt_timeout = rto;
 
-            TCPSenderTestHarness test{"RTO resets on ACK of new data", cfg};
+            TCPSenderTestHarness test{"RTO resets on ACK of new data", cfg.with_fixed_timers()};
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
             test.execute(ExpectState{TCPSenderStateSummary::SYN_ACKED});
@@ -186,7 +188,7 @@ int main() {
             cfg.fixed_isn = isn;
             cfg.rt_timeout = rto;
 
-            TCPSenderTestHarness test{"Retransmit a FIN-containing segment same as any other", cfg};
+            TCPSenderTestHarness test{"Retransmit a FIN-containing segment same as any other", cfg.with_fixed_timers()};
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
             test.execute(ExpectState{TCPSenderStateSummary::SYN_ACKED});
@@ -205,7 +207,7 @@ int main() {
             cfg.fixed_isn = isn;
             cfg.rt_timeout = rto;
 
-            TCPSenderTestHarness test{"Retransmit a FIN-only segment same as any other", cfg};
+            TCPSenderTestHarness test{"Retransmit a FIN-only segment same as any other", cfg.with_fixed_timers()};
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
             test.execute(ExpectState{TCPSenderStateSummary::SYN_ACKED});
@@ -306,7 +308,8 @@ int main() {
             cfg.rt_timeout = rto;
 
             TCPSenderTestHarness test{
-                "When filling window, treat a '0' window size as equal to '1' but don't back off RTO", cfg};
+                "When filling window, treat a '0' window size as equal to '1' but don't back off RTO",
+                cfg.with_fixed_timers()};
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(WriteBytes("abc"));
             test.execute(ExpectNoSegment{});
@@ -362,7 +365,7 @@ int main() {
             cfg.rt_timeout = rto;
 
             TCPSenderTestHarness test{"Unlike a zero-size window, a full window of nonzero size should be respected",
-                                      cfg};
+                                      cfg.with_fixed_timers()};
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(WriteBytes("abc"));
             test.execute(ExpectNoSegment{});
@@ -422,10 +425,16 @@ int main() {
             test.execute(AckReceived{WrappingInt32{isn + 8}}.with_win(1000));
             test.execute(AckReceived{WrappingInt32{isn + 8}}.with_win(1000));
             test.execute(AckReceived{WrappingInt32{isn + 8}}.with_win(1000));
+            // three duplicate ACKs with data outstanding trigger a fast retransmit...
+            test.execute(ExpectSegment{}.with_payload_size(4).with_data("ijkl").with_seqno(isn + 8).with_fin(true));
+            test.execute(ExpectNoSegment{});
+            // ...and a partial ACK during recovery retransmits what is still unacknowledged
             test.execute(AckReceived{WrappingInt32{isn + 12}}.with_win(1000));
+            test.execute(ExpectSegment{}.with_payload_size(4).with_data("ijkl").with_seqno(isn + 8).with_fin(true));
             test.execute(AckReceived{WrappingInt32{isn + 12}}.with_win(1000));
             test.execute(AckReceived{WrappingInt32{isn + 12}}.with_win(1000));
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
+            test.execute(ExpectNoSegment{});
             test.execute(Tick{5 * rto});
             test.execute(ExpectSegment{}.with_payload_size(4).with_data("ijkl").with_seqno(isn + 8).with_fin(true));
             test.execute(ExpectNoSegment{});
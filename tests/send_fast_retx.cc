@@ -0,0 +1,83 @@
+#include "sender_harness.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        const size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"Three duplicate ACKs trigger a fast retransmit", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(10 * MSS));
+            test.execute(WriteBytes{string(5 * MSS, 'a')});
+            for (unsigned i = 0; i < 5; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(AckReceived{WrappingInt32{isn + 1 + MSS}}.with_win(10 * MSS));
+
+            // segments 2 and 4 were lost: 3, 4 and 5 arriving produce duplicate ACKs
+            test.execute(AckReceived{WrappingInt32{isn + 1 + MSS}}.with_win(10 * MSS));
+            test.execute(AckReceived{WrappingInt32{isn + 1 + MSS}}.with_win(10 * MSS));
+            test.execute(ExpectNoSegment{});
+            test.execute(AckReceived{WrappingInt32{isn + 1 + MSS}}.with_win(10 * MSS));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + MSS));
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectFastRetransmissions{1});
+
+            // further duplicates during recovery don't retransmit again
+            test.execute(AckReceived{WrappingInt32{isn + 1 + MSS}}.with_win(10 * MSS));
+            test.execute(ExpectNoSegment{});
+
+            // the partial ACK shows segment 4 is missing too
+            test.execute(AckReceived{WrappingInt32{isn + 1 + 3 * MSS}}.with_win(10 * MSS));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + 3 * MSS));
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectFastRetransmissions{2});
+
+            // everything acknowledged: recovery is over and no timeout ever fired
+            test.execute(AckReceived{WrappingInt32{isn + 1 + 5 * MSS}}.with_win(10 * MSS));
+            test.execute(ExpectBytesInFlight{0});
+            test.execute(Tick{cfg.rt_timeout});
+            test.execute(ExpectNoSegment{});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"Window updates are not duplicate ACKs", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(3 * MSS));
+            test.execute(WriteBytes{string(3 * MSS, 'a')});
+            for (unsigned i = 0; i < 3; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(4 * MSS));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(5 * MSS));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(6 * MSS));
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectFastRetransmissions{0});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "sender_harness.hh"
+#include "tcp_config.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        const size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+        const WrappingInt32 isn{0};
+        const auto seg = [&](const unsigned i) { return isn + 1 + i * MSS; };
+
+        // the default config has RACK-TLP on: a hole is declared lost one RTT plus a quarter of the min RTT
+        // after it was sent, without waiting for three duplicate ACKs
+        {
+            TCPConfig cfg;
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"RACK resends a hole one RTT and a reordering window after it was sent", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_seqno(isn));
+            test.execute(Tick{100});
+            test.execute(AckReceived{isn + 1}.with_win(20 * MSS));
+            test.execute(WriteBytes{string(4 * MSS, 'x')});
+            for (unsigned i = 0; i < 4; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(i)));
+            }
+            test.execute(Tick{100});
+            test.execute(AckReceived{seg(1)}.with_win(20 * MSS));
+            test.execute(AckReceived{seg(1)}.with_win(20 * MSS).with_sack(seg(2), seg(3)));
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{24});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(1)));
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectFastRetransmissions{1});
+        }
+
+        {
+            TCPConfig cfg;
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"RACK does not resend a segment that turns up inside the reordering window",
+                                      cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_seqno(isn));
+            test.execute(Tick{100});
+            test.execute(AckReceived{isn + 1}.with_win(20 * MSS));
+            test.execute(WriteBytes{string(4 * MSS, 'x')});
+            for (unsigned i = 0; i < 4; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(i)));
+            }
+            test.execute(Tick{100});
+            test.execute(AckReceived{seg(1)}.with_win(20 * MSS));
+            test.execute(AckReceived{seg(1)}.with_win(20 * MSS).with_sack(seg(2), seg(3)));
+            test.execute(AckReceived{seg(1)}.with_win(20 * MSS).with_sack(seg(2), seg(4)));
+            test.execute(Tick{20});
+            test.execute(AckReceived{seg(4)}.with_win(20 * MSS));
+            test.execute(Tick{100});
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectFastRetransmissions{0});
+            test.execute(ExpectBytesInFlight{0});
+        }
+
+        // with no new data to send, the probe resends the last segment; its SACK reveals the hole before it
+        {
+            TCPConfig cfg;
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"TLP probes the tail two SRTTs after the last ACK", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_seqno(isn));
+            test.execute(Tick{100});
+            test.execute(AckReceived{isn + 1}.with_win(20 * MSS));
+            test.execute(WriteBytes{string(4 * MSS, 'x')});
+            for (unsigned i = 0; i < 4; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(i)));
+            }
+            test.execute(Tick{100});
+            test.execute(AckReceived{seg(2)}.with_win(20 * MSS));
+            test.execute(Tick{199});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(3)));
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectTailLossProbes{1});
+            test.execute(ExpectConsecutiveRetransmissions{0});
+
+            test.execute(Tick{100});
+            test.execute(AckReceived{seg(2)}.with_win(20 * MSS).with_sack(seg(3), seg(4)));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(2)));
+            test.execute(AckReceived{seg(4)}.with_win(20 * MSS));
+            test.execute(ExpectBytesInFlight{0});
+            test.execute(ExpectConsecutiveRetransmissions{0});
+        }
+
+        // when the congestion window holds data back, the probe sends new data instead
+        {
+            TCPConfig cfg;
+            cfg.fixed_isn = isn;
+            cfg.congestion_control = CongestionControlAlgorithm::NewReno;
+
+            TCPSenderTestHarness test{"TLP sends new data that the congestion window held back", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_seqno(isn));
+            test.execute(Tick{100});
+            test.execute(AckReceived{isn + 1}.with_win(20 * MSS));
+            test.execute(WriteBytes{string(12 * MSS, 'x')});
+            for (unsigned i = 0; i < 10; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(i)));
+            }
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectBytesInFlight{10 * MSS});
+            test.execute(Tick{199});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(10)));
+            test.execute(ExpectTailLossProbes{1});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
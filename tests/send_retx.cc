@@ -74,7 +74,8 @@ int main() {
             cfg.fixed_isn = isn;
             cfg.rt_timeout = retx_timeout;
 
-            TCPSenderTestHarness test{"Send some data, the retx and succeed, then retx till limit", cfg};
+            TCPSenderTestHarness test{"Send some data, the retx and succeed, then retx till limit",
+                                      cfg.with_fixed_timers()};
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(ExpectNoSegment{});
             test.execute(AckReceived{WrappingInt32{isn + 1}});
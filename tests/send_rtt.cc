@@ -0,0 +1,124 @@
+#include "sender_harness.hh"
+#include "tcp_config.hh"
+#include "tcp_sender.hh"
+#include "test_should_be.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+//! Send `data` and drop whatever the sender queued
+static void send(TCPSender &sender, const string &data) {
+    sender.stream_in().write(data);
+    sender.fill_window();
+    while (not sender.segments_out().empty()) {
+        sender.segments_out().pop();
+    }
+}
+
+int main() {
+    try {
+        const WrappingInt32 isn{0};
+
+        {
+            TCPSender sender{TCPConfig::DEFAULT_CAPACITY, 1000, isn, CongestionControlAlgorithm::None, 10, 60000};
+            send(sender, "");
+            test_should_be(sender.retransmission_timeout(), 1000ul);
+
+            // first sample: SRTT = R, RTTVAR = R / 2
+            sender.tick(100);
+            sender.ack_received(isn + 1, 1000);
+            test_should_be(sender.srtt(), 100.0);
+            test_should_be(sender.rttvar(), 50.0);
+            test_should_be(sender.retransmission_timeout(), 300ul);
+
+            // RTTVAR is updated with the old SRTT
+            send(sender, "hello");
+            sender.tick(20);
+            sender.ack_received(isn + 6, 1000);
+            test_should_be(sender.srtt(), 90.0);
+            test_should_be(sender.rttvar(), 57.5);
+            test_should_be(sender.retransmission_timeout(), 320ul);
+
+            // a timeout doubles the RTO...
+            send(sender, "world");
+            sender.tick(320);
+            test_should_be(sender.retransmission_timeout(), 640ul);
+            // ...and the ACK for a retransmitted segment is no sample (Karn), but drops the backoff
+            sender.tick(50);
+            sender.ack_received(isn + 11, 1000);
+            test_should_be(sender.srtt(), 90.0);
+            test_should_be(sender.retransmission_timeout(), 320ul);
+        }
+
+        {
+            TCPSender sender{TCPConfig::DEFAULT_CAPACITY, 1000, isn, CongestionControlAlgorithm::None, 100, 150};
+            send(sender, "");
+            sender.tick(100);
+            sender.ack_received(isn + 1, 1000);
+            test_should_be(sender.retransmission_timeout(), 150ul);  // capped at rto_max
+
+            send(sender, "again");
+            sender.tick(150);
+            test_should_be(sender.retransmission_timeout(), 300ul);  // but backoff may go beyond it
+        }
+
+        {
+            TCPSender sender{TCPConfig::DEFAULT_CAPACITY, 1000, isn, CongestionControlAlgorithm::None, 200, 60000};
+            send(sender, "");
+            sender.tick(1);
+            sender.ack_received(isn + 1, 1000);
+            test_should_be(sender.retransmission_timeout(), 200ul);  // raised to rto_min
+        }
+
+        // with the default config, the retransmission timer follows the measured RTT
+        {
+            TCPConfig cfg;
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"The default RTO comes from the RTT samples", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_seqno(isn));
+            test.execute(Tick{100});
+            test.execute(AckReceived{isn + 1}.with_win(1000));
+            // SRTT = 100, RTTVAR = 50: the RTO is 300 ms rather than rt_timeout
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_data("abc").with_seqno(isn + 1));
+            test.execute(Tick{299});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("abc").with_seqno(isn + 1));
+            // backed off to 600 ms
+            test.execute(Tick{599});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("abc").with_seqno(isn + 1));
+        }
+
+        {
+            TCPConfig cfg;
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"The default RTO is no shorter than rto_min", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_seqno(isn));
+            test.execute(Tick{1});
+            test.execute(AckReceived{isn + 1}.with_win(1000));
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_data("abc").with_seqno(isn + 1));
+            test.execute(Tick{TCPConfig::RTO_MIN_DFLT - 1});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("abc").with_seqno(isn + 1));
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
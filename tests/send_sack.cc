@@ -0,0 +1,92 @@
+#include "sender_harness.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        const size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            const auto seg = [&](const unsigned i) { return WrappingInt32{isn + 1 + i * MSS}; };
+
+            TCPSenderTestHarness test{"SACK repairs two holes before the partial ACK", cfg.with_fixed_timers()};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{seg(0)}.with_win(10 * MSS));
+            test.execute(WriteBytes{string(10 * MSS, 'a')});
+            for (unsigned i = 0; i < 10; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(i)));
+            }
+            test.execute(AckReceived{seg(1)}.with_win(10 * MSS));
+
+            // segments 1 and 3 were lost; the others are SACKed as they arrive
+            test.execute(AckReceived{seg(1)}.with_win(10 * MSS).with_sack(seg(2), seg(3)));
+            test.execute(AckReceived{seg(1)}.with_win(10 * MSS).with_sack(seg(4), seg(5)).with_sack(seg(2), seg(3)));
+            test.execute(ExpectNoSegment{});
+            test.execute(AckReceived{seg(1)}.with_win(10 * MSS).with_sack(seg(4), seg(6)).with_sack(seg(2), seg(3)));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(1)));
+            test.execute(ExpectNoSegment{});
+
+            // three segments SACKed above segment 3 mark it lost too, without waiting for a partial ACK
+            test.execute(AckReceived{seg(1)}.with_win(10 * MSS).with_sack(seg(4), seg(7)).with_sack(seg(2), seg(3)));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(3)));
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectFastRetransmissions{2});
+
+            // SACKed segments are never resent
+            test.execute(AckReceived{seg(1)}.with_win(10 * MSS).with_sack(seg(4), seg(10)).with_sack(seg(2), seg(3)));
+            test.execute(AckReceived{seg(3)}.with_win(10 * MSS).with_sack(seg(4), seg(10)));
+            test.execute(ExpectNoSegment{});
+            test.execute(AckReceived{seg(10)}.with_win(10 * MSS));
+            test.execute(ExpectBytesInFlight{0});
+            test.execute(ExpectFastRetransmissions{2});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            const auto seg = [&](const unsigned i) { return WrappingInt32{isn + 1 + i * MSS}; };
+
+            TCPSenderTestHarness test{"After a timeout, holes below SACKed data are resent at once",
+                                      cfg.with_fixed_timers()};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{seg(0)}.with_win(4 * MSS));
+            test.execute(WriteBytes{string(4 * MSS, 'a')});
+            for (unsigned i = 0; i < 4; i++) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(i)));
+            }
+
+            // segments 0 and 1 were lost: two duplicates are not enough for fast retransmit
+            test.execute(AckReceived{seg(0)}.with_win(4 * MSS).with_sack(seg(2), seg(3)));
+            test.execute(AckReceived{seg(0)}.with_win(4 * MSS).with_sack(seg(2), seg(4)));
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{cfg.rt_timeout});
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(0)));
+            test.execute(ExpectNoSegment{});
+
+            test.execute(AckReceived{seg(1)}.with_win(4 * MSS).with_sack(seg(2), seg(4)));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seg(1)));
+            test.execute(ExpectNoSegment{});
+            test.execute(AckReceived{seg(4)}.with_win(4 * MSS));
+            test.execute(ExpectBytesInFlight{0});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
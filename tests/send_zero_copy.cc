@@ -0,0 +1,54 @@
+#include "buffer.hh"
+#include "sender_harness.hh"
+#include "tcp_config.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        const size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+        const WrappingInt32 isn{0};
+        const uint16_t win = MSS;
+
+        // a segment within one written buffer shares its storage; one that spans two buffers is a copy
+        {
+            TCPConfig cfg;
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"Segments share the storage of the buffer they were written from", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_seqno(isn));
+            test.execute(AckReceived{isn + 1}.with_win(win));
+
+            const Buffer first{string(MSS + 100, 'b')};
+            test.execute(WriteBuffer{first});
+            test.execute(ExpectSegment{}.with_seqno(isn + 1).with_payload_size(MSS).with_storage_of(first));
+            const Buffer second{string(MSS - 100, 'c')};
+            test.execute(WriteBuffer{second});
+            test.execute(ExpectNoSegment{});
+
+            test.execute(AckReceived{isn + 1 + MSS}.with_win(win));
+            const string spanning = string(100, 'b') + string(MSS - 100, 'c');
+            test.execute(ExpectSegment{}.with_seqno(isn + 1 + MSS).with_data(spanning));
+            test.execute(ExpectNoSegment{});
+
+            test.execute(AckReceived{isn + 1 + 2 * MSS}.with_win(2 * win));
+            const Buffer third{string(2 * MSS, 'd')};
+            test.execute(WriteBuffer{third});
+            test.execute(ExpectSegment{}.with_seqno(isn + 1 + 2 * MSS).with_payload_size(MSS).with_storage_of(third));
+            test.execute(ExpectSegment{}.with_seqno(isn + 1 + 3 * MSS).with_payload_size(MSS).with_storage_of(third));
+            test.execute(ExpectNoSegment{});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
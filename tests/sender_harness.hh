@@ -1,6 +1,7 @@
 #ifndef SPONGE_SENDER_HARNESS_HH
 #define SPONGE_SENDER_HARNESS_HH
 
+#include "buffer.hh"
 #include "byte_stream.hh"
 #include "string_conversions.hh"
 #include "tcp_sender.hh"
@@ -99,6 +100,54 @@ struct ExpectBytesInFlight : public SenderExpectation {
     }
 };
 
+struct ExpectFastRetransmissions : public SenderExpectation {
+    uint64_t _count;
+
+    ExpectFastRetransmissions(uint64_t count) : _count(count) {}
+    std::string description() const { return std::to_string(_count) + " fast retransmissions"; }
+
+    void execute(TCPSender &sender, std::queue<TCPSegment> &) const {
+        if (sender.fast_retransmissions() != _count) {
+            std::ostringstream ss;
+            ss << "The TCPSender reported " << sender.fast_retransmissions()
+               << " fast retransmissions, but there were expected to be " << _count;
+            throw SenderExpectationViolation(ss.str());
+        }
+    }
+};
+
+struct ExpectTailLossProbes : public SenderExpectation {
+    uint64_t _count;
+
+    ExpectTailLossProbes(uint64_t count) : _count(count) {}
+    std::string description() const { return std::to_string(_count) + " tail loss probes"; }
+
+    void execute(TCPSender &sender, std::queue<TCPSegment> &) const {
+        if (sender.tail_loss_probes() != _count) {
+            std::ostringstream ss;
+            ss << "The TCPSender reported " << sender.tail_loss_probes()
+               << " tail loss probes, but there were expected to be " << _count;
+            throw SenderExpectationViolation(ss.str());
+        }
+    }
+};
+
+struct ExpectConsecutiveRetransmissions : public SenderExpectation {
+    unsigned int _count;
+
+    ExpectConsecutiveRetransmissions(unsigned int count) : _count(count) {}
+    std::string description() const { return std::to_string(_count) + " consecutive retransmissions"; }
+
+    void execute(TCPSender &sender, std::queue<TCPSegment> &) const {
+        if (sender.consecutive_retransmissions() != _count) {
+            std::ostringstream ss;
+            ss << "The TCPSender reported " << sender.consecutive_retransmissions()
+               << " consecutive retransmissions, but there were expected to be " << _count;
+            throw SenderExpectationViolation(ss.str());
+        }
+    }
+};
+
 struct ExpectNoSegment : public SenderExpectation {
     ExpectNoSegment() {}
     std::string description() const { return "no (more) segments"; }
@@ -150,6 +199,20 @@ struct WriteBytes : public SenderAction {
     }
 };
 
+struct WriteBuffer : public SenderAction {
+    Buffer _buffer;
+
+    WriteBuffer(Buffer buffer) : _buffer(std::move(buffer)) {}
+    std::string description() const {
+        return "write a buffer of " + std::to_string(_buffer.size()) + " bytes, sharing its storage";
+    }
+
+    void execute(TCPSender &sender, std::queue<TCPSegment> &) const {
+        sender.stream_in().write(Buffer{_buffer});
+        sender.fill_window();
+    }
+};
+
 struct Tick : public SenderAction {
     size_t _ms;
     std::optional<bool> max_retx_exceeded{};
@@ -191,11 +254,15 @@ struct Tick : public SenderAction {
 struct AckReceived : public SenderAction {
     WrappingInt32 _ackno;
     std::optional<uint16_t> _window_advertisement{};
+    std::vector<TCPHeader::SackBlock> _sack{};
 
     AckReceived(WrappingInt32 ackno) : _ackno(ackno) {}
     std::string description() const {
         std::ostringstream ss;
         ss << "ack " << _ackno.raw_value() << " winsize " << _window_advertisement.value_or(DEFAULT_TEST_WINDOW);
+        for (const auto &block : _sack) {
+            ss << " sack " << block.left << "-" << block.right;
+        }
         return ss.str();
     }
 
@@ -204,8 +271,13 @@ struct AckReceived : public SenderAction {
         return *this;
     }
 
+    AckReceived &with_sack(WrappingInt32 left, WrappingInt32 right) {
+        _sack.push_back({left, right});
+        return *this;
+    }
+
     void execute(TCPSender &sender, std::queue<TCPSegment> &) const {
-        sender.ack_received(_ackno, _window_advertisement.value_or(DEFAULT_TEST_WINDOW));
+        sender.ack_received(_ackno, _window_advertisement.value_or(DEFAULT_TEST_WINDOW), true, {}, _sack);
         sender.fill_window();
     }
 };
@@ -230,6 +302,7 @@ struct ExpectSegment : public SenderExpectation {
     std::optional<uint16_t> win{};
     std::optional<size_t> payload_size{};
     std::optional<std::string> data{};
+    std::optional<Buffer> storage{};
 
     ExpectSegment &with_ack(bool ack_) {
         ack = ack_;
@@ -288,6 +361,12 @@ struct ExpectSegment : public SenderExpectation {
         return *this;
     }
 
+    //! The payload must point into `buffer`, rather than into a copy of it
+    ExpectSegment &with_storage_of(Buffer buffer) {
+        storage = std::move(buffer);
+        return *this;
+    }
+
     std::string segment_description() const {
         std::ostringstream o;
         o << "(";
@@ -330,6 +409,9 @@ struct ExpectSegment : public SenderExpectation {
             }
             o << "\",";
         }
+        if (storage.has_value()) {
+            o << "sharing a buffer of " << storage.value().size() << " bytes,";
+        }
         o << "...)";
         return o.str();
     }
@@ -375,6 +457,13 @@ struct ExpectSegment : public SenderExpectation {
             throw SegmentExpectationViolation("payloads differ. expected \"" + data.value() + "\" but found \"" +
                                               std::string(seg.payload().str()) + "\"");
         }
+        if (storage.has_value()) {
+            const std::string_view payload = seg.payload().str();
+            const std::string_view buffer = storage.value().str();
+            if (payload.data() < buffer.data() or payload.data() + payload.size() > buffer.data() + buffer.size()) {
+                throw SegmentExpectationViolation("the payload is a copy, rather than sharing the written buffer");
+            }
+        }
     }
 };
 
@@ -394,7 +483,13 @@ class TCPSenderTestHarness {
   public:
     TCPSenderTestHarness(const std::string &name_, TCPConfig config)
         : outbound_segments()
-        , sender(config.send_capacity, config.rt_timeout, config.fixed_isn)
+        , sender(config.send_capacity,
+                 config.rt_timeout,
+                 config.fixed_isn,
+                 config.congestion_control,
+                 config.rto_min,
+                 config.rto_max,
+                 config.rack_tlp)
         , steps_executed()
         , name(name_) {
         sender.fill_window();
@@ -11,6 +11,7 @@
 #include <exception>
 #include <optional>
 #include <sstream>
+#include <vector>
 
 struct TCPExpectation : public TCPTestStep {
     virtual ~TCPExpectation() {}
@@ -121,6 +122,7 @@ struct ExpectSegment : public TCPExpectation {
     std::optional<WrappingInt32> seqno{};
     std::optional<WrappingInt32> ackno{};
     std::optional<uint16_t> win{};
+    std::optional<uint8_t> wscale{};
     std::optional<size_t> payload_size{};
     std::optional<std::string> data{};
 
@@ -171,6 +173,11 @@ struct ExpectSegment : public TCPExpectation {
         return *this;
     }
 
+    ExpectSegment &with_wscale(uint8_t wscale_) {
+        wscale = wscale_;
+        return *this;
+    }
+
     ExpectSegment &with_payload_size(size_t payload_size_) {
         payload_size = payload_size_;
         return *this;
@@ -202,6 +209,9 @@ struct ExpectSegment : public TCPExpectation {
         if (win.has_value()) {
             o << "win=" << win.value() << ",";
         }
+        if (wscale.has_value()) {
+            o << "wscale=" << +wscale.value() << ",";
+        }
         if (seqno.has_value()) {
             o << "seqno=" << seqno.value() << ",";
         }
@@ -248,6 +258,10 @@ struct ExpectSegment : public TCPExpectation {
         if (win.has_value() and seg.header().win != win.value()) {
             throw SegmentExpectationViolation::violated_field("win", win.value(), seg.header().win);
         }
+        if (wscale.has_value() and seg.header().wscale != wscale) {
+            throw SegmentExpectationViolation::violated_field(
+                "wscale", +wscale.value(), seg.header().wscale.has_value() ? +seg.header().wscale.value() : -1);
+        }
         if (payload_size.has_value() and seg.payload().size() != payload_size.value()) {
             throw SegmentExpectationViolation::violated_field(
                 "payload_size", payload_size.value(), seg.payload().size());
@@ -363,6 +377,25 @@ struct ExpectUnassembledBytes : public TCPExpectation {
     }
 };
 
+struct ExpectReceiveCapacity : public TCPExpectation {
+    size_t bytes;
+
+    ExpectReceiveCapacity(size_t bytes_) : bytes(bytes_) {}
+
+    std::string description() const {
+        std::ostringstream o;
+        o << "TCP has a receive capacity of " << bytes << " bytes";
+        return o.str();
+    }
+
+    void execute(TCPTestHarness &harness) const {
+        size_t actual_bytes = harness._fsm.receive_capacity();
+        if (actual_bytes != bytes) {
+            throw TCPPropertyViolation::make("receive_capacity", bytes, actual_bytes);
+        }
+    }
+};
+
 struct ExpectLingerTimer : public TCPExpectation {
     uint64_t ms;
 
@@ -382,6 +415,32 @@ struct ExpectLingerTimer : public TCPExpectation {
     }
 };
 
+struct ExpectNextDeadline : public TCPExpectation {
+    std::optional<size_t> ms;
+
+    ExpectNextDeadline(std::optional<size_t> ms_) : ms(ms_) {}
+
+    std::string description() const {
+        std::ostringstream o;
+        if (ms.has_value()) {
+            o << "Next timer expires in " << ms.value() << " ms";
+        } else {
+            o << "No timer running";
+        }
+        return o.str();
+    }
+
+    void execute(TCPTestHarness &harness) const {
+        std::optional<size_t> actual_ms = harness._fsm.next_deadline();
+        if (actual_ms != ms) {
+            const auto name = [](const std::optional<size_t> &t) {
+                return t.has_value() ? std::to_string(t.value()) : std::string{"none"};
+            };
+            throw TCPPropertyViolation::make("next_deadline", name(ms), name(actual_ms));
+        }
+    }
+};
+
 struct SendSegment : public TCPAction {
     bool ack{false};
     bool rst{false};
@@ -390,6 +449,8 @@ struct SendSegment : public TCPAction {
     WrappingInt32 seqno{0};
     WrappingInt32 ackno{0};
     uint16_t win{0};
+    std::optional<uint8_t> wscale{};
+    std::optional<TCPHeader::Timestamps> timestamps{};
     size_t payload_size{0};
     std::string data{};
 
@@ -403,6 +464,8 @@ struct SendSegment : public TCPAction {
         seqno = seg.header().seqno;
         ackno = seg.header().ackno;
         win = seg.header().win;
+        wscale = seg.header().wscale;
+        timestamps = seg.header().timestamps;
         data = seg.payload();
     }
 
@@ -445,6 +508,16 @@ struct SendSegment : public TCPAction {
         return *this;
     }
 
+    SendSegment &with_wscale(uint8_t wscale_) {
+        wscale = wscale_;
+        return *this;
+    }
+
+    SendSegment &with_timestamps(uint32_t tsval, uint32_t tsecr) {
+        timestamps = TCPHeader::Timestamps{tsval, tsecr};
+        return *this;
+    }
+
     SendSegment &with_payload_size(size_t payload_size_) {
         payload_size = payload_size_;
         return *this;
@@ -466,6 +539,9 @@ struct SendSegment : public TCPAction {
         data_hdr.ackno = ackno;
         data_hdr.seqno = seqno;
         data_hdr.win = win;
+        data_hdr.wscale = wscale;
+        data_hdr.timestamps = timestamps;
+        data_hdr.doff = (TCPHeader::LENGTH + data_hdr.options_length()) / 4;
         return data_seg;
     }
 
@@ -489,6 +565,29 @@ struct SendSegment : public TCPAction {
     }
 };
 
+struct SendSegments : public TCPAction {
+    std::vector<SendSegment> segments;
+
+    SendSegments(std::vector<SendSegment> &&segments_) : segments(std::move(segments_)) {}
+
+    std::string description() const {
+        std::ostringstream o;
+        o << segments.size() << " packets arrive together:";
+        for (const auto &seg : segments) {
+            o << "\n\t\t" << seg.description();
+        }
+        return o.str();
+    }
+
+    void execute(TCPTestHarness &harness) const {
+        std::vector<TCPSegment> batch;
+        for (const auto &seg : segments) {
+            batch.push_back(seg.get_segment());
+        }
+        harness._fsm.segments_received(batch);
+    }
+};
+
 struct Write : public TCPAction {
     std::string data;
     std::optional<size_t> _bytes_written{};
@@ -30,8 +30,11 @@ struct ExpectNoData;
 struct ExpectSegmentAvailable;
 struct ExpectBytesInFlight;
 struct ExpectUnassembledBytes;
+struct ExpectReceiveCapacity;
 struct ExpectWaitTimer;
+struct ExpectNextDeadline;
 struct SendSegment;
+struct SendSegments;
 struct Write;
 struct Tick;
 struct Connect;
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Two clients talk to one tcp_udp server at the same time. Each client must receive everything the
+# server sends, and the server must receive what each client sends.
+
+SERVER_PORT=$(($((RANDOM % 50000)) + 1025))
+SERVER_IN=$(mktemp)
+SERVER_OUT=$(mktemp)
+CLIENT_OUT_1=$(mktemp)
+CLIENT_OUT_2=$(mktemp)
+trap 'rm -f "${SERVER_IN}" "${SERVER_OUT}" "${CLIENT_OUT_1}" "${CLIENT_OUT_2}"' EXIT
+
+dd status=none if=/dev/urandom of="${SERVER_IN}" bs=100000 count=1
+
+timeout 60 ./apps/tcp_udp -t 12 -l -n 2 127.0.0.1 ${SERVER_PORT} <"${SERVER_IN}" >"${SERVER_OUT}" &
+SERVER_PID=$!
+sleep 0.2
+echo alpha | timeout 60 ./apps/tcp_udp -t 12 127.0.0.1 ${SERVER_PORT} >"${CLIENT_OUT_1}" &
+CLIENT_PID_1=$!
+echo bravo | timeout 60 ./apps/tcp_udp -t 12 127.0.0.1 ${SERVER_PORT} >"${CLIENT_OUT_2}" &
+CLIENT_PID_2=$!
+
+if ! wait ${CLIENT_PID_1} || ! wait ${CLIENT_PID_2} || ! wait ${SERVER_PID}; then
+    echo ERROR: subprocess failed
+    exit 1
+fi
+
+if ! cmp -s "${SERVER_IN}" "${CLIENT_OUT_1}" || ! cmp -s "${SERVER_IN}" "${CLIENT_OUT_2}"; then
+    echo ERROR: a client did not receive what the server sent
+    exit 1
+fi
+
+if [ "$(sort "${SERVER_OUT}" | tr '\n' ' ')" != "alpha bravo " ]; then
+    echo ERROR: the server received \""$(cat "${SERVER_OUT}")"\" rather than one line from each client
+    exit 1
+fi
+exit 0
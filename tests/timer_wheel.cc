@@ -0,0 +1,106 @@
+#include "test_should_be.hh"
+#include "timer_wheel.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+//! Timers armed, cancelled and advanced at random fire at their expiry, and only then
+static void test_random(const uint64_t max_delay, const uint64_t max_step) {
+    auto rd = get_random_generator();
+    TimerWheel<uint32_t> wheel{rd()};
+    vector<TimerWheel<uint32_t>::Handle> handles;
+    map<uint32_t, uint64_t> expected;  // armed timers, by id, and their expiry
+    uint64_t last_fired = wheel.now();
+
+    const auto fire = [&](const uint32_t id) {
+        test_should_be(expected.count(id), size_t{1});
+        test_should_be(wheel.now(), expected[id]);
+        test_should_be(wheel.now() >= last_fired, true);
+        last_fired = wheel.now();
+        expected.erase(id);
+    };
+    for (unsigned round = 0; round < 2000; round++) {
+        for (unsigned i = rd() % 8; i > 0; i--) {
+            const uint64_t delay = uniform_int_distribution<uint64_t>{0, max_delay}(rd);
+            const auto id = static_cast<uint32_t>(handles.size());
+            handles.push_back(wheel.arm(delay, id));
+            expected[id] = wheel.now() + delay;
+        }
+        if (not handles.empty() and rd() % 3 == 0) {
+            const uint32_t id = rd() % handles.size();
+            test_should_be(wheel.cancel(handles[id]), expected.erase(id) == 1);
+            test_should_be(wheel.armed(handles[id]), false);
+        }
+        test_should_be(wheel.size(), expected.size());
+
+        // the next expiry is exact, whatever level the first timer waits at
+        optional<uint64_t> first{};
+        for (const auto &[id, expiry] : expected) {
+            first = first ? min(*first, expiry) : expiry;
+        }
+        const optional<uint64_t> next = wheel.next_expiry();
+        test_should_be(next.has_value(), first.has_value());
+        if (next) {
+            test_should_be(*next, *first - wheel.now());
+        }
+
+        const uint64_t target = wheel.now() + uniform_int_distribution<uint64_t>{0, max_step}(rd);
+        wheel.advance(target - wheel.now(), fire);
+        test_should_be(wheel.now(), target);
+        for (const auto &[id, expiry] : expected) {
+            test_should_be(expiry > target, true);
+        }
+    }
+}
+
+int main() {
+    try {
+        TimerWheel<int> wheel;
+
+        // a timer fires when its time has come, not before
+        const auto handle = wheel.arm(100, 1);
+        test_should_be(wheel.expiry(handle).value(), uint64_t{100});
+        vector<int> fired;
+        const auto fire = [&](const int value) { fired.push_back(value); };
+        wheel.advance(99, fire);
+        test_should_be(fired.size(), size_t{0});
+        wheel.advance(1, fire);
+        test_should_be(fired.size(), size_t{1});
+        test_should_be(wheel.armed(handle), false);
+        test_should_be(wheel.cancel(handle), false);
+
+        // a timer armed with no delay fires at the next advance, and a timer can arm another from inside advance()
+        wheel.arm(0, 2);
+        wheel.advance(0, [&](const int value) {
+            fired.push_back(value);
+            if (value < 4) {
+                wheel.arm(value == 2 ? 0 : 5000, value + 1);
+            }
+        });
+        test_should_be(fired.size(), size_t{3});
+        test_should_be(wheel.next_expiry().value(), uint64_t{5000});
+
+        // a handle to a fired timer does not name a new timer in the same node
+        const auto reused = wheel.arm(10, 5);
+        test_should_be(wheel.cancel(handle), false);
+        test_should_be(wheel.armed(reused), true);
+
+        test_random(100, 10);
+        test_random(10000, 1000);
+        test_random(uint64_t{1} << 40, uint64_t{1} << 36);
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}